@@ -0,0 +1,337 @@
+/*
+Copyright (c) 2011, Eric Haines
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "stdafx.h"
+#include <stdio.h>
+#include "BlockStates.h"
+
+// Minecraft's names for BLOCK_AIR through BLOCK_DARK_OAK_DOOR, in order
+static const char *gBlockStateName[NUM_BLOCKS_STANDARD] = {
+    "air", "stone", "grass", "dirt", "cobblestone", "planks", "sapling", "bedrock",
+    "flowing_water", "water", "flowing_lava", "lava", "sand", "gravel", "gold_ore", "iron_ore",
+    "coal_ore", "log", "leaves", "sponge", "glass", "lapis_ore", "lapis_block", "dispenser",
+    "sandstone", "noteblock", "bed", "golden_rail", "detector_rail", "sticky_piston", "web", "tallgrass",
+    "deadbush", "piston", "piston_head", "wool", "piston_extension", "yellow_flower", "red_flower", "brown_mushroom",
+    "red_mushroom", "gold_block", "iron_block", "double_stone_slab", "stone_slab", "brick_block", "tnt", "bookshelf",
+    "mossy_cobblestone", "obsidian", "torch", "fire", "mob_spawner", "oak_stairs", "chest", "redstone_wire",
+    "diamond_ore", "diamond_block", "crafting_table", "wheat", "farmland", "furnace", "lit_furnace", "standing_sign",
+    "wooden_door", "ladder", "rail", "stone_stairs", "wall_sign", "lever", "stone_pressure_plate", "iron_door",
+    "wooden_pressure_plate", "redstone_ore", "lit_redstone_ore", "unlit_redstone_torch", "redstone_torch", "stone_button", "snow_layer", "ice",
+    "snow", "cactus", "clay", "reeds", "jukebox", "fence", "pumpkin", "netherrack",
+    "soul_sand", "glowstone", "portal", "lit_pumpkin", "cake", "unpowered_repeater", "powered_repeater", "stained_glass",
+    "trapdoor", "monster_egg", "stonebrick", "brown_mushroom_block", "red_mushroom_block", "iron_bars", "glass_pane", "melon_block",
+    "pumpkin_stem", "melon_stem", "vine", "fence_gate", "brick_stairs", "stone_brick_stairs", "mycelium", "waterlily",
+    "nether_brick", "nether_brick_fence", "nether_brick_stairs", "nether_wart", "enchanting_table", "brewing_stand", "cauldron", "end_portal",
+    "end_portal_frame", "end_stone", "dragon_egg", "redstone_lamp", "lit_redstone_lamp", "double_wooden_slab", "wooden_slab", "cocoa",
+    "sandstone_stairs", "emerald_ore", "ender_chest", "tripwire_hook", "tripwire", "emerald_block", "spruce_stairs", "birch_stairs",
+    "jungle_stairs", "command_block", "beacon", "cobblestone_wall", "flower_pot", "carrots", "potatoes", "wooden_button",
+    "skull", "anvil", "trapped_chest", "light_weighted_pressure_plate", "heavy_weighted_pressure_plate", "unpowered_comparator", "powered_comparator", "daylight_detector",
+    "redstone_block", "quartz_ore", "hopper", "quartz_block", "quartz_stairs", "activator_rail", "dropper", "stained_hardened_clay",
+    "stained_glass_pane", "leaves2", "log2", "acacia_stairs", "dark_oak_stairs", "slime", "barrier", "iron_trapdoor",
+    "prismarine", "sea_lantern", "hay_block", "carpet", "hardened_clay", "coal_block", "packed_ice", "double_plant",
+    "standing_banner", "wall_banner", "daylight_detector_inverted", "red_sandstone", "red_sandstone_stairs", "double_stone_slab2", "stone_slab2", "spruce_fence_gate",
+    "birch_fence_gate", "jungle_fence_gate", "dark_oak_fence_gate", "acacia_fence_gate", "spruce_fence", "birch_fence", "jungle_fence", "dark_oak_fence",
+    "acacia_fence", "spruce_door", "birch_door", "jungle_door", "acacia_door", "dark_oak_door",
+};
+
+static const char *gColor[16] = { "white", "orange", "magenta", "light_blue", "yellow", "lime", "pink", "gray",
+    "silver", "cyan", "purple", "blue", "brown", "green", "red", "black" };
+static const char *gWood[8] = { "oak", "spruce", "birch", "jungle", "acacia", "dark_oak", "oak", "oak" };
+// data 0-3 of the horizontal blocks: beds, pumpkins, repeaters, gates and so on
+static const char *gHorizontal[4] = { "south", "west", "north", "east" };
+// data 0-5 of blocks that can face any way: dispensers, pistons, hoppers
+static const char *gFacing[8] = { "down", "up", "north", "south", "west", "east", "down", "down" };
+// data 0-7 of blocks that face away from what they're on: wall signs, ladders, chests, furnaces
+static const char *gWallFacing[8] = { "north", "north", "north", "south", "west", "east", "north", "north" };
+static const char *gStoneSlab[8] = { "stone", "sand", "wood_old", "cobblestone", "brick", "stone_brick", "nether_brick", "quartz" };
+static const char *gRailShape[16] = { "north_south", "east_west", "ascending_east", "ascending_west", "ascending_north", "ascending_south",
+    "south_east", "south_west", "north_west", "north_east",
+    "north_south", "north_south", "north_south", "north_south", "north_south", "north_south" };
+static const char *gMushroom[16] = { "all_inside", "north_west", "north", "north_east", "west", "center", "east", "south_west",
+    "south", "south_east", "stem", "all_inside", "all_inside", "all_inside", "all_outside", "all_stem" };
+
+#define TF( b ) ( (b) ? "true" : "false" )
+
+// pick a name from a list, using the first for data past the end of it
+#define PICK( list, i ) ( ( (i) < (int)(sizeof(list)/sizeof(list[0])) ) ? list[i] : list[0] )
+
+static const char *gStone[] = { "stone", "granite", "smooth_granite", "diorite", "smooth_diorite", "andesite", "smooth_andesite" };
+static const char *gDirt[] = { "dirt", "coarse_dirt", "podzol" };
+static const char *gSandstone[] = { "sandstone", "chiseled_sandstone", "smooth_sandstone" };
+static const char *gRedSandstone[] = { "red_sandstone", "chiseled_red_sandstone", "smooth_red_sandstone" };
+static const char *gTallGrass[] = { "dead_bush", "tall_grass", "fern" };
+static const char *gRedFlower[] = { "poppy", "blue_orchid", "allium", "houstonia", "red_tulip", "orange_tulip", "white_tulip", "pink_tulip", "oxeye_daisy" };
+static const char *gMonsterEgg[] = { "stone", "cobblestone", "stone_brick", "mossy_brick", "cracked_brick", "chiseled_brick" };
+static const char *gStoneBrick[] = { "stonebrick", "mossy_stonebrick", "cracked_stonebrick", "chiseled_stonebrick" };
+static const char *gQuartz[] = { "default", "chiseled", "lines_y", "lines_x", "lines_z" };
+static const char *gPrismarine[] = { "prismarine", "prismarine_bricks", "dark_prismarine" };
+static const char *gDoublePlant[] = { "sunflower", "syringa", "double_grass", "double_fern", "double_rose", "paeonia" };
+static const char *gAxis[] = { "y", "x", "z", "none" };
+static const char *gTorch[] = { "up", "east", "west", "south", "north", "up" };
+static const char *gLever[8] = { "down_x", "east", "west", "south", "north", "up_z", "up_x", "down_z" };
+static const char *gButton[8] = { "down", "east", "west", "south", "north", "up", "down", "down" };
+static const char *gDoorFacing[4] = { "east", "south", "west", "north" };
+static const char *gTrapdoorFacing[4] = { "north", "south", "west", "east" };
+static const char *gStairsFacing[4] = { "east", "west", "south", "north" };
+
+// Properties of the block's state, in Minecraft's order, which is by name. Returns 0 for blocks with none.
+static int getProperties( int type, int data, char *props, int size )
+{
+    switch ( type )
+    {
+    case BLOCK_STONE:
+        return sprintf_s( props, size, "variant=%s", PICK( gStone, data ) );
+    case BLOCK_GRASS:
+    case BLOCK_MYCELIUM:
+        return sprintf_s( props, size, "snowy=false" );
+    case BLOCK_DIRT:
+        return sprintf_s( props, size, "snowy=false,variant=%s", PICK( gDirt, data ) );
+    case BLOCK_WOODEN_PLANKS:
+    case BLOCK_WOODEN_DOUBLE_SLAB:
+        return sprintf_s( props, size, "variant=%s", gWood[data&0x7] );
+    case BLOCK_WOODEN_SLAB:
+        return sprintf_s( props, size, "half=%s,variant=%s", (data&0x8) ? "top" : "bottom", gWood[data&0x7] );
+    case BLOCK_DOUBLE_STONE_SLAB:
+        return sprintf_s( props, size, "seamless=%s,variant=%s", TF(data&0x8), gStoneSlab[data&0x7] );
+    case BLOCK_STONE_SLAB:
+        return sprintf_s( props, size, "half=%s,variant=%s", (data&0x8) ? "top" : "bottom", gStoneSlab[data&0x7] );
+    case BLOCK_DOUBLE_RED_SANDSTONE_SLAB:
+        return sprintf_s( props, size, "seamless=%s,variant=red_sandstone", TF(data&0x8) );
+    case BLOCK_RED_SANDSTONE_SLAB:
+        return sprintf_s( props, size, "half=%s,variant=red_sandstone", (data&0x8) ? "top" : "bottom" );
+    case BLOCK_SAPLING:
+        return sprintf_s( props, size, "stage=%d,type=%s", (data>>3)&0x1, gWood[data&0x7] );
+    case BLOCK_WATER:
+    case BLOCK_STATIONARY_WATER:
+    case BLOCK_LAVA:
+    case BLOCK_STATIONARY_LAVA:
+        return sprintf_s( props, size, "level=%d", data );
+    case BLOCK_SAND:
+        return sprintf_s( props, size, "variant=%s", (data&0x1) ? "red_sand" : "sand" );
+    case BLOCK_LOG:
+        return sprintf_s( props, size, "axis=%s,variant=%s", gAxis[(data>>2)&0x3], gWood[data&0x3] );
+    case BLOCK_AD_LOG:
+        return sprintf_s( props, size, "axis=%s,variant=%s", gAxis[(data>>2)&0x3], gWood[4+(data&0x1)] );
+    case BLOCK_LEAVES:
+        return sprintf_s( props, size, "check_decay=%s,decayable=%s,variant=%s", TF(data&0x8), TF(!(data&0x4)), gWood[data&0x3] );
+    case BLOCK_AD_LEAVES:
+        return sprintf_s( props, size, "check_decay=%s,decayable=%s,variant=%s", TF(data&0x8), TF(!(data&0x4)), gWood[4+(data&0x1)] );
+    case BLOCK_SPONGE:
+        return sprintf_s( props, size, "wet=%s", TF(data&0x1) );
+    case BLOCK_SANDSTONE:
+        return sprintf_s( props, size, "type=%s", PICK( gSandstone, data ) );
+    case BLOCK_RED_SANDSTONE:
+        return sprintf_s( props, size, "type=%s", PICK( gRedSandstone, data ) );
+    case BLOCK_TALL_GRASS:
+        return sprintf_s( props, size, "type=%s", PICK( gTallGrass, data ) );
+    case BLOCK_POPPY:
+        return sprintf_s( props, size, "type=%s", PICK( gRedFlower, data ) );
+    case BLOCK_WOOL:
+    case BLOCK_STAINED_GLASS:
+    case BLOCK_STAINED_CLAY:
+    case BLOCK_CARPET:
+        return sprintf_s( props, size, "color=%s", gColor[data] );
+    case BLOCK_STAINED_GLASS_PANE:
+        return sprintf_s( props, size, "color=%s,east=false,north=false,south=false,west=false", gColor[data] );
+    case BLOCK_HIDDEN_SILVERFISH:
+        return sprintf_s( props, size, "variant=%s", PICK( gMonsterEgg, data ) );
+    case BLOCK_STONE_BRICKS:
+        return sprintf_s( props, size, "variant=%s", PICK( gStoneBrick, data ) );
+    case BLOCK_COBBLESTONE_WALL:
+        return sprintf_s( props, size, "east=false,north=false,south=false,up=true,variant=%s,west=false", (data&0x1) ? "mossy_cobblestone" : "cobblestone" );
+    case BLOCK_QUARTZ_BLOCK:
+        return sprintf_s( props, size, "variant=%s", PICK( gQuartz, data ) );
+    case BLOCK_PRISMARINE:
+        return sprintf_s( props, size, "variant=%s", PICK( gPrismarine, data ) );
+    case BLOCK_HAY:
+        return sprintf_s( props, size, "axis=%s", gAxis[(data>>2)&0x3] );
+    case BLOCK_DOUBLE_FLOWER:
+        // the top half doesn't know which flower it is
+        return sprintf_s( props, size, "facing=north,half=%s,variant=%s", (data&0x8) ? "upper" : "lower", PICK( gDoublePlant, (data&0x8) ? 0 : data ) );
+    case BLOCK_HUGE_BROWN_MUSHROOM:
+    case BLOCK_HUGE_RED_MUSHROOM:
+        return sprintf_s( props, size, "variant=%s", gMushroom[data] );
+
+    case BLOCK_OAK_WOOD_STAIRS:
+    case BLOCK_COBBLESTONE_STAIRS:
+    case BLOCK_BRICK_STAIRS:
+    case BLOCK_STONE_BRICK_STAIRS:
+    case BLOCK_NETHER_BRICK_STAIRS:
+    case BLOCK_SANDSTONE_STAIRS:
+    case BLOCK_SPRUCE_WOOD_STAIRS:
+    case BLOCK_BIRCH_WOOD_STAIRS:
+    case BLOCK_JUNGLE_WOOD_STAIRS:
+    case BLOCK_QUARTZ_STAIRS:
+    case BLOCK_ACACIA_WOOD_STAIRS:
+    case BLOCK_DARK_OAK_WOOD_STAIRS:
+    case BLOCK_RED_SANDSTONE_STAIRS:
+        return sprintf_s( props, size, "facing=%s,half=%s,shape=straight", gStairsFacing[data&0x3], (data&0x4) ? "top" : "bottom" );
+
+    case BLOCK_TORCH:
+    case BLOCK_REDSTONE_TORCH_OFF:
+    case BLOCK_REDSTONE_TORCH_ON:
+        return sprintf_s( props, size, "facing=%s", PICK( gTorch, data ) );
+    case BLOCK_LADDER:
+    case BLOCK_WALL_SIGN:
+    case BLOCK_WALL_BANNER:
+    case BLOCK_CHEST:
+    case BLOCK_TRAPPED_CHEST:
+    case BLOCK_ENDER_CHEST:
+    case BLOCK_FURNACE:
+    case BLOCK_BURNING_FURNACE:
+        return sprintf_s( props, size, "facing=%s", gWallFacing[data&0x7] );
+    case BLOCK_SIGN_POST:
+    case BLOCK_STANDING_BANNER:
+        return sprintf_s( props, size, "rotation=%d", data );
+    case BLOCK_PUMPKIN:
+    case BLOCK_JACK_O_LANTERN:
+        return sprintf_s( props, size, "facing=%s", gHorizontal[data&0x3] );
+    case BLOCK_DISPENSER:
+    case BLOCK_DROPPER:
+        return sprintf_s( props, size, "facing=%s,triggered=%s", gFacing[data&0x7], TF(data&0x8) );
+    case BLOCK_PISTON:
+    case BLOCK_STICKY_PISTON:
+        return sprintf_s( props, size, "extended=%s,facing=%s", TF(data&0x8), gFacing[data&0x7] );
+    case BLOCK_PISTON_HEAD:
+        return sprintf_s( props, size, "facing=%s,short=false,type=%s", gFacing[data&0x7], (data&0x8) ? "sticky" : "normal" );
+    case BLOCK_HOPPER:
+        return sprintf_s( props, size, "enabled=%s,facing=%s", TF(!(data&0x8)), gFacing[data&0x7] );
+    case BLOCK_HEAD:
+        return sprintf_s( props, size, "facing=%s,nodrop=%s", gFacing[data&0x7], TF(data&0x8) );
+    case BLOCK_BED:
+        return sprintf_s( props, size, "facing=%s,occupied=%s,part=%s", gHorizontal[data&0x3], TF(data&0x4), (data&0x8) ? "head" : "foot" );
+
+    case BLOCK_RAIL:
+        return sprintf_s( props, size, "shape=%s", gRailShape[data] );
+    case BLOCK_POWERED_RAIL:
+    case BLOCK_DETECTOR_RAIL:
+    case BLOCK_ACTIVATOR_RAIL:
+        return sprintf_s( props, size, "powered=%s,shape=%s", TF(data&0x8), gRailShape[(data&0x7) > 5 ? 0 : (data&0x7)] );
+
+    case BLOCK_WOODEN_DOOR:
+    case BLOCK_IRON_DOOR:
+    case BLOCK_SPRUCE_DOOR:
+    case BLOCK_BIRCH_DOOR:
+    case BLOCK_JUNGLE_DOOR:
+    case BLOCK_ACACIA_DOOR:
+    case BLOCK_DARK_OAK_DOOR:
+        // each half of a door keeps only some of its state: the bottom its facing and whether it's open,
+        // the top its hinge and whether it's powered
+        if ( data & 0x8 )
+        {
+            return sprintf_s( props, size, "facing=east,half=upper,hinge=%s,open=false,powered=%s", (data&0x1) ? "right" : "left", TF(data&0x2) );
+        }
+        return sprintf_s( props, size, "facing=%s,half=lower,hinge=left,open=%s,powered=false", gDoorFacing[data&0x3], TF(data&0x4) );
+    case BLOCK_TRAPDOOR:
+    case BLOCK_IRON_TRAPDOOR:
+        return sprintf_s( props, size, "facing=%s,half=%s,open=%s", gTrapdoorFacing[data&0x3], (data&0x8) ? "top" : "bottom", TF(data&0x4) );
+    case BLOCK_FENCE_GATE:
+    case BLOCK_SPRUCE_FENCE_GATE:
+    case BLOCK_BIRCH_FENCE_GATE:
+    case BLOCK_JUNGLE_FENCE_GATE:
+    case BLOCK_DARK_OAK_FENCE_GATE:
+    case BLOCK_ACACIA_FENCE_GATE:
+        return sprintf_s( props, size, "facing=%s,in_wall=false,open=%s,powered=false", gHorizontal[data&0x3], TF(data&0x4) );
+
+    case BLOCK_REDSTONE_WIRE:
+        return sprintf_s( props, size, "east=none,north=none,power=%d,south=none,west=none", data );
+    case BLOCK_REDSTONE_REPEATER_OFF:
+    case BLOCK_REDSTONE_REPEATER_ON:
+        return sprintf_s( props, size, "delay=%d,facing=%s,locked=false", ((data>>2)&0x3)+1, gHorizontal[data&0x3] );
+    case BLOCK_REDSTONE_COMPARATOR_INACTIVE:
+    case BLOCK_REDSTONE_COMPARATOR_ACTIVE:
+        return sprintf_s( props, size, "facing=%s,mode=%s,powered=%s", gHorizontal[data&0x3], (data&0x4) ? "subtract" : "compare", TF(data&0x8) );
+    case BLOCK_LEVER:
+        return sprintf_s( props, size, "facing=%s,powered=%s", gLever[data&0x7], TF(data&0x8) );
+    case BLOCK_STONE_BUTTON:
+    case BLOCK_WOODEN_BUTTON:
+        return sprintf_s( props, size, "facing=%s,powered=%s", gButton[data&0x7], TF(data&0x8) );
+    case BLOCK_STONE_PRESSURE_PLATE:
+    case BLOCK_WOODEN_PRESSURE_PLATE:
+        return sprintf_s( props, size, "powered=%s", TF(data&0x1) );
+    case BLOCK_WEIGHTED_PRESSURE_PLATE_LIGHT:
+    case BLOCK_WEIGHTED_PRESSURE_PLATE_HEAVY:
+    case BLOCK_DAYLIGHT_SENSOR:
+    case BLOCK_INVERTED_DAYLIGHT_SENSOR:
+        return sprintf_s( props, size, "power=%d", data );
+    case BLOCK_TRIPWIRE_HOOK:
+        return sprintf_s( props, size, "attached=%s,facing=%s,powered=%s", TF(data&0x4), gHorizontal[data&0x3], TF(data&0x8) );
+
+    case BLOCK_CROPS:
+    case BLOCK_CARROTS:
+    case BLOCK_POTATOES:
+        return sprintf_s( props, size, "age=%d", data&0x7 );
+    case BLOCK_PUMPKIN_STEM:
+    case BLOCK_MELON_STEM:
+        return sprintf_s( props, size, "age=%d,facing=up", data&0x7 );
+    case BLOCK_NETHER_WART:
+        return sprintf_s( props, size, "age=%d", data&0x3 );
+    case BLOCK_CACTUS:
+    case BLOCK_SUGAR_CANE:
+    case BLOCK_FIRE:
+        return sprintf_s( props, size, "age=%d", data );
+    case BLOCK_COCOA_PLANT:
+        return sprintf_s( props, size, "age=%d,facing=%s", (data>>2)&0x3, gHorizontal[data&0x3] );
+    case BLOCK_FARMLAND:
+        return sprintf_s( props, size, "moisture=%d", data&0x7 );
+    case BLOCK_SNOW:
+        return sprintf_s( props, size, "layers=%d", (data&0x7)+1 );
+    case BLOCK_VINES:
+        return sprintf_s( props, size, "east=%s,north=%s,south=%s,up=false,west=%s", TF(data&0x8), TF(data&0x4), TF(data&0x1), TF(data&0x2) );
+    case BLOCK_CAKE:
+        return sprintf_s( props, size, "bites=%d", (data&0x7) > 6 ? 0 : (data&0x7) );
+    case BLOCK_CAULDRON:
+        return sprintf_s( props, size, "level=%d", data&0x3 );
+    case BLOCK_BREWING_STAND:
+        return sprintf_s( props, size, "has_bottle_0=%s,has_bottle_1=%s,has_bottle_2=%s", TF(data&0x1), TF(data&0x2), TF(data&0x4) );
+    case BLOCK_END_PORTAL_FRAME:
+        return sprintf_s( props, size, "eye=%s,facing=%s", TF(data&0x4), gHorizontal[data&0x3] );
+    case BLOCK_ANVIL:
+        return sprintf_s( props, size, "damage=%d,facing=%s", (data>>2)&0x3, gHorizontal[data&0x3] );
+    default:
+        break;
+    }
+    return 0;
+}
+
+int GetBlockStateString( int type, int data, char *stateString, int size )
+{
+    char props[256];
+
+    if ( type < 0 || type >= NUM_BLOCKS_STANDARD )
+    {
+        type = BLOCK_AIR;
+    }
+    data &= 0xf;
+
+    if ( getProperties( type, data, props, 256 ) > 0 )
+    {
+        return sprintf_s( stateString, size, "minecraft:%s[%s]", gBlockStateName[type], props );
+    }
+    return sprintf_s( stateString, size, "minecraft:%s", gBlockStateName[type] );
+}
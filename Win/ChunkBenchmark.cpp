@@ -0,0 +1,408 @@
+/*
+Copyright (c) 2011, Eric Haines
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "stdafx.h"
+#include <stdio.h>
+#ifndef WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include "ChunkBenchmark.h"
+
+#define REGION_SECTOR       4096
+
+// how many of the slowest chunks to list
+#define SLOWEST_CHUNKS      10
+
+// the stages of reading a chunk that are timed, and their total
+enum {
+    CHUNK_READ,         // opening the region file, seeking, and reading the chunk's sectors
+    CHUNK_INFLATE,
+    CHUNK_PARSE,        // nbtGetBlocks
+    CHUNK_TOTAL,
+    CHUNK_STAGE_COUNT
+};
+
+static const char *gChunkStageName[CHUNK_STAGE_COUNT] = {
+    "read",
+    "inflate",
+    "parse",
+    "total",
+};
+
+typedef struct ChunkSample {
+    int fileNo;         // which region file
+    int cx, cz;         // chunk location in the world
+    int sectors;        // 4 KB sectors given to the chunk in the region header
+    int length;         // compressed length of the chunk, from its own header
+    int ok;             // read and parsed without error
+    double seconds[CHUNK_STAGE_COUNT];
+} ChunkSample;
+
+typedef struct ChunkBenchmark {
+    wchar_t regionDir[MAX_PATH];    // where the region files are
+    wchar_t (*fileName)[MAX_PATH];
+    int fileCount;
+    int filesAllocated;
+    ChunkSample *sample;
+    int sampleCount;
+    int samplesAllocated;
+} ChunkBenchmark;
+
+// buffers for a chunk's contents; only the timing matters, not what's in them
+typedef struct ChunkBuffers {
+    unsigned char block[16*16*256];
+    unsigned char data[16*16*128];
+    unsigned char light[16*16*128];
+    unsigned char biome[16*16];
+} ChunkBuffers;
+
+static int findRegionFiles( const wchar_t *directory, ChunkBenchmark *pBench );
+static int addRegionFile( const wchar_t *fileName, void *context );
+static int readRegionHeader( ChunkBenchmark *pBench, int fileNo, int rx, int rz );
+static ChunkSample *addSample( ChunkBenchmark *pBench );
+static void dropFileCache( const wchar_t *fileName );
+static void printStages( ChunkBenchmark *pBench );
+static void printSizes( ChunkBenchmark *pBench );
+static void printSlowest( ChunkBenchmark *pBench );
+static int writeChunkList( ChunkBenchmark *pBench, const wchar_t *chunkListFile );
+
+
+int RunChunkBenchmark( const wchar_t *directory, int cold, const wchar_t *chunkListFile )
+{
+    ChunkBenchmark bench;
+    long long frequency, start, end;
+    int failed = 0;
+    int i;
+
+    memset( &bench, 0, sizeof(ChunkBenchmark) );
+    if ( findRegionFiles( directory, &bench ) != 0 || bench.sampleCount == 0 )
+    {
+        fwprintf( stderr, L"No chunks found in the region files in %ls\n", directory );
+        free( bench.fileName );
+        free( bench.sample );
+        return -1;
+    }
+
+    ChunkBuffers *pBuffers = (ChunkBuffers *)malloc( sizeof(ChunkBuffers) );
+    if ( pBuffers == NULL )
+    {
+        free( bench.fileName );
+        free( bench.sample );
+        return -1;
+    }
+
+    fwprintf( stderr, L"Reading %d chunks from %d region files, %ls cache\n", bench.sampleCount, bench.fileCount, cold ? L"cold" : L"warm" );
+
+    frequency = PortaTicksPerSecond();
+    for ( i = 0; i < bench.sampleCount; i++ )
+    {
+        ChunkSample *pSample = &bench.sample[i];
+        const wchar_t *fileName = bench.fileName[pSample->fileNo];
+        int calls;
+        double cpu;
+
+        if ( cold )
+            dropFileCache( fileName );
+
+        // regionFileGetBlocks times its own stages
+        Timing_Reset( 1 );
+        start = PortaTicks();
+        pSample->ok = regionFileGetBlocks( fileName, pSample->cx, pSample->cz, pBuffers->block, pBuffers->data, pBuffers->light, pBuffers->biome );
+        end = PortaTicks();
+
+        Timing_GetStage( TIMING_REGION_READ, &pSample->seconds[CHUNK_READ], &cpu, &calls );
+        Timing_GetStage( TIMING_INFLATE, &pSample->seconds[CHUNK_INFLATE], &cpu, &calls );
+        Timing_GetStage( TIMING_NBT_PARSE, &pSample->seconds[CHUNK_PARSE], &cpu, &calls );
+        pSample->seconds[CHUNK_TOTAL] = (double)(end - start) / (double)frequency;
+        if ( !pSample->ok )
+        {
+            failed++;
+            fwprintf( stderr, L"Cannot read chunk %d %d from %ls\n", pSample->cx, pSample->cz, fileName );
+        }
+    }
+    Timing_Reset( 0 );
+    free( pBuffers );
+
+    printStages( &bench );
+    printSizes( &bench );
+    printSlowest( &bench );
+    if ( chunkListFile != NULL )
+    {
+        if ( writeChunkList( &bench, chunkListFile ) != 0 )
+            fwprintf( stderr, L"Cannot write chunk list %ls\n", chunkListFile );
+    }
+    if ( failed > 0 )
+        wprintf( L"%d of %d chunks could not be read\n", failed, bench.sampleCount );
+
+    free( bench.fileName );
+    free( bench.sample );
+    return ( failed > 0 ) ? 1 : 0;
+}
+
+// Find the region files in directory, or in its region subdirectory, and the chunks in each.
+static int findRegionFiles( const wchar_t *directory, ChunkBenchmark *pBench )
+{
+    int rc;
+
+    // a world directory has its region files one level down
+    swprintf_s( pBench->regionDir, MAX_PATH, L"%ls" PORTA_SLASH L"region", directory );
+    rc = PortaScanDirectory( pBench->regionDir, addRegionFile, pBench );
+    if ( rc < 0 )
+    {
+        wcscpy_s( pBench->regionDir, MAX_PATH, directory );
+        rc = PortaScanDirectory( pBench->regionDir, addRegionFile, pBench );
+    }
+    return ( rc == 0 ) ? 0 : -1;
+}
+
+// Add the file, if it is a region file, and the chunks in it. Returns 1 if out of memory, which stops the scan.
+static int addRegionFile( const wchar_t *fileName, void *context )
+{
+    ChunkBenchmark *pBench = (ChunkBenchmark *)context;
+    wchar_t ending[8];
+    int rx, rz;
+
+    // the region's location is in its name; skip anything else
+    if ( swscanf_s( fileName, L"r.%d.%d.%3ls", &rx, &rz, ending, 8 ) != 3 || wcscmp( ending, L"mca" ) != 0 )
+        return 0;
+
+    if ( pBench->fileCount >= pBench->filesAllocated )
+    {
+        pBench->filesAllocated = ( pBench->filesAllocated == 0 ) ? 64 : 2*pBench->filesAllocated;
+        wchar_t (*newNames)[MAX_PATH] = (wchar_t (*)[MAX_PATH])realloc( pBench->fileName, pBench->filesAllocated*sizeof(pBench->fileName[0]) );
+        if ( newNames == NULL )
+            return 1;
+        pBench->fileName = newNames;
+    }
+    swprintf_s( pBench->fileName[pBench->fileCount], MAX_PATH, L"%ls" PORTA_SLASH L"%ls", pBench->regionDir, fileName );
+    if ( readRegionHeader( pBench, pBench->fileCount, rx, rz ) == 0 )
+        pBench->fileCount++;
+    return 0;
+}
+
+// Add a sample for each chunk the region file's header lists, with its size.
+static int readRegionHeader( ChunkBenchmark *pBench, int fileNo, int rx, int rz )
+{
+#ifdef WIN32
+    DWORD br;
+#endif
+    unsigned char header[REGION_SECTOR];
+    unsigned char chunkHeader[5];
+
+    PORTAFILE regionFile = PortaOpen( pBench->fileName[fileNo] );
+    if ( regionFile == INVALID_HANDLE_VALUE )
+        return -1;
+    if ( PortaRead( regionFile, header, REGION_SECTOR ) )
+    {
+        PortaClose( regionFile );
+        return -1;
+    }
+
+    for ( int i = 0; i < 1024; i++ )
+    {
+        int offset = ( header[4*i]<<16 ) | ( header[4*i+1]<<8 ) | header[4*i+2];
+        int sectors = header[4*i+3];
+        if ( offset == 0 )
+            continue;
+
+        ChunkSample *pSample = addSample( pBench );
+        if ( pSample == NULL )
+        {
+            PortaClose( regionFile );
+            return -1;
+        }
+        pSample->fileNo = fileNo;
+        pSample->cx = rx*32 + ( i & 31 );
+        pSample->cz = rz*32 + ( i >> 5 );
+        pSample->sectors = sectors;
+        if ( PortaSeek( regionFile, REGION_SECTOR*offset ) || PortaRead( regionFile, chunkHeader, 5 ) )
+            pSample->length = 0;
+        else
+            pSample->length = ( chunkHeader[0]<<24 ) | ( chunkHeader[1]<<16 ) | ( chunkHeader[2]<<8 ) | chunkHeader[3];
+    }
+    PortaClose( regionFile );
+    return 0;
+}
+
+static ChunkSample *addSample( ChunkBenchmark *pBench )
+{
+    if ( pBench->sampleCount >= pBench->samplesAllocated )
+    {
+        pBench->samplesAllocated = ( pBench->samplesAllocated == 0 ) ? 1024 : 2*pBench->samplesAllocated;
+        ChunkSample *newSamples = (ChunkSample *)realloc( pBench->sample, pBench->samplesAllocated*sizeof(ChunkSample) );
+        if ( newSamples == NULL )
+            return NULL;
+        pBench->sample = newSamples;
+    }
+    ChunkSample *pSample = &pBench->sample[pBench->sampleCount++];
+    memset( pSample, 0, sizeof(ChunkSample) );
+    return pSample;
+}
+
+// Windows throws away what it has cached of a file when the file is opened unbuffered, so the
+// next read comes from the disk. This only works when no one else has the file open.
+// Elsewhere the kernel is asked to drop the file's pages, which it does for pages no one has dirty.
+static void dropFileCache( const wchar_t *fileName )
+{
+#ifdef WIN32
+    HANDLE hFile = CreateFileW( fileName, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_FLAG_NO_BUFFERING, NULL );
+    if ( hFile != INVALID_HANDLE_VALUE )
+        CloseHandle( hFile );
+#else
+    char name[MAX_PATH*4];
+    portaFileName( fileName, name, MAX_PATH*4 );
+    int fd = open( name, O_RDONLY );
+    if ( fd >= 0 )
+    {
+        posix_fadvise( fd, 0, 0, POSIX_FADV_DONTNEED );
+        close( fd );
+    }
+#endif
+}
+
+// total, mean and percentiles of each stage, in milliseconds
+static void printStages( ChunkBenchmark *pBench )
+{
+    double *sorted = (double *)malloc( pBench->sampleCount*sizeof(double) );
+    if ( sorted == NULL )
+        return;
+
+    wprintf( L"stage\ttotal s\tmean ms\tp50 ms\tp90 ms\tp99 ms\tmax ms\n" );
+    for ( int stage = 0; stage < CHUNK_STAGE_COUNT; stage++ )
+    {
+        double total = 0.0;
+        int count = 0;
+        for ( int i = 0; i < pBench->sampleCount; i++ )
+        {
+            if ( pBench->sample[i].ok )
+            {
+                sorted[count++] = pBench->sample[i].seconds[stage];
+                total += pBench->sample[i].seconds[stage];
+            }
+        }
+        if ( count == 0 )
+            break;
+        qsort( sorted, count, sizeof(double), Timing_CompareDoubles );
+        wprintf( L"%hs\t%.3f\t%.3f\t%.3f\t%.3f\t%.3f\t%.3f\n", gChunkStageName[stage], total, 1000.0*total/count,
+            1000.0*Timing_Percentile( sorted, count, 0.5 ), 1000.0*Timing_Percentile( sorted, count, 0.9 ),
+            1000.0*Timing_Percentile( sorted, count, 0.99 ), 1000.0*sorted[count-1] );
+    }
+    free( sorted );
+}
+
+// how the chunks' sizes are spread, from the region headers and the chunks' own lengths
+static void printSizes( ChunkBenchmark *pBench )
+{
+    // chunks taking 1, 2, 3, 4, 5-8, 9-16, 17-32 and more sectors
+    static const int bucketTop[] = { 1, 2, 3, 4, 8, 16, 32, 255 };
+    int bucketCount[sizeof(bucketTop)/sizeof(bucketTop[0])];
+    long long totalBytes = 0;
+    int bucket, i;
+
+    double *sorted = (double *)malloc( pBench->sampleCount*sizeof(double) );
+    if ( sorted == NULL )
+        return;
+
+    memset( bucketCount, 0, sizeof(bucketCount) );
+    for ( i = 0; i < pBench->sampleCount; i++ )
+    {
+        for ( bucket = 0; pBench->sample[i].sectors > bucketTop[bucket]; bucket++ )
+            ;
+        bucketCount[bucket]++;
+        sorted[i] = (double)pBench->sample[i].length;
+        totalBytes += pBench->sample[i].length;
+    }
+    qsort( sorted, pBench->sampleCount, sizeof(double), Timing_CompareDoubles );
+
+    wprintf( L"\nsectors\tchunks\tpercent\n" );
+    for ( bucket = 0; bucket < (int)(sizeof(bucketTop)/sizeof(bucketTop[0])); bucket++ )
+    {
+        int bottom = ( bucket == 0 ) ? 1 : bucketTop[bucket-1] + 1;
+        if ( bottom == bucketTop[bucket] )
+            wprintf( L"%d", bottom );
+        else
+            wprintf( L"%d-%d", bottom, bucketTop[bucket] );
+        wprintf( L"\t%d\t%.1f\n", bucketCount[bucket], 100.0*bucketCount[bucket]/pBench->sampleCount );
+    }
+    wprintf( L"\ncompressed bytes: mean %.0f, p50 %.0f, p90 %.0f, p99 %.0f, max %.0f\n",
+        (double)totalBytes/pBench->sampleCount, Timing_Percentile( sorted, pBench->sampleCount, 0.5 ),
+        Timing_Percentile( sorted, pBench->sampleCount, 0.9 ), Timing_Percentile( sorted, pBench->sampleCount, 0.99 ),
+        sorted[pBench->sampleCount-1] );
+    free( sorted );
+}
+
+// the chunks that took longest in all, worst first
+static void printSlowest( ChunkBenchmark *pBench )
+{
+    int slowest[SLOWEST_CHUNKS];
+    int slowCount = 0;
+    int i, j;
+
+    // keep a short list in order, as the whole list can be large
+    for ( i = 0; i < pBench->sampleCount; i++ )
+    {
+        double seconds = pBench->sample[i].seconds[CHUNK_TOTAL];
+        if ( slowCount == SLOWEST_CHUNKS && seconds <= pBench->sample[slowest[slowCount-1]].seconds[CHUNK_TOTAL] )
+            continue;
+        if ( slowCount < SLOWEST_CHUNKS )
+            slowCount++;
+        for ( j = slowCount-1; j > 0 && pBench->sample[slowest[j-1]].seconds[CHUNK_TOTAL] < seconds; j-- )
+            slowest[j] = slowest[j-1];
+        slowest[j] = i;
+    }
+
+    wprintf( L"\nslowest chunks\ncx\tcz\tsectors\tbytes\tread ms\tinflate ms\tparse ms\ttotal ms\tfile\n" );
+    for ( i = 0; i < slowCount; i++ )
+    {
+        ChunkSample *pSample = &pBench->sample[slowest[i]];
+        wprintf( L"%d\t%d\t%d\t%d\t%.3f\t%.3f\t%.3f\t%.3f\t%ls\n", pSample->cx, pSample->cz, pSample->sectors, pSample->length,
+            1000.0*pSample->seconds[CHUNK_READ], 1000.0*pSample->seconds[CHUNK_INFLATE], 1000.0*pSample->seconds[CHUNK_PARSE],
+            1000.0*pSample->seconds[CHUNK_TOTAL], pBench->fileName[pSample->fileNo] );
+    }
+}
+
+// every chunk, one per line, for looking at in a spreadsheet or comparing runs
+static int writeChunkList( ChunkBenchmark *pBench, const wchar_t *chunkListFile )
+{
+    FILE *fh;
+    if ( _wfopen_s( &fh, chunkListFile, L"wt" ) != 0 )
+        return -1;
+
+    fprintf( fh, "cx\tcz\tsectors\tbytes\tok\tread ms\tinflate ms\tparse ms\ttotal ms\n" );
+    for ( int i = 0; i < pBench->sampleCount; i++ )
+    {
+        ChunkSample *pSample = &pBench->sample[i];
+        fprintf( fh, "%d\t%d\t%d\t%d\t%d\t%.4f\t%.4f\t%.4f\t%.4f\n", pSample->cx, pSample->cz, pSample->sectors, pSample->length, pSample->ok,
+            1000.0*pSample->seconds[CHUNK_READ], 1000.0*pSample->seconds[CHUNK_INFLATE], 1000.0*pSample->seconds[CHUNK_PARSE],
+            1000.0*pSample->seconds[CHUNK_TOTAL] );
+    }
+    int retCode = ferror( fh ) ? -1 : 0;
+    fclose( fh );
+    return retCode;
+}
@@ -0,0 +1,1206 @@
+/*
+Copyright (c) 2011, Eric Haines
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "stdafx.h"
+#include <stdio.h>
+#include <assert.h>
+#ifdef WIN32
+#include "XZip.h"
+#endif
+#include "ZipWriter.h"
+#include "ExportDriver.h"
+
+// Number of lines to read from the header - don't want to go too far
+#define HEADER_LINES 60
+
+static const wchar_t *gExportNoteText[EXPORT_NOTE_COUNT] = {
+    L"Note: color output is not supported for ASCII text STL.\nFile will contain no colors.",	// <<0
+    L"Note: texture output is not supported for binary STL.\nFile will contain VisCAM colors instead.",	// <<1
+    L"Note: texture output is not supported for binary STL.\nFile will contain Materialise Magics colors instead.",	// <<2
+    L"Note: texture output is not supported for binary PLY.\nFile will contain per-face colors instead.",	// <<3
+};
+
+static int readLineSet( FILE *fh, char lines[HEADER_LINES][120], int maxLine );
+static int readLine( FILE *fh, char *inputString, int stringLength );
+static int findLine( char *checkString, char lines[HEADER_LINES][120], int startLine, int maxLines );
+static const wchar_t *removePath( const wchar_t *src );
+static void saveMemoryFiles( FileList *pOutputFileList );
+
+
+#define INIT_ALL_FILE_TYPES( a, v0,v1,v2,v3,v4,v5,v6,v7,v8)    \
+    (a)[FILE_TYPE_WAVEFRONT_REL_OBJ] = (v0);    \
+    (a)[FILE_TYPE_WAVEFRONT_ABS_OBJ] = (v1);    \
+    (a)[FILE_TYPE_BINARY_MAGICS_STL] = (v2);    \
+    (a)[FILE_TYPE_BINARY_VISCAM_STL] = (v3);    \
+    (a)[FILE_TYPE_ASCII_STL] = (v4);    \
+    (a)[FILE_TYPE_VRML2] = (v5);	\
+    (a)[FILE_TYPE_BINARY_PLY] = (v6);	\
+    (a)[FILE_TYPE_GLTF] = (v7);	\
+    (a)[FILE_TYPE_SCHEMATIC] = (v8);
+
+void InitializeExportSettings( ExportFileData *pPrint, ExportFileData *pView, ExportFileData *pSchematic )
+{
+    // by default, make everything 0 - off
+    memset(pPrint,0,sizeof(ExportFileData));
+
+    // turn stuff on
+    pPrint->fileType = FILE_TYPE_VRML2;
+
+    INIT_ALL_FILE_TYPES( pPrint->chkCreateZip,         1, 1, 0, 0, 0, 1, 0, 0, 0);
+    // I used to set the last value to 0, meaning only the zip would be created. The idea
+    // was that the naive user would then only have the zip, and so couldn't screw up
+    // when uploading the model file. But this setting is a pain if you want to preview
+    // the model file, you have to always remember to check the box so you can get the
+    // preview files. So, now it's off.
+    INIT_ALL_FILE_TYPES( pPrint->chkCreateModelFiles,  1, 1, 1, 1, 1, 1, 1, 1, 1);
+
+    // OBJ and VRML have color, depending...
+    // order: OBJ, BSTL, ASTL, VRML
+    INIT_ALL_FILE_TYPES( pPrint->radioExportNoMaterials,  0, 0, 0, 0, 1, 0, 0, 0, 1);
+    // might as well export color with OBJ and binary STL - nice for previewing
+    INIT_ALL_FILE_TYPES( pPrint->radioExportMtlColors,    0, 0, 1, 1, 0, 0, 1, 0, 0);  
+    INIT_ALL_FILE_TYPES( pPrint->radioExportSolidTexture, 0, 0, 0, 0, 0, 0, 0, 0, 0);  
+    INIT_ALL_FILE_TYPES( pPrint->radioExportFullTexture,  1, 1, 0, 0, 0, 1, 0, 1, 0);  
+
+    pPrint->chkMergeFlattop = 1;
+    // Shapeways imports VRML files and displays them with Y up, that is, it
+    // rotates them itself. Sculpteo imports OBJ, and likes Z is up, so we export with this on.
+    // STL uses Z is up, even though i.materialise's previewer shows Y is up.
+    INIT_ALL_FILE_TYPES( pPrint->chkMakeZUp, 1, 1, 1, 1, 1, 0, 1, 0, 0);  
+    pPrint->chkCenterModel = 1;
+    pPrint->chkExportAll = 0; 
+    pPrint->chkFatten = 0; 
+    pPrint->chkIndividualBlocks = 0;
+    pPrint->chkBiome = 0;
+
+    pPrint->radioRotate0 = 1;
+
+    pPrint->radioScaleByBlock = 1;
+    pPrint->modelHeightVal = 5.0f;    // 5 cm target height
+    INIT_ALL_FILE_TYPES( pPrint->blockSizeVal,
+        METERS_TO_MM * gMtlCostTable[PRINT_MATERIAL_FULL_COLOR_SANDSTONE].minWall,
+        METERS_TO_MM * gMtlCostTable[PRINT_MATERIAL_FULL_COLOR_SANDSTONE].minWall,
+        METERS_TO_MM * gMtlCostTable[PRINT_MATERIAL_FULL_COLOR_SANDSTONE].minWall,
+        METERS_TO_MM * gMtlCostTable[PRINT_MATERIAL_FULL_COLOR_SANDSTONE].minWall,
+        METERS_TO_MM * gMtlCostTable[PRINT_MATERIAL_WHITE_STRONG_FLEXIBLE].minWall,
+        METERS_TO_MM * gMtlCostTable[PRINT_MATERIAL_FULL_COLOR_SANDSTONE].minWall,
+        METERS_TO_MM * gMtlCostTable[PRINT_MATERIAL_FULL_COLOR_SANDSTONE].minWall,
+        METERS_TO_MM * gMtlCostTable[PRINT_MATERIAL_FULL_COLOR_SANDSTONE].minWall,
+        METERS_TO_MM * gMtlCostTable[PRINT_MATERIAL_FULL_COLOR_SANDSTONE].minWall);
+    pPrint->costVal = 25.00f;
+
+    pPrint->chkSealEntrances = 0; // left off by default: useful, but the user should want to do this
+    pPrint->chkSealSideTunnels = 0; // left off by default: useful, but the user should want to do this
+    pPrint->chkFillBubbles = 1;
+    pPrint->chkConnectParts = 1;
+    pPrint->chkConnectCornerTips = 1;
+    // it's actually better to start with manifold off and see if there are lots of groups.
+    pPrint->chkConnectAllEdges = 0;
+    pPrint->chkDeleteFloaters = 1;
+    pPrint->chkMeltSnow = 0;
+
+    pPrint->chkShowParts = 0;
+    pPrint->chkShowWelds = 0;
+
+    pPrint->chkMultipleObjects = 1;
+    pPrint->chkMaterialPerType = 1;
+    // we want a neutral material for printing (the rest is not all that important), as the SAP Viewer needs this
+    pPrint->chkG3DMaterial = 1;
+
+    pPrint->floaterCountVal = 16;
+    INIT_ALL_FILE_TYPES( pPrint->chkHollow, 1, 1, 0, 0, 0, 1, 0, 0, 0);
+    INIT_ALL_FILE_TYPES( pPrint->chkSuperHollow, 1, 1, 0, 0, 0, 1, 0, 0, 0);
+    INIT_ALL_FILE_TYPES( pPrint->chkHollowByDistance, 0,0,0,0,0,0,0,0,0);
+    INIT_ALL_FILE_TYPES( pPrint->chkDrainHoles, 0,0,0,0,0,0,0,0,0);
+    INIT_ALL_FILE_TYPES( pPrint->hollowThicknessVal,
+        METERS_TO_MM * gMtlCostTable[PRINT_MATERIAL_FULL_COLOR_SANDSTONE].minWall,
+        METERS_TO_MM * gMtlCostTable[PRINT_MATERIAL_FULL_COLOR_SANDSTONE].minWall,
+        METERS_TO_MM * gMtlCostTable[PRINT_MATERIAL_FULL_COLOR_SANDSTONE].minWall,
+        METERS_TO_MM * gMtlCostTable[PRINT_MATERIAL_FULL_COLOR_SANDSTONE].minWall,
+        METERS_TO_MM * gMtlCostTable[PRINT_MATERIAL_WHITE_STRONG_FLEXIBLE].minWall,
+        METERS_TO_MM * gMtlCostTable[PRINT_MATERIAL_FULL_COLOR_SANDSTONE].minWall,
+        METERS_TO_MM * gMtlCostTable[PRINT_MATERIAL_FULL_COLOR_SANDSTONE].minWall,
+        METERS_TO_MM * gMtlCostTable[PRINT_MATERIAL_FULL_COLOR_SANDSTONE].minWall,
+        METERS_TO_MM * gMtlCostTable[PRINT_MATERIAL_FULL_COLOR_SANDSTONE].minWall);
+
+    // materials selected
+    INIT_ALL_FILE_TYPES( pPrint->comboPhysicalMaterial,PRINT_MATERIAL_FCS_SCULPTEO,PRINT_MATERIAL_FCS_SCULPTEO,PRINT_MATERIAL_FULL_COLOR_SANDSTONE,PRINT_MATERIAL_FULL_COLOR_SANDSTONE,PRINT_MATERIAL_WHITE_STRONG_FLEXIBLE,PRINT_MATERIAL_FULL_COLOR_SANDSTONE,PRINT_MATERIAL_FULL_COLOR_SANDSTONE,PRINT_MATERIAL_FULL_COLOR_SANDSTONE,PRINT_MATERIAL_FULL_COLOR_SANDSTONE);
+    // defaults: for Sculpteo OBJ, cm; for i.materialise, mm; for other STL, cm; for Shapeways VRML, mm
+    INIT_ALL_FILE_TYPES( pPrint->comboModelUnits,UNITS_CENTIMETER,UNITS_CENTIMETER,UNITS_MILLIMETER,UNITS_MILLIMETER,UNITS_MILLIMETER,UNITS_MILLIMETER,UNITS_MILLIMETER,UNITS_METER,UNITS_MILLIMETER);
+
+
+    //////////////////////////////////////////////////////
+    // copy view data from print, and change what's needed
+    *pView = *pPrint;
+
+    // Now that I've figured out that Blender can show materials OK, change to "true spec"
+    pView->fileType = FILE_TYPE_WAVEFRONT_ABS_OBJ;
+
+    // don't really need to create a zip for rendering output
+    INIT_ALL_FILE_TYPES( pView->chkCreateZip,         0, 0, 0, 0, 0, 0, 0, 0, 0);
+    INIT_ALL_FILE_TYPES( pView->chkCreateModelFiles,  1, 1, 1, 1, 1, 1, 1, 1, 1);
+
+    INIT_ALL_FILE_TYPES( pView->radioExportNoMaterials,  0, 0, 0, 0, 1, 0, 0, 0, 1);  
+    INIT_ALL_FILE_TYPES( pView->radioExportMtlColors,    0, 0, 1, 1, 0, 0, 1, 0, 0);  
+    INIT_ALL_FILE_TYPES( pView->radioExportSolidTexture, 0, 0, 0, 0, 0, 0, 0, 0, 0);  
+    INIT_ALL_FILE_TYPES( pView->radioExportFullTexture,  1, 1, 0, 0, 0, 1, 0, 1, 0);  
+
+    pView->chkExportAll = 1; 
+    // for renderers, assume Y is up, which is the norm
+    INIT_ALL_FILE_TYPES( pView->chkMakeZUp, 0, 0, 0, 0, 0, 0, 0, 0, 0);  
+
+    pView->modelHeightVal = 1000.0f;    // 10 cm - view doesn't need a minimum, really
+    INIT_ALL_FILE_TYPES( pView->blockSizeVal,
+        100.0f,
+        100.0f,
+        100.0f,
+        100.0f,
+        100.0f,
+        100.0f,
+        100.0f,
+        100.0f,
+        100.0f);
+    pView->costVal = 25.00f;
+
+    pView->chkSealEntrances = 0;
+    pView->chkSealSideTunnels = 0;
+    pView->chkFillBubbles = 0;
+    pView->chkConnectParts = 0;
+    pView->chkConnectCornerTips = 0;
+    pView->chkConnectAllEdges = 0;
+    pView->chkDeleteFloaters = 0;
+    INIT_ALL_FILE_TYPES( pView->chkHollow, 0,0,0,0,0,0,0,0,0);
+    INIT_ALL_FILE_TYPES( pView->chkSuperHollow, 0,0,0,0,0,0,0,0,0);
+    INIT_ALL_FILE_TYPES( pView->chkHollowByDistance, 0,0,0,0,0,0,0,0,0);
+    INIT_ALL_FILE_TYPES( pView->chkDrainHoles, 0,0,0,0,0,0,0,0,0);
+    // G3D material off by default for rendering
+    pView->chkG3DMaterial = 0;
+
+    pView->floaterCountVal = 16;
+    // irrelevant for viewing
+    INIT_ALL_FILE_TYPES( pView->hollowThicknessVal, 10.0f, 10.0f, 10.0f, 10.0f, 10.0f, 10.0f, 10.0f, 10.0f, 10.0f );    // 10 mm
+    INIT_ALL_FILE_TYPES( pView->comboPhysicalMaterial,PRINT_MATERIAL_FCS_SCULPTEO,PRINT_MATERIAL_FCS_SCULPTEO,PRINT_MATERIAL_FULL_COLOR_SANDSTONE,PRINT_MATERIAL_FULL_COLOR_SANDSTONE,PRINT_MATERIAL_WHITE_STRONG_FLEXIBLE,PRINT_MATERIAL_FULL_COLOR_SANDSTONE,PRINT_MATERIAL_FULL_COLOR_SANDSTONE,PRINT_MATERIAL_FULL_COLOR_SANDSTONE,PRINT_MATERIAL_FULL_COLOR_SANDSTONE);
+    INIT_ALL_FILE_TYPES( pView->comboModelUnits,UNITS_METER,UNITS_METER,UNITS_MILLIMETER,UNITS_MILLIMETER,UNITS_MILLIMETER,UNITS_METER,UNITS_MILLIMETER,UNITS_METER,UNITS_METER);
+
+    // copy schematic data - a little goofy, but there it is
+    *pSchematic = *pView;
+    pSchematic->chkMergeFlattop = 0;
+    // TODO someday allow getting rid of floaters, that would be cool.
+    //pSchematic->chkDeleteFloaters = 1;
+}
+
+
+int ImportExportSettings( const wchar_t *importFile, ExportFileData *pPrint, ExportFileData *pView, ExportFileData **ppEFD )
+{
+    // read header, as written by writeStatistics(), and get export settings from it
+
+    //char inputString[256];
+    int worldBox[6];
+    char c;
+
+    FILE *fh;
+    errno_t err = _wfopen_s( &fh, importFile, L"rt" );
+
+    if (err != 0) {
+        return MW_CANNOT_READ_IMPORT_FILE;
+    }
+
+    char lines[HEADER_LINES][120];
+
+    int numLines = readLineSet( fh, lines, HEADER_LINES );
+
+    fclose( fh );
+
+    if ( numLines == 0 )
+        return MW_CANNOT_PARSE_IMPORT_FILE;
+
+    // find size
+    int lineNo = findLine( "# Selection location min to max:", lines, 0, 10 );
+    if ( lineNo >= 0)
+    {
+        // found selection, parse it
+        if ( 6 != sscanf_s( lines[lineNo], "# Selection location min to max: %d, %d, %d to %d, %d, %d", 
+            &worldBox[0], &worldBox[1], &worldBox[2],
+            &worldBox[3], &worldBox[4], &worldBox[5] ) )
+            return MW_CANNOT_PARSE_IMPORT_FILE;
+    }
+    else
+    {
+        // old format, and need to not pass in lineNo (which is -1)
+        lineNo = findLine( "# Selection location:", lines, 0, 30 );
+        if ( lineNo >= 0)
+        {
+            // found selection, parse it
+            if ( 6 != sscanf_s( lines[lineNo], "# Selection location: %d, %d, %d to %d, %d, %d", 
+                &worldBox[0], &worldBox[1], &worldBox[2],
+                &worldBox[3], &worldBox[4], &worldBox[5] ) )
+                return MW_CANNOT_PARSE_IMPORT_FILE;
+        }
+        else
+            return MW_CANNOT_PARSE_IMPORT_FILE;
+    }
+
+    // note we restart the search here, because old style output had this bit earlier
+    lineNo = findLine( "# Created for ", lines, 0, 20 );
+    if ( lineNo >= 0)
+    {
+        // found selection, parse it
+        if ( !sscanf_s( lines[lineNo], "# Created for %c", &c, sizeof(char) ) )
+            return MW_CANNOT_PARSE_IMPORT_FILE;
+    }
+    else
+        return MW_CANNOT_PARSE_IMPORT_FILE;
+
+    ExportFileData efd;
+    ExportFileData *pSaveEFD;
+    // 3d print or render?
+    if ( c == '3' )
+    {
+        efd = *pPrint;
+        pSaveEFD = pPrint;
+        efd.flags = EXPT_3DPRINT;
+    }
+    else
+    {
+        efd = *pView;
+        pSaveEFD = pView;
+        efd.flags = 0x0;
+    }
+    // file type - if not found, abort;
+    // older files don't have this info
+    if ( strstr( lines[lineNo], "Wavefront OBJ absolute indices" ) )
+    {
+        efd.fileType = FILE_TYPE_WAVEFRONT_ABS_OBJ;
+    }
+    else if ( strstr( lines[lineNo], "Wavefront OBJ relative indices" ) )
+    {
+        efd.fileType = FILE_TYPE_WAVEFRONT_REL_OBJ;
+    }
+    else if ( strstr( lines[lineNo], "Binary STL iMaterialise" ) )
+    {
+        efd.fileType = FILE_TYPE_BINARY_MAGICS_STL;
+    }
+    else if ( strstr( lines[lineNo], "Binary STL VisCAM" ) )
+    {
+        efd.fileType = FILE_TYPE_BINARY_VISCAM_STL;
+    }
+    else if ( strstr( lines[lineNo], "ASCII STL" ) )
+    {
+        efd.fileType = FILE_TYPE_ASCII_STL;
+    }
+    else if ( strstr( lines[lineNo], "VRML 2.0" ) )
+    {
+        efd.fileType = FILE_TYPE_VRML2;
+    }
+    else if ( strstr( lines[lineNo], "Binary PLY" ) )
+    {
+        efd.fileType = FILE_TYPE_BINARY_PLY;
+    }
+    else if ( strstr( lines[lineNo], "glTF 2.0 binary" ) )
+    {
+        efd.fileType = FILE_TYPE_GLTF;
+    }
+    else
+    {
+        // can't figure it out from the file (old-style), so figure it out
+        // from the file name itself.
+        if ( wcsstr( importFile, L".obj" ) )
+        {
+            efd.fileType = FILE_TYPE_WAVEFRONT_ABS_OBJ;
+        }
+        else if ( wcsstr( importFile, L".txt" ) )
+        {
+            efd.fileType = FILE_TYPE_BINARY_MAGICS_STL;
+        }
+        else if ( wcsstr( importFile, L".wrl" ) )
+        {
+            efd.fileType = FILE_TYPE_VRML2;
+        }
+        else
+            return MW_CANNOT_PARSE_IMPORT_FILE;
+    }
+
+    // units - well after 3D print output, so scan many lines
+    char string1[100], string2[100], string3[100], string4[100];
+    lineNo = findLine( "# Units for the model vertex data itself:", lines, lineNo+1, 20 );
+    if ( lineNo >= 0)
+    {
+        // found selection, parse it
+        if ( !sscanf_s( lines[lineNo], "# Units for the model vertex data itself: %s", string1, _countof(string1) ) )
+            return MW_CANNOT_PARSE_IMPORT_FILE;
+    }
+    else
+        return MW_CANNOT_PARSE_IMPORT_FILE;
+
+    int i;
+    for ( i = 0; i < MODELS_UNITS_TABLE_SIZE; i++ )
+    {
+        if ( strcmp( gUnitTypeTable[i].name, string1 ) == 0 )
+        {
+            efd.comboModelUnits[efd.fileType] = i;
+            break;
+        }
+    }
+    // units found?
+    if ( i >= 4 )
+    {
+        return MW_CANNOT_PARSE_IMPORT_FILE;
+    }
+
+    lineNo = findLine( "# File type:", lines, lineNo+1, 20 );
+    if ( lineNo >= 0)
+    {
+        // found selection, parse it
+        if ( !sscanf_s( lines[lineNo], "# File type: Export %s", string1, _countof(string1) ) )
+            return MW_CANNOT_PARSE_IMPORT_FILE;
+    }
+    else
+        return MW_CANNOT_PARSE_IMPORT_FILE;
+
+    char *outputTypeString[] = {
+        "no", // "Export no materials",
+        "solid", // "Export solid material colors only (no textures)",
+        "richer", // "Export richer color textures",
+        "full", // "Export full color texture patterns"
+    };
+    for ( i = 0; i < 4; i++ )
+    {
+        if ( strcmp( outputTypeString[i], string1 ) == 0 )
+        {
+            break;
+        }
+    }
+
+    efd.radioExportNoMaterials[efd.fileType] = 0;
+    efd.radioExportMtlColors[efd.fileType] = 0;
+    efd.radioExportSolidTexture[efd.fileType] = 0;
+    efd.radioExportFullTexture[efd.fileType] = 0;
+    switch ( i )
+    {
+    case 0:
+        efd.radioExportNoMaterials[efd.fileType] = 1;
+        break;
+    case 1:
+        efd.radioExportMtlColors[efd.fileType] = 1;
+        break;
+    case 2:
+        efd.radioExportSolidTexture[efd.fileType] = 1;
+        break;
+    case 3:
+        efd.radioExportFullTexture[efd.fileType] = 1;
+        break;
+    default:
+    case 4:
+        return MW_CANNOT_PARSE_IMPORT_FILE;
+    }
+
+    // set material options if using OBJ
+    if ( ( efd.fileType == FILE_TYPE_WAVEFRONT_ABS_OBJ ) || ( efd.fileType == FILE_TYPE_WAVEFRONT_REL_OBJ ) )
+    {
+        lineNo = findLine( "# Export separate objects:", lines, lineNo+1, 20 );
+        if ( lineNo >= 0)
+        {
+            if ( !sscanf_s( lines[lineNo], "# Export separate objects: %s", string1, _countof(string1) ) )
+                return MW_CANNOT_PARSE_IMPORT_FILE;
+
+            efd.chkMultipleObjects = ( string1[0] == 'Y');
+
+            if ( efd.chkMultipleObjects )
+            {
+                lineNo = findLine( "#  Material per object:", lines, lineNo+1, 20 );
+                if ( lineNo >= 0)
+                {
+                    if ( !sscanf_s( lines[lineNo], "#  Material per object: %s", string1, _countof(string1) ) )
+                        return MW_CANNOT_PARSE_IMPORT_FILE;
+                }
+                else
+                    return MW_CANNOT_PARSE_IMPORT_FILE;
+
+                efd.chkMaterialPerType = ( string1[0] == 'Y');
+
+                if ( efd.chkMaterialPerType )
+                {
+                    lineNo = findLine( "#   G3D full material:", lines, lineNo+1, 20 );
+                    if ( lineNo >= 0)
+                    {
+                        if ( !sscanf_s( lines[lineNo], "#   G3D full material: %s", string1, _countof(string1) ) )
+                            return MW_CANNOT_PARSE_IMPORT_FILE;
+                    }
+                    else
+                        return MW_CANNOT_PARSE_IMPORT_FILE;
+
+                    efd.chkG3DMaterial = ( string1[0] == 'Y');
+                }
+            }
+        }
+        // else if not found, that's OK, this is a newer feature; set defaults
+        else
+        {
+            efd.chkMultipleObjects = 1;
+            efd.chkMaterialPerType = 1;
+        }
+
+        lineNo = findLine( "# Write geometry as it is made:", lines, 0, 40 );
+        if ( lineNo >= 0)
+        {
+            if ( !sscanf_s( lines[lineNo], "# Write geometry as it is made: %s", string1, _countof(string1) ) )
+                return MW_CANNOT_PARSE_IMPORT_FILE;
+
+            efd.chkStreamOBJ = ( string1[0] == 'Y');
+        }
+        // new feature - if missing, assume it's off, but don't fail
+
+        lineNo = findLine( "# Fixed precision coordinates:", lines, 0, 40 );
+        if ( lineNo >= 0)
+        {
+            if ( !sscanf_s( lines[lineNo], "# Fixed precision coordinates: %s", string1, _countof(string1) ) )
+                return MW_CANNOT_PARSE_IMPORT_FILE;
+
+            efd.chkFixedPrecisionOBJ = ( string1[0] == 'Y');
+        }
+        // new feature - if missing, assume it's off, but don't fail
+    }
+
+    lineNo = findLine( "# Make Z the up", lines, 0, 40 );
+    if ( lineNo >= 0)
+    {
+        if ( !sscanf_s( lines[lineNo], "# Make Z the up direction instead of Y: %s", string1, _countof(string1) ) )
+            return MW_CANNOT_PARSE_IMPORT_FILE;
+
+        efd.chkMakeZUp[efd.fileType] = ( string1[0] == 'Y');
+    }
+    else
+    {
+        // unfortunately the old code had a bug and it always said YES, even when not set.
+        // So we leave this value untouched and move on.
+        /*
+        lineNo = findLine( "# Make Z direction up:", lines, 0, 40 );
+        if ( lineNo >= 0)
+        {
+        if ( !sscanf_s( lines[lineNo], "# Make Z direction up: %s", string1, _countof(string1) ) )
+        return MW_CANNOT_PARSE_IMPORT_FILE;
+        }
+        else
+        return MW_CANNOT_PARSE_IMPORT_FILE;
+        */
+    }
+
+
+    lineNo = findLine( "# Center model:", lines, 0, 40 );
+    if ( lineNo >= 0)
+    {
+        if ( !sscanf_s( lines[lineNo], "# Center model: %s", string1, _countof(string1) ) )
+            return MW_CANNOT_PARSE_IMPORT_FILE;
+    }
+    else
+        return MW_CANNOT_PARSE_IMPORT_FILE;
+
+    efd.chkCenterModel = ( string1[0] == 'Y');
+
+
+    lineNo = findLine( "# Export lesser blocks:", lines, lineNo+1, 20 );
+    if ( lineNo >= 0)
+    {
+        if ( !sscanf_s( lines[lineNo], "# Export lesser blocks: %s", string1, _countof(string1) ) )
+            return MW_CANNOT_PARSE_IMPORT_FILE;
+
+        efd.chkExportAll = ( string1[0] == 'Y');
+
+        if ( efd.chkExportAll )
+        {
+            lineNo = findLine( "# Fatten lesser blocks:", lines, lineNo+1, 20 );
+            if ( lineNo >= 0)
+            {
+                if ( !sscanf_s( lines[lineNo], "# Fatten lesser blocks: %s", string1, _countof(string1) ) )
+                    return MW_CANNOT_PARSE_IMPORT_FILE;
+            }
+            else
+                return MW_CANNOT_PARSE_IMPORT_FILE;
+
+            efd.chkFatten = ( string1[0] == 'Y');
+        }
+    }
+    // this is a newer feature, so if we don't find it, continue on
+    else
+    {
+        // if rendering, set this to be on
+        if ( !(efd.flags & EXPT_3DPRINT) )
+        {
+            efd.chkExportAll = 1;
+        }
+    }
+
+
+    lineNo = findLine( "# Individual blocks:", lines, 0, 40 );
+    if ( lineNo >= 0)
+    {
+        if ( !sscanf_s( lines[lineNo], "# Individual blocks: %s", string1, _countof(string1) ) )
+            return MW_CANNOT_PARSE_IMPORT_FILE;
+
+        efd.chkIndividualBlocks = ( string1[0] == 'Y');
+    }
+    // new feature - if missing, assume it's off, but don't fail
+
+    lineNo = findLine( "# Use biomes:", lines, 0, 40 );
+    if ( lineNo >= 0)
+    {
+        if ( !sscanf_s( lines[lineNo], "# Use biomes: %s", string1, _countof(string1) ) )
+            return MW_CANNOT_PARSE_IMPORT_FILE;
+
+        efd.chkBiome = ( string1[0] == 'Y');
+    }
+    // new feature - if missing, assume it's off, but don't fail
+
+    float floatVal = 0.0f;
+    lineNo = findLine( "# Rotate model", lines, 0, 40 );
+    if ( lineNo >= 0)
+    {
+        if ( !sscanf_s( lines[lineNo], "# Rotate model %f degrees", &floatVal ) )
+            return MW_CANNOT_PARSE_IMPORT_FILE;
+    }
+    else
+        return MW_CANNOT_PARSE_IMPORT_FILE;
+
+    efd.radioRotate0 = efd.radioRotate90 = efd.radioRotate180 = efd.radioRotate270 = 0;
+
+    efd.radioRotate0 = ( floatVal == 0.0f );
+    efd.radioRotate90 = ( floatVal == 90.0f );
+    efd.radioRotate180 = ( floatVal == 180.0f );
+    efd.radioRotate270 = ( floatVal == 270.0f );
+
+    // just in case
+    if ( !( efd.radioRotate90 || efd.radioRotate180 || efd.radioRotate270) )
+        efd.radioRotate0 = 1;
+
+
+    lineNo = findLine( "# Scale model by ", lines, lineNo+1, 20 );
+    if ( lineNo >= 0)
+    {
+        efd.radioScaleByBlock = efd.radioScaleByCost = efd.radioScaleToHeight = efd.radioScaleToMaterial = 0;
+
+        if ( sscanf_s( lines[lineNo], "# Scale model by making each block %f mm high", &floatVal ) )
+        {
+            efd.radioScaleByBlock = 1;
+            efd.blockSizeVal[efd.fileType] = floatVal;
+        }
+        else
+            // terrible hackery and laziness: look for 3, 2, or 1 word materials. fgets or read() might be better...
+            if ( 5 == sscanf_s( lines[lineNo], "# Scale model by aiming for a cost of %f for the %s %s %s %s", &floatVal, string1, _countof(string1), string2, _countof(string2), string3, _countof(string3), string4, _countof(string4) ) )
+            {
+                if ( strcmp( string4, "material" ) != 0 )
+                    return MW_CANNOT_PARSE_IMPORT_FILE;
+                strcat_s( string1, _countof(string1), " " );
+                strcat_s( string1, _countof(string1), string2 );
+                strcat_s( string1, _countof(string1), " " );
+                strcat_s( string1, _countof(string1), string3 );
+                efd.radioScaleByCost = 1;
+                efd.costVal = floatVal;
+            }
+            else if ( 4 == sscanf_s( lines[lineNo], "# Scale model by aiming for a cost of %f for the %s %s %s", &floatVal, string1, _countof(string1), string2, _countof(string2), string3, _countof(string3) ) )
+            {
+                if ( strcmp( string3, "material" ) != 0 )
+                    return MW_CANNOT_PARSE_IMPORT_FILE;
+                strcat_s( string1, _countof(string1), " " );
+                strcat_s( string1, _countof(string1), string2 );
+                efd.radioScaleByCost = 1;
+                efd.costVal = floatVal;
+            }
+            else if ( 3 == sscanf_s( lines[lineNo], "# Scale model by aiming for a cost of %f for the %s %s", &floatVal, string1, _countof(string1), string2, _countof(string2) ) )
+            {
+                if ( strcmp( string2, "material" ) != 0 )
+                    return MW_CANNOT_PARSE_IMPORT_FILE;
+                efd.radioScaleByCost = 1;
+                efd.costVal = floatVal;
+            }
+            else if ( sscanf_s( lines[lineNo], "# Scale model by fitting to a height of %f cm", &floatVal ) )
+            {
+                efd.radioScaleToHeight = 1;
+                efd.modelHeightVal = floatVal;
+            }
+            else
+                // terrible hackery and laziness: look for 3, 2, or 1 word materials. fgets or read() might be better...
+                if ( 4 == sscanf_s( lines[lineNo], "# Scale model by using the minimum wall thickness for the %s %s %s %s", string1, _countof(string1), string2, _countof(string2), string3, _countof(string3), string4, _countof(string4) ) )
+                {
+                    if ( strcmp( string4, "material" ) != 0 )
+                        return MW_CANNOT_PARSE_IMPORT_FILE;
+                    strcat_s( string1, _countof(string1), " " );
+                    strcat_s( string1, _countof(string1), string2 );
+                    strcat_s( string1, _countof(string1), " " );
+                    strcat_s( string1, _countof(string1), string3 );
+                    efd.radioScaleToMaterial = 1;
+                }
+                else if ( 3 == sscanf_s( lines[lineNo], "# Scale model by using the minimum wall thickness for the %s %s %s", string1, _countof(string1), string2, _countof(string2), string3, _countof(string3) ) )
+                {
+                    if ( strcmp( string3, "material" ) != 0 )
+                        return MW_CANNOT_PARSE_IMPORT_FILE;
+                    strcat_s( string1, _countof(string1), " " );
+                    strcat_s( string1, _countof(string1), string2 );
+                    efd.radioScaleToMaterial = 1;
+                }
+                else if ( 2 == sscanf_s( lines[lineNo], "# Scale model by using the minimum wall thickness for the %s %s", string1, _countof(string1), string2, _countof(string2) ) )
+                {
+                    if ( strcmp( string2, "material" ) != 0 )
+                        return MW_CANNOT_PARSE_IMPORT_FILE;
+                    efd.radioScaleToMaterial = 1;
+                }
+                else
+                    return MW_CANNOT_PARSE_IMPORT_FILE;
+
+                // if by cost or by material, need to set the material type.
+                if ( efd.radioScaleByCost || efd.radioScaleToMaterial )
+                {
+                    for ( i = 0; i < MTL_COST_TABLE_SIZE; i++ )
+                    {
+                        if ( strcmp( string1, gMtlCostTable[i].name ) == 0 )
+                        {
+                            break;
+                        }
+                    }
+                    if ( i >= MTL_COST_TABLE_SIZE )
+                        return MW_CANNOT_PARSE_IMPORT_FILE;
+
+                    efd.comboPhysicalMaterial[efd.fileType] = i;
+                }
+    }
+    else
+        return MW_CANNOT_PARSE_IMPORT_FILE;
+
+    lineNo = findLine( "#   Fill air bubbles:", lines, lineNo+1, 20 );
+    if ( lineNo >= 0)
+    {
+        if ( 3 != sscanf_s( lines[lineNo], "#   Fill air bubbles: %s Seal off entrances: %s Fill in isolated tunnels in base of model: %s",
+            string1, _countof(string1),
+            string2, _countof(string2),
+            string3, _countof(string3)
+            ) )
+            return MW_CANNOT_PARSE_IMPORT_FILE;
+    }
+    else
+        return MW_CANNOT_PARSE_IMPORT_FILE;
+
+    efd.chkFillBubbles = ( string1[0] == 'Y');
+    efd.chkSealEntrances = ( string2[0] == 'Y');
+    efd.chkSealSideTunnels = ( string3[0] == 'Y');
+
+
+    lineNo = findLine( "#   Connect parts sharing an edge:", lines, lineNo+1, 20 );
+    if ( lineNo >= 0)
+    {
+        if ( 3 != sscanf_s( lines[lineNo], "#   Connect parts sharing an edge: %s Connect corner tips: %s Weld all shared edges: %s",
+            string1, _countof(string1),
+            string2, _countof(string2),
+            string3, _countof(string3)
+            ) )
+            return MW_CANNOT_PARSE_IMPORT_FILE;
+    }
+    else
+        return MW_CANNOT_PARSE_IMPORT_FILE;
+
+    efd.chkConnectParts = ( string1[0] == 'Y');
+    efd.chkConnectCornerTips = ( string2[0] == 'Y');
+    efd.chkConnectAllEdges = ( string3[0] == 'Y');
+
+
+    int intVal = 0;
+    lineNo = findLine( "#   Delete floating objects:", lines, lineNo+1, 20 );
+    if ( lineNo >= 0)
+    {
+        if ( 2 != sscanf_s( lines[lineNo], "#   Delete floating objects: trees and parts smaller than %d blocks: %s",
+            &intVal,
+            string1, _countof(string1) ) )
+            return MW_CANNOT_PARSE_IMPORT_FILE;
+    }
+    else
+        return MW_CANNOT_PARSE_IMPORT_FILE;
+
+    efd.chkDeleteFloaters = ( string1[0] == 'Y');
+    efd.floaterCountVal = intVal;
+
+
+    lineNo = findLine( "#   Hollow out bottom of model", lines, lineNo+1, 20 );
+    if ( lineNo >= 0)
+    {
+        if ( 3 != sscanf_s( lines[lineNo], "#   Hollow out bottom of model, making the walls %f mm thick: %s Superhollow: %s",
+            &floatVal,
+            string1, _countof(string1),
+            string2, _countof(string2)
+            ) )
+            return MW_CANNOT_PARSE_IMPORT_FILE;
+    }
+    else
+        return MW_CANNOT_PARSE_IMPORT_FILE;
+
+    efd.hollowThicknessVal[efd.fileType] = floatVal;
+    efd.chkHollow[efd.fileType] = ( string1[0] == 'Y');
+    efd.chkSuperHollow[efd.fileType] = ( string2[0] == 'Y');
+
+    // files from before distance hollowing don't have this line
+    efd.chkHollowByDistance[efd.fileType] = 0;
+    efd.chkDrainHoles[efd.fileType] = 0;
+    int distanceLine = findLine( "#   Hollow by distance", lines, lineNo+1, 1 );
+    if ( distanceLine >= 0 )
+    {
+        lineNo = distanceLine;
+        if ( 2 != sscanf_s( lines[lineNo], "#   Hollow by distance to the surface: %s Drill drain holes: %s",
+            string1, _countof(string1),
+            string2, _countof(string2)
+            ) )
+            return MW_CANNOT_PARSE_IMPORT_FILE;
+        efd.chkHollowByDistance[efd.fileType] = ( string1[0] == 'Y');
+        efd.chkDrainHoles[efd.fileType] = ( string2[0] == 'Y');
+    }
+
+
+    lineNo = findLine( "# Melt snow blocks:", lines, lineNo+1, 20 );
+    if ( lineNo >= 0)
+    {
+        if ( !sscanf_s( lines[lineNo], "# Melt snow blocks: %s", string1, _countof(string1) ) )
+            return MW_CANNOT_PARSE_IMPORT_FILE;
+    }
+    else
+        return MW_CANNOT_PARSE_IMPORT_FILE;
+
+    efd.chkMeltSnow = ( string1[0] == 'Y');
+
+
+    lineNo = findLine( "#   Debug: show separate parts as colors:", lines, lineNo+1, 20 );
+    if ( lineNo >= 0)
+    {
+        if ( !sscanf_s( lines[lineNo], "#   Debug: show separate parts as colors: %s", string1, _countof(string1) ) )
+            return MW_CANNOT_PARSE_IMPORT_FILE;
+    }
+    else
+        return MW_CANNOT_PARSE_IMPORT_FILE;
+
+    efd.chkShowParts = ( string1[0] == 'Y');
+
+
+    lineNo = findLine( "#   Debug: show weld blocks", lines, lineNo+1, 20 );
+    if ( lineNo >= 0)
+    {
+        if ( !sscanf_s( lines[lineNo], "#   Debug: show weld blocks in bright colors: %s", string1, _countof(string1) ) )
+            return MW_CANNOT_PARSE_IMPORT_FILE;
+    }
+    else
+        return MW_CANNOT_PARSE_IMPORT_FILE;
+
+    efd.chkShowWelds = ( string1[0] == 'Y');
+
+
+    // survived, so copy data read in over
+    *pSaveEFD = efd;
+    pSaveEFD->minxVal = worldBox[0];
+    pSaveEFD->minyVal = worldBox[1];
+    pSaveEFD->minzVal = worldBox[2];
+    pSaveEFD->maxxVal = worldBox[3];
+    pSaveEFD->maxyVal = worldBox[4];
+    pSaveEFD->maxzVal = worldBox[5];
+
+    *ppEFD = pSaveEFD;
+
+    return MW_NO_ERROR;
+}
+
+// read line, includes \n at end.
+static int readLineSet( FILE *fh, char lines[HEADER_LINES][120], int maxLine )
+{
+    int lineNum = 0;
+    int pos;
+    do {
+        pos = readLine( fh, lines[lineNum++], 120 );
+    } while ( (pos > 0) && ( lineNum < maxLine ) );
+    return lineNum;
+}
+
+// read line, includes \n at end.
+static int readLine( FILE *fh, char *inputString, int stringLength )
+{
+    int pos = 0;
+    int c;
+    do {
+        c = fgetc(fh);
+        if (c != EOF) inputString[pos++] = (char)c;
+        // line too long?
+        if (pos >= stringLength - 1)
+        {
+            inputString[stringLength-1] = '\0';
+            return ( c != EOF ) ? pos : -1;
+        }
+    } while (c != EOF && c != '\n');
+    inputString[pos] = '\0';
+
+    return ( c != EOF) ? pos : -1;
+}
+
+// return line number if checkString is found in the next maxLines of the file.
+static int findLine( char *checkString, char lines[HEADER_LINES][120], int startLine, int maxLines )
+{
+    int trueMaxLines = ( startLine+maxLines >= HEADER_LINES ) ? HEADER_LINES : startLine+maxLines;
+    for ( int i=startLine; i < trueMaxLines; i++ )
+    {
+        if ( strstr( lines[i], checkString ) != NULL )
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+// Set the save filter and export flags in pOptions from the dialog values in pEFD.
+// printModel is 1 for 3D printing, 0 for rendering, 2 for schematic.
+// Returns EXPORT_NOTE_* bits for any options that the file type does not support and so were dropped.
+int SetExportOptions( Options *pOptions, ExportFileData *pEFD, int printModel )
+{
+    int notes = 0x0;
+
+    pOptions->exportFlags = ( printModel == 1 ) ? EXPT_3DPRINT : 0x0;
+    pOptions->pEFD = pEFD;
+
+    // export all
+    if ( pEFD->chkExportAll )
+    {
+        if ( printModel )
+        {
+            pOptions->saveFilterFlags = BLF_WHOLE | BLF_ALMOST_WHOLE | BLF_STAIRS | BLF_HALF | BLF_MIDDLER | BLF_BILLBOARD | BLF_PANE | BLF_FLATTOP |
+                BLF_FLATSIDE | BLF_3D_BIT;
+        }
+        else
+        {
+            pOptions->saveFilterFlags = BLF_WHOLE | BLF_ALMOST_WHOLE | BLF_STAIRS | BLF_HALF | BLF_MIDDLER | BLF_BILLBOARD | BLF_PANE | BLF_FLATTOP |
+                BLF_FLATSIDE | BLF_SMALL_MIDDLER | BLF_SMALL_BILLBOARD;
+        }
+    }
+    else
+    {
+        pOptions->saveFilterFlags = BLF_WHOLE | BLF_ALMOST_WHOLE | BLF_STAIRS | BLF_HALF | BLF_MIDDLER | BLF_BILLBOARD | BLF_PANE | BLF_FLATTOP | BLF_FLATSIDE;
+    }
+
+    // export options
+    if ( pEFD->radioExportMtlColors[pEFD->fileType] == 1 )
+    {
+        pOptions->exportFlags |= EXPT_OUTPUT_MATERIALS | EXPT_GROUP_BY_MATERIAL;
+    }
+    else if ( pEFD->radioExportSolidTexture[pEFD->fileType] == 1 )
+    {
+        pOptions->exportFlags |= EXPT_OUTPUT_MATERIALS | EXPT_OUTPUT_TEXTURE_SWATCHES | EXPT_GROUP_BY_MATERIAL;
+    }
+    else if ( pEFD->radioExportFullTexture[pEFD->fileType] == 1 )
+    {
+        pOptions->exportFlags |= EXPT_OUTPUT_MATERIALS | EXPT_OUTPUT_TEXTURE_IMAGES | EXPT_GROUP_BY_MATERIAL;
+        // TODO: if we're *viewing* full textures, output all the billboards!
+        //  pOptions->saveFilterFlags |= BLF_SMALL_BILLBOARD;
+    }
+
+    pOptions->exportFlags |=
+        (pEFD->chkFillBubbles ? EXPT_FILL_BUBBLES : 0x0) |
+        ((pEFD->chkFillBubbles&&pEFD->chkSealEntrances) ? EXPT_FILL_BUBBLES|EXPT_SEAL_ENTRANCES : 0x0) |
+        ((pEFD->chkFillBubbles&&pEFD->chkSealSideTunnels) ? EXPT_FILL_BUBBLES|EXPT_SEAL_SIDE_TUNNELS : 0x0) |
+
+        (pEFD->chkConnectParts ? EXPT_CONNECT_PARTS : 0x0) |
+        // is it better to force part connection on if corner tips or edges are on? I feel like the
+        // dialog should take care of this, not allowing these options if the controlling algorithm is set.
+        (pEFD->chkConnectCornerTips ? (EXPT_CONNECT_PARTS|EXPT_CONNECT_CORNER_TIPS) : 0x0) |
+        (pEFD->chkConnectAllEdges ? (EXPT_CONNECT_PARTS|EXPT_CONNECT_ALL_EDGES) : 0x0) |
+        (pEFD->chkDeleteFloaters ? EXPT_DELETE_FLOATING_OBJECTS : 0x0) |
+
+        (pEFD->chkHollow[pEFD->fileType] ? EXPT_HOLLOW_BOTTOM : 0x0) |
+        ((pEFD->chkHollow[pEFD->fileType] && pEFD->chkSuperHollow[pEFD->fileType]) ? EXPT_HOLLOW_BOTTOM|EXPT_SUPER_HOLLOW_BOTTOM : 0x0) |
+        ((pEFD->chkHollow[pEFD->fileType] && pEFD->chkHollowByDistance[pEFD->fileType]) ? EXPT_HOLLOW_BOTTOM|EXPT_HOLLOW_BY_DISTANCE : 0x0) |
+        ((pEFD->chkHollow[pEFD->fileType] && pEFD->chkHollowByDistance[pEFD->fileType] && pEFD->chkDrainHoles[pEFD->fileType]) ? EXPT_HOLLOW_DRAIN_HOLES : 0x0) |
+
+        // materials are forced on if using debugging mode - just an internal override, doesn't need to happen in dialog.
+        (pEFD->chkShowParts ? EXPT_DEBUG_SHOW_GROUPS|EXPT_OUTPUT_MATERIALS|EXPT_OUTPUT_OBJ_GROUPS|EXPT_OUTPUT_OBJ_MATERIAL_PER_TYPE : 0x0) |
+        (pEFD->chkShowWelds ? EXPT_DEBUG_SHOW_WELDS|EXPT_OUTPUT_MATERIALS|EXPT_OUTPUT_OBJ_GROUPS|EXPT_OUTPUT_OBJ_MATERIAL_PER_TYPE : 0x0);
+
+
+    // set OBJ group and material output state
+    if ( pEFD->fileType == FILE_TYPE_WAVEFRONT_ABS_OBJ || pEFD->fileType == FILE_TYPE_WAVEFRONT_REL_OBJ )
+    {
+        if ( pEFD->chkMultipleObjects )
+        {
+            // note, can get overridden by EXPT_GROUP_BY_BLOCK being on.
+            pOptions->exportFlags |= EXPT_OUTPUT_OBJ_GROUPS;
+
+            if ( pEFD->chkMaterialPerType )
+            {
+                pOptions->exportFlags |= EXPT_OUTPUT_OBJ_MATERIAL_PER_TYPE;
+
+                if ( pEFD->chkG3DMaterial )
+                {
+                    pOptions->exportFlags |= EXPT_OUTPUT_OBJ_FULL_MATERIAL;
+                    if ( pOptions->exportFlags & (EXPT_OUTPUT_TEXTURE_IMAGES|EXPT_OUTPUT_TEXTURE_SWATCHES))
+                    {
+                        // G3D - use only if textures are on.
+                        pOptions->exportFlags |= EXPT_OUTPUT_OBJ_NEUTRAL_MATERIAL;
+                    }
+                }
+            }
+        }
+        // if in debugging mode, force groups and material type
+
+        // check if we're exporting relative coordinates
+        if ( pEFD->fileType == FILE_TYPE_WAVEFRONT_REL_OBJ )
+        {
+            pOptions->exportFlags |= EXPT_OUTPUT_OBJ_REL_COORDINATES;
+        }
+
+        // write the model out as it is made instead of holding it all
+        if ( pEFD->chkStreamOBJ )
+        {
+            pOptions->exportFlags |= EXPT_OUTPUT_OBJ_STREAMING;
+        }
+
+        if ( pEFD->chkFixedPrecisionOBJ )
+        {
+            pOptions->exportFlags |= EXPT_OUTPUT_OBJ_FIXED_PRECISION;
+        }
+    }
+    // STL files never need grouping by material, and certainly don't export textures
+    else if ( pEFD->fileType == FILE_TYPE_ASCII_STL )
+    {
+        int unsupportedCodes = (EXPT_OUTPUT_MATERIALS | EXPT_OUTPUT_TEXTURE_SWATCHES | EXPT_OUTPUT_TEXTURE_IMAGES | EXPT_GROUP_BY_MATERIAL|
+            EXPT_DEBUG_SHOW_GROUPS|EXPT_DEBUG_SHOW_WELDS);
+        if ( pOptions->exportFlags & unsupportedCodes )
+        {
+            notes |= EXPORT_NOTE_ASCII_STL_NO_COLOR;
+        }
+        // ASCII STL in particular cannot export any materials at all.
+        pOptions->exportFlags &= ~unsupportedCodes;
+
+        // we never have to group by material for STL, as there are no material groups.
+        pOptions->exportFlags &= ~EXPT_GROUP_BY_MATERIAL;
+    }
+    else if ( ( pEFD->fileType == FILE_TYPE_BINARY_MAGICS_STL ) || ( pEFD->fileType == FILE_TYPE_BINARY_VISCAM_STL ) )
+    {
+        int unsupportedCodes = (EXPT_OUTPUT_TEXTURE_SWATCHES | EXPT_OUTPUT_TEXTURE_IMAGES);
+        if ( pOptions->exportFlags & unsupportedCodes )
+        {
+            if ( pEFD->fileType == FILE_TYPE_BINARY_VISCAM_STL )
+            {
+                notes |= EXPORT_NOTE_VISCAM_STL_NO_TEXTURE;
+            }
+            else
+            {
+                notes |= EXPORT_NOTE_MAGICS_STL_NO_TEXTURE;
+            }
+        }
+        pOptions->exportFlags &= ~unsupportedCodes;
+
+        // we never have to group by material for STL, as there are no material groups.
+        pOptions->exportFlags &= ~EXPT_GROUP_BY_MATERIAL;
+    }
+    else if ( pEFD->fileType == FILE_TYPE_VRML2 )
+    {
+        // are we outputting color textures?
+        if ( pOptions->exportFlags & EXPT_OUTPUT_TEXTURE )
+        {
+            if ( pOptions->exportFlags & EXPT_3DPRINT)
+            {
+                // if printing, we don't need to group by material, as it can be one huge pile of data
+                pOptions->exportFlags &= ~EXPT_GROUP_BY_MATERIAL;
+            }
+            // else if we're outputting for rendering, VRML then outputs grouped by material, unless it's a single material output
+            // (in which case this flag isn't turned on anyway).
+        }
+    }
+    else if ( pEFD->fileType == FILE_TYPE_BINARY_PLY )
+    {
+        int unsupportedCodes = (EXPT_OUTPUT_TEXTURE_SWATCHES | EXPT_OUTPUT_TEXTURE_IMAGES);
+        if ( pOptions->exportFlags & unsupportedCodes )
+        {
+            notes |= EXPORT_NOTE_PLY_NO_TEXTURE;
+        }
+        pOptions->exportFlags &= ~unsupportedCodes;
+
+        // PLY faces each carry their own color, so there is no need to group by material.
+        pOptions->exportFlags &= ~EXPT_GROUP_BY_MATERIAL;
+    }
+    else if ( pEFD->fileType == FILE_TYPE_GLTF )
+    {
+        // glTF uses the material and texture options as set; its materials are always kept per block type,
+        // since a glTF mesh has no groups.
+    }
+    else if ( pEFD->fileType == FILE_TYPE_SCHEMATIC )
+    {
+        // really, ignore all options for Schematic - set how you want, but they'll all be ignored except rotation around the Y axis.
+        pOptions->exportFlags &= 0x0;
+    }
+    else
+    {
+        // unknown file type?
+        assert(0);
+    }
+
+    // if individual blocks are to be exported, we group by cube, not by material, so turn that off
+    if ( pEFD->chkIndividualBlocks )
+    {
+        // this also allows us to use the faceIndex as a way of noting the start of a new group
+        pOptions->exportFlags &= ~EXPT_GROUP_BY_MATERIAL;
+        pOptions->exportFlags |= EXPT_GROUP_BY_BLOCK;
+    }
+
+    if ( pEFD->chkBiome )
+    {
+        pOptions->exportFlags |= EXPT_BIOME;
+    }
+
+    // if showing debug groups, we need to turn off full image texturing so we get the largest group as semitransparent
+    // (and full textures would just be confusing for debug, anyway)
+    if ( pOptions->exportFlags & EXPT_DEBUG_SHOW_GROUPS )
+    {
+        if ( pOptions->exportFlags & EXPT_OUTPUT_TEXTURE_IMAGES )
+        {
+            pOptions->exportFlags &= ~EXPT_OUTPUT_TEXTURE_IMAGES;
+            pOptions->exportFlags |= EXPT_OUTPUT_TEXTURE_SWATCHES;
+        }
+        // we don't want to group by block for debugging
+        pOptions->exportFlags &= ~EXPT_GROUP_BY_BLOCK;
+    }
+
+    return notes;
+}
+
+const wchar_t *GetExportNoteText( int noteNum )
+{
+    assert( noteNum >= 0 && noteNum < EXPORT_NOTE_COUNT );
+    return gExportNoteText[noteNum];
+}
+
+// zip it up - test that there's something to zip, in case of errors. Note that the first
+// file saved in ObjManip.c is the one used as the zip file's name. Any files the export kept in memory
+// are freed here.
+void ZipExportFiles( FileList *pOutputFileList, int keepModelFiles, ProgressCallback callback )
+{
+    if ( pOutputFileList->count <= 0 )
+        return;
+
+    wchar_t wcZip[MAX_PATH];
+    // we add .zip not (just) out of laziness, but this helps differentiate obj from wrl from stl.
+    swprintf_s(wcZip,MAX_PATH,L"%ls.zip",pOutputFileList->name[0]);
+
+    PortaDelete(wcZip);
+
+    // stream the files through, compressed on several threads, storing PNGs as they are; files kept
+    // in memory are zipped straight from there
+    const wchar_t *fileName[MAX_OUTPUT_FILES];
+    const wchar_t *entryName[MAX_OUTPUT_FILES];
+    const unsigned char *data[MAX_OUTPUT_FILES];
+    size_t size[MAX_OUTPUT_FILES];
+    int i;
+    for ( i = 0; i < pOutputFileList->count; i++ )
+    {
+        fileName[i] = pOutputFileList->name[i];
+        entryName[i] = removePath( pOutputFileList->name[i] );
+        data[i] = pOutputFileList->inMemory ? pOutputFileList->data[i] : NULL;
+        size[i] = pOutputFileList->inMemory ? pOutputFileList->size[i] : 0;
+    }
+    if ( WriteZip( wcZip, fileName, entryName, data, size, pOutputFileList->count, callback, 0.90f, 1.0f ) != 0 )
+    {
+        // anything in memory has to go to disk now, to be zipped from there or kept
+        saveMemoryFiles( pOutputFileList );
+#ifdef WIN32
+        // if that can't be done, e.g. it's over 4 GB, zip one file at a time
+        PortaDelete(wcZip);
+        HZIP hz = CreateZip(wcZip,0,ZIP_FILENAME);
+        for ( i = 0; i < pOutputFileList->count; i++ )
+        {
+            if (callback)
+            { (*callback)(0.90f + 0.10f*(float)i/(float)pOutputFileList->count);}
+
+            ZipAdd(hz,entryName[i], pOutputFileList->name[i], 0, ZIP_FILENAME);
+        }
+        CloseZip(hz);
+#else
+        // no fallback here, so keep the model files rather than lose them
+        PortaDelete(wcZip);
+        keepModelFiles = 1;
+#endif
+    }
+
+    // delete model files if not needed, and let go of those in memory
+    for ( i = 0; i < pOutputFileList->count; i++ )
+    {
+        if ( pOutputFileList->inMemory && pOutputFileList->data[i] != NULL )
+        {
+            free(pOutputFileList->data[i]);
+            pOutputFileList->data[i] = NULL;
+        }
+        else if ( !keepModelFiles )
+        {
+            PortaDelete(pOutputFileList->name[i]);
+        }
+    }
+}
+
+// Write out each file still in memory, so that it's on disk like the rest
+static void saveMemoryFiles( FileList *pOutputFileList )
+{
+#ifdef WIN32
+    DWORD br;
+#endif
+    if ( !pOutputFileList->inMemory )
+        return;
+    for ( int i = 0; i < pOutputFileList->count; i++ )
+    {
+        if ( pOutputFileList->data[i] != NULL )
+        {
+            PORTAFILE fh = PortaCreate(pOutputFileList->name[i]);
+            if ( fh != INVALID_HANDLE_VALUE )
+            {
+                if ( pOutputFileList->size[i] > 0 )
+                    PortaWrite(fh, pOutputFileList->data[i], (DWORD)pOutputFileList->size[i]);
+                PortaClose(fh);
+            }
+            free(pOutputFileList->data[i]);
+            pOutputFileList->data[i] = NULL;
+        }
+    }
+}
+
+// yes, this it totally lame, copying code from MinewaysMap
+static const wchar_t *removePath( const wchar_t *src )
+{
+    // find last \ in string
+    const wchar_t *strPtr = wcsrchr(src,(int)'\\');
+    if ( strPtr )
+        // found a \, so move up past it
+        strPtr++;
+    else
+    {
+        // look for /
+        strPtr = wcsrchr(src,(int)'/');
+        if ( strPtr )
+            // found a /, so move up past it
+            strPtr++;
+        else
+            // no \ or / found, just return string itself
+            return src;
+    }
+
+    return strPtr;
+}
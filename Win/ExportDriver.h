@@ -0,0 +1,46 @@
+/*
+Copyright (c) 2011, Eric Haines
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// The steps of an export that need no user interface: default settings, reading settings back
+// from an exported file's header, turning settings into Options, and zipping the results.
+// Shared by the Mineways UI and the MinewaysCmd console driver.
+
+#pragma once
+
+// Notes returned by SetExportOptions, for options that were asked for but that the file type cannot do.
+#define EXPORT_NOTE_ASCII_STL_NO_COLOR          1
+#define EXPORT_NOTE_VISCAM_STL_NO_TEXTURE       (1<<1)
+#define EXPORT_NOTE_MAGICS_STL_NO_TEXTURE       (1<<2)
+#define EXPORT_NOTE_PLY_NO_TEXTURE              (1<<3)
+
+#define EXPORT_NOTE_COUNT                       4
+
+void InitializeExportSettings( ExportFileData *pPrint, ExportFileData *pView, ExportFileData *pSchematic );
+int ImportExportSettings( const wchar_t *importFile, ExportFileData *pPrint, ExportFileData *pView, ExportFileData **ppEFD );
+int SetExportOptions( Options *pOptions, ExportFileData *pEFD, int printModel );
+const wchar_t *GetExportNoteText( int noteNum );
+void ZipExportFiles( FileList *pOutputFileList, int keepModelFiles, ProgressCallback callback );
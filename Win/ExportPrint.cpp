@@ -32,7 +32,8 @@ THE POSSIBILITY OF SUCH DAMAGE.
 #include "Resource.h"
 #include "ExportPrint.h"
 
-#define IS_STL ((epd.fileType == FILE_TYPE_ASCII_STL)||(epd.fileType == FILE_TYPE_BINARY_MAGICS_STL)||(epd.fileType == FILE_TYPE_BINARY_VISCAM_STL))
+// PLY, like STL, has no groups
+#define IS_STL ((epd.fileType == FILE_TYPE_ASCII_STL)||(epd.fileType == FILE_TYPE_BINARY_MAGICS_STL)||(epd.fileType == FILE_TYPE_BINARY_VISCAM_STL)||(epd.fileType == FILE_TYPE_BINARY_PLY))
 
 static int prevPhysMaterial;
 static int curPhysMaterial;
@@ -144,6 +145,8 @@ INT_PTR CALLBACK ExportPrint(HWND hDlg,UINT message,WPARAM wParam,LPARAM lParam)
             CheckDlgButton(hDlg,IDC_DELETE_FLOATERS,epd.chkDeleteFloaters);
             CheckDlgButton(hDlg,IDC_HOLLOW,epd.chkHollow[epd.fileType]);
             CheckDlgButton(hDlg,IDC_SUPER_HOLLOW,epd.chkHollow[epd.fileType]?epd.chkSuperHollow[epd.fileType]:BST_INDETERMINATE);
+            CheckDlgButton(hDlg,IDC_HOLLOW_BY_DISTANCE,epd.chkHollow[epd.fileType]?epd.chkHollowByDistance[epd.fileType]:BST_INDETERMINATE);
+            CheckDlgButton(hDlg,IDC_DRAIN_HOLES,(epd.chkHollow[epd.fileType]&&epd.chkHollowByDistance[epd.fileType])?epd.chkDrainHoles[epd.fileType]:BST_INDETERMINATE);
             CheckDlgButton(hDlg,IDC_MELT_SNOW,epd.chkMeltSnow);
 
             SetDlgItemTextA(hDlg,IDC_FLOAT_COUNT,epd.floaterCountString);
@@ -274,6 +277,8 @@ INT_PTR CALLBACK ExportPrint(HWND hDlg,UINT message,WPARAM wParam,LPARAM lParam)
                 UINT isHollowChecked = IsDlgButtonChecked(hDlg,IDC_HOLLOW);
                 // if hollow turned on, then default setting for superhollow is on
                 CheckDlgButton(hDlg,IDC_SUPER_HOLLOW,isHollowChecked?epd.chkSuperHollow[epd.fileType]:BST_INDETERMINATE);
+                CheckDlgButton(hDlg,IDC_HOLLOW_BY_DISTANCE,isHollowChecked?epd.chkHollowByDistance[epd.fileType]:BST_INDETERMINATE);
+                CheckDlgButton(hDlg,IDC_DRAIN_HOLES,(isHollowChecked&&epd.chkHollowByDistance[epd.fileType])?epd.chkDrainHoles[epd.fileType]:BST_INDETERMINATE);
             }
             break;
         case IDC_SUPER_HOLLOW:
@@ -291,6 +296,38 @@ INT_PTR CALLBACK ExportPrint(HWND hDlg,UINT message,WPARAM wParam,LPARAM lParam)
                 }
             }
             break;
+        case IDC_HOLLOW_BY_DISTANCE:
+            {
+                UINT isHollowChecked = IsDlgButtonChecked(hDlg,IDC_HOLLOW);
+                if ( !isHollowChecked )
+                {
+                    CheckDlgButton(hDlg,IDC_HOLLOW_BY_DISTANCE,BST_INDETERMINATE);
+                }
+                else
+                {
+                    UINT isByDistanceIndeterminate = ( IsDlgButtonChecked(hDlg,IDC_HOLLOW_BY_DISTANCE) == BST_INDETERMINATE );
+                    if ( isByDistanceIndeterminate )
+                        CheckDlgButton(hDlg,IDC_HOLLOW_BY_DISTANCE,BST_UNCHECKED);
+                }
+                // drain holes are only drilled when hollowing by distance
+                CheckDlgButton(hDlg,IDC_DRAIN_HOLES,(IsDlgButtonChecked(hDlg,IDC_HOLLOW_BY_DISTANCE) == BST_CHECKED)?epd.chkDrainHoles[epd.fileType]:BST_INDETERMINATE);
+            }
+            break;
+        case IDC_DRAIN_HOLES:
+            {
+                UINT isByDistanceChecked = ( IsDlgButtonChecked(hDlg,IDC_HOLLOW_BY_DISTANCE) == BST_CHECKED );
+                if ( !isByDistanceChecked )
+                {
+                    CheckDlgButton(hDlg,IDC_DRAIN_HOLES,BST_INDETERMINATE);
+                }
+                else
+                {
+                    UINT isDrainHolesIndeterminate = ( IsDlgButtonChecked(hDlg,IDC_DRAIN_HOLES) == BST_INDETERMINATE );
+                    if ( isDrainHolesIndeterminate )
+                        CheckDlgButton(hDlg,IDC_DRAIN_HOLES,BST_UNCHECKED);
+                }
+            }
+            break;
 
         case IDC_RADIO_EXPORT_NO_MATERIALS:
             // set the combo box material to white (might already be that, which is fine)
@@ -693,6 +730,9 @@ ChangeMaterial:
                 lepd.chkHollow[epd.fileType] = IsDlgButtonChecked(hDlg,IDC_HOLLOW);
                 // if hollow is off, superhollow is off
                 lepd.chkSuperHollow[epd.fileType] = lepd.chkHollow[epd.fileType] ? IsDlgButtonChecked(hDlg,IDC_SUPER_HOLLOW) : 0;
+                lepd.chkHollowByDistance[epd.fileType] = lepd.chkHollow[epd.fileType] ? IsDlgButtonChecked(hDlg,IDC_HOLLOW_BY_DISTANCE) : 0;
+                // drain holes are only drilled when hollowing by distance
+                lepd.chkDrainHoles[epd.fileType] = lepd.chkHollowByDistance[epd.fileType] ? IsDlgButtonChecked(hDlg,IDC_DRAIN_HOLES) : 0;
 
                 lepd.chkMeltSnow = IsDlgButtonChecked(hDlg,IDC_MELT_SNOW);
 
@@ -0,0 +1,244 @@
+/*
+Copyright (c) 2011, Eric Haines
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "stdafx.h"
+#include <stdio.h>
+#ifdef WIN32
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+typedef struct TimingStage {
+    long long wall;         // PortaTicks ticks
+    unsigned long long cpu; // 100 ns units, this thread's user plus kernel time
+    long long startWall;
+    unsigned long long startCPU;
+    int started;
+    int calls;
+} TimingStage;
+
+static THREAD_LOCAL int gTimingOn = 0;
+static THREAD_LOCAL TimingStage gStage[TIMING_STAGE_COUNT];
+static THREAD_LOCAL long long gCounter[TIMING_COUNTER_COUNT];
+
+static const char *gStageName[TIMING_STAGE_COUNT] = {
+    "chunkLoad",
+    "regionRead",
+    "inflate",
+    "nbtParse",
+    "texture",
+    "populateBox",
+    "filterBox",
+    "groups",
+    "faces",
+    "sort",
+    "write",
+    "pngEncode",
+    "mapDraw",
+    "mapBlit",
+};
+
+static const char *gCounterName[TIMING_COUNTER_COUNT] = {
+    "chunksLoaded",
+    "cacheHits",
+    "bytesRead",
+    "bytesWritten",
+    "faces",
+    "vertices",
+    "peakMemoryBytes",
+    "tilesReused",
+};
+
+static unsigned long long threadCPUTime();
+
+void Timing_Reset( int on )
+{
+    memset( gStage, 0, sizeof(gStage) );
+    memset( gCounter, 0, sizeof(gCounter) );
+    gTimingOn = on;
+}
+
+int Timing_IsOn()
+{
+    return gTimingOn;
+}
+
+void Timing_Start( int stage )
+{
+    if ( gTimingOn )
+    {
+        gStage[stage].startWall = PortaTicks();
+        gStage[stage].startCPU = threadCPUTime();
+        gStage[stage].started = 1;
+    }
+}
+
+// a stop with no start, e.g. when the start was skipped by an early return, is ignored
+void Timing_Stop( int stage )
+{
+    if ( gTimingOn && gStage[stage].started )
+    {
+        gStage[stage].wall += PortaTicks() - gStage[stage].startWall;
+        gStage[stage].cpu += threadCPUTime() - gStage[stage].startCPU;
+        gStage[stage].started = 0;
+        gStage[stage].calls++;
+    }
+}
+
+void Timing_Count( int counter, long long amount )
+{
+    gCounter[counter] += amount;
+}
+
+void Timing_Set( int counter, long long value )
+{
+    gCounter[counter] = value;
+}
+
+void Timing_SetPeakMemory()
+{
+#ifdef WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    if ( GetProcessMemoryInfo( GetCurrentProcess(), &pmc, sizeof(pmc) ) )
+    {
+        gCounter[TIMING_PEAK_MEMORY] = (long long)pmc.PeakPagefileUsage;
+    }
+#else
+    // the most resident memory, in KB, there being no commit charge to go by
+    struct rusage usage;
+    if ( getrusage( RUSAGE_SELF, &usage ) == 0 )
+    {
+        gCounter[TIMING_PEAK_MEMORY] = (long long)usage.ru_maxrss * 1024;
+    }
+#endif
+}
+
+const char *Timing_StageName( int stage )
+{
+    return gStageName[stage];
+}
+
+const char *Timing_CounterName( int counter )
+{
+    return gCounterName[counter];
+}
+
+void Timing_GetStage( int stage, double *pWall, double *pCPU, int *pCalls )
+{
+    *pWall = (double)gStage[stage].wall / (double)PortaTicksPerSecond();
+    *pCPU = (double)gStage[stage].cpu * 1e-7;
+    *pCalls = gStage[stage].calls;
+}
+
+long long Timing_GetCounter( int counter )
+{
+    return gCounter[counter];
+}
+
+int Timing_WriteJSON( const wchar_t *fileName, int fileType )
+{
+#ifdef WIN32
+    DWORD br;
+#endif
+    char outputString[256];
+    int i;
+
+    PORTAFILE fh = PortaCreate( fileName );
+    if ( fh == INVALID_HANDLE_VALUE )
+        return MW_CANNOT_CREATE_FILE;
+
+    sprintf_s( outputString, 256, "{\n  \"fileType\": %d,\n  \"stages\": {\n", fileType );
+    if ( PortaWrite( fh, outputString, strlen(outputString) ) )
+        goto WriteError;
+    for ( i = 0; i < TIMING_STAGE_COUNT; i++ )
+    {
+        double wall, cpu;
+        int calls;
+        Timing_GetStage( i, &wall, &cpu, &calls );
+        sprintf_s( outputString, 256, "    \"%s\": { \"wallSeconds\": %.6f, \"cpuSeconds\": %.6f, \"calls\": %d }%s\n",
+            gStageName[i], wall, cpu, calls, ( i < TIMING_STAGE_COUNT-1 ) ? "," : "" );
+        if ( PortaWrite( fh, outputString, strlen(outputString) ) )
+            goto WriteError;
+    }
+    sprintf_s( outputString, 256, "  },\n  \"counters\": {\n" );
+    if ( PortaWrite( fh, outputString, strlen(outputString) ) )
+        goto WriteError;
+    for ( i = 0; i < TIMING_COUNTER_COUNT; i++ )
+    {
+        sprintf_s( outputString, 256, "    \"%s\": %lld%s\n",
+            gCounterName[i], gCounter[i], ( i < TIMING_COUNTER_COUNT-1 ) ? "," : "" );
+        if ( PortaWrite( fh, outputString, strlen(outputString) ) )
+            goto WriteError;
+    }
+    sprintf_s( outputString, 256, "  }\n}\n" );
+    if ( PortaWrite( fh, outputString, strlen(outputString) ) )
+        goto WriteError;
+
+    PortaClose( fh );
+    return MW_NO_ERROR;
+
+WriteError:
+    PortaClose( fh );
+    return MW_CANNOT_WRITE_TO_FILE;
+}
+
+double Timing_Percentile( const double *sorted, int count, double fraction )
+{
+    int index = (int)( fraction*(count-1) + 0.5 );
+    return sorted[index];
+}
+
+int Timing_CompareDoubles( const void *a, const void *b )
+{
+    double da = *(const double *)a;
+    double db = *(const double *)b;
+    return ( da < db ) ? -1 : ( ( da > db ) ? 1 : 0 );
+}
+
+// CPU time of only this thread, so that exports running at once on other threads don't count.
+// Work an export hands off to other threads, such as PNG compression, is not counted either.
+static unsigned long long threadCPUTime()
+{
+#ifdef WIN32
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+    ULARGE_INTEGER kernel, user;
+
+    if ( !GetThreadTimes( GetCurrentThread(), &creationTime, &exitTime, &kernelTime, &userTime ) )
+        return 0;
+    kernel.LowPart = kernelTime.dwLowDateTime;
+    kernel.HighPart = kernelTime.dwHighDateTime;
+    user.LowPart = userTime.dwLowDateTime;
+    user.HighPart = userTime.dwHighDateTime;
+    return kernel.QuadPart + user.QuadPart;
+#else
+    struct timespec cpu;
+    if ( clock_gettime( CLOCK_THREAD_CPUTIME_ID, &cpu ) != 0 )
+        return 0;
+    return (unsigned long long)cpu.tv_sec * 10000000ULL + (unsigned long long)cpu.tv_nsec / 100;
+#endif
+}
@@ -0,0 +1,90 @@
+/*
+Copyright (c) 2011, Eric Haines
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Timing and counts for each stage of an export, so that what's slow can be found. Kept per thread,
+// like the rest of an export's state; SaveVolume starts afresh each time, if Options.timingReport asks.
+// DrawMap times its stages too, when something has turned timing on for its thread.
+
+#pragma once
+
+// Options.timingReport bits
+#define TIMING_REPORT_JSON              0x1     // write <output>-timing.json next to the exported files
+#define TIMING_REPORT_HEADER            0x2     // add the times so far to the statistics in the model file's header
+
+// The timed stages. Stages can be inside others: chunk loading happens during populating the box
+// and map drawing, and region reading, inflating and NBT parsing happen during chunk loading.
+enum {
+    TIMING_CHUNK_LOAD,      // reading chunks not in the cache
+    TIMING_REGION_READ,     // reading a chunk's bytes from its region file
+    TIMING_INFLATE,         // decompressing a chunk
+    TIMING_NBT_PARSE,       // finding a chunk's blocks in its NBT data
+    TIMING_TEXTURE,         // reading terrainExt.png and building the texture atlas
+    TIMING_POPULATE_BOX,    // copying the selection out of the chunks
+    TIMING_FILTER_BOX,      // removing unwanted blocks, outputting billboards
+    TIMING_GROUPS,          // finding parts, welding, hollowing, deleting floaters
+    TIMING_FACES,           // making faces; when streaming OBJ, this includes writing them
+    TIMING_SORT,            // sorting faces by material
+    TIMING_WRITE,           // the file type's writer
+    TIMING_PNG_ENCODE,      // compressing and writing texture files
+    TIMING_MAP_DRAW,        // drawing one chunk's tile of the map, including loading the chunk
+    TIMING_MAP_BLIT,        // copying a tile into the map, scaled
+    TIMING_STAGE_COUNT
+};
+
+enum {
+    TIMING_CHUNKS_LOADED,   // chunks read from region files
+    TIMING_CACHE_HITS,      // chunks found in the chunk cache
+    TIMING_BYTES_READ,      // from region files
+    TIMING_BYTES_WRITTEN,   // size of all files output
+    TIMING_FACES_OUTPUT,
+    TIMING_VERTICES_OUTPUT,
+    TIMING_PEAK_MEMORY,     // the process's peak memory so far, in bytes; -benchmark gives each export its own process
+    TIMING_TILES_REUSED,    // map tiles that were already drawn as needed, so were not drawn again
+    TIMING_COUNTER_COUNT
+};
+
+void Timing_Reset( int on );
+int Timing_IsOn();
+void Timing_Start( int stage );
+void Timing_Stop( int stage );
+void Timing_Count( int counter, long long amount );
+void Timing_Set( int counter, long long value );
+void Timing_SetPeakMemory();
+
+const char *Timing_StageName( int stage );
+const char *Timing_CounterName( int counter );
+// seconds of wall and CPU time for the stage, and how many times it was run
+void Timing_GetStage( int stage, double *pWall, double *pCPU, int *pCalls );
+long long Timing_GetCounter( int counter );
+
+// Returns 0 on success, else MW_CANNOT_CREATE_FILE or MW_CANNOT_WRITE_TO_FILE
+int Timing_WriteJSON( const wchar_t *fileName, int fileType );
+
+// For the benchmarks' statistics: the value a fraction of the way through values sorted with
+// qsort and Timing_CompareDoubles, to the nearest one.
+double Timing_Percentile( const double *sorted, int count, double fraction );
+int Timing_CompareDoubles( const void *a, const void *b );
@@ -0,0 +1,267 @@
+/*
+Copyright (c) 2011, Eric Haines
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "stdafx.h"
+#include <stdio.h>
+#include <math.h>
+#include "MapBenchmark.h"
+
+// size of the map drawn, in pixels, as for a typical Mineways window
+#define MAP_WIDTH       1024
+#define MAP_HEIGHT      768
+
+// the zoom Mineways starts at and the most the path zooms in to
+#define MAP_MIN_ZOOM    1.0
+#define MAP_MAX_ZOOM    16.0
+
+#define MAX_MAP_FRAMES  256
+
+// the parts of the path
+enum {
+    PATH_PAN,           // a quarter of the map to the east each frame, then back
+    PATH_ZOOM,          // zoom in, then back out
+    PATH_DEPTH,         // lower the depth slider to the bottom, then raise it back up
+    PATH_CAVEMODE,      // turn each view option on and off again
+    PATH_LIGHTING,
+    PATH_BIOMES,
+    PATH_COUNT
+};
+
+static const char *gPathName[PATH_COUNT] = {
+    "pan",
+    "zoom",
+    "depth",
+    "cavemode",
+    "lighting",
+    "biomes",
+};
+
+// how many frames to take for each toggle of a view option
+#define TOGGLE_FRAMES   8
+// how many steps the depth slider is moved in, each way
+#define DEPTH_STEPS     32
+
+typedef struct MapFrame {
+    int path;
+    double cx, cz;      // center of the map, in blocks
+    double zoom;
+    int topy;
+    int worldType;
+    // results
+    double totalSeconds;
+    double loadSeconds;
+    double drawSeconds; // drawing tiles, not counting loading chunks
+    double blitSeconds;
+    int chunksLoaded;
+    int cacheHits;
+    int tilesReused;
+} MapFrame;
+
+static int makePath( MapFrame *frames, double cx, double cz );
+static int addFrame( MapFrame *frames, int frameCount, int path, double cx, double cz, double zoom, int topy, int worldType );
+static void drawPath( const wchar_t *world, int dimension, MapFrame *frames, int frameCount, unsigned char *bits, int cold, int timed );
+static void printFrames( MapFrame *frames, int frameCount );
+static void printSummary( MapFrame *frames, int frameCount );
+
+
+int RunMapBenchmark( const wchar_t *world, int dimension, int cold )
+{
+    int spawnX, spawnY, spawnZ;
+
+    if ( GetSpawn( world, &spawnX, &spawnY, &spawnZ ) != 0 )
+    {
+        fwprintf( stderr, L"Cannot read level.dat in world %ls\n", world );
+        return -1;
+    }
+
+    MapFrame *frames = (MapFrame *)malloc( MAX_MAP_FRAMES*sizeof(MapFrame) );
+    unsigned char *bits = (unsigned char *)malloc( MAP_WIDTH*MAP_HEIGHT*4 );
+    if ( frames == NULL || bits == NULL )
+    {
+        free( frames );
+        free( bits );
+        return -1;
+    }
+
+    // x is down the screen and z across it
+    int frameCount = makePath( frames, (double)spawnX, (double)spawnZ );
+
+    ClearCache();
+    if ( !cold )
+    {
+        fwprintf( stderr, L"Drawing the path once to fill the cache\n" );
+        drawPath( world, dimension, frames, frameCount, bits, cold, 0 );
+    }
+    fwprintf( stderr, L"Drawing %d frames of %dx%d, %ls cache\n", frameCount, MAP_WIDTH, MAP_HEIGHT, cold ? L"cold" : L"warm" );
+    drawPath( world, dimension, frames, frameCount, bits, cold, 1 );
+
+    printFrames( frames, frameCount );
+    printSummary( frames, frameCount );
+
+    free( frames );
+    free( bits );
+    return 0;
+}
+
+static int makePath( MapFrame *frames, double cx, double cz )
+{
+    int frameCount = 0;
+    int i;
+
+    // pan east a quarter of the map each frame, then back over the same ground
+    double step = MAP_WIDTH / ( 4.0 * MAP_MIN_ZOOM );
+    for ( i = 0; i < 32; i++ )
+        frameCount = addFrame( frames, frameCount, PATH_PAN, cx, cz + i*step, MAP_MIN_ZOOM, MAP_MAX_HEIGHT, 0x0 );
+    for ( i = 31; i >= 0; i-- )
+        frameCount = addFrame( frames, frameCount, PATH_PAN, cx, cz + i*step, MAP_MIN_ZOOM, MAP_MAX_HEIGHT, 0x0 );
+
+    // zoom in by the same factor each frame, as the mouse wheel does, then out again
+    for ( i = 0; i <= 24; i++ )
+        frameCount = addFrame( frames, frameCount, PATH_ZOOM, cx, cz, MAP_MIN_ZOOM*pow( MAP_MAX_ZOOM/MAP_MIN_ZOOM, i/24.0 ), MAP_MAX_HEIGHT, 0x0 );
+    for ( i = 23; i >= 0; i-- )
+        frameCount = addFrame( frames, frameCount, PATH_ZOOM, cx, cz, MAP_MIN_ZOOM*pow( MAP_MAX_ZOOM/MAP_MIN_ZOOM, i/24.0 ), MAP_MAX_HEIGHT, 0x0 );
+
+    // every tile is drawn again at each depth, from the top down to 0, then back up to the top
+    for ( i = 0; i <= DEPTH_STEPS; i++ )
+        frameCount = addFrame( frames, frameCount, PATH_DEPTH, cx, cz, MAP_MIN_ZOOM, MAP_MAX_HEIGHT - i*MAP_MAX_HEIGHT/DEPTH_STEPS, 0x0 );
+    for ( i = DEPTH_STEPS-1; i >= 0; i-- )
+        frameCount = addFrame( frames, frameCount, PATH_DEPTH, cx, cz, MAP_MIN_ZOOM, MAP_MAX_HEIGHT - i*MAP_MAX_HEIGHT/DEPTH_STEPS, 0x0 );
+
+    // each option on, then off
+    for ( i = 0; i < TOGGLE_FRAMES; i++ )
+        frameCount = addFrame( frames, frameCount, PATH_CAVEMODE, cx, cz, MAP_MIN_ZOOM, MAP_MAX_HEIGHT, ( i & 1 ) ? 0x0 : CAVEMODE );
+    for ( i = 0; i < TOGGLE_FRAMES; i++ )
+        frameCount = addFrame( frames, frameCount, PATH_LIGHTING, cx, cz, MAP_MIN_ZOOM, MAP_MAX_HEIGHT, ( i & 1 ) ? 0x0 : LIGHTING );
+    for ( i = 0; i < TOGGLE_FRAMES; i++ )
+        frameCount = addFrame( frames, frameCount, PATH_BIOMES, cx, cz, MAP_MIN_ZOOM, MAP_MAX_HEIGHT, ( i & 1 ) ? 0x0 : BIOMES );
+
+    return frameCount;
+}
+
+static int addFrame( MapFrame *frames, int frameCount, int path, double cx, double cz, double zoom, int topy, int worldType )
+{
+    if ( frameCount >= MAX_MAP_FRAMES )
+        return frameCount;
+    MapFrame *pFrame = &frames[frameCount];
+    memset( pFrame, 0, sizeof(MapFrame) );
+    pFrame->path = path;
+    pFrame->cx = cx;
+    pFrame->cz = cz;
+    pFrame->zoom = zoom;
+    pFrame->topy = topy;
+    pFrame->worldType = worldType;
+    return frameCount + 1;
+}
+
+static void drawPath( const wchar_t *world, int dimension, MapFrame *frames, int frameCount, unsigned char *bits, int cold, int timed )
+{
+    long long frequency, start, end;
+    Options opts;
+    int hitsFound[4];
+    double cpu;
+    int calls;
+
+    memset( &opts, 0, sizeof(Options) );
+    frequency = PortaTicksPerSecond();
+    for ( int i = 0; i < frameCount; i++ )
+    {
+        MapFrame *pFrame = &frames[i];
+        opts.worldType = dimension | pFrame->worldType;
+        hitsFound[0] = hitsFound[1] = hitsFound[2] = 0;
+        hitsFound[3] = MAP_MAX_HEIGHT+1;
+
+        if ( cold )
+            ClearCache();
+
+        Timing_Reset( timed );
+        start = PortaTicks();
+        DrawMap( world, pFrame->cx, pFrame->cz, pFrame->topy, MAP_WIDTH, MAP_HEIGHT, pFrame->zoom, bits, opts, hitsFound, NULL );
+        end = PortaTicks();
+        if ( !timed )
+            continue;
+
+        double drawSeconds;
+        pFrame->totalSeconds = (double)(end - start) / (double)frequency;
+        Timing_GetStage( TIMING_CHUNK_LOAD, &pFrame->loadSeconds, &cpu, &calls );
+        Timing_GetStage( TIMING_MAP_DRAW, &drawSeconds, &cpu, &calls );
+        Timing_GetStage( TIMING_MAP_BLIT, &pFrame->blitSeconds, &cpu, &calls );
+        // loading happens inside drawing
+        pFrame->drawSeconds = drawSeconds - pFrame->loadSeconds;
+        pFrame->chunksLoaded = (int)Timing_GetCounter( TIMING_CHUNKS_LOADED );
+        pFrame->cacheHits = (int)Timing_GetCounter( TIMING_CACHE_HITS );
+        pFrame->tilesReused = (int)Timing_GetCounter( TIMING_TILES_REUSED );
+    }
+    Timing_Reset( 0 );
+}
+
+static void printFrames( MapFrame *frames, int frameCount )
+{
+    wprintf( L"frame\tpath\tcx\tcz\tzoom\ttopy\toptions\ttotal ms\tload ms\tdraw ms\tblit ms\tloaded\tcache hits\thit %%\ttiles reused\n" );
+    for ( int i = 0; i < frameCount; i++ )
+    {
+        MapFrame *pFrame = &frames[i];
+        int lookups = pFrame->chunksLoaded + pFrame->cacheHits;
+        wprintf( L"%d\t%hs\t%.0f\t%.0f\t%.2f\t%d\t0x%x\t%.3f\t%.3f\t%.3f\t%.3f\t%d\t%d\t%.1f\t%d\n",
+            i, gPathName[pFrame->path], pFrame->cx, pFrame->cz, pFrame->zoom, pFrame->topy, pFrame->worldType,
+            1000.0*pFrame->totalSeconds, 1000.0*pFrame->loadSeconds, 1000.0*pFrame->drawSeconds, 1000.0*pFrame->blitSeconds,
+            pFrame->chunksLoaded, pFrame->cacheHits, ( lookups > 0 ) ? 100.0*pFrame->cacheHits/lookups : 0.0, pFrame->tilesReused );
+    }
+}
+
+// frame times for each part of the path, and where the time went
+static void printSummary( MapFrame *frames, int frameCount )
+{
+    double sorted[MAX_MAP_FRAMES];
+
+    wprintf( L"\npath\tframes\tmean ms\tp50 ms\tp95 ms\tmax ms\tload ms\tdraw ms\tblit ms\thit %%\n" );
+    for ( int path = 0; path < PATH_COUNT; path++ )
+    {
+        double total = 0.0, load = 0.0, draw = 0.0, blit = 0.0;
+        long long loaded = 0, hits = 0;
+        int count = 0;
+        for ( int i = 0; i < frameCount; i++ )
+        {
+            MapFrame *pFrame = &frames[i];
+            if ( pFrame->path != path )
+                continue;
+            sorted[count++] = pFrame->totalSeconds;
+            total += pFrame->totalSeconds;
+            load += pFrame->loadSeconds;
+            draw += pFrame->drawSeconds;
+            blit += pFrame->blitSeconds;
+            loaded += pFrame->chunksLoaded;
+            hits += pFrame->cacheHits;
+        }
+        if ( count == 0 )
+            continue;
+        qsort( sorted, count, sizeof(double), Timing_CompareDoubles );
+        wprintf( L"%hs\t%d\t%.3f\t%.3f\t%.3f\t%.3f\t%.3f\t%.3f\t%.3f\t%.1f\n", gPathName[path], count,
+            1000.0*total/count, 1000.0*Timing_Percentile( sorted, count, 0.5 ), 1000.0*Timing_Percentile( sorted, count, 0.95 ), 1000.0*sorted[count-1],
+            1000.0*load/count, 1000.0*draw/count, 1000.0*blit/count, ( loaded+hits > 0 ) ? 100.0*hits/(loaded+hits) : 0.0 );
+    }
+}
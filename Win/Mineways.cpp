@@ -30,8 +30,9 @@ THE POSSIBILITY OF SUCH DAMAGE.
 #include "Mineways.h"
 #include "ColorSchemes.h"
 #include "ExportPrint.h"
-#include "XZip.h"
+#include "ExportDriver.h"
 #include "lodepng.h"
+#include "rwpng.h"
 #include <assert.h>
 #include <ShlObj.h>
 #include <Shlwapi.h>
@@ -163,9 +164,6 @@ static struct {
     {_T("Error writing to export file; partial file output\n\nPNG error: %s"), _T("Export error"), MB_OK|MB_ICONERROR},	// <<21
 };
 
-// Number of lines to read from the header - don't want to go too far
-#define HEADER_LINES 60
-
 // Forward declarations of functions included in this code module:
 ATOM				MyRegisterClass(HINSTANCE hInstance);
 BOOL				InitInstance(HINSTANCE, int);
@@ -190,12 +188,6 @@ static void copyOverExportPrintData( ExportFileData *pEFD );
 static int saveObjFile( HWND hWnd, wchar_t *objFileName, int printModel, wchar_t *terrainFileName, BOOL showDialog );
 static void PopupErrorDialogs( int errCode );
 static BOOL GetAppVersion( TCHAR *LibName, WORD *MajorVersion, WORD *MinorVersion, WORD *BuildNumber, WORD *RevisionNumber );
-static const wchar_t *removePath( const wchar_t *src );
-static void initializeExportDialogData();
-static int importSettings( wchar_t *importFile );
-static int readLineSet( FILE *fh, char lines[HEADER_LINES][120], int maxLine );
-static int readLine( FILE *fh, char *inputString, int stringLength );
-static int findLine( char *checkString, char lines[HEADER_LINES][120], int startLine, int maxLines );
 static void formTitle(wchar_t *world, wchar_t *title);
 
 
@@ -216,7 +208,7 @@ int APIENTRY _tWinMain(HINSTANCE hInstance,
     UNREFERENCED_PARAMETER(hPrevInstance);
     UNREFERENCED_PARAMETER(lpCmdLine);
 
-    initializeExportDialogData();
+    InitializeExportSettings( &gExportPrintData, &gExportViewData, &gExportSchematicData );
 
     MSG msg;
     HACCEL hAccelTable;
@@ -1319,7 +1311,7 @@ InitEnable:
             {
                 // copy file name, since it definitely appears to exist.
                 wcscpy_s(gImportFile,MAX_PATH,path);
-                int retVal = importSettings( gImportFile );
+                int retVal = ImportExportSettings( gImportFile, &gExportPrintData, &gExportViewData, &gpEFD );
                 if ( MW_NO_ERROR != retVal )
                 {
                     // error, so warn.
@@ -1418,7 +1410,7 @@ InitEnable:
                     ofn.lpstrFile=gExportPath;
                     //gExportPath[0]=0;
                     ofn.nMaxFile=MAX_PATH;
-                    ofn.lpstrFilter= L"Schematic file (*.schematic)\0*.schematic\0";
+                    ofn.lpstrFilter= L"Schematic file (*.schematic)\0*.schematic\0Sponge schematic file (*.schem)\0*.schem\0";
                     ofn.nFilterIndex= 1;
                     ofn.lpstrFileTitle=NULL;
                     ofn.nMaxFileTitle=0;
@@ -1427,6 +1419,12 @@ InitEnable:
                     ofn.Flags=OFN_PATHMUSTEXIST | OFN_FILEMUSTEXIST;
 
                     saveOK = GetSaveFileName(&ofn);
+                    // the export writes the Sponge format for a file named .schem
+                    if ( saveOK && ofn.nFilterIndex == 2 &&
+                        ( wcslen(gExportPath) < 6 || _wcsicmp(gExportPath + wcslen(gExportPath) - 6, L".schem") != 0 ) )
+                    {
+                        wcscat_s(gExportPath, MAX_PATH, L".schem");
+                    }
 
                     gExportSchematicData.fileType = FILE_TYPE_SCHEMATIC;	// always
                 }
@@ -1439,8 +1437,8 @@ InitEnable:
                     ofn.lpstrFile=gExportPath;
                     //gExportPath[0]=0;
                     ofn.nMaxFile=MAX_PATH;
-                    ofn.lpstrFilter= gPrintModel ? L"Sculpteo: Wavefront OBJ, absolute (*.obj)\0*.obj\0Wavefront OBJ, relative (*.obj)\0*.obj\0i.materialise: Binary Materialise Magics STL stereolithography file (*.stl)\0*.stl\0Binary VisCAM STL stereolithography file (*.stl)\0*.stl\0ASCII text STL stereolithography file (*.stl)\0*.stl\0Shapeways: VRML 2.0 (VRML 97) file (*.wrl)\0*.wrl\0" :
-                        L"Wavefront OBJ, absolute (*.obj)\0*.obj\0Wavefront OBJ, relative (*.obj)\0*.obj\0Binary Materialise Magics STL stereolithography file (*.stl)\0*.stl\0Binary VisCAM STL stereolithography file (*.stl)\0*.stl\0ASCII text STL stereolithography file (*.stl)\0*.stl\0VRML 2.0 (VRML 97) file (*.wrl)\0*.wrl\0";
+                    ofn.lpstrFilter= gPrintModel ? L"Sculpteo: Wavefront OBJ, absolute (*.obj)\0*.obj\0Wavefront OBJ, relative (*.obj)\0*.obj\0i.materialise: Binary Materialise Magics STL stereolithography file (*.stl)\0*.stl\0Binary VisCAM STL stereolithography file (*.stl)\0*.stl\0ASCII text STL stereolithography file (*.stl)\0*.stl\0Shapeways: VRML 2.0 (VRML 97) file (*.wrl)\0*.wrl\0Binary PLY polygon file (*.ply)\0*.ply\0" :
+                        L"Wavefront OBJ, absolute (*.obj)\0*.obj\0Wavefront OBJ, relative (*.obj)\0*.obj\0Binary Materialise Magics STL stereolithography file (*.stl)\0*.stl\0Binary VisCAM STL stereolithography file (*.stl)\0*.stl\0ASCII text STL stereolithography file (*.stl)\0*.stl\0VRML 2.0 (VRML 97) file (*.wrl)\0*.wrl\0Binary PLY polygon file (*.ply)\0*.ply\0glTF 2.0 binary file (*.glb)\0*.glb\0";
                     ofn.nFilterIndex=(gPrintModel ? gExportPrintData.fileType+1 : gExportViewData.fileType+1);
                     ofn.lpstrFileTitle=NULL;
                     ofn.nMaxFileTitle=0;
@@ -1681,6 +1679,20 @@ InitEnable:
             gOptions.moreExportMemory = !gOptions.moreExportMemory;
             CheckMenuItem(GetMenu(hWnd),wmId,(gOptions.moreExportMemory)?MF_CHECKED:MF_UNCHECKED);
             break;
+        case IDM_HELP_FASTPNG:
+            // Texture files for large terrain files can take longer to compress than the model takes to make.
+            gOptions.pngCompression = (gOptions.pngCompression == PNG_COMPRESSION_FAST) ? PNG_COMPRESSION_DEFAULT : PNG_COMPRESSION_FAST;
+            CheckMenuItem(GetMenu(hWnd),wmId,(gOptions.pngCompression == PNG_COMPRESSION_FAST)?MF_CHECKED:MF_UNCHECKED);
+            break;
+        case IDM_HELP_KEEPVOLUME:
+            // Re-exporting the same selection with other settings needn't read it in again, at the cost of holding on to it.
+            gOptions.keepVolume = !gOptions.keepVolume;
+            if ( !gOptions.keepVolume )
+            {
+                ClearVolumeCache();
+            }
+            CheckMenuItem(GetMenu(hWnd),wmId,(gOptions.keepVolume)?MF_CHECKED:MF_UNCHECKED);
+            break;
         default:
             return DefWindowProc(hWnd, message, wParam, lParam);
         }
@@ -2042,6 +2054,8 @@ static int loadWorld()
 {
     int version;
     CloseAll();
+    // the world may have changed on disk, so don't reuse the last volume exported
+    ClearVolumeCache();
 
     if ( gWorld[0] == 0 )
     {
@@ -2429,6 +2443,10 @@ static void copyOverExportPrintData( ExportFileData *pEFD )
         dest[1] = FILE_TYPE_BINARY_VISCAM_STL;
         count = 2;
         break;
+    case FILE_TYPE_BINARY_PLY:
+    case FILE_TYPE_GLTF:
+        // no other format is close enough to share settings with
+        return;
     default:
         // unknown, don't copy
         assert(0);
@@ -2534,183 +2552,22 @@ static int saveObjFile( HWND hWnd, wchar_t *objFileName, int printModel, wchar_t
     }
     SetHighlightState(on, gpEFD->minxVal, gpEFD->minyVal, gpEFD->minzVal, gpEFD->maxxVal, gpEFD->maxyVal, gpEFD->maxzVal );
 
-    // export all
-    if ( gpEFD->chkExportAll )
-    {
-        if ( printModel )
-        {
-            gOptions.saveFilterFlags = BLF_WHOLE | BLF_ALMOST_WHOLE | BLF_STAIRS | BLF_HALF | BLF_MIDDLER | BLF_BILLBOARD | BLF_PANE | BLF_FLATTOP |
-                BLF_FLATSIDE | BLF_3D_BIT;
-        }
-        else
-        {
-            gOptions.saveFilterFlags = BLF_WHOLE | BLF_ALMOST_WHOLE | BLF_STAIRS | BLF_HALF | BLF_MIDDLER | BLF_BILLBOARD | BLF_PANE | BLF_FLATTOP |
-                BLF_FLATSIDE | BLF_SMALL_MIDDLER | BLF_SMALL_BILLBOARD;
-        }
-    }
-    else
-    {
-        gOptions.saveFilterFlags = BLF_WHOLE | BLF_ALMOST_WHOLE | BLF_STAIRS | BLF_HALF | BLF_MIDDLER | BLF_BILLBOARD | BLF_PANE | BLF_FLATTOP | BLF_FLATSIDE;
-    }
-
-    // export options
-    if ( gpEFD->radioExportMtlColors[gpEFD->fileType] == 1 )
-    {
-        gOptions.exportFlags |= EXPT_OUTPUT_MATERIALS | EXPT_GROUP_BY_MATERIAL;
-    }
-    else if ( gpEFD->radioExportSolidTexture[gpEFD->fileType] == 1 )
-    {
-        gOptions.exportFlags |= EXPT_OUTPUT_MATERIALS | EXPT_OUTPUT_TEXTURE_SWATCHES | EXPT_GROUP_BY_MATERIAL;
-    }
-    else if ( gpEFD->radioExportFullTexture[gpEFD->fileType] == 1 )
-    {
-        gOptions.exportFlags |= EXPT_OUTPUT_MATERIALS | EXPT_OUTPUT_TEXTURE_IMAGES | EXPT_GROUP_BY_MATERIAL;
-        // TODO: if we're *viewing* full textures, output all the billboards!
-        //  gOptions.saveFilterFlags |= BLF_SMALL_BILLBOARD;
-    }
-
-    gOptions.exportFlags |=
-        (gpEFD->chkFillBubbles ? EXPT_FILL_BUBBLES : 0x0) |
-        ((gpEFD->chkFillBubbles&&gpEFD->chkSealEntrances) ? EXPT_FILL_BUBBLES|EXPT_SEAL_ENTRANCES : 0x0) |
-        ((gpEFD->chkFillBubbles&&gpEFD->chkSealSideTunnels) ? EXPT_FILL_BUBBLES|EXPT_SEAL_SIDE_TUNNELS : 0x0) |
-
-        (gpEFD->chkConnectParts ? EXPT_CONNECT_PARTS : 0x0) |
-        // is it better to force part connection on if corner tips or edges are on? I feel like the
-        // dialog should take care of this, not allowing these options if the controlling algorithm is set.
-        (gpEFD->chkConnectCornerTips ? (EXPT_CONNECT_PARTS|EXPT_CONNECT_CORNER_TIPS) : 0x0) |
-        (gpEFD->chkConnectAllEdges ? (EXPT_CONNECT_PARTS|EXPT_CONNECT_ALL_EDGES) : 0x0) |
-        (gpEFD->chkDeleteFloaters ? EXPT_DELETE_FLOATING_OBJECTS : 0x0) |
-
-        (gpEFD->chkHollow[gpEFD->fileType] ? EXPT_HOLLOW_BOTTOM : 0x0) |
-        ((gpEFD->chkHollow[gpEFD->fileType] && gpEFD->chkSuperHollow[gpEFD->fileType]) ? EXPT_HOLLOW_BOTTOM|EXPT_SUPER_HOLLOW_BOTTOM : 0x0) |
-
-        // materials are forced on if using debugging mode - just an internal override, doesn't need to happen in dialog.
-        (gpEFD->chkShowParts ? EXPT_DEBUG_SHOW_GROUPS|EXPT_OUTPUT_MATERIALS|EXPT_OUTPUT_OBJ_GROUPS|EXPT_OUTPUT_OBJ_MATERIAL_PER_TYPE : 0x0) |
-        (gpEFD->chkShowWelds ? EXPT_DEBUG_SHOW_WELDS|EXPT_OUTPUT_MATERIALS|EXPT_OUTPUT_OBJ_GROUPS|EXPT_OUTPUT_OBJ_MATERIAL_PER_TYPE : 0x0);
-
-
-    // set OBJ group and material output state
-    if ( gpEFD->fileType == FILE_TYPE_WAVEFRONT_ABS_OBJ || gpEFD->fileType == FILE_TYPE_WAVEFRONT_REL_OBJ )
-    {
-        if ( gpEFD->chkMultipleObjects )
-        {
-            // note, can get overridden by EXPT_GROUP_BY_BLOCK being on.
-            gOptions.exportFlags |= EXPT_OUTPUT_OBJ_GROUPS;
-
-            if ( gpEFD->chkMaterialPerType )
-            {
-                gOptions.exportFlags |= EXPT_OUTPUT_OBJ_MATERIAL_PER_TYPE;
-
-                if ( gpEFD->chkG3DMaterial )
-                {
-                    gOptions.exportFlags |= EXPT_OUTPUT_OBJ_FULL_MATERIAL;
-                    if ( gOptions.exportFlags & (EXPT_OUTPUT_TEXTURE_IMAGES|EXPT_OUTPUT_TEXTURE_SWATCHES))
-                    {
-                        // G3D - use only if textures are on.
-                        gOptions.exportFlags |= EXPT_OUTPUT_OBJ_NEUTRAL_MATERIAL;
-                    }
-                }
-            }
-        }
-        // if in debugging mode, force groups and material type
-
-        // check if we're exporting relative coordinates
-        if ( gpEFD->fileType == FILE_TYPE_WAVEFRONT_REL_OBJ )
-        {
-            gOptions.exportFlags |= EXPT_OUTPUT_OBJ_REL_COORDINATES;
-        }
-    }
-    // STL files never need grouping by material, and certainly don't export textures
-    else if ( gpEFD->fileType == FILE_TYPE_ASCII_STL )
+    // set the export flags, noting any options that cannot be used with this file type
+    int notes = SetExportOptions( &gOptions, gpEFD, printModel );
+    for ( int noteNo = 0; noteNo < EXPORT_NOTE_COUNT; noteNo++ )
     {
-        int unsupportedCodes = (EXPT_OUTPUT_MATERIALS | EXPT_OUTPUT_TEXTURE_SWATCHES | EXPT_OUTPUT_TEXTURE_IMAGES | EXPT_GROUP_BY_MATERIAL|
-            EXPT_DEBUG_SHOW_GROUPS|EXPT_DEBUG_SHOW_WELDS);
-        if ( gOptions.exportFlags & unsupportedCodes )
+        if ( (1<<noteNo) & notes )
         {
-            MessageBox( NULL, _T("Note: color output is not supported for ASCII text STL.\nFile will contain no colors."),
+            MessageBox( NULL, GetExportNoteText(noteNo),
                 _T("Informational"), MB_OK|MB_ICONINFORMATION);
         }
-        // ASCII STL in particular cannot export any materials at all.
-        gOptions.exportFlags &= ~unsupportedCodes;
-
-        // we never have to group by material for STL, as there are no material groups.
-        gOptions.exportFlags &= ~EXPT_GROUP_BY_MATERIAL;
-    }
-    else if ( ( gpEFD->fileType == FILE_TYPE_BINARY_MAGICS_STL ) || ( gpEFD->fileType == FILE_TYPE_BINARY_VISCAM_STL ) )
-    {
-        int unsupportedCodes = (EXPT_OUTPUT_TEXTURE_SWATCHES | EXPT_OUTPUT_TEXTURE_IMAGES);
-        if ( gOptions.exportFlags & unsupportedCodes )
-        {
-            if ( gpEFD->fileType == FILE_TYPE_BINARY_VISCAM_STL )
-            {
-                MessageBox( NULL, _T("Note: texture output is not supported for binary STL.\nFile will contain VisCAM colors instead."),
-                    _T("Informational"), MB_OK|MB_ICONINFORMATION);
-            }
-            else
-            {
-                MessageBox( NULL, _T("Note: texture output is not supported for binary STL.\nFile will contain Materialise Magics colors instead."),
-                    _T("Informational"), MB_OK|MB_ICONINFORMATION);
-            }
-        }
-        gOptions.exportFlags &= ~unsupportedCodes;
-
-        // we never have to group by material for STL, as there are no material groups.
-        gOptions.exportFlags &= ~EXPT_GROUP_BY_MATERIAL;
-    }
-    else if ( gpEFD->fileType == FILE_TYPE_VRML2 )
-    {
-        // are we outputting color textures?
-        if ( gOptions.exportFlags & EXPT_OUTPUT_TEXTURE )
-        {
-            if ( gOptions.exportFlags & EXPT_3DPRINT)
-            {
-                // if printing, we don't need to group by material, as it can be one huge pile of data
-                gOptions.exportFlags &= ~EXPT_GROUP_BY_MATERIAL;
-            }
-            // else if we're outputting for rendering, VRML then outputs grouped by material, unless it's a single material output
-            // (in which case this flag isn't turned on anyway).
-        }
-    }
-    else if ( gpEFD->fileType == FILE_TYPE_SCHEMATIC )
-    {
-        // really, ignore all options for Schematic - set how you want, but they'll all be ignored except rotation around the Y axis.
-        gOptions.exportFlags &= 0x0;
-    }
-    else
-    {
-        // unknown file type?
-        assert(0);
-    }
-
-    // if individual blocks are to be exported, we group by cube, not by material, so turn that off
-    if ( gpEFD->chkIndividualBlocks )
-    {
-        // this also allows us to use the faceIndex as a way of noting the start of a new group
-        gOptions.exportFlags &= ~EXPT_GROUP_BY_MATERIAL;
-        gOptions.exportFlags |= EXPT_GROUP_BY_BLOCK;
-    }
-
-    if ( gpEFD->chkBiome )
-    {
-        gOptions.exportFlags |= EXPT_BIOME;
-    }
-
-    // if showing debug groups, we need to turn off full image texturing so we get the largest group as semitransparent
-    // (and full textures would just be confusing for debug, anyway)
-    if ( gOptions.exportFlags & EXPT_DEBUG_SHOW_GROUPS )
-    {
-        if ( gOptions.exportFlags & EXPT_OUTPUT_TEXTURE_IMAGES )
-        {
-            gOptions.exportFlags &= ~EXPT_OUTPUT_TEXTURE_IMAGES;
-            gOptions.exportFlags |= EXPT_OUTPUT_TEXTURE_SWATCHES;
-        }
-        // we don't want to group by block for debugging
-        gOptions.exportFlags &= ~EXPT_GROUP_BY_BLOCK;
     }
 
     // OK, all set, let's go!
     FileList outputFileList;
     outputFileList.count = 0;
+    // files only wanted in the zip needn't touch the disk
+    outputFileList.inMemory = gpEFD->chkCreateZip[gpEFD->fileType] && !gpEFD->chkCreateModelFiles[gpEFD->fileType];
     if ( on ) {
         // redraw, in case the bounds were changed
         draw();
@@ -2724,32 +2581,10 @@ static int saveObjFile( HWND hWnd, wchar_t *objFileName, int printModel, wchar_t
         // note how many files were output
         retCode = outputFileList.count;
 
-        // zip it up - test that there's something to zip, in case of errors. Note that the first
-        // file saved in ObjManip.c is the one used as the zip file's name.
-        if ( gpEFD->chkCreateZip[gpEFD->fileType] && (outputFileList.count > 0) )
+        // zip it up, if requested
+        if ( gpEFD->chkCreateZip[gpEFD->fileType] )
         {
-            wchar_t wcZip[MAX_PATH];
-            // we add .zip not (just) out of laziness, but this helps differentiate obj from wrl from stl.
-            swprintf_s(wcZip,MAX_PATH,L"%s.zip",outputFileList.name[0]);
-
-            DeleteFile(wcZip);
-            HZIP hz = CreateZip(wcZip,0,ZIP_FILENAME);
-            for ( int i = 0; i < outputFileList.count; i++ )
-            {
-                const wchar_t *nameOnly = removePath( outputFileList.name[i] ) ;
-
-                if (*updateProgress)
-                { (*updateProgress)(0.90f + 0.10f*(float)i/(float)outputFileList.count);}
-
-                ZipAdd(hz,nameOnly, outputFileList.name[i], 0, ZIP_FILENAME);
-
-                // delete model files if not needed
-                if ( !gpEFD->chkCreateModelFiles[gpEFD->fileType] )
-                {
-                    DeleteFile(outputFileList.name[i]);
-                }
-            }
-            CloseZip(hz);
+            ZipExportFiles( &outputFileList, gpEFD->chkCreateModelFiles[gpEFD->fileType], updateProgress );
         }
         if (*updateProgress)
         { (*updateProgress)(1.0f);}
@@ -2867,179 +2702,6 @@ static BOOL GetAppVersion( TCHAR *LibName, WORD *MajorVersion, WORD *MinorVersio
     return FALSE;
 }
 
-// yes, this it totally lame, copying code from MinewaysMap
-static const wchar_t *removePath( const wchar_t *src )
-{
-    // find last \ in string
-    const wchar_t *strPtr = wcsrchr(src,(int)'\\');
-    if ( strPtr )
-        // found a \, so move up past it
-        strPtr++;
-    else
-    {
-        // look for /
-        strPtr = wcsrchr(src,(int)'/');
-        if ( strPtr )
-            // found a /, so move up past it
-            strPtr++;
-        else
-            // no \ or / found, just return string itself
-            return src;
-    }
-
-    return strPtr;
-}
-
-#define INIT_ALL_FILE_TYPES( a, v0,v1,v2,v3,v4,v5,v6)    \
-    (a)[FILE_TYPE_WAVEFRONT_REL_OBJ] = (v0);    \
-    (a)[FILE_TYPE_WAVEFRONT_ABS_OBJ] = (v1);    \
-    (a)[FILE_TYPE_BINARY_MAGICS_STL] = (v2);    \
-    (a)[FILE_TYPE_BINARY_VISCAM_STL] = (v3);    \
-    (a)[FILE_TYPE_ASCII_STL] = (v4);    \
-    (a)[FILE_TYPE_VRML2] = (v5);	\
-    (a)[FILE_TYPE_SCHEMATIC] = (v6);
-
-static void initializeExportDialogData()
-{
-    // by default, make everything 0 - off
-    memset(&gExportPrintData,0,sizeof(ExportFileData));
-
-    // turn stuff on
-    gExportPrintData.fileType = FILE_TYPE_VRML2;
-
-    INIT_ALL_FILE_TYPES( gExportPrintData.chkCreateZip,         1, 1, 0, 0, 0, 1, 0);
-    // I used to set the last value to 0, meaning only the zip would be created. The idea
-    // was that the naive user would then only have the zip, and so couldn't screw up
-    // when uploading the model file. But this setting is a pain if you want to preview
-    // the model file, you have to always remember to check the box so you can get the
-    // preview files. So, now it's off.
-    INIT_ALL_FILE_TYPES( gExportPrintData.chkCreateModelFiles,  1, 1, 1, 1, 1, 1, 1);
-
-    // OBJ and VRML have color, depending...
-    // order: OBJ, BSTL, ASTL, VRML
-    INIT_ALL_FILE_TYPES( gExportPrintData.radioExportNoMaterials,  0, 0, 0, 0, 1, 0, 1);
-    // might as well export color with OBJ and binary STL - nice for previewing
-    INIT_ALL_FILE_TYPES( gExportPrintData.radioExportMtlColors,    0, 0, 1, 1, 0, 0, 0);  
-    INIT_ALL_FILE_TYPES( gExportPrintData.radioExportSolidTexture, 0, 0, 0, 0, 0, 0, 0);  
-    INIT_ALL_FILE_TYPES( gExportPrintData.radioExportFullTexture,  1, 1, 0, 0, 0, 1, 0);  
-
-    gExportPrintData.chkMergeFlattop = 1;
-    // Shapeways imports VRML files and displays them with Y up, that is, it
-    // rotates them itself. Sculpteo imports OBJ, and likes Z is up, so we export with this on.
-    // STL uses Z is up, even though i.materialise's previewer shows Y is up.
-    INIT_ALL_FILE_TYPES( gExportPrintData.chkMakeZUp, 1, 1, 1, 1, 1, 0, 0);  
-    gExportPrintData.chkCenterModel = 1;
-    gExportPrintData.chkExportAll = 0; 
-    gExportPrintData.chkFatten = 0; 
-    gExportPrintData.chkIndividualBlocks = 0;
-    gExportPrintData.chkBiome = 0;
-
-    gExportPrintData.radioRotate0 = 1;
-
-    gExportPrintData.radioScaleByBlock = 1;
-    gExportPrintData.modelHeightVal = 5.0f;    // 5 cm target height
-    INIT_ALL_FILE_TYPES( gExportPrintData.blockSizeVal,
-        METERS_TO_MM * gMtlCostTable[PRINT_MATERIAL_FULL_COLOR_SANDSTONE].minWall,
-        METERS_TO_MM * gMtlCostTable[PRINT_MATERIAL_FULL_COLOR_SANDSTONE].minWall,
-        METERS_TO_MM * gMtlCostTable[PRINT_MATERIAL_FULL_COLOR_SANDSTONE].minWall,
-        METERS_TO_MM * gMtlCostTable[PRINT_MATERIAL_FULL_COLOR_SANDSTONE].minWall,
-        METERS_TO_MM * gMtlCostTable[PRINT_MATERIAL_WHITE_STRONG_FLEXIBLE].minWall,
-        METERS_TO_MM * gMtlCostTable[PRINT_MATERIAL_FULL_COLOR_SANDSTONE].minWall,
-        METERS_TO_MM * gMtlCostTable[PRINT_MATERIAL_FULL_COLOR_SANDSTONE].minWall);
-    gExportPrintData.costVal = 25.00f;
-
-    gExportPrintData.chkSealEntrances = 0; // left off by default: useful, but the user should want to do this
-    gExportPrintData.chkSealSideTunnels = 0; // left off by default: useful, but the user should want to do this
-    gExportPrintData.chkFillBubbles = 1;
-    gExportPrintData.chkConnectParts = 1;
-    gExportPrintData.chkConnectCornerTips = 1;
-    // it's actually better to start with manifold off and see if there are lots of groups.
-    gExportPrintData.chkConnectAllEdges = 0;
-    gExportPrintData.chkDeleteFloaters = 1;
-    gExportPrintData.chkMeltSnow = 0;
-
-    gExportPrintData.chkShowParts = 0;
-    gExportPrintData.chkShowWelds = 0;
-
-    gExportPrintData.chkMultipleObjects = 1;
-    gExportPrintData.chkMaterialPerType = 1;
-    // we want a neutral material for printing (the rest is not all that important), as the SAP Viewer needs this
-    gExportPrintData.chkG3DMaterial = 1;
-
-    gExportPrintData.floaterCountVal = 16;
-    INIT_ALL_FILE_TYPES( gExportPrintData.chkHollow, 1, 1, 0, 0, 0, 1, 0);
-    INIT_ALL_FILE_TYPES( gExportPrintData.chkSuperHollow, 1, 1, 0, 0, 0, 1, 0);
-    INIT_ALL_FILE_TYPES( gExportPrintData.hollowThicknessVal,
-        METERS_TO_MM * gMtlCostTable[PRINT_MATERIAL_FULL_COLOR_SANDSTONE].minWall,
-        METERS_TO_MM * gMtlCostTable[PRINT_MATERIAL_FULL_COLOR_SANDSTONE].minWall,
-        METERS_TO_MM * gMtlCostTable[PRINT_MATERIAL_FULL_COLOR_SANDSTONE].minWall,
-        METERS_TO_MM * gMtlCostTable[PRINT_MATERIAL_FULL_COLOR_SANDSTONE].minWall,
-        METERS_TO_MM * gMtlCostTable[PRINT_MATERIAL_WHITE_STRONG_FLEXIBLE].minWall,
-        METERS_TO_MM * gMtlCostTable[PRINT_MATERIAL_FULL_COLOR_SANDSTONE].minWall,
-        METERS_TO_MM * gMtlCostTable[PRINT_MATERIAL_FULL_COLOR_SANDSTONE].minWall);
-
-    // materials selected
-    INIT_ALL_FILE_TYPES( gExportPrintData.comboPhysicalMaterial,PRINT_MATERIAL_FCS_SCULPTEO,PRINT_MATERIAL_FCS_SCULPTEO,PRINT_MATERIAL_FULL_COLOR_SANDSTONE,PRINT_MATERIAL_FULL_COLOR_SANDSTONE,PRINT_MATERIAL_WHITE_STRONG_FLEXIBLE,PRINT_MATERIAL_FULL_COLOR_SANDSTONE,PRINT_MATERIAL_FULL_COLOR_SANDSTONE);
-    // defaults: for Sculpteo OBJ, cm; for i.materialise, mm; for other STL, cm; for Shapeways VRML, mm
-    INIT_ALL_FILE_TYPES( gExportPrintData.comboModelUnits,UNITS_CENTIMETER,UNITS_CENTIMETER,UNITS_MILLIMETER,UNITS_MILLIMETER,UNITS_MILLIMETER,UNITS_MILLIMETER,UNITS_MILLIMETER);
-
-
-    //////////////////////////////////////////////////////
-    // copy view data from print, and change what's needed
-    gExportViewData = gExportPrintData;
-
-    // Now that I've figured out that Blender can show materials OK, change to "true spec"
-    gExportViewData.fileType = FILE_TYPE_WAVEFRONT_ABS_OBJ;
-
-    // don't really need to create a zip for rendering output
-    INIT_ALL_FILE_TYPES( gExportViewData.chkCreateZip,         0, 0, 0, 0, 0, 0, 0);
-    INIT_ALL_FILE_TYPES( gExportViewData.chkCreateModelFiles,  1, 1, 1, 1, 1, 1, 1);
-
-    INIT_ALL_FILE_TYPES( gExportViewData.radioExportNoMaterials,  0, 0, 0, 0, 1, 0, 1);  
-    INIT_ALL_FILE_TYPES( gExportViewData.radioExportMtlColors,    0, 0, 1, 1, 0, 0, 0);  
-    INIT_ALL_FILE_TYPES( gExportViewData.radioExportSolidTexture, 0, 0, 0, 0, 0, 0, 0);  
-    INIT_ALL_FILE_TYPES( gExportViewData.radioExportFullTexture,  1, 1, 0, 0, 0, 1, 0);  
-
-    gExportViewData.chkExportAll = 1; 
-    // for renderers, assume Y is up, which is the norm
-    INIT_ALL_FILE_TYPES( gExportViewData.chkMakeZUp, 0, 0, 0, 0, 0, 0, 0);  
-
-    gExportViewData.modelHeightVal = 1000.0f;    // 10 cm - view doesn't need a minimum, really
-    INIT_ALL_FILE_TYPES( gExportViewData.blockSizeVal,
-        100.0f,
-        100.0f,
-        100.0f,
-        100.0f,
-        100.0f,
-        100.0f,
-        100.0f);
-    gExportViewData.costVal = 25.00f;
-
-    gExportViewData.chkSealEntrances = 0;
-    gExportViewData.chkSealSideTunnels = 0;
-    gExportViewData.chkFillBubbles = 0;
-    gExportViewData.chkConnectParts = 0;
-    gExportViewData.chkConnectCornerTips = 0;
-    gExportViewData.chkConnectAllEdges = 0;
-    gExportViewData.chkDeleteFloaters = 0;
-    INIT_ALL_FILE_TYPES( gExportViewData.chkHollow, 0,0,0,0,0,0,0);
-    INIT_ALL_FILE_TYPES( gExportViewData.chkSuperHollow, 0,0,0,0,0,0,0);
-    // G3D material off by default for rendering
-    gExportViewData.chkG3DMaterial = 0;
-
-    gExportViewData.floaterCountVal = 16;
-    // irrelevant for viewing
-    INIT_ALL_FILE_TYPES( gExportViewData.hollowThicknessVal, 10.0f, 10.0f, 10.0f, 10.0f, 10.0f, 10.0f, 10.0f );    // 10 mm
-    INIT_ALL_FILE_TYPES( gExportViewData.comboPhysicalMaterial,PRINT_MATERIAL_FCS_SCULPTEO,PRINT_MATERIAL_FCS_SCULPTEO,PRINT_MATERIAL_FULL_COLOR_SANDSTONE,PRINT_MATERIAL_FULL_COLOR_SANDSTONE,PRINT_MATERIAL_WHITE_STRONG_FLEXIBLE,PRINT_MATERIAL_FULL_COLOR_SANDSTONE,PRINT_MATERIAL_FULL_COLOR_SANDSTONE);
-    INIT_ALL_FILE_TYPES( gExportViewData.comboModelUnits,UNITS_METER,UNITS_METER,UNITS_MILLIMETER,UNITS_MILLIMETER,UNITS_MILLIMETER,UNITS_METER,UNITS_METER);
-
-    // copy schematic data - a little goofy, but there it is
-    gExportSchematicData = gExportViewData;
-    gExportSchematicData.chkMergeFlattop = 0;
-    // TODO someday allow getting rid of floaters, that would be cool.
-    //gExportSchematicData.chkDeleteFloaters = 1;
-}
-
 // Message handler for about box.
 INT_PTR CALLBACK About(HWND hDlg, UINT message, WPARAM wParam, LPARAM lParam)
 {
@@ -3061,618 +2723,6 @@ INT_PTR CALLBACK About(HWND hDlg, UINT message, WPARAM wParam, LPARAM lParam)
 }
 
 
-static int importSettings( wchar_t *importFile )
-{
-    // read header, as written by writeStatistics(), and get export settings from it
-
-    //char inputString[256];
-    int worldBox[6];
-    char c;
-
-    FILE *fh;
-    errno_t err = _wfopen_s( &fh, importFile, L"rt" );
-
-    if (err != 0) {
-        return MW_CANNOT_READ_IMPORT_FILE;
-    }
-
-    char lines[HEADER_LINES][120];
-
-    int numLines = readLineSet( fh, lines, HEADER_LINES );
-
-    fclose( fh );
-
-    if ( numLines == 0 )
-        return MW_CANNOT_PARSE_IMPORT_FILE;
-
-    // find size
-    int lineNo = findLine( "# Selection location min to max:", lines, 0, 10 );
-    if ( lineNo >= 0)
-    {
-        // found selection, parse it
-        if ( 6 != sscanf_s( lines[lineNo], "# Selection location min to max: %d, %d, %d to %d, %d, %d", 
-            &worldBox[0], &worldBox[1], &worldBox[2],
-            &worldBox[3], &worldBox[4], &worldBox[5] ) )
-            return MW_CANNOT_PARSE_IMPORT_FILE;
-    }
-    else
-    {
-        // old format, and need to not pass in lineNo (which is -1)
-        lineNo = findLine( "# Selection location:", lines, 0, 30 );
-        if ( lineNo >= 0)
-        {
-            // found selection, parse it
-            if ( 6 != sscanf_s( lines[lineNo], "# Selection location: %d, %d, %d to %d, %d, %d", 
-                &worldBox[0], &worldBox[1], &worldBox[2],
-                &worldBox[3], &worldBox[4], &worldBox[5] ) )
-                return MW_CANNOT_PARSE_IMPORT_FILE;
-        }
-        else
-            return MW_CANNOT_PARSE_IMPORT_FILE;
-    }
-
-    // note we restart the search here, because old style output had this bit earlier
-    lineNo = findLine( "# Created for ", lines, 0, 20 );
-    if ( lineNo >= 0)
-    {
-        // found selection, parse it
-        if ( !sscanf_s( lines[lineNo], "# Created for %c", &c, sizeof(char) ) )
-            return MW_CANNOT_PARSE_IMPORT_FILE;
-    }
-    else
-        return MW_CANNOT_PARSE_IMPORT_FILE;
-
-    ExportFileData efd;
-    ExportFileData *pSaveEFD;
-    // 3d print or render?
-    if ( c == '3' )
-    {
-        efd = gExportPrintData;
-        pSaveEFD = &gExportPrintData;
-        efd.flags = EXPT_3DPRINT;
-    }
-    else
-    {
-        efd = gExportViewData;
-        pSaveEFD = &gExportViewData;
-        efd.flags = 0x0;
-    }
-    // file type - if not found, abort;
-    // older files don't have this info
-    if ( strstr( lines[lineNo], "Wavefront OBJ absolute indices" ) )
-    {
-        efd.fileType = FILE_TYPE_WAVEFRONT_ABS_OBJ;
-    }
-    else if ( strstr( lines[lineNo], "Wavefront OBJ relative indices" ) )
-    {
-        efd.fileType = FILE_TYPE_WAVEFRONT_REL_OBJ;
-    }
-    else if ( strstr( lines[lineNo], "Binary STL iMaterialise" ) )
-    {
-        efd.fileType = FILE_TYPE_BINARY_MAGICS_STL;
-    }
-    else if ( strstr( lines[lineNo], "Binary STL VisCAM" ) )
-    {
-        efd.fileType = FILE_TYPE_BINARY_VISCAM_STL;
-    }
-    else if ( strstr( lines[lineNo], "ASCII STL" ) )
-    {
-        efd.fileType = FILE_TYPE_ASCII_STL;
-    }
-    else if ( strstr( lines[lineNo], "VRML 2.0" ) )
-    {
-        efd.fileType = FILE_TYPE_VRML2;
-    }
-    else
-    {
-        // can't figure it out from the file (old-style), so figure it out
-        // from the file name itself.
-        if ( wcsstr( importFile, L".obj" ) )
-        {
-            efd.fileType = FILE_TYPE_WAVEFRONT_ABS_OBJ;
-        }
-        else if ( wcsstr( importFile, L".txt" ) )
-        {
-            efd.fileType = FILE_TYPE_BINARY_MAGICS_STL;
-        }
-        else if ( wcsstr( importFile, L".wrl" ) )
-        {
-            efd.fileType = FILE_TYPE_VRML2;
-        }
-        else
-            return MW_CANNOT_PARSE_IMPORT_FILE;
-    }
-
-    // units - well after 3D print output, so scan many lines
-    char string1[100], string2[100], string3[100], string4[100];
-    lineNo = findLine( "# Units for the model vertex data itself:", lines, lineNo+1, 20 );
-    if ( lineNo >= 0)
-    {
-        // found selection, parse it
-        if ( !sscanf_s( lines[lineNo], "# Units for the model vertex data itself: %s", string1, _countof(string1) ) )
-            return MW_CANNOT_PARSE_IMPORT_FILE;
-    }
-    else
-        return MW_CANNOT_PARSE_IMPORT_FILE;
-
-    int i;
-    for ( i = 0; i < MODELS_UNITS_TABLE_SIZE; i++ )
-    {
-        if ( strcmp( gUnitTypeTable[i].name, string1 ) == 0 )
-        {
-            efd.comboModelUnits[efd.fileType] = i;
-            break;
-        }
-    }
-    // units found?
-    if ( i >= 4 )
-    {
-        return MW_CANNOT_PARSE_IMPORT_FILE;
-    }
-
-    lineNo = findLine( "# File type:", lines, lineNo+1, 20 );
-    if ( lineNo >= 0)
-    {
-        // found selection, parse it
-        if ( !sscanf_s( lines[lineNo], "# File type: Export %s", string1, _countof(string1) ) )
-            return MW_CANNOT_PARSE_IMPORT_FILE;
-    }
-    else
-        return MW_CANNOT_PARSE_IMPORT_FILE;
-
-    char *outputTypeString[] = {
-        "no", // "Export no materials",
-        "solid", // "Export solid material colors only (no textures)",
-        "richer", // "Export richer color textures",
-        "full", // "Export full color texture patterns"
-    };
-    for ( i = 0; i < 4; i++ )
-    {
-        if ( strcmp( outputTypeString[i], string1 ) == 0 )
-        {
-            break;
-        }
-    }
-
-    efd.radioExportNoMaterials[efd.fileType] = 0;
-    efd.radioExportMtlColors[efd.fileType] = 0;
-    efd.radioExportSolidTexture[efd.fileType] = 0;
-    efd.radioExportFullTexture[efd.fileType] = 0;
-    switch ( i )
-    {
-    case 0:
-        efd.radioExportNoMaterials[efd.fileType] = 1;
-        break;
-    case 1:
-        efd.radioExportMtlColors[efd.fileType] = 1;
-        break;
-    case 2:
-        efd.radioExportSolidTexture[efd.fileType] = 1;
-        break;
-    case 3:
-        efd.radioExportFullTexture[efd.fileType] = 1;
-        break;
-    default:
-    case 4:
-        return MW_CANNOT_PARSE_IMPORT_FILE;
-    }
-
-    // set material options if using OBJ
-    if ( ( efd.fileType == FILE_TYPE_WAVEFRONT_ABS_OBJ ) || ( efd.fileType == FILE_TYPE_WAVEFRONT_REL_OBJ ) )
-    {
-        lineNo = findLine( "# Export separate objects:", lines, lineNo+1, 20 );
-        if ( lineNo >= 0)
-        {
-            if ( !sscanf_s( lines[lineNo], "# Export separate objects: %s", string1, _countof(string1) ) )
-                return MW_CANNOT_PARSE_IMPORT_FILE;
-
-            efd.chkMultipleObjects = ( string1[0] == 'Y');
-
-            if ( efd.chkMultipleObjects )
-            {
-                lineNo = findLine( "#  Material per object:", lines, lineNo+1, 20 );
-                if ( lineNo >= 0)
-                {
-                    if ( !sscanf_s( lines[lineNo], "#  Material per object: %s", string1, _countof(string1) ) )
-                        return MW_CANNOT_PARSE_IMPORT_FILE;
-                }
-                else
-                    return MW_CANNOT_PARSE_IMPORT_FILE;
-
-                efd.chkMaterialPerType = ( string1[0] == 'Y');
-
-                if ( efd.chkMaterialPerType )
-                {
-                    lineNo = findLine( "#   G3D full material:", lines, lineNo+1, 20 );
-                    if ( lineNo >= 0)
-                    {
-                        if ( !sscanf_s( lines[lineNo], "#   G3D full material: %s", string1, _countof(string1) ) )
-                            return MW_CANNOT_PARSE_IMPORT_FILE;
-                    }
-                    else
-                        return MW_CANNOT_PARSE_IMPORT_FILE;
-
-                    efd.chkG3DMaterial = ( string1[0] == 'Y');
-                }
-            }
-        }
-        // else if not found, that's OK, this is a newer feature; set defaults
-        else
-        {
-            efd.chkMultipleObjects = 1;
-            efd.chkMaterialPerType = 1;
-        }
-    }
-
-    lineNo = findLine( "# Make Z the up", lines, 0, 40 );
-    if ( lineNo >= 0)
-    {
-        if ( !sscanf_s( lines[lineNo], "# Make Z the up direction instead of Y: %s", string1, _countof(string1) ) )
-            return MW_CANNOT_PARSE_IMPORT_FILE;
-
-        efd.chkMakeZUp[efd.fileType] = ( string1[0] == 'Y');
-    }
-    else
-    {
-        // unfortunately the old code had a bug and it always said YES, even when not set.
-        // So we leave this value untouched and move on.
-        /*
-        lineNo = findLine( "# Make Z direction up:", lines, 0, 40 );
-        if ( lineNo >= 0)
-        {
-        if ( !sscanf_s( lines[lineNo], "# Make Z direction up: %s", string1, _countof(string1) ) )
-        return MW_CANNOT_PARSE_IMPORT_FILE;
-        }
-        else
-        return MW_CANNOT_PARSE_IMPORT_FILE;
-        */
-    }
-
-
-    lineNo = findLine( "# Center model:", lines, 0, 40 );
-    if ( lineNo >= 0)
-    {
-        if ( !sscanf_s( lines[lineNo], "# Center model: %s", string1, _countof(string1) ) )
-            return MW_CANNOT_PARSE_IMPORT_FILE;
-    }
-    else
-        return MW_CANNOT_PARSE_IMPORT_FILE;
-
-    efd.chkCenterModel = ( string1[0] == 'Y');
-
-
-    lineNo = findLine( "# Export lesser blocks:", lines, lineNo+1, 20 );
-    if ( lineNo >= 0)
-    {
-        if ( !sscanf_s( lines[lineNo], "# Export lesser blocks: %s", string1, _countof(string1) ) )
-            return MW_CANNOT_PARSE_IMPORT_FILE;
-
-        efd.chkExportAll = ( string1[0] == 'Y');
-
-        if ( efd.chkExportAll )
-        {
-            lineNo = findLine( "# Fatten lesser blocks:", lines, lineNo+1, 20 );
-            if ( lineNo >= 0)
-            {
-                if ( !sscanf_s( lines[lineNo], "# Fatten lesser blocks: %s", string1, _countof(string1) ) )
-                    return MW_CANNOT_PARSE_IMPORT_FILE;
-            }
-            else
-                return MW_CANNOT_PARSE_IMPORT_FILE;
-
-            efd.chkFatten = ( string1[0] == 'Y');
-        }
-    }
-    // this is a newer feature, so if we don't find it, continue on
-    else
-    {
-        // if rendering, set this to be on
-        if ( !(efd.flags & EXPT_3DPRINT) )
-        {
-            efd.chkExportAll = 1;
-        }
-    }
-
-
-    lineNo = findLine( "# Individual blocks:", lines, 0, 40 );
-    if ( lineNo >= 0)
-    {
-        if ( !sscanf_s( lines[lineNo], "# Individual blocks: %s", string1, _countof(string1) ) )
-            return MW_CANNOT_PARSE_IMPORT_FILE;
-
-        efd.chkIndividualBlocks = ( string1[0] == 'Y');
-    }
-    // new feature - if missing, assume it's off, but don't fail
-
-    lineNo = findLine( "# Use biomes:", lines, 0, 40 );
-    if ( lineNo >= 0)
-    {
-        if ( !sscanf_s( lines[lineNo], "# Use biomes: %s", string1, _countof(string1) ) )
-            return MW_CANNOT_PARSE_IMPORT_FILE;
-
-        efd.chkBiome = ( string1[0] == 'Y');
-    }
-    // new feature - if missing, assume it's off, but don't fail
-
-    float floatVal = 0.0f;
-    lineNo = findLine( "# Rotate model", lines, 0, 40 );
-    if ( lineNo >= 0)
-    {
-        if ( !sscanf_s( lines[lineNo], "# Rotate model %f degrees", &floatVal ) )
-            return MW_CANNOT_PARSE_IMPORT_FILE;
-    }
-    else
-        return MW_CANNOT_PARSE_IMPORT_FILE;
-
-    efd.radioRotate0 = efd.radioRotate90 = efd.radioRotate180 = efd.radioRotate270 = 0;
-
-    efd.radioRotate0 = ( floatVal == 0.0f );
-    efd.radioRotate90 = ( floatVal == 90.0f );
-    efd.radioRotate180 = ( floatVal == 180.0f );
-    efd.radioRotate270 = ( floatVal == 270.0f );
-
-    // just in case
-    if ( !( efd.radioRotate90 || efd.radioRotate180 || efd.radioRotate270) )
-        efd.radioRotate0 = 1;
-
-
-    lineNo = findLine( "# Scale model by ", lines, lineNo+1, 20 );
-    if ( lineNo >= 0)
-    {
-        efd.radioScaleByBlock = efd.radioScaleByCost = efd.radioScaleToHeight = efd.radioScaleToMaterial = 0;
-
-        if ( sscanf_s( lines[lineNo], "# Scale model by making each block %f mm high", &floatVal ) )
-        {
-            efd.radioScaleByBlock = 1;
-            efd.blockSizeVal[efd.fileType] = floatVal;
-        }
-        else
-            // terrible hackery and laziness: look for 3, 2, or 1 word materials. fgets or read() might be better...
-            if ( 5 == sscanf_s( lines[lineNo], "# Scale model by aiming for a cost of %f for the %s %s %s %s", &floatVal, string1, _countof(string1), string2, _countof(string2), string3, _countof(string3), string4, _countof(string4) ) )
-            {
-                if ( strcmp( string4, "material" ) != 0 )
-                    return MW_CANNOT_PARSE_IMPORT_FILE;
-                strcat_s( string1, _countof(string1), " " );
-                strcat_s( string1, _countof(string1), string2 );
-                strcat_s( string1, _countof(string1), " " );
-                strcat_s( string1, _countof(string1), string3 );
-                efd.radioScaleByCost = 1;
-                efd.costVal = floatVal;
-            }
-            else if ( 4 == sscanf_s( lines[lineNo], "# Scale model by aiming for a cost of %f for the %s %s %s", &floatVal, string1, _countof(string1), string2, _countof(string2), string3, _countof(string3) ) )
-            {
-                if ( strcmp( string3, "material" ) != 0 )
-                    return MW_CANNOT_PARSE_IMPORT_FILE;
-                strcat_s( string1, _countof(string1), " " );
-                strcat_s( string1, _countof(string1), string2 );
-                efd.radioScaleByCost = 1;
-                efd.costVal = floatVal;
-            }
-            else if ( 3 == sscanf_s( lines[lineNo], "# Scale model by aiming for a cost of %f for the %s %s", &floatVal, string1, _countof(string1), string2, _countof(string2) ) )
-            {
-                if ( strcmp( string2, "material" ) != 0 )
-                    return MW_CANNOT_PARSE_IMPORT_FILE;
-                efd.radioScaleByCost = 1;
-                efd.costVal = floatVal;
-            }
-            else if ( sscanf_s( lines[lineNo], "# Scale model by fitting to a height of %f cm", &floatVal ) )
-            {
-                efd.radioScaleToHeight = 1;
-                efd.modelHeightVal = floatVal;
-            }
-            else
-                // terrible hackery and laziness: look for 3, 2, or 1 word materials. fgets or read() might be better...
-                if ( 4 == sscanf_s( lines[lineNo], "# Scale model by using the minimum wall thickness for the %s %s %s %s", string1, _countof(string1), string2, _countof(string2), string3, _countof(string3), string4, _countof(string4) ) )
-                {
-                    if ( strcmp( string4, "material" ) != 0 )
-                        return MW_CANNOT_PARSE_IMPORT_FILE;
-                    strcat_s( string1, _countof(string1), " " );
-                    strcat_s( string1, _countof(string1), string2 );
-                    strcat_s( string1, _countof(string1), " " );
-                    strcat_s( string1, _countof(string1), string3 );
-                    efd.radioScaleToMaterial = 1;
-                }
-                else if ( 3 == sscanf_s( lines[lineNo], "# Scale model by using the minimum wall thickness for the %s %s %s", string1, _countof(string1), string2, _countof(string2), string3, _countof(string3) ) )
-                {
-                    if ( strcmp( string3, "material" ) != 0 )
-                        return MW_CANNOT_PARSE_IMPORT_FILE;
-                    strcat_s( string1, _countof(string1), " " );
-                    strcat_s( string1, _countof(string1), string2 );
-                    efd.radioScaleToMaterial = 1;
-                }
-                else if ( 2 == sscanf_s( lines[lineNo], "# Scale model by using the minimum wall thickness for the %s %s", string1, _countof(string1), string2, _countof(string2) ) )
-                {
-                    if ( strcmp( string2, "material" ) != 0 )
-                        return MW_CANNOT_PARSE_IMPORT_FILE;
-                    efd.radioScaleToMaterial = 1;
-                }
-                else
-                    return MW_CANNOT_PARSE_IMPORT_FILE;
-
-                // if by cost or by material, need to set the material type.
-                if ( efd.radioScaleByCost || efd.radioScaleToMaterial )
-                {
-                    for ( i = 0; i < MTL_COST_TABLE_SIZE; i++ )
-                    {
-                        if ( strcmp( string1, gMtlCostTable[i].name ) == 0 )
-                        {
-                            break;
-                        }
-                    }
-                    if ( i >= MTL_COST_TABLE_SIZE )
-                        return MW_CANNOT_PARSE_IMPORT_FILE;
-
-                    efd.comboPhysicalMaterial[efd.fileType] = i;
-                }
-    }
-    else
-        return MW_CANNOT_PARSE_IMPORT_FILE;
-
-    lineNo = findLine( "#   Fill air bubbles:", lines, lineNo+1, 20 );
-    if ( lineNo >= 0)
-    {
-        if ( 3 != sscanf_s( lines[lineNo], "#   Fill air bubbles: %s Seal off entrances: %s Fill in isolated tunnels in base of model: %s",
-            string1, _countof(string1),
-            string2, _countof(string2),
-            string3, _countof(string3)
-            ) )
-            return MW_CANNOT_PARSE_IMPORT_FILE;
-    }
-    else
-        return MW_CANNOT_PARSE_IMPORT_FILE;
-
-    efd.chkFillBubbles = ( string1[0] == 'Y');
-    efd.chkSealEntrances = ( string2[0] == 'Y');
-    efd.chkSealSideTunnels = ( string3[0] == 'Y');
-
-
-    lineNo = findLine( "#   Connect parts sharing an edge:", lines, lineNo+1, 20 );
-    if ( lineNo >= 0)
-    {
-        if ( 3 != sscanf_s( lines[lineNo], "#   Connect parts sharing an edge: %s Connect corner tips: %s Weld all shared edges: %s",
-            string1, _countof(string1),
-            string2, _countof(string2),
-            string3, _countof(string3)
-            ) )
-            return MW_CANNOT_PARSE_IMPORT_FILE;
-    }
-    else
-        return MW_CANNOT_PARSE_IMPORT_FILE;
-
-    efd.chkConnectParts = ( string1[0] == 'Y');
-    efd.chkConnectCornerTips = ( string2[0] == 'Y');
-    efd.chkConnectAllEdges = ( string3[0] == 'Y');
-
-
-    int intVal = 0;
-    lineNo = findLine( "#   Delete floating objects:", lines, lineNo+1, 20 );
-    if ( lineNo >= 0)
-    {
-        if ( 2 != sscanf_s( lines[lineNo], "#   Delete floating objects: trees and parts smaller than %d blocks: %s",
-            &intVal,
-            string1, _countof(string1) ) )
-            return MW_CANNOT_PARSE_IMPORT_FILE;
-    }
-    else
-        return MW_CANNOT_PARSE_IMPORT_FILE;
-
-    efd.chkDeleteFloaters = ( string1[0] == 'Y');
-    efd.floaterCountVal = intVal;
-
-
-    lineNo = findLine( "#   Hollow out bottom of model", lines, lineNo+1, 20 );
-    if ( lineNo >= 0)
-    {
-        if ( 3 != sscanf_s( lines[lineNo], "#   Hollow out bottom of model, making the walls %f mm thick: %s Superhollow: %s",
-            &floatVal,
-            string1, _countof(string1),
-            string2, _countof(string2)
-            ) )
-            return MW_CANNOT_PARSE_IMPORT_FILE;
-    }
-    else
-        return MW_CANNOT_PARSE_IMPORT_FILE;
-
-    efd.hollowThicknessVal[efd.fileType] = floatVal;
-    efd.chkHollow[efd.fileType] = ( string1[0] == 'Y');
-    efd.chkSuperHollow[efd.fileType] = ( string2[0] == 'Y');
-
-
-    lineNo = findLine( "# Melt snow blocks:", lines, lineNo+1, 20 );
-    if ( lineNo >= 0)
-    {
-        if ( !sscanf_s( lines[lineNo], "# Melt snow blocks: %s", string1, _countof(string1) ) )
-            return MW_CANNOT_PARSE_IMPORT_FILE;
-    }
-    else
-        return MW_CANNOT_PARSE_IMPORT_FILE;
-
-    efd.chkMeltSnow = ( string1[0] == 'Y');
-
-
-    lineNo = findLine( "#   Debug: show separate parts as colors:", lines, lineNo+1, 20 );
-    if ( lineNo >= 0)
-    {
-        if ( !sscanf_s( lines[lineNo], "#   Debug: show separate parts as colors: %s", string1, _countof(string1) ) )
-            return MW_CANNOT_PARSE_IMPORT_FILE;
-    }
-    else
-        return MW_CANNOT_PARSE_IMPORT_FILE;
-
-    efd.chkShowParts = ( string1[0] == 'Y');
-
-
-    lineNo = findLine( "#   Debug: show weld blocks", lines, lineNo+1, 20 );
-    if ( lineNo >= 0)
-    {
-        if ( !sscanf_s( lines[lineNo], "#   Debug: show weld blocks in bright colors: %s", string1, _countof(string1) ) )
-            return MW_CANNOT_PARSE_IMPORT_FILE;
-    }
-    else
-        return MW_CANNOT_PARSE_IMPORT_FILE;
-
-    efd.chkShowWelds = ( string1[0] == 'Y');
-
-
-    // survived, so copy data read in over
-    *pSaveEFD = efd;
-    pSaveEFD->minxVal = worldBox[0];
-    pSaveEFD->minyVal = worldBox[1];
-    pSaveEFD->minzVal = worldBox[2];
-    pSaveEFD->maxxVal = worldBox[3];
-    pSaveEFD->maxyVal = worldBox[4];
-    pSaveEFD->maxzVal = worldBox[5];
-
-    gpEFD = pSaveEFD;
-
-    return MW_NO_ERROR;
-}
-
-// read line, includes \n at end.
-static int readLineSet( FILE *fh, char lines[HEADER_LINES][120], int maxLine )
-{
-    int lineNum = 0;
-    int pos;
-    do {
-        pos = readLine( fh, lines[lineNum++], 120 );
-    } while ( (pos > 0) && ( lineNum < maxLine ) );
-    return lineNum;
-}
-
-// read line, includes \n at end.
-static int readLine( FILE *fh, char *inputString, int stringLength )
-{
-    int pos = 0;
-    int c;
-    do {
-        c = fgetc(fh);
-        if (c != EOF) inputString[pos++] = (char)c;
-        // line too long?
-        if (pos >= stringLength - 1)
-        {
-            inputString[stringLength-1] = '\0';
-            return ( c != EOF ) ? pos : -1;
-        }
-    } while (c != EOF && c != '\n');
-    inputString[pos] = '\0';
-
-    return ( c != EOF) ? pos : -1;
-}
-
-// return line number if checkString is found in the next maxLines of the file.
-static int findLine( char *checkString, char lines[HEADER_LINES][120], int startLine, int maxLines )
-{
-    int trueMaxLines = ( startLine+maxLines >= HEADER_LINES ) ? HEADER_LINES : startLine+maxLines;
-    for ( int i=startLine; i < trueMaxLines; i++ )
-    {
-        if ( strstr( lines[i], checkString ) != NULL )
-        {
-            return i;
-        }
-    }
-    return -1;
-}
-
 static void formTitle(wchar_t *world, wchar_t *title)
 {
     wcscpy_s( title, MAX_PATH-1, L"Mineways: " );
@@ -0,0 +1,1251 @@
+/*
+Copyright (c) 2011, Eric Haines
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// MinewaysCmd: run an export with no user interface, for batch jobs. The settings come from the
+// header of a file Mineways exported earlier (File -> Import Settings reads the same thing). The MW_* codes
+// SaveVolume returns are printed, and the process exit code says whether there were warnings or errors,
+// so scripts can check for them.
+
+#include "stdafx.h"
+#include <stdio.h>
+#ifdef WIN32
+#include <direct.h>
+#endif
+#include <locale.h>
+#ifndef WIN32
+#include <spawn.h>
+#include <sys/wait.h>
+extern char **environ;
+#endif
+#include "rwpng.h"
+#include "lodepng.h"
+#include "ExportDriver.h"
+#include "SyntheticWorld.h"
+#include "ChunkBenchmark.h"
+#include "MapBenchmark.h"
+#include "Workers.h"
+
+// written into the header of each exported file - keep in step with FILEVERSION in Mineways.rc
+#define MINEWAYS_MAJOR_VERSION  2
+#define MINEWAYS_MINOR_VERSION  24
+
+// Process exit codes. The MW_* bits go past the 8 bits of an exit code that POSIX keeps, so they are
+// printed to stderr instead, and the exit code just says how bad the worst of them was.
+#define CMD_OK                  0
+#define CMD_WARNINGS            1
+#define CMD_ERRORS              2
+// exit code when the command line cannot be used, or the world cannot be opened, so no export was tried
+#define CMD_NOT_RUN             (-1)
+
+// Short form of each MW_* code, for the console. Keep in step with the codes in ObjFileManip.h
+static const char *gErrorName[MW_NUM_CODES] = {
+    "walls might be thin",                  // <<0
+    "sum of dimensions is low",             // <<1
+    "too many polygons",                    // <<2
+    "multiple separate parts found",        // <<3
+    "at least one dimension is too high",   // <<4
+    "unknown block type encountered",       // <<5
+    "terrain image does not have enough rows",  // <<6
+    "no blocks found in selection",         // <<7
+    "all blocks were deleted",              // <<8
+    "cannot create file",                   // <<9
+    "cannot write to file",                 // <<10
+    "terrain image width is not a multiple of 16",  // <<11
+    "terrain image needs 16 rows",          // <<12
+    "dimension too large",                  // <<13
+    "cannot read settings file",            // <<14
+    "cannot parse settings file",           // <<15
+    "texture too large",                    // <<16
+    "export too large",                     // <<17
+    "internal error",                       // <<18
+    "cannot read selected terrain file",    // <<19
+    "cannot read default terrain file",     // <<20
+    "cannot write PNG file",                // <<21
+};
+
+static struct {
+    const wchar_t *name;
+    int fileType;
+} gFileTypeName[] = {
+    { L"obj", FILE_TYPE_WAVEFRONT_ABS_OBJ },
+    { L"objrel", FILE_TYPE_WAVEFRONT_REL_OBJ },
+    { L"stl", FILE_TYPE_BINARY_MAGICS_STL },
+    { L"stlviscam", FILE_TYPE_BINARY_VISCAM_STL },
+    { L"stlascii", FILE_TYPE_ASCII_STL },
+    { L"vrml", FILE_TYPE_VRML2 },
+    { L"ply", FILE_TYPE_BINARY_PLY },
+    { L"gltf", FILE_TYPE_GLTF },
+    { L"schematic", FILE_TYPE_SCHEMATIC },
+};
+#define FILE_TYPE_NAME_COUNT (sizeof(gFileTypeName)/sizeof(gFileTypeName[0]))
+
+static Options gOptions = {0,   // which world is visible
+    BLF_WHOLE | BLF_ALMOST_WHOLE | BLF_STAIRS | BLF_HALF | BLF_MIDDLER | BLF_BILLBOARD | BLF_PANE | BLF_FLATTOP | BLF_FLATSIDE,   // what's exportable (really, set on output)
+    0x0,
+    0,  // start with low memory
+    INITIAL_CACHE_SIZE,	// cache size
+    NULL};
+
+// One export: the output file, and the settings, file type and selection to export with.
+typedef struct ExportJob {
+    wchar_t outputFile[MAX_PATH];
+    wchar_t settingsFile[MAX_PATH];
+    wchar_t terrainFile[MAX_PATH];
+    int fileType;           // -1 means use the type in the settings file
+    int box[6];
+    int boxSet;
+    int printDefaults;
+    int pngCompression;
+    int schematicCompression;
+    int streamOBJ;          // write OBJ geometry out as it is made, whatever the settings say
+    int fixedOBJ;           // write OBJ coordinates with a fixed number of decimals, whatever the settings say
+    int lineNo;             // line of the batch file the job came from, 0 for the command line
+    unsigned int order;     // position of the selection along a Hilbert curve, for running nearby jobs together
+    int printModel;         // 1 is print, 0 is render, 2 is schematic
+    ExportFileData efd;     // settings to export with, once resolved
+} ExportJob;
+
+// longest line in a batch file, and most arguments on it
+#define BATCH_LINE_LENGTH   2048
+#define BATCH_MAX_ARGS      32
+
+// most exports run at once with -threads
+#define MAX_EXPORT_THREADS  16
+
+// sizes, in chunks on a side, of the worlds -benchmark makes
+static const int gBenchmarkSize[] = { 4, 16, 32 };
+#define BENCHMARK_SIZE_COUNT (sizeof(gBenchmarkSize)/sizeof(gBenchmarkSize[0]))
+
+// The jobs of a batch run on several threads. Each thread takes the next job not yet started.
+typedef struct JobQueue {
+    const wchar_t *world;
+    const wchar_t *curDir;
+    ExportJob *jobs;
+    int jobCount;
+    int quiet;
+    volatile LONG nextJob;
+    volatile LONG retCode;  // every problem found in any job
+} JobQueue;
+
+static int gLastPercent = -1;
+
+// held while a job writes to the console, so that the output of jobs running at once is not mixed
+static PORTALOCK gOutputLock;
+
+static int runExport( int argc, wchar_t *argv[] );
+static void initJob( ExportJob *pJob );
+static int parseJobOption( int argc, wchar_t *argv[], int *pArg, ExportJob *pJob );
+static int readBatchFile( const wchar_t *batchFile, ExportJob **ppJobs, int *pJobCount );
+static int splitLine( wchar_t *line, wchar_t *argv[], int maxArgs );
+static int resolveJob( ExportJob *pJob );
+static unsigned int hilbertIndex( int x, int z );
+static int compareJobs( const void *a, const void *b );
+static DWORD WINAPI runJobs( LPVOID pParam );
+static int runJob( const wchar_t *world, const wchar_t *curDir, ExportJob *pJob, int quiet, int threaded );
+static int runBenchmark( const wchar_t *benchmarkDir );
+static int runBenchmarkExport( const wchar_t *benchmarkDir, const wchar_t *curDir, int kind, int sizeNo, int type );
+static int runSelf( int argc, const wchar_t **argv );
+static int runSelfTest( int quiet );
+static int benchmarkExport( const wchar_t *world, const wchar_t *curDir, const wchar_t *outputFile, int fileType, int size, double *pSeconds );
+static void printUsage();
+static int findFileType( const wchar_t *name );
+static void copyFileTypeSettings( ExportFileData *pEFD, int srcType, int dstType );
+static void printProgress( float progress );
+static void printResult( int errCode );
+static int exitCode( int errCode );
+
+
+int wmain( int argc, wchar_t *argv[] )
+{
+    return runExport( argc, argv );
+}
+
+#ifndef WIN32
+// gcc and clang have no wmain, so widen the arguments, which are taken to be UTF-8
+int main( int argc, char *argv[] )
+{
+    wchar_t **wargv = (wchar_t **)malloc( (argc+1) * sizeof(wchar_t *) );
+    int i;
+
+    // so that fgetws reads the batch file as UTF-8, and wide output is written as UTF-8
+    if ( setlocale( LC_CTYPE, "C.UTF-8" ) == NULL )
+        setlocale( LC_CTYPE, "" );
+    if ( wargv == NULL )
+        return CMD_NOT_RUN;
+    for ( i = 0; i < argc; i++ )
+    {
+        int length = MultiByteToWideChar( CP_UTF8, 0, argv[i], -1, NULL, 0 );
+        wargv[i] = (wchar_t *)malloc( ( length > 0 ? length : 1 ) * sizeof(wchar_t) );
+        if ( wargv[i] == NULL )
+            return CMD_NOT_RUN;
+        wargv[i][0] = 0;
+        MultiByteToWideChar( CP_UTF8, 0, argv[i], -1, wargv[i], length );
+    }
+    wargv[argc] = NULL;
+    return wmain( argc, wargv );
+}
+#endif
+
+static int runExport( int argc, wchar_t *argv[] )
+{
+    const wchar_t *world = NULL;
+    const wchar_t *batchFile = NULL;
+    const wchar_t *benchmarkDir = NULL;
+    const wchar_t *chunkBenchDir = NULL;
+    const wchar_t *chunkListFile = NULL;
+    int benchKind = -1, benchSizeNo = -1, benchType = -1;
+    int mapBenchmark = 0;
+    int selfTest = 0;
+    int coldCache = 0;
+    wchar_t curDir[MAX_PATH];
+    ExportJob *jobs = NULL;
+    int jobCount = 0;
+    int quiet = 0;
+    int numThreads = 1;
+    int retCode;
+    int i;
+
+    // the job given on the command line itself, used when there's no batch file
+    ExportJob *pCmdJob = (ExportJob *)malloc( sizeof(ExportJob) );
+    if ( pCmdJob == NULL )
+        return CMD_NOT_RUN;
+    initJob( pCmdJob );
+
+    for ( i = 1; i < argc; i++ )
+    {
+        if ( argv[i][0] != (wchar_t)'-' )
+        {
+            if ( world == NULL )
+                world = argv[i];
+            else if ( pCmdJob->outputFile[0] == (wchar_t)0 )
+                wcscpy_s( pCmdJob->outputFile, MAX_PATH, argv[i] );
+            else
+            {
+                fwprintf( stderr, L"Unexpected argument %ls\n", argv[i] );
+                printUsage();
+                free( pCmdJob );
+                return CMD_NOT_RUN;
+            }
+            continue;
+        }
+
+        retCode = parseJobOption( argc, argv, &i, pCmdJob );
+        if ( retCode < 0 )
+        {
+            printUsage();
+            free( pCmdJob );
+            return CMD_NOT_RUN;
+        }
+        else if ( retCode > 0 )
+        {
+            continue;
+        }
+
+        // options that apply to the whole run
+        if ( wcscmp( argv[i], L"-dim" ) == 0 && i+1 < argc )
+        {
+            i++;
+            gOptions.worldType &= ~(HELL|ENDER);
+            if ( wcscmp( argv[i], L"nether" ) == 0 )
+                gOptions.worldType |= HELL;
+            else if ( wcscmp( argv[i], L"end" ) == 0 )
+                gOptions.worldType |= ENDER;
+            else if ( wcscmp( argv[i], L"overworld" ) != 0 )
+            {
+                fwprintf( stderr, L"Unknown dimension %ls\n", argv[i] );
+                printUsage();
+                free( pCmdJob );
+                return CMD_NOT_RUN;
+            }
+        }
+        else if ( wcscmp( argv[i], L"-batch" ) == 0 && i+1 < argc )
+        {
+            batchFile = argv[++i];
+        }
+        else if ( wcscmp( argv[i], L"-benchmark" ) == 0 && i+1 < argc )
+        {
+            benchmarkDir = argv[++i];
+        }
+        else if ( wcscmp( argv[i], L"-benchexport" ) == 0 && i+3 < argc )
+        {
+            // used by -benchmark itself, to run each export in a process of its own
+            benchKind = (int)wcstol( argv[++i], NULL, 10 );
+            benchSizeNo = (int)wcstol( argv[++i], NULL, 10 );
+            benchType = (int)wcstol( argv[++i], NULL, 10 );
+            if ( benchKind < 0 || benchKind >= SYNTHETIC_KIND_COUNT || benchSizeNo < 0 || benchSizeNo >= (int)BENCHMARK_SIZE_COUNT ||
+                benchType < 0 || benchType >= (int)FILE_TYPE_NAME_COUNT )
+            {
+                fwprintf( stderr, L"-benchexport is out of range\n" );
+                free( pCmdJob );
+                return CMD_NOT_RUN;
+            }
+        }
+        else if ( wcscmp( argv[i], L"-chunkbench" ) == 0 && i+1 < argc )
+        {
+            chunkBenchDir = argv[++i];
+        }
+        else if ( wcscmp( argv[i], L"-chunklist" ) == 0 && i+1 < argc )
+        {
+            chunkListFile = argv[++i];
+        }
+        else if ( wcscmp( argv[i], L"-mapbench" ) == 0 )
+        {
+            mapBenchmark = 1;
+        }
+        else if ( wcscmp( argv[i], L"-selftest" ) == 0 )
+        {
+            selfTest = 1;
+        }
+        else if ( wcscmp( argv[i], L"-cold" ) == 0 )
+        {
+            coldCache = 1;
+        }
+        else if ( wcscmp( argv[i], L"-cache" ) == 0 && i+1 < argc )
+        {
+            // number of chunks kept in memory; batches of overlapping selections share more when it's larger
+            int cacheSize = (int)wcstol( argv[++i], NULL, 10 );
+            if ( cacheSize > 0 )
+            {
+                gOptions.currentCacheSize = cacheSize;
+                ChangeCache( cacheSize );
+            }
+        }
+        else if ( wcscmp( argv[i], L"-memory" ) == 0 )
+        {
+            gOptions.moreExportMemory = 1;
+        }
+        else if ( wcscmp( argv[i], L"-threads" ) == 0 && i+1 < argc )
+        {
+            numThreads = (int)wcstol( argv[++i], NULL, 10 );
+            if ( numThreads < 1 )
+                numThreads = 1;
+            else if ( numThreads > MAX_EXPORT_THREADS )
+                numThreads = MAX_EXPORT_THREADS;
+        }
+        else if ( wcscmp( argv[i], L"-timing" ) == 0 )
+        {
+            gOptions.timingReport |= TIMING_REPORT_JSON;
+        }
+        else if ( wcscmp( argv[i], L"-timingheader" ) == 0 )
+        {
+            gOptions.timingReport |= TIMING_REPORT_HEADER;
+        }
+        else if ( wcscmp( argv[i], L"-quiet" ) == 0 )
+        {
+            quiet = 1;
+        }
+        else
+        {
+            fwprintf( stderr, L"Unknown or incomplete option %ls\n", argv[i] );
+            printUsage();
+            free( pCmdJob );
+            return CMD_NOT_RUN;
+        }
+    }
+
+    if ( selfTest )
+    {
+        free( pCmdJob );
+        return runSelfTest( quiet );
+    }
+
+    if ( chunkBenchDir != NULL )
+    {
+        free( pCmdJob );
+        return RunChunkBenchmark( chunkBenchDir, coldCache, chunkListFile );
+    }
+
+    if ( mapBenchmark && world != NULL )
+    {
+        free( pCmdJob );
+        SetMapPremultipliedColors();
+        return RunMapBenchmark( world, gOptions.worldType & (HELL|ENDER), coldCache );
+    }
+
+    if ( benchmarkDir != NULL )
+    {
+        free( pCmdJob );
+        SetMapPremultipliedColors();
+        if ( PortaGetCwd( curDir, MAX_PATH ) == NULL )
+            curDir[0] = (wchar_t)0;
+        PortaInitLock( &gOutputLock );
+        if ( benchType >= 0 )
+            retCode = exitCode( runBenchmarkExport( benchmarkDir, curDir, benchKind, benchSizeNo, benchType ) );
+        else
+            retCode = runBenchmark( benchmarkDir );
+        PortaDeleteLock( &gOutputLock );
+        return retCode;
+    }
+
+    if ( world == NULL || ( batchFile == NULL && pCmdJob->outputFile[0] == (wchar_t)0 ) )
+    {
+        printUsage();
+        free( pCmdJob );
+        return CMD_NOT_RUN;
+    }
+
+    if ( batchFile != NULL )
+    {
+        free( pCmdJob );
+        retCode = readBatchFile( batchFile, &jobs, &jobCount );
+        if ( retCode != MW_NO_ERROR )
+        {
+            free( jobs );
+            return exitCode( retCode );
+        }
+    }
+    else
+    {
+        jobs = pCmdJob;
+        jobCount = 1;
+    }
+
+    // settle every job's settings before exporting anything, so a bad job is found before hours of work, not after
+    for ( i = 0; i < jobCount; i++ )
+    {
+        retCode = resolveJob( &jobs[i] );
+        if ( retCode != MW_NO_ERROR )
+        {
+            if ( jobs[i].lineNo > 0 )
+                fwprintf( stderr, L"Batch file line %d: job not run\n", jobs[i].lineNo );
+            if ( retCode != CMD_NOT_RUN )
+                printResult( retCode );
+            free( jobs );
+            return exitCode( retCode );
+        }
+    }
+
+    // The chunk cache keeps the chunks read most recently, so exports that share chunks should run
+    // one after the other. Following a Hilbert curve through the selections' centers does this.
+    qsort( jobs, jobCount, sizeof(ExportJob), compareJobs );
+
+    // make sure there's a world there before doing any work
+    int version;
+    if ( GetFileVersion( world, &version ) != 0 )
+    {
+        fwprintf( stderr, L"Cannot read level.dat in world %ls\n", world );
+        free( jobs );
+        return CMD_NOT_RUN;
+    }
+    if ( version < 19133 )
+    {
+        fwprintf( stderr, L"World %ls is in the old pre-Anvil format; open and save it in Minecraft first\n", world );
+        free( jobs );
+        return CMD_NOT_RUN;
+    }
+
+    // the block colors and alphas are set up here, as when Mineways starts
+    SetMapPremultipliedColors();
+
+    // the default terrainExt.png is looked for in the current directory, as Mineways does
+    if ( PortaGetCwd( curDir, MAX_PATH ) == NULL )
+        curDir[0] = (wchar_t)0;
+
+    PortaInitLock( &gOutputLock );
+
+    if ( numThreads > jobCount )
+        numThreads = jobCount;
+    if ( numThreads > 1 )
+    {
+        // Exports on different threads share the chunk cache, and as the jobs are in Hilbert order,
+        // those running at once are usually near each other and read many of the same chunks.
+        // The last volume read is kept by each thread; the terrain texture built is shared by all.
+        JobQueue queue;
+        queue.world = world;
+        queue.curDir = curDir;
+        queue.jobs = jobs;
+        queue.jobCount = jobCount;
+        queue.quiet = quiet;
+        queue.nextJob = 0;
+        queue.retCode = MW_NO_ERROR;
+        // this thread runs jobs, too
+        RunOnWorkers( runJobs, &queue, numThreads );
+        retCode = (int)queue.retCode;
+    }
+    else
+    {
+        // All jobs run in this one process, so the chunk cache, the last volume read, and the
+        // terrain texture built are all reused from job to job by SaveVolume.
+        retCode = MW_NO_ERROR;
+        for ( i = 0; i < jobCount; i++ )
+        {
+            if ( !quiet && jobCount > 1 )
+            {
+                fwprintf( stderr, L"Job %d of %d: %ls\n", i+1, jobCount, jobs[i].outputFile );
+            }
+            // the result is every problem found in any job
+            retCode |= runJob( world, curDir, &jobs[i], quiet, 0 );
+        }
+        ClearVolumeCache();
+    }
+
+    PortaDeleteLock( &gOutputLock );
+    free( jobs );
+    return exitCode( retCode );
+}
+
+static DWORD WINAPI runJobs( LPVOID pParam )
+{
+    JobQueue *pQueue = (JobQueue *)pParam;
+    int job;
+
+    while ( ( job = (int)PortaIncrement( &pQueue->nextJob ) - 1 ) < pQueue->jobCount )
+    {
+        int errCode = runJob( pQueue->world, pQueue->curDir, &pQueue->jobs[job], pQueue->quiet, 1 );
+        PortaOr( &pQueue->retCode, (LONG)errCode );
+    }
+    // each thread keeps its own last volume, so each must free it
+    ClearVolumeCache();
+    return 0;
+}
+
+static void initJob( ExportJob *pJob )
+{
+    memset( pJob, 0, sizeof(ExportJob) );
+    pJob->fileType = -1;
+}
+
+// Options that can differ from one job to the next. Returns 1 if argv[*pArg] was one of these
+// (and moves *pArg past any values it takes), 0 if it was not, or -1 if it was but was wrong.
+static int parseJobOption( int argc, wchar_t *argv[], int *pArg, ExportJob *pJob )
+{
+    int i = *pArg;
+
+    if ( wcscmp( argv[i], L"-settings" ) == 0 && i+1 < argc )
+    {
+        wcscpy_s( pJob->settingsFile, MAX_PATH, argv[++i] );
+    }
+    else if ( wcscmp( argv[i], L"-type" ) == 0 && i+1 < argc )
+    {
+        pJob->fileType = findFileType( argv[++i] );
+        if ( pJob->fileType < 0 )
+        {
+            fwprintf( stderr, L"Unknown file type %ls\n", argv[i] );
+            return -1;
+        }
+    }
+    else if ( wcscmp( argv[i], L"-box" ) == 0 && i+6 < argc )
+    {
+        for ( int j = 0; j < 6; j++ )
+        {
+            pJob->box[j] = (int)wcstol( argv[++i], NULL, 10 );
+        }
+        pJob->boxSet = 1;
+    }
+    else if ( wcscmp( argv[i], L"-terrain" ) == 0 && i+1 < argc )
+    {
+        wcscpy_s( pJob->terrainFile, MAX_PATH, argv[++i] );
+    }
+    else if ( wcscmp( argv[i], L"-print" ) == 0 )
+    {
+        pJob->printDefaults = 1;
+    }
+    else if ( wcscmp( argv[i], L"-pngfast" ) == 0 )
+    {
+        pJob->pngCompression = PNG_COMPRESSION_FAST;
+    }
+    else if ( wcscmp( argv[i], L"-pngsmall" ) == 0 )
+    {
+        pJob->pngCompression = PNG_COMPRESSION_SMALL;
+    }
+    else if ( wcscmp( argv[i], L"-objstream" ) == 0 )
+    {
+        pJob->streamOBJ = 1;
+    }
+    else if ( wcscmp( argv[i], L"-objfixed" ) == 0 )
+    {
+        pJob->fixedOBJ = 1;
+    }
+    else if ( wcscmp( argv[i], L"-schematiclevel" ) == 0 && i+1 < argc )
+    {
+        pJob->schematicCompression = (int)wcstol( argv[++i], NULL, 10 );
+        if ( pJob->schematicCompression < 1 || pJob->schematicCompression > 9 )
+        {
+            fwprintf( stderr, L"-schematiclevel must be 1 to 9\n" );
+            return -1;
+        }
+    }
+    else
+    {
+        return 0;
+    }
+
+    *pArg = i;
+    return 1;
+}
+
+// A batch file has one job per line: the job options, then the output file name, e.g.
+//   -settings city.obj -box 0 0 0 255 255 255 tile_0_0.obj
+// Names with spaces go in double quotes. Blank lines and lines starting with # are skipped.
+static int readBatchFile( const wchar_t *batchFile, ExportJob **ppJobs, int *pJobCount )
+{
+    FILE *fh;
+    errno_t err = _wfopen_s( &fh, batchFile, L"rt, ccs=UTF-8" );
+    if ( err != 0 )
+    {
+        fwprintf( stderr, L"Cannot read batch file %ls\n", batchFile );
+        return CMD_NOT_RUN;
+    }
+
+    wchar_t line[BATCH_LINE_LENGTH];
+    wchar_t *argv[BATCH_MAX_ARGS];
+    int allocated = 0;
+    int lineNo = 0;
+
+    *ppJobs = NULL;
+    *pJobCount = 0;
+    while ( fgetws( line, BATCH_LINE_LENGTH, fh ) != NULL )
+    {
+        lineNo++;
+        int argc = splitLine( line, argv, BATCH_MAX_ARGS );
+        if ( argc == 0 || argv[0][0] == (wchar_t)'#' )
+            continue;
+
+        if ( *pJobCount >= allocated )
+        {
+            allocated = ( allocated == 0 ) ? 64 : 2*allocated;
+            ExportJob *newJobs = (ExportJob *)realloc( *ppJobs, allocated*sizeof(ExportJob) );
+            if ( newJobs == NULL )
+            {
+                fclose( fh );
+                return CMD_NOT_RUN;
+            }
+            *ppJobs = newJobs;
+        }
+        ExportJob *pJob = &(*ppJobs)[*pJobCount];
+        initJob( pJob );
+        pJob->lineNo = lineNo;
+
+        for ( int i = 0; i < argc; i++ )
+        {
+            int retCode = ( argv[i][0] == (wchar_t)'-' ) ? parseJobOption( argc, argv, &i, pJob ) : 0;
+            if ( retCode > 0 )
+                continue;
+
+            if ( retCode == 0 && argv[i][0] != (wchar_t)'-' && pJob->outputFile[0] == (wchar_t)0 )
+            {
+                wcscpy_s( pJob->outputFile, MAX_PATH, argv[i] );
+            }
+            else
+            {
+                fwprintf( stderr, L"Batch file line %d: cannot use %ls here\n", lineNo, argv[i] );
+                fclose( fh );
+                return CMD_NOT_RUN;
+            }
+        }
+        if ( pJob->outputFile[0] == (wchar_t)0 )
+        {
+            fwprintf( stderr, L"Batch file line %d: no output file given\n", lineNo );
+            fclose( fh );
+            return CMD_NOT_RUN;
+        }
+        (*pJobCount)++;
+    }
+    fclose( fh );
+
+    if ( *pJobCount == 0 )
+    {
+        fwprintf( stderr, L"No jobs found in batch file %ls\n", batchFile );
+        return CMD_NOT_RUN;
+    }
+    return MW_NO_ERROR;
+}
+
+// split line into arguments in place, white space separated, with "quotes" around ones holding spaces
+static int splitLine( wchar_t *line, wchar_t *argv[], int maxArgs )
+{
+    int argc = 0;
+    wchar_t *c = line;
+    for (;;)
+    {
+        while ( *c == (wchar_t)' ' || *c == (wchar_t)'\t' || *c == (wchar_t)'\r' || *c == (wchar_t)'\n' )
+            c++;
+        if ( *c == (wchar_t)0 || argc >= maxArgs )
+            break;
+
+        if ( *c == (wchar_t)'"' )
+        {
+            argv[argc++] = ++c;
+            while ( *c != (wchar_t)0 && *c != (wchar_t)'"' )
+                c++;
+        }
+        else
+        {
+            argv[argc++] = c;
+            while ( *c != (wchar_t)0 && *c != (wchar_t)' ' && *c != (wchar_t)'\t' && *c != (wchar_t)'\r' && *c != (wchar_t)'\n' )
+                c++;
+        }
+        if ( *c == (wchar_t)0 )
+            break;
+        *c++ = (wchar_t)0;
+    }
+    return argc;
+}
+
+// Work out the settings the job exports with: the defaults, any imported settings, then the
+// file type and selection given for the job.
+static int resolveJob( ExportJob *pJob )
+{
+    ExportFileData *pPrint = (ExportFileData *)malloc( 3*sizeof(ExportFileData) );
+    if ( pPrint == NULL )
+        return CMD_NOT_RUN;
+    ExportFileData *pView = pPrint + 1;
+    ExportFileData *pSchematic = pPrint + 2;
+
+    InitializeExportSettings( pPrint, pView, pSchematic );
+
+    // start from the rendering or printing defaults, then lay any imported settings on top
+    ExportFileData *pEFD = pJob->printDefaults ? pPrint : pView;
+    if ( pJob->settingsFile[0] )
+    {
+        int retCode = ImportExportSettings( pJob->settingsFile, pPrint, pView, &pEFD );
+        if ( retCode != MW_NO_ERROR )
+        {
+            free( pPrint );
+            return retCode;
+        }
+        if ( !pJob->boxSet )
+        {
+            pJob->box[0] = pEFD->minxVal;
+            pJob->box[1] = pEFD->minyVal;
+            pJob->box[2] = pEFD->minzVal;
+            pJob->box[3] = pEFD->maxxVal;
+            pJob->box[4] = pEFD->maxyVal;
+            pJob->box[5] = pEFD->maxzVal;
+            pJob->boxSet = 1;
+        }
+    }
+    if ( !pJob->boxSet )
+    {
+        fwprintf( stderr, L"No selection for %ls: give -box, or -settings from a file that has one\n", pJob->outputFile );
+        free( pPrint );
+        return CMD_NOT_RUN;
+    }
+
+    pJob->printModel = ( pEFD->flags & EXPT_3DPRINT ) ? 1 : 0;
+    if ( pJob->fileType == FILE_TYPE_SCHEMATIC )
+    {
+        // schematics ignore nearly all options, so there is nothing to carry over
+        pEFD = pSchematic;
+        pEFD->fileType = FILE_TYPE_SCHEMATIC;
+        pJob->printModel = 2;
+    }
+    else if ( pJob->fileType >= 0 && pJob->fileType != pEFD->fileType )
+    {
+        // export the imported settings as a different file type
+        copyFileTypeSettings( pEFD, pEFD->fileType, pJob->fileType );
+        pEFD->fileType = pJob->fileType;
+    }
+    pEFD->flags = ( pJob->printModel == 1 ) ? EXPT_3DPRINT : 0x0;
+    if ( pJob->streamOBJ )
+    {
+        pEFD->chkStreamOBJ = 1;
+    }
+    if ( pJob->fixedOBJ )
+    {
+        pEFD->chkFixedPrecisionOBJ = 1;
+    }
+    pEFD->minxVal = min( pJob->box[0], pJob->box[3] );
+    pEFD->minyVal = min( pJob->box[1], pJob->box[4] );
+    pEFD->minzVal = min( pJob->box[2], pJob->box[5] );
+    pEFD->maxxVal = max( pJob->box[0], pJob->box[3] );
+    pEFD->maxyVal = max( pJob->box[1], pJob->box[4] );
+    pEFD->maxzVal = max( pJob->box[2], pJob->box[5] );
+
+    pJob->efd = *pEFD;
+    free( pPrint );
+
+    // chunk the center of the selection is in
+    int centerX = (pJob->efd.minxVal + pJob->efd.maxxVal) / 2;
+    int centerZ = (pJob->efd.minzVal + pJob->efd.maxzVal) / 2;
+    pJob->order = hilbertIndex( centerX >> 4, centerZ >> 4 );
+
+    return MW_NO_ERROR;
+}
+
+// Position of chunk x,z along a Hilbert curve filling a 65536 x 65536 chunk square centered on
+// the origin; chunks beyond that wrap around. Nearby positions on the curve are nearby chunks.
+static unsigned int hilbertIndex( int x, int z )
+{
+    unsigned int ux = (unsigned int)(x + 0x8000) & 0xffff;
+    unsigned int uz = (unsigned int)(z + 0x8000) & 0xffff;
+    unsigned int d = 0;
+
+    for ( unsigned int s = 0x8000; s > 0; s >>= 1 )
+    {
+        unsigned int rx = ( ux & s ) ? 1 : 0;
+        unsigned int rz = ( uz & s ) ? 1 : 0;
+        d += s * s * ( ( 3 * rx ) ^ rz );
+
+        // rotate the quadrant so the curve inside it joins up with its neighbors
+        if ( rz == 0 )
+        {
+            if ( rx == 1 )
+            {
+                ux = 0xffff - ux;
+                uz = 0xffff - uz;
+            }
+            unsigned int temp = ux;
+            ux = uz;
+            uz = temp;
+        }
+    }
+    return d;
+}
+
+static int compareJobs( const void *a, const void *b )
+{
+    const ExportJob *jobA = (const ExportJob *)a;
+    const ExportJob *jobB = (const ExportJob *)b;
+    if ( jobA->order != jobB->order )
+        return ( jobA->order < jobB->order ) ? -1 : 1;
+    // same spot: keep the order of the batch file
+    return jobA->lineNo - jobB->lineNo;
+}
+
+// Run one export. When threaded, other jobs are running at the same time, so there's no progress
+// shown, and the job's output is written all at once when it's done.
+static int runJob( const wchar_t *world, const wchar_t *curDir, ExportJob *pJob, int quiet, int threaded )
+{
+    ExportFileData *pEFD = &pJob->efd;
+    int i;
+
+    // each job gets its own options, as SaveVolume uses them until it's done
+    Options options = gOptions;
+    options.pngCompression = pJob->pngCompression;
+    options.schematicCompression = pJob->schematicCompression;
+    // jobs often export the same selection to several files, so keep the volume read for the next one
+    options.keepVolume = 1;
+    int notes = SetExportOptions( &options, pEFD, pJob->printModel );
+    if ( !threaded )
+    {
+        for ( i = 0; i < EXPORT_NOTE_COUNT; i++ )
+        {
+            if ( (1<<i) & notes )
+            {
+                fwprintf( stderr, L"%ls\n", GetExportNoteText(i) );
+            }
+        }
+    }
+
+    FileList outputFileList;
+    outputFileList.count = 0;
+    // files only wanted in the zip needn't touch the disk
+    outputFileList.inMemory = pEFD->chkCreateZip[pEFD->fileType] && !pEFD->chkCreateModelFiles[pEFD->fileType];
+    ProgressCallback callback = ( quiet || threaded ) ? NULL : printProgress;
+    gLastPercent = -1;
+
+    int errCode = SaveVolume( pJob->outputFile, pEFD->fileType, &options, world, curDir,
+        pEFD->minxVal, pEFD->minyVal, pEFD->minzVal, pEFD->maxxVal, pEFD->maxyVal, pEFD->maxzVal,
+        callback, pJob->terrainFile, &outputFileList, MINEWAYS_MAJOR_VERSION, MINEWAYS_MINOR_VERSION );
+
+    if ( pEFD->chkCreateZip[pEFD->fileType] )
+    {
+        ZipExportFiles( &outputFileList, pEFD->chkCreateModelFiles[pEFD->fileType], callback );
+    }
+
+    PortaLock( &gOutputLock );
+    if ( threaded )
+    {
+        if ( !quiet )
+        {
+            fwprintf( stderr, L"Done: %ls\n", pJob->outputFile );
+        }
+        for ( i = 0; i < EXPORT_NOTE_COUNT; i++ )
+        {
+            if ( (1<<i) & notes )
+            {
+                fwprintf( stderr, L"%ls\n", GetExportNoteText(i) );
+            }
+        }
+    }
+    if ( !quiet )
+    {
+        if ( !threaded )
+            fwprintf( stderr, L"\n" );
+        for ( i = 0; i < outputFileList.count; i++ )
+        {
+            wprintf( L"%ls\n", outputFileList.name[i] );
+        }
+    }
+
+    printResult( errCode );
+    if ( options.timingReportError != MW_NO_ERROR )
+    {
+        fwprintf( stderr, L"Could not write the timing report for %ls\n", pJob->outputFile );
+    }
+    PortaUnlock( &gOutputLock );
+
+    // the PNG error code rides along above the MW_* bits; just the MW_* bits are returned
+    return errCode & ((1<<MW_NUM_CODES)-1);
+}
+
+// Make each kind of synthetic world at each size in benchmarkDir, export each in full as each file
+// type, and print a tab-separated line of how fast each export went. The worlds are made the same
+// every time, so the numbers can be compared from build to build. Returns the worst exit code of the exports.
+static int runBenchmark( const wchar_t *benchmarkDir )
+{
+    wchar_t world[MAX_PATH];
+    wchar_t exportDir[MAX_PATH];
+    int retCode = MW_NO_ERROR;
+    int kind, sizeNo, type;
+
+    PortaMakeDirectory( benchmarkDir );
+    swprintf_s( exportDir, MAX_PATH, L"%ls" PORTA_SLASH L"exports", benchmarkDir );
+    PortaMakeDirectory( exportDir );
+
+    for ( kind = 0; kind < SYNTHETIC_KIND_COUNT; kind++ )
+    {
+        for ( sizeNo = 0; sizeNo < (int)BENCHMARK_SIZE_COUNT; sizeNo++ )
+        {
+            swprintf_s( world, MAX_PATH, L"%ls" PORTA_SLASH L"%ls-%d", benchmarkDir, SyntheticWorldName( kind ), gBenchmarkSize[sizeNo] );
+            fwprintf( stderr, L"Making world %ls\n", world );
+            retCode = WriteSyntheticWorld( world, kind, gBenchmarkSize[sizeNo] );
+            if ( retCode != MW_NO_ERROR )
+            {
+                fwprintf( stderr, L"Cannot write world %ls\n", world );
+                printResult( retCode );
+                return exitCode( retCode );
+            }
+        }
+    }
+
+    wprintf( L"world\ttype\tseconds\tblocks/s\tfaces/s\tMB/s\tfaces\tMB written\tpeak MB\n" );
+    fflush( stdout );
+    retCode = CMD_OK;
+    for ( kind = 0; kind < SYNTHETIC_KIND_COUNT; kind++ )
+    {
+        for ( sizeNo = 0; sizeNo < (int)BENCHMARK_SIZE_COUNT; sizeNo++ )
+        {
+            for ( type = 0; type < (int)FILE_TYPE_NAME_COUNT; type++ )
+            {
+                // Each export runs in a process of its own, which prints its line, so that the peak memory
+                // is that export's alone, not the most of any export so far.
+                wchar_t kindArg[16], sizeArg[16], typeArg[16];
+                const wchar_t *args[6] = { L"-benchmark", benchmarkDir, L"-benchexport", kindArg, sizeArg, typeArg };
+                swprintf_s( kindArg, 16, L"%d", kind );
+                swprintf_s( sizeArg, 16, L"%d", sizeNo );
+                swprintf_s( typeArg, 16, L"%d", type );
+                // the export prints its own warnings and errors
+                int childCode = runSelf( 6, args );
+                if ( childCode < CMD_OK || childCode > CMD_ERRORS )
+                {
+                    fwprintf( stderr, L"Cannot run the export of %ls-%d as %ls\n", SyntheticWorldName( kind ), gBenchmarkSize[sizeNo], gFileTypeName[type].name );
+                    return CMD_ERRORS;
+                }
+                if ( childCode > retCode )
+                    retCode = childCode;
+            }
+        }
+    }
+    return retCode;
+}
+
+// Run one export of the benchmark, in a process of its own, and print its line.
+static int runBenchmarkExport( const wchar_t *benchmarkDir, const wchar_t *curDir, int kind, int sizeNo, int type )
+{
+    wchar_t world[MAX_PATH];
+    wchar_t outputFile[MAX_PATH];
+    double seconds;
+    int size = gBenchmarkSize[sizeNo];
+    int retCode;
+
+    // the timing report keeps the counts of faces and bytes written
+    gOptions.timingReport |= TIMING_REPORT_JSON;
+
+    // The first export reads the terrain file and builds the texture, which the timed export reuses,
+    // and warms up the file system, so it's done untimed. It's the smallest export there is, so it
+    // doesn't raise the peak memory above what the timed export itself needs.
+    swprintf_s( world, MAX_PATH, L"%ls" PORTA_SLASH L"%ls-%d", benchmarkDir, SyntheticWorldName( 0 ), gBenchmarkSize[0] );
+    swprintf_s( outputFile, MAX_PATH, L"%ls" PORTA_SLASH L"exports" PORTA_SLASH L"warmup.obj", benchmarkDir );
+    retCode = benchmarkExport( world, curDir, outputFile, FILE_TYPE_WAVEFRONT_ABS_OBJ, gBenchmarkSize[0], &seconds );
+    if ( retCode >= MW_BEGIN_ERRORS )
+    {
+        printResult( retCode );
+        return retCode & ((1<<MW_NUM_CODES)-1);
+    }
+
+    swprintf_s( world, MAX_PATH, L"%ls" PORTA_SLASH L"%ls-%d", benchmarkDir, SyntheticWorldName( kind ), size );
+    swprintf_s( outputFile, MAX_PATH, L"%ls" PORTA_SLASH L"exports" PORTA_SLASH L"%ls-%d-%ls", benchmarkDir, SyntheticWorldName( kind ), size, gFileTypeName[type].name );
+    retCode = benchmarkExport( world, curDir, outputFile, gFileTypeName[type].fileType, size, &seconds );
+    if ( retCode != MW_NO_ERROR )
+    {
+        fwprintf( stderr, L"%ls-%d as %ls:\n", SyntheticWorldName( kind ), size, gFileTypeName[type].name );
+        printResult( retCode );
+    }
+    Timing_SetPeakMemory();
+
+    double blocks = 256.0 * 256.0 * size * size;
+    double faces = (double)Timing_GetCounter( TIMING_FACES_OUTPUT );
+    double megabytes = (double)Timing_GetCounter( TIMING_BYTES_WRITTEN ) / (1024.0*1024.0);
+    double peak = (double)Timing_GetCounter( TIMING_PEAK_MEMORY ) / (1024.0*1024.0);
+    if ( seconds <= 0.0 )
+        seconds = 1e-6;
+    wprintf( L"%ls-%d\t%ls\t%.3f\t%.0f\t%.0f\t%.2f\t%.0f\t%.2f\t%.1f\n",
+        SyntheticWorldName( kind ), size, gFileTypeName[type].name, seconds,
+        blocks / seconds, faces / seconds, megabytes / seconds, faces, megabytes, peak );
+    fflush( stdout );
+    return retCode & ((1<<MW_NUM_CODES)-1);
+}
+
+// Run this program again with the given arguments, sharing this one's console, and wait for it to end.
+// Returns its exit code, or -1 if it couldn't be run.
+static int runSelf( int argc, const wchar_t **argv )
+{
+    int i;
+#ifdef WIN32
+    wchar_t program[MAX_PATH];
+    wchar_t commandLine[MAX_PATH*8];
+    STARTUPINFOW startInfo;
+    PROCESS_INFORMATION procInfo;
+    DWORD processCode;
+
+    if ( GetModuleFileNameW( NULL, program, MAX_PATH ) == 0 )
+        return -1;
+    // each argument is quoted, as paths can have spaces; a backslash at the end is doubled, or it would escape the quote
+    swprintf_s( commandLine, MAX_PATH*8, L"\"%ls\"", program );
+    for ( i = 0; i < argc; i++ )
+    {
+        size_t len = wcslen( argv[i] );
+        wcscat_s( commandLine, MAX_PATH*8, L" \"" );
+        wcscat_s( commandLine, MAX_PATH*8, argv[i] );
+        if ( len > 0 && argv[i][len-1] == (wchar_t)'\\' )
+            wcscat_s( commandLine, MAX_PATH*8, L"\\" );
+        wcscat_s( commandLine, MAX_PATH*8, L"\"" );
+    }
+
+    memset( &startInfo, 0, sizeof(STARTUPINFOW) );
+    startInfo.cb = sizeof(STARTUPINFOW);
+    startInfo.dwFlags = STARTF_USESTDHANDLES;
+    startInfo.hStdInput = GetStdHandle( STD_INPUT_HANDLE );
+    startInfo.hStdOutput = GetStdHandle( STD_OUTPUT_HANDLE );
+    startInfo.hStdError = GetStdHandle( STD_ERROR_HANDLE );
+    if ( !CreateProcessW( program, commandLine, NULL, NULL, TRUE, 0, NULL, NULL, &startInfo, &procInfo ) )
+        return -1;
+    WaitForSingleObject( procInfo.hProcess, INFINITE );
+    if ( !GetExitCodeProcess( procInfo.hProcess, &processCode ) )
+        processCode = (DWORD)-1;
+    CloseHandle( procInfo.hThread );
+    CloseHandle( procInfo.hProcess );
+    return (int)processCode;
+#else
+    // Linux has the running program at /proc/self/exe; only the low 8 bits of the exit code come back
+    char argBuffer[8][MAX_PATH*4];
+    char *args[10];
+    pid_t pid;
+    int status;
+
+    if ( argc > 8 )
+        return -1;
+    args[0] = (char *)"MinewaysCmd";
+    for ( i = 0; i < argc; i++ )
+    {
+        if ( WideCharToMultiByte( CP_UTF8, 0, argv[i], -1, argBuffer[i], MAX_PATH*4, NULL, NULL ) == 0 )
+            return -1;
+        args[i+1] = argBuffer[i];
+    }
+    args[argc+1] = NULL;
+    if ( posix_spawn( &pid, "/proc/self/exe", NULL, NULL, args, environ ) != 0 )
+        return -1;
+    if ( waitpid( pid, &status, 0 ) != pid || !WIFEXITED( status ) )
+        return -1;
+    return WEXITSTATUS( status );
+#endif
+}
+
+// Export all of a synthetic world of size by size chunks, starting from an empty chunk cache so
+// every export reads the same chunks from disk, and return how long it took.
+static int benchmarkExport( const wchar_t *world, const wchar_t *curDir, const wchar_t *outputFile, int fileType, int size, double *pSeconds )
+{
+    long long start;
+
+    ExportJob *pJob = (ExportJob *)malloc( sizeof(ExportJob) );
+    if ( pJob == NULL )
+        return MW_INTERNAL_ERROR;
+    initJob( pJob );
+    wcscpy_s( pJob->outputFile, MAX_PATH, outputFile );
+    pJob->fileType = fileType;
+    pJob->box[0] = 0;
+    pJob->box[1] = 0;
+    pJob->box[2] = 0;
+    pJob->box[3] = size*16 - 1;
+    pJob->box[4] = 255;
+    pJob->box[5] = size*16 - 1;
+    pJob->boxSet = 1;
+    int retCode = resolveJob( pJob );
+    if ( retCode != MW_NO_ERROR )
+    {
+        free( pJob );
+        *pSeconds = 0.0;
+        return ( retCode == CMD_NOT_RUN ) ? MW_INTERNAL_ERROR : retCode;
+    }
+
+    ClearCache();
+    ClearVolumeCache();
+
+    start = PortaTicks();
+    retCode = runJob( world, curDir, pJob, 1, 0 );
+    *pSeconds = (double)(PortaTicks() - start) / (double)PortaTicksPerSecond();
+
+    free( pJob );
+    return retCode;
+}
+
+// Check that the SSE2 texture code gives the same texels as the plain code. Returns 0 if it does, else 1.
+static int runSelfTest( int quiet )
+{
+    wchar_t report[TEXEL_SELF_TEST_OPS*128];
+    int mismatches = TexelSelfTest( report, TEXEL_SELF_TEST_OPS*128 );
+
+    if ( !quiet || mismatches > 0 )
+        fwprintf( ( mismatches > 0 ) ? stderr : stdout, L"%ls", report );
+    return ( mismatches > 0 ) ? 1 : 0;
+}
+
+static void printUsage()
+{
+    fwprintf( stderr,
+        L"usage: MinewaysCmd [options] world output\n"
+        L"       MinewaysCmd [options] -batch jobfile world\n"
+        L"       MinewaysCmd [options] -benchmark directory\n"
+        L"       MinewaysCmd -chunkbench directory [-cold] [-chunklist file]\n"
+        L"       MinewaysCmd -mapbench [-cold] [-dim name] world\n"
+        L"       MinewaysCmd -selftest\n"
+        L"  world               directory holding the world's level.dat\n"
+        L"  output              file name to export to\n"
+        L"options for each export:\n"
+        L"  -settings file      use the settings in the header of a file Mineways exported (.obj, .wrl or .txt)\n"
+        L"  -type name          obj, objrel, stl, stlviscam, stlascii, vrml, ply, gltf or schematic\n"
+        L"                      (default: the type in the -settings file, else obj). A schematic output file\n"
+        L"                      named .schem is in the Sponge format, else the older MCEdit one.\n"
+        L"  -box x0 y0 z0 x1 y1 z1   selection to export (default: the one in the -settings file)\n"
+        L"  -print              with no -settings, start from the 3D printing defaults instead of rendering\n"
+        L"  -terrain file       terrainExt.png to use (default: terrainExt.png in the current directory)\n"
+        L"  -pngfast, -pngsmall trade texture file size for export speed\n"
+        L"  -objstream          write OBJ geometry out as it is made, using less memory; materials are repeated\n"
+        L"                      for each slab of the model\n"
+        L"  -objfixed           write OBJ coordinates with as many decimals as the block size needs, instead of\n"
+        L"                      the default %%g format; faster to write and usually smaller\n"
+        L"  -schematiclevel n   compress schematic files at zlib level n, 1 (fastest) to 9 (smallest)\n"
+        L"options for the whole run:\n"
+        L"  -dim name           overworld, nether or end (default overworld)\n"
+        L"  -batch jobfile      run many exports, one per line of jobfile: the options for that export, then its\n"
+        L"                      output file. Jobs near each other run one after another, sharing chunks read.\n"
+        L"  -cache chunks       number of chunks to keep in memory (default %d)\n"
+        L"  -memory             give the export more memory by freeing chunks once read; batch jobs then share none\n"
+        L"  -threads count      run up to count batch jobs at once (default 1, at most %d); all share the chunk cache\n"
+        L"  -timing             write how long each stage of each export took to <output>-timing.json\n"
+        L"  -timingheader       also list the times in the statistics in the model file's header\n"
+        L"  -quiet              no progress or file list output\n"
+        L"  -benchmark directory  make test worlds of each kind (terrain, caves, buildings, ocean) and size (4, 16 and\n"
+        L"                      32 chunks square) in directory, export each in full as each file type, and print how\n"
+        L"                      fast each went, as tab-separated columns. Each export runs in a process of its own,\n"
+        L"                      so peak MB is that export's alone.\n"
+        L"  -chunkbench directory  read every chunk of the region files in directory (a world or its region\n"
+        L"                      directory), and print the times to read, inflate and parse them, chunk sizes, and\n"
+        L"                      the slowest chunks\n"
+        L"  -mapbench           draw the map of world, around its spawn point, while panning, zooming, changing the\n"
+        L"                      depth and turning cave mode, lighting and biomes on and off, and print how long\n"
+        L"                      loading, drawing and copying took for each frame\n"
+        L"  -selftest           check that the SSE2 texture operations give the same results as the plain ones;\n"
+        L"                      the exit code is 1 if any differ\n"
+        L"  -cold               with -chunkbench, drop each region file from the file cache before each chunk is read;\n"
+        L"                      with -mapbench, empty the chunk cache before each frame\n"
+        L"  -chunklist file     with -chunkbench, also write the sizes and times of every chunk to file\n"
+        L"Warnings and errors are listed on stderr. The exit code is 0 if all went well, 1 if there were only\n"
+        L"warnings, 2 if there was an error, or -1 (255) if no export was tried. For a batch, it is the worst of\n"
+        L"all the jobs.\n", INITIAL_CACHE_SIZE, MAX_EXPORT_THREADS );
+}
+
+static int findFileType( const wchar_t *name )
+{
+    for ( int i = 0; i < (int)FILE_TYPE_NAME_COUNT; i++ )
+    {
+        if ( wcscmp( name, gFileTypeName[i].name ) == 0 )
+            return gFileTypeName[i].fileType;
+    }
+    return -1;
+}
+
+// every per-file-type value, so that settings saved for one file type are used as-is for another
+static void copyFileTypeSettings( ExportFileData *pEFD, int srcType, int dstType )
+{
+    pEFD->radioExportNoMaterials[dstType] = pEFD->radioExportNoMaterials[srcType];
+    pEFD->radioExportMtlColors[dstType] = pEFD->radioExportMtlColors[srcType];
+    pEFD->radioExportSolidTexture[dstType] = pEFD->radioExportSolidTexture[srcType];
+    pEFD->radioExportFullTexture[dstType] = pEFD->radioExportFullTexture[srcType];
+    pEFD->chkMakeZUp[dstType] = pEFD->chkMakeZUp[srcType];
+    pEFD->blockSizeVal[dstType] = pEFD->blockSizeVal[srcType];
+    pEFD->chkCreateZip[dstType] = pEFD->chkCreateZip[srcType];
+    pEFD->chkCreateModelFiles[dstType] = pEFD->chkCreateModelFiles[srcType];
+    pEFD->chkHollow[dstType] = pEFD->chkHollow[srcType];
+    pEFD->chkSuperHollow[dstType] = pEFD->chkSuperHollow[srcType];
+    pEFD->chkHollowByDistance[dstType] = pEFD->chkHollowByDistance[srcType];
+    pEFD->chkDrainHoles[dstType] = pEFD->chkDrainHoles[srcType];
+    pEFD->hollowThicknessVal[dstType] = pEFD->hollowThicknessVal[srcType];
+    pEFD->comboPhysicalMaterial[dstType] = pEFD->comboPhysicalMaterial[srcType];
+    pEFD->comboModelUnits[dstType] = pEFD->comboModelUnits[srcType];
+}
+
+static void printProgress( float progress )
+{
+    int percent = (int)(progress*100.0f);
+    if ( percent != gLastPercent )
+    {
+        gLastPercent = percent;
+        fwprintf( stderr, L"\r%3d%%", percent );
+    }
+}
+
+static int exitCode( int errCode )
+{
+    if ( errCode == CMD_NOT_RUN )
+        return CMD_NOT_RUN;
+    if ( errCode >= MW_BEGIN_ERRORS )
+        return CMD_ERRORS;
+    return ( errCode != MW_NO_ERROR ) ? CMD_WARNINGS : CMD_OK;
+}
+
+static void printResult( int errCode )
+{
+    for ( int errNo = 0; errNo < MW_NUM_CODES; errNo++ )
+    {
+        if ( (1<<errNo) & errCode )
+        {
+            const char *kind = ( (1<<errNo) >= MW_BEGIN_ERRORS ) ? "Error" : "Warning";
+            if ( (1<<errNo) >= MW_BEGIN_PNG_ERRORS )
+            {
+                // PNG errors have extra information, i.e., what the PNG error string is.
+                fprintf( stderr, "%s: %s; PNG error: %s\n", kind, gErrorName[errNo], lodepng_error_text(errCode>>MW_NUM_CODES) );
+            }
+            else
+            {
+                fprintf( stderr, "%s: %s\n", kind, gErrorName[errNo] );
+            }
+        }
+    }
+}
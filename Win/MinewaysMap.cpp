@@ -235,8 +235,12 @@ void DrawMap(const wchar_t *world,double cx,double cz,int topy,int w,int h,doubl
         // z increases west, decreases east
         for (x=0,px=-shiftx;x<=hBlocks;x++,px+=blockScale)
         {
+            Timing_Start(TIMING_MAP_DRAW);
             blockbits = draw(world,startxblock+x,startzblock+z,topy,opts,callback,(float)(z*hBlocks+x)/(float)(vBlocks*hBlocks),hitsFound);
+            Timing_Stop(TIMING_MAP_DRAW);
+            Timing_Start(TIMING_MAP_BLIT);
             blit(blockbits,bits,px,py,zoom,w,h);
+            Timing_Stop(TIMING_MAP_BLIT);
         }
     }
     // clear dirty rectangle, if any
@@ -1440,9 +1444,12 @@ static unsigned char* draw(const wchar_t *world,int bx,int bz,int maxHeight,Opti
             wcscat_s(directory,256,L"DIM1/");
         }
 
+        Timing_Start(TIMING_CHUNK_LOAD);
         block=LoadBlock(directory,bx,bz);
+        Timing_Stop(TIMING_CHUNK_LOAD);
         if (block==NULL) //blank tile
             return gBlankTile;
+        Timing_Count(TIMING_CHUNKS_LOADED, 1);
 
         //let's only update the progress bar if we're loading
         if (callback)
@@ -1450,6 +1457,8 @@ static unsigned char* draw(const wchar_t *world,int bx,int bz,int maxHeight,Opti
 
         Cache_Add(bx,bz,block);
     }
+    else
+        Timing_Count(TIMING_CACHE_HITS, 1);
 
     // At this point the block is loaded.
 
@@ -1473,6 +1482,7 @@ static unsigned char* draw(const wchar_t *world,int bx,int bz,int maxHeight,Opti
                 ((block->renderhilitID==0) && !isInside) )
             {
                 // there's no need to re-render, use cached image already generated
+                Timing_Count(TIMING_TILES_REUSED, 1);
                 return block->rendercache;
             }
             // else re-render, to clean up previous highlight
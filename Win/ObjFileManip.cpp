@@ -33,13 +33,24 @@ THE POSSIBILITY OF SUCH DAMAGE.
 #include "tiles.h"
 #include "rwpng.h"
 #include "vector.h"
+#include "BlockStates.h"
+#include "Workers.h"
 #include <assert.h>
 #include <string.h>
 #include <math.h>
 #include <time.h>
+#include <limits.h>
 
 #include <vector>
 
+// The PNG tile operations at the end of this file work on four texels at a time with SSE2 when it's available,
+// which is always on x64 and on x86 when the compiler is set to use it. The results are the same as the plain loops,
+// which are still used for any leftover texels and when there's no SSE2.
+#if defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2)) || defined(__SSE2__)
+#define USE_SSE2_TEXELS
+#include <emmintrin.h>
+#endif
+
 // Set to a tiny number to have front and back faces of billboards be separated a bit.
 // TODO: currently works only for those billboards made by using the various multitile calls,
 // not by the traditional billboard calls.
@@ -55,12 +66,81 @@ THE POSSIBILITY OF SUCH DAMAGE.
 // solves some problems people with Macs have running Mineways under Wine
 //#define OLD_BUILD
 
-static PORTAFILE gModelFile;
-static PORTAFILE gMtlFile;
-static PORTAFILE gPngFile;  // for terrainExt.png input (not texture output)
+// All export state is per thread, so that several exports can run at once; see acquireChunk
+// for how they share the chunk cache.
+// An output file, on disk or, if the export's files are only going into a zip, kept in memory in the
+// output file list until the zip is written.
+typedef struct OutputFile {
+    PORTAFILE fh;       // INVALID_HANDLE_VALUE while the file is in memory
+    int index;          // which of the output file list's files it is
+    size_t capacity;    // how much memory the file has room for
+} OutputFile;
+
+// Most memory an export's files can take up in memory, so that a huge export can't run out; past this
+// a file that's growing goes to disk after all.
+#define MAX_OUTPUT_MEMORY (512*1024*1024)
+
+static THREAD_LOCAL OutputFile *gModelFile;
+static THREAD_LOCAL OutputFile *gMtlFile;
+static THREAD_LOCAL PORTAFILE gPngFile;  // for terrainExt.png input (not texture output)
+
+// Text lines for the model file are assembled in this buffer and written out in large blocks,
+// instead of one write call per line.
+#define OUTPUT_BUFFER_SIZE (4*1024*1024)
+// room always left at the end of the buffer for the longest single line we add, e.g. a face with a comment
+#define OUTPUT_BUFFER_LINE_ROOM 1024
+static THREAD_LOCAL char *gOutputBuffer = NULL;
+static THREAD_LOCAL int gOutputBufferCount = 0;
+
+// Decimals used for vertex and texture coordinates when EXPT_OUTPUT_OBJ_FIXED_PRECISION is set;
+// -1 means "%g" style output, the default.
+static THREAD_LOCAL int gVertexDecimals = -1;
+static THREAD_LOCAL int gUVDecimals = -1;
+
+// Set when OBJ geometry is written out slab by slab while it is generated, see EXPT_OUTPUT_OBJ_STREAMING.
+static THREAD_LOCAL int gStreamOBJ = 0;
+// number of rows of blocks along X in each streamed slab
+#define STREAM_SLAB_ROWS 16
+
+// OBJ face output state, which carries over from one streamed slab to the next
+static THREAD_LOCAL int gOBJPrevType;
+static THREAD_LOCAL int gOBJGroupCount;
+static THREAD_LOCAL int gOBJSingleMaterialOutput;
+static THREAD_LOCAL unsigned char gOBJOutputMaterial[NUM_BLOCKS];
 
 #define MINECRAFT_SINGLE_MATERIAL "MC_material"
 
+// binary glTF container: header magic and chunk types, https://github.com/KhronosGroup/glTF/tree/master/specification/2.0
+#define GLB_MAGIC       0x46546C67
+#define GLB_CHUNK_JSON  0x4E4F534A
+#define GLB_CHUNK_BIN   0x004E4942
+// the file length is stored in 32 bits
+#define GLB_MAX_LENGTH  0xffffffffu
+// largest vertex hash table, in entries
+#define GLTF_MAX_HASH_SIZE  ((size_t)1<<30)
+// glTF enumerations, from OpenGL
+#define GLTF_FLOAT                  5126
+#define GLTF_UNSIGNED_INT           5125
+#define GLTF_ARRAY_BUFFER           34962
+#define GLTF_ELEMENT_ARRAY_BUFFER   34963
+#define GLTF_NEAREST                9728
+#define GLTF_CLAMP_TO_EDGE          33071
+
+// A schematic file is put together in memory in one of these, then gzipped in one go
+typedef struct SchematicBuffer {
+    unsigned char *data;
+    size_t count;
+    size_t size;
+} SchematicBuffer;
+// room for each Sponge palette entry's block state name
+#define SCHEMATIC_STATE_LENGTH  256
+// layers of a schematic filled in at once, from runs of blocks up each column of the box
+#define SCHEMATIC_LAYERS        16
+// gzipped schematic data is written out in blocks this size
+#define SCHEMATIC_OUTPUT_SIZE   (1024*1024)
+// set when the schematic file name ends in .schem, for the Sponge format with its block state palette
+static THREAD_LOCAL int gSpongeSchematic = 0;
+
 #define NO_GROUP_SET 0
 #define BOUNDARY_AIR_GROUP 1
 
@@ -74,45 +154,126 @@ typedef struct BoxCell {
     unsigned char data;     // extra data for block (wool color, etc.)
 } BoxCell;
 
+// Work for one thread of filterBox's first pass: a range of X slabs of the solid box.
+typedef struct FilterSlabJob {
+    int minX;
+    int maxX;
+    // the export's box, as the globals describing it belong to the export's thread
+    BoxCell *boxData;
+    IBox solidBox;
+    int boxSizeY;
+    int boxSizeYZ;
+    const unsigned char *keepType;      // 256 entries, 0 if the type is filtered out
+    const unsigned char *specialType;   // 256 entries, 1 if the type is a billboard or is flattened
+    int *specialList;       // box indices of blocks with special types, in scan order
+    int specialCount;
+    int specialListSize;
+    int foundBlock;         // set if a block was kept that is not special
+    int outOfMemory;
+} FilterSlabJob;
+
+// most threads filterBox will split its work among
+#define MAX_FILTER_THREADS 16
+
+// filterBox's slab ranges, taken in turn by the threads running filterSlabs
+typedef struct FilterSlabQueue {
+    FilterSlabJob *jobs;
+    int numJobs;
+    volatile LONG nextJob;
+} FilterSlabQueue;
+
+// One texture file to write, possibly on its own thread.
+typedef struct PNGWriteJob {
+    progimage_info *image;
+    int channels;           // 3 for RGB, 4 for RGBA
+    wchar_t *filename;
+    int compression;        // PNG_COMPRESSION_* level, as writepng's setting is per thread
+    int inMemory;           // keep the file in memory for the zip, rather than writing it to disk
+    unsigned char *data;    // the file, if it's kept in memory
+    size_t size;
+    int rc;                 // writepng's return code
+} PNGWriteJob;
+
+// most texture files written at the end of an export: RGBA, RGB, and alpha
+#define MAX_PNG_WRITE_JOBS 3
+
+// the texture files, taken in turn by the threads running writePNGJobQueue
+typedef struct PNGWriteQueue {
+    PNGWriteJob *jobs;
+    int numJobs;
+    volatile LONG nextJob;
+} PNGWriteQueue;
+
+// The box as read in by populateBox, kept so that exporting the same volume again with other
+// options does not need to read the world again. Anything that changes what populateBox reads is in the key.
+typedef struct VolumeCache {
+    BoxCell *boxData;       // NULL if nothing is cached
+    unsigned char *biome;
+    wchar_t world[MAX_PATH];
+    int worldType;          // just the dimension bits, HELL and ENDER
+    int useBiomes;
+    int notSchematic;
+    IBox selection;         // box asked for, clamped
+    IBox worldBox;          // box read, trimmed to the solid blocks
+    IBox solidWorldBox;
+    int badBlocks;
+} VolumeCache;
+
 typedef struct BoxGroup 
 {
     int groupID;	// which group number am I? Always matches index of gGroupInfo array
     int population;	// how many in the group?
     int solid;		// solid or air group?
     IBox bounds;	// the box that this group occupies. Not valid if population is 0 (merged)
+    int mergedTo;   // group this group's blocks are to be moved to by applyGroupMerges, else NO_GROUP_SET
+    int fillType;   // what the blocks become when moved, if they change solidity, else GROUP_NO_FILL
 } BoxGroup;
 
-static BoxCell *gBoxData = NULL;
-static unsigned char *gBiome = NULL;
-static IPoint gBoxSize;
-static int gBoxSizeYZ = -999;
-static int gBoxSizeXYZ = -999;
+#define GROUP_NO_FILL -1
+
+static THREAD_LOCAL BoxCell *gBoxData = NULL;
+static THREAD_LOCAL unsigned char *gBiome = NULL;
+static THREAD_LOCAL IPoint gBoxSize;
+static THREAD_LOCAL int gBoxSizeYZ = -999;
+static THREAD_LOCAL int gBoxSizeXYZ = -999;
 // the box bounds of gBoxData that has something in it, before processing
-static IBox gSolidBox;
+static THREAD_LOCAL IBox gSolidBox;
 // the box bounds of gBoxData that has something in it, +1 in all directions for air
 // Basically, gSolidBox + 1 in all directions, but generated once for readability
-static IBox gAirBox;
+static THREAD_LOCAL IBox gAirBox;
 // Dimensions of what truly has stuff in it, after all processing is done and we're ready to write
-static Point gFilledBoxSize;    // in centimeters
-
-static IBox gSolidWorldBox;  // area of solid box in world coordinates
-static IPoint gWorld2BoxOffset;
-
-typedef struct FaceRecord {
-    int type;	// block id
-    int faceIndex;	// tie breaker, so that faces get near each other in location
-    int vertexIndex[4];
-    int normalIndex;    // always the same! normals all the same for the face
-    int uvIndex[4];
-} FaceRecord;
-
-#define FACE_RECORD_POOL_SIZE 10000
-
-typedef struct FaceRecordPool {
-    FaceRecord fr[FACE_RECORD_POOL_SIZE];
-    struct FaceRecordPool *pPrev;
-    int count;
-} FaceRecordPool;
+static THREAD_LOCAL Point gFilledBoxSize;    // in centimeters
+
+static THREAD_LOCAL IBox gSolidWorldBox;  // area of solid box in world coordinates
+static THREAD_LOCAL IPoint gWorld2BoxOffset;
+
+// Faces are kept as a structure of arrays, one entry per face in each array, all grown together.
+// The sort and the file writers then walk each array linearly, instead of chasing a pointer per face.
+typedef struct FaceStore {
+    int *type;	// block id
+    int *faceIndex;	// tie breaker, so that faces get near each other in location
+    int (*vertexIndex)[4];
+    int *normalIndex;    // always the same! normals all the same for the face
+    int (*uvIndex)[4];
+} FaceStore;
+
+// used only when sorting faces by material
+typedef struct FaceSortKey {
+    int type;
+    int faceIndex;
+    int face;   // location of the face in the FaceStore before sorting
+} FaceSortKey;
+
+// one glTF mesh primitive, i.e. a run of faces sharing a material
+typedef struct GLTFPrimitive {
+    int type;   // block type of the material, or GENERIC_MATERIAL
+    int firstVertex;
+    int vertexCount;
+    int firstIndex;
+    int indexCount;
+    Point min;
+    Point max;
+} GLTFPrimitive;
 
 typedef struct SwatchComposite {
     int swatchLoc;
@@ -166,9 +327,20 @@ typedef struct Model {
     // What is returned is the index into the vertices[] array itself, where to
     // find the vertex information.
     int *vertexIndices;
+    int vertexIndexPlanes;  // number of X planes of corners in vertexIndices; fewer than gBoxSize[X] when streaming
     int vertexCount;    // lowest unused vertex index;
     int vertexListSize;
 
+    // When streaming, each slab's vertices and faces are dropped from the lists once written. The vertices on the
+    // plane shared with the next slab are kept at the start of the list; carriedVertexIndex is their index in the file.
+    int carriedVertexCount;
+    int *carriedVertexIndex;
+    // what has been written to the model file so far
+    int writtenVertexCount;
+    int writtenNormalCount;
+    int writtenUVCount;
+    int writtenFaceCount;
+
     // One for each SwatchLoc - each UVList potentially contains a list of UVs associated with this particular swatch.
     // During output of the 
     UVList uvSwatches[NUM_MAX_SWATCHES];
@@ -183,7 +355,7 @@ typedef struct Model {
     int billboardCount;
     IBox billboardBounds;
 
-    FaceRecord **faceList;
+    FaceStore faces;
     int faceCount;
     int faceSize;
     int triangleCount;	// the number of true triangles output - currently just sloped rail sides
@@ -209,10 +381,41 @@ typedef struct Model {
     int usesRGB;    // 1 if the RGB (only) texture is used and so should be output
     int usesRGBA;   // 1 if the RGBA texture is used
     int usesAlpha;   // 1 if the Alpha-only texture is used
-    FaceRecordPool *faceRecordPool;
 } Model;
 
-static Model gModel;
+static THREAD_LOCAL Model gModel;
+
+// What the base texture built by createBaseMaterialTexture depends on, besides the block data
+typedef struct AtlasKey {
+    wchar_t terrainFileName[MAX_PATH];
+    unsigned int terrainHash;   // of the terrain file's contents
+    unsigned int colorHash;     // of the block colors and alphas, which color schemes change
+    int exportFlags;            // only the flags that change the texture
+    int fileType;
+    int solidTexture;
+    int noMaterials;
+    int exportAll;
+    int g3dMaterial;
+    int biome;                  // biome used for grass and leaf colors, -1 if none
+    int textureResolution;
+} AtlasKey;
+
+// The last base texture built, so that exporting again with the same terrain file and texture options
+// does not need to decode the terrain file or rebuild the texture. Composites made while exporting go on top.
+// There's one for the whole process, shared by exports on all threads. Once built it's never changed, only
+// replaced whole, and exports copy from it under gAtlasLock.
+typedef struct AtlasCache {
+    progimage_info *pTexture;   // NULL if nothing is cached
+    AtlasKey key;
+    int inputWidth;             // size of the terrain image
+    int inputHeight;
+    int inputRetCode;           // warnings from reading the terrain image
+    int tileSize;
+    int verticalTiles;
+    int swatchCount;
+    int compositeCount;
+    SwatchComposite *composites;    // the composite swatch list, as an array
+} AtlasCache;
 
 typedef struct CompositeSwatchPreset
 {
@@ -243,36 +446,48 @@ typedef struct FillAlpha {
     (c) = (s) % gModel.swatchesPerRow; \
     (r) = (s) / gModel.swatchesPerRow; \
 
-static int gSolidGroups = -999;
-static int gAirGroups = -999;
+static THREAD_LOCAL int gSolidGroups = -999;
+static THREAD_LOCAL int gAirGroups = -999;
 
-static int gGroupListSize = 0;
-static BoxGroup *gGroupList = NULL;
-static int gGroupCount = -999;
+static THREAD_LOCAL int gGroupListSize = 0;
+static THREAD_LOCAL BoxGroup *gGroupList = NULL;
+static THREAD_LOCAL int gGroupCount = -999;
+// which groups touch which, see buildGroupGraph()
+static THREAD_LOCAL int *gGroupNeighborStart = NULL;
+static THREAD_LOCAL int *gGroupNeighbors = NULL;
+// area covered by groups merged but not yet applied to gBoxData
+static THREAD_LOCAL IBox gGroupMergeBounds;
 
 // offsets in box coordinates to the neighboring faces
-static int gFaceOffset[6];
+static THREAD_LOCAL int gFaceOffset[6];
 
-static ProgressCallback *gpCallback;
+static THREAD_LOCAL ProgressCallback *gpCallback;
 
-static Options *gOptions;
+static THREAD_LOCAL Options *gOptions;
 
-static FileList *gOutputFileList;
+static THREAD_LOCAL FileList *gOutputFileList;
 
-static int gExportTexture=0;
+static THREAD_LOCAL int gExportTexture=0;
 // whether we're outputting a print or render
-static int gPrint3D=0;
+static THREAD_LOCAL int gPrint3D=0;
 
-static int gPhysMtl;
+static THREAD_LOCAL int gPhysMtl;
 
-static float gUnitsScale=1.0f;
+static THREAD_LOCAL float gUnitsScale=1.0f;
 
-static int gExportBillboards=0;
+static THREAD_LOCAL int gExportBillboards=0;
 
-static int gMajorVersion=0;
-static int gMinorVersion=0;
+// per thread, like everything else here, so a reused volume is only found by the same thread
+static THREAD_LOCAL VolumeCache gVolumeCache;
 
-static int gBadBlocksInModel=0;
+static AtlasCache gAtlasCache;
+// held shared while an export copies from gAtlasCache, exclusive while it's replaced
+static PORTARWLOCK gAtlasLock=PORTARWLOCK_INIT;
+
+static THREAD_LOCAL int gMajorVersion=0;
+static THREAD_LOCAL int gMinorVersion=0;
+
+static THREAD_LOCAL int gBadBlocksInModel=0;
 
 // If set, the current faces being output will (probably) be transformed later.
 // This is important to know for merging faces: if faces are to later be rotated, etc.,
@@ -281,7 +496,7 @@ static int gBadBlocksInModel=0;
 // This is a global hack, but I didn't want to add this variable *everywhere* when it's usually 0.
 // Basically, if you are going to transform geometry being created to a new spot, set this to true
 // before creating the geometry, then false after.
-static int gUsingTransform=0;
+static THREAD_LOCAL int gUsingTransform=0;
 
 // extra face directions, for normals
 #define DIRECTION_LO_X_LO_Z 6
@@ -332,23 +547,23 @@ static int gUsingTransform=0;
 #define SWATCH_WORKSPACE        SWATCH_INDEX( 8, 2 )
 
 
-wchar_t gOutputFilePath[MAX_PATH];
-wchar_t gOutputFileRoot[MAX_PATH];
-wchar_t gOutputFileRootClean[MAX_PATH]; // used by all files that are referenced inside text files
-char gOutputFileRootCleanChar[MAX_PATH];
+THREAD_LOCAL wchar_t gOutputFilePath[MAX_PATH];
+THREAD_LOCAL wchar_t gOutputFileRoot[MAX_PATH];
+THREAD_LOCAL wchar_t gOutputFileRootClean[MAX_PATH]; // used by all files that are referenced inside text files
+THREAD_LOCAL char gOutputFileRootCleanChar[MAX_PATH];
 
 // how many blocks are needed to make a thick enough wall
-static int gWallBlockThickness = -999;
+static THREAD_LOCAL int gWallBlockThickness = -999;
 // how many is the user specifying for hollow walls
-static int gHollowBlockThickness = -999;
+static THREAD_LOCAL int gHollowBlockThickness = -999;
 
-static int gBlockCount = -999;
+static THREAD_LOCAL int gBlockCount = -999;
 
-static int gMinorBlockCount = -999;
+static THREAD_LOCAL int gMinorBlockCount = -999;
 
-static int gDebugTransparentType = -999;
+static THREAD_LOCAL int gDebugTransparentType = -999;
 
-static long gMySeed = 12345;
+static THREAD_LOCAL long gMySeed = 12345;
 
 
 // these should not be relied on for much of anything during processing,
@@ -366,12 +581,13 @@ typedef struct ExportStatistics {
     int blocksCornertipWelded;
     int blocksHollowed;
     int blocksSuperHollowed;
+    int blocksDrained;
     int floaterGroupsDeleted;
     int blocksFloaterDeleted;
     float density;  // value 0 to 1, number of blocks filled.
 } ExportStatistics;
 
-static ExportStatistics gStats;
+static THREAD_LOCAL ExportStatistics gStats;
 
 typedef struct TypeTile {
     int type;	// block id
@@ -410,7 +626,7 @@ static int gFaceDirectionVector[6][3] =
     { 1,0,0},{0, 1,0},{0,0, 1}
 };
 
-#define WERROR(x) if(x) { assert(0); PortaClose(gModelFile); return MW_CANNOT_WRITE_TO_FILE; }
+#define WERROR(x) if(x) { assert(0); closeOutputFile(&gModelFile); return MW_CANNOT_WRITE_TO_FILE; }
 
 
 // feed world coordinate in to get box index: in our coordinate system, X is dominant, Z is next, Y is weakest.
@@ -457,15 +673,36 @@ static int gFaceDirectionVector[6][3] =
 #define SURROUND_AIR_GROUP 1
 
 
+// a vertical run of solid or air cells in one column, used when finding groups
+typedef struct GroupRun {
+    int parent;     // union-find parent run
+    int group;      // group number, set on root runs and entrances once numbered
+    int top;
+    int bottom;
+    unsigned char solid;
+    unsigned char entrance; // air that was an entrance, kept as a run of its own
+} GroupRun;
+
 typedef struct TouchCell {
+    int boxIndex;               // which air cell this is, TOUCH_EMPTY_SLOT if this hash slot is unused
     unsigned short connections;	// bit field showing connections to edges
     unsigned char count;		// number of connections (up to 12)
     unsigned char obscurity;	// how many directions have something blocking it from visibility (up to 6). More hidden air cells get filled first
 } TouchCell;
 
-TouchCell *gTouchGrid;
+#define TOUCH_EMPTY_SLOT -1
+// initial number of hash slots, must be a power of 2
+#define TOUCH_GRID_START_SIZE 1024
+
+// Air cells next to touching edges, kept in a hash table keyed on box index, so that memory
+// is proportional to the number of problem edges instead of the size of the box.
+static THREAD_LOCAL TouchCell *gTouchGrid = NULL;
+static THREAD_LOCAL int gTouchGridSize = 0;
+static THREAD_LOCAL int gTouchGridUsed = 0;
+// set if the hash table could not grow, so fixTouchingEdges has to give up
+static THREAD_LOCAL int gTouchOutOfMemory = 0;
 
-static int gTouchSize;
+static THREAD_LOCAL int gTouchSize;
 
 typedef struct TouchRecord {
     int boxIndex;
@@ -515,20 +752,34 @@ static void initializeWorldData( IBox *worldBox, int xmin, int ymin, int zmin, i
 static int initializeModelData();
 
 static int readTerrainPNG( const wchar_t *curDir, progimage_info *pII, wchar_t *terrainFileName );
+static int readTerrainImage( const wchar_t *curDir, wchar_t *terrainFileName );
+static unsigned int hashTerrainFile( const wchar_t *curDir, wchar_t *terrainFileName, wchar_t *terrainPath );
+static void makeAtlasKey( AtlasKey *pKey, const wchar_t *terrainPath, unsigned int terrainHash );
+static int findAtlasTerrain( const wchar_t *terrainPath, unsigned int terrainHash, int *pInputRetCode );
+static int readAtlasCache( const wchar_t *terrainPath, unsigned int terrainHash );
+static void writeAtlasCache( const wchar_t *terrainPath, unsigned int terrainHash, int inputRetCode );
+static void replaceAtlasCache( AtlasCache *pNewCache );
+static void clearAtlasCache();
 
 static int populateBox(const wchar_t *world, IBox *box);
+static void setSolidBoxes();
+static int readVolumeCache( const wchar_t *world, IBox *worldBox );
+static void writeVolumeCache( const wchar_t *world, IBox *selection, IBox *worldBox );
 #ifndef OLD_BUILD
+static WorldBlock *acquireChunk(const wchar_t *world, int bx, int bz, int *pExclusive );
+static void releaseChunk( int exclusive );
 static void findChunkBounds(const wchar_t *world, int bx, int bz, IBox *worldBox );
 #endif
 static void extractChunk(const wchar_t *world, int bx, int bz, IBox *box );
 
 static int filterBox();
+static DWORD WINAPI filterSlabs( LPVOID pParam );
+static void filterSlabRange( FilterSlabJob *pJob );
 static int computeFlatFlags( int boxIndex );
 static int firstFaceModifier( int isFirst, int faceIndex );
 static int saveBillboardOrGeometry( int boxIndex, int type );
 static int saveTriangleGeometry( int type, int dataVal, int boxIndex, int typeBelow, int dataValBelow, int boxIndexBelow, int choppedSide );
 static void setDefaultUVs( Point2 uvs[3], int skip );
-static FaceRecord * allocFaceRecordFromPool();
 static int saveTriangleFace( int boxIndex, int swatchLoc, int type, int faceDirection, int startVertexIndex, int vindex[3], Point2 uvs[3] );
 static void saveBlockGeometry( int boxIndex, int type, int dataVal, int markFirstFace, int faceMask, int minPixX, int maxPixX, int minPixY, int maxPixY, int minPixZ, int maxPixZ );
 static void saveBoxGeometry( int boxIndex, int type, int markFirstFace, int faceMask, int minPixX, int maxPixX, int minPixY, int maxPixY, int minPixZ, int maxPixZ );
@@ -548,20 +799,29 @@ static int saveBillboardFaces( int boxIndex, int type, int billboardType );
 static int saveBillboardFacesExtraData( int boxIndex, int type, int billboardType, int dataVal, int firstFace );
 static int checkGroupListSize();
 static int checkVertexListSize();
+static int allocFaceStore( int faceSize );
 static int checkFaceListSize();
 
 static int findGroups();
 static void addVolumeToGroup( int groupID, int minx, int miny, int minz, int maxx, int maxy, int maxz );
-static void propagateSeed(IPoint point, BoxGroup *groupInfo, IPoint **seedStack, int *seedSize, int *seedCount);
+static int findGroupRunRoot( GroupRun *runs, int run );
+static void joinGroupRunColumns( GroupRun *runs, int *colStart, int colA, int colB );
+static int findGroupRunAt( GroupRun *runs, int *colStart, int col, int y );
+static int findEntranceGroup( GroupRun *runs, int *colStart, int col, int sizeZ, IPoint loc );
 static int getNeighbor( int faceDirection, IPoint newPoint );
 static void getNeighborUnsafe( int faceDirection, IPoint newPoint );
 
-static void checkAndRemoveBubbles();
-static void findNeighboringGroups( IBox *bounds, int groupID, int *neighborGroups );
+static int checkAndRemoveBubbles();
+static int buildGroupGraph();
+static void freeGroupGraph();
+static int findMergedGroup( int groupID );
+static void mergeGroupInto( int groupID, int masterGroupID, int solid, int fillType );
+static int applyGroupMerges();
 
 //static void establishGroupBounds();
 
 static void fillGroups( IBox *bounds, int masterGroupID, int solid, int fillType, int *targetGroupIDs );
+static void fillGroupCell( int boxIndex, int fillType );
 
 static void addBounds( IPoint loc, IBox *bounds );
 static void addBoundsToBounds( IBox inBounds, IBox *bounds );
@@ -571,21 +831,28 @@ static int checkForCorner(int boxIndex, int offx, int offz);
 
 static int fixTouchingEdges();
 static int touchRecordCompare( void *context, const void *str1, const void *str2);
+static TouchCell *findTouchCell( int boxIndex );
+static TouchCell *addTouchCell( int boxIndex );
+static int touchIndexCompare( const void *str1, const void *str2 );
 static void checkForTouchingEdge(int boxIndex, int offx, int offy, int offz);
 static int computeObscurity( int boxIndex );
 static void decrementNeighbors( int boxIndex );
 static float computeHidingDistance( Point loc1, Point loc2, float norm );
 static void boxIndexToLoc( IPoint loc, int boxIndex );
 
-static void deleteFloatingGroups();
+static int deleteFloatingGroups();
 static int determineScaleAndHollowAndMelt();
 static void scaleByCost();
 static void hollowBottomOfModel();
+static void distanceTransformLine( unsigned short *dist, int stride, int n, int cap, int *g, int *s, int *t );
+static int hollowByDistance();
 static void meltSnow();
 static void hollowSeed( int x, int y, int z, IPoint **seedList, int *seedSize, int *seedCount );
 
 static int generateBlockDataAndStatistics();
+static void transformVertices( int startVertex );
 static int faceIdCompare( void *context, const void *str1, const void *str2);
+static int sortFacesByMaterial();
 
 static int getDimensionsAndCount( Point dimensions );
 static void rotateLocation( Point pt );
@@ -599,6 +866,7 @@ static float computeUpperCornerHeight( int type, int boxIndex, int x, int z );
 static float getFluidHeightPercent( int dataVal );
 static int sameFluid( int fluidType, int type );
 static int saveSpecialVertices( int boxIndex, int faceDirection, IPoint loc, float heights[4], int heightIndices[4] );
+static int vertexIndexSlot( int vertexIndex );
 static int saveVertices( int boxIndex, int faceDirection, IPoint loc );
 static int saveFaceLoop( int boxIndex, int faceDirection, float heights[4], int heightIndex[4] );
 static int getMaterialUsingGroup( int groupID );
@@ -617,40 +885,68 @@ static void freeModel( Model *pModel );
 
 static int writeAsciiSTLBox( const wchar_t *world, IBox *box );
 static int writeBinarySTLBox( const wchar_t *world, IBox *box );
+static int writeBinaryPLYBox( const wchar_t *world, IBox *worldBox );
 static int writeOBJBox( const wchar_t *world, IBox *worldBox, const wchar_t *curDir, const wchar_t *terrainFileName );
+static int writeOBJSlab();
+static int streamOBJSlab( int nextPlane );
 static int writeOBJTextureUV( float u, float v, int addComment, int swatchLoc );
+static char *appendOBJFace( char *pOut, int face, int vertexOffset, int uvOffset, int normalIndex );
 static int writeOBJMtlFile();
 
+static int startBufferedOutput();
+static char *bufferedOutputLine();
+static void endBufferedOutputLine( char *pOut );
+static int flushBufferedOutput();
+static int bufferedWrite( const char *str );
+static char *appendString( char *pOut, const char *str );
+static char *appendInt( char *pOut, int value );
+static char *appendFloat( char *pOut, float value, int decimals );
+static int formatInt( char *dst, int value );
+static int formatFloatG( char *dst, float value );
+static int formatFloatFixed( char *dst, float value, int decimals );
+
 static int writeVRML2Box( const wchar_t *world, IBox *box );
 static int writeVRMLAttributeShapeSplit( int type, char *mtlName, char *textureOutputString );
 static int writeVRMLTextureUV( float u, float v, int addComment, int swatchLoc );
 
+static int writeGLTFBox( const wchar_t *world, IBox *worldBox );
+static int writeGLTFMaterial( char *json, int jsonSize, int type, int firstMaterial );
+
 static int writeSchematicBox();
-static int schematicWriteCompoundTag( gzFile gz, char *tag );
-static int schematicWriteShortTag( gzFile gz, char *tag, short value );
-static int schematicWriteEmptyListTag( gzFile gz, char *tag );
-static int schematicWriteString( gzFile gz, char *tag, char *field );
-static int schematicWriteByteArrayTag( gzFile gz, char *tag, unsigned char *byteData, int totalSize );
+static int writeSchematicFile( const wchar_t *fileName, SchematicBuffer *sb, float progressStart, float progressEnd );
+static unsigned char *schematicReserve( SchematicBuffer *sb, size_t size );
+static int schematicWriteCompoundTag( SchematicBuffer *sb, char *tag );
+static int schematicWriteShortTag( SchematicBuffer *sb, char *tag, short value );
+static int schematicWriteIntTag( SchematicBuffer *sb, char *tag, int value );
+static int schematicWriteEmptyListTag( SchematicBuffer *sb, char *tag );
+static int schematicWriteString( SchematicBuffer *sb, char *tag, char *field );
+static int schematicWriteByteArrayTag( SchematicBuffer *sb, char *tag, unsigned char *byteData, int totalSize );
 
-static int schematicWriteTagValue( gzFile gz, unsigned char tagValue, char *tag );
-static int schematicWriteUnsignedCharValue( gzFile gz, unsigned char charValue );
-static int schematicWriteUnsignedShortValue( gzFile gz, unsigned short shortValue );
-static int schematicWriteShortValue( gzFile gz, short shortValue );
-static int schematicWriteIntValue( gzFile gz, int intValue );
-static int schematicWriteStringValue( gzFile gz, char *stringValue );
+static int schematicWriteTagValue( SchematicBuffer *sb, unsigned char tagValue, char *tag );
+static int schematicWriteUnsignedCharValue( SchematicBuffer *sb, unsigned char charValue );
+static int schematicWriteUnsignedShortValue( SchematicBuffer *sb, unsigned short shortValue );
+static int schematicWriteShortValue( SchematicBuffer *sb, short shortValue );
+static int schematicWriteIntValue( SchematicBuffer *sb, int intValue );
+static int schematicWriteStringValue( SchematicBuffer *sb, char *stringValue );
 
 
-static int writeLines( HANDLE file, char **textLines, int lines );
+static int writeLines( OutputFile *file, char **textLines, int lines );
 
-static int writeStatistics( HANDLE fh, const char *justWorldFileName, IBox *worldBox );
+static int writeStatistics( OutputFile *fh, const char *justWorldFileName, IBox *worldBox );
+static int writeTimingReport( int fileType );
 
 static float computeMaterialCost( int printMaterialType, float blockEdgeSize, int numBlocks, int numMinorBlocks );
 static int finalModelChecks();
 
-static void addOutputFilenameToList(wchar_t *filename);
+static void addOutputFilenameToList(const wchar_t *filename);
+static OutputFile *createOutputFile( const wchar_t *filename );
+static int writeOutputFile( OutputFile *pFile, const void *data, size_t size );
+static void closeOutputFile( OutputFile **ppFile );
+static size_t outputMemorySize();
 
 static void spacesToUnderlines( wchar_t *targetString );
 static void spacesToUnderlinesChar( char *targetString );
+static void escapeJSONChar( char *targetString, int size, const char *sourceString );
 
 static int createBaseMaterialTexture();
 
@@ -671,9 +967,12 @@ static void rotatePNGTile(progimage_info *dst, int dcol, int drow, int scol, int
 static void blendTwoSwatches( progimage_info *dst, int txrSwatch, int solidSwatch, float blend, unsigned char alpha );
 static void bleedPNGSwatch(progimage_info *dst, int dstSwatch, int xmin, int xmax, int ymin, int ymax, int swatchSize, int swatchesPerRow, unsigned int alpha );
 static void compositePNGSwatches(progimage_info *dst, int dstSwatch, int overSwatch, int underSwatch, int swatchSize, int swatchesPerRow, int forceSolid );
-static int convertRGBAtoRGBandWrite(progimage_info *src, wchar_t *filename);
+static void convertRGBAtoRGB(progimage_info *src, progimage_info *dst);
+static int writePNGJobs( PNGWriteJob *jobs, int numJobs );
+static DWORD WINAPI writePNGJobQueue( LPVOID pParam );
 static void convertAlphaToGrayscale( progimage_info *dst );
 
+static int hasSuffix( const wchar_t *src, const wchar_t *suffix );
 static void ensureSuffix( wchar_t *dst, const wchar_t *src, const wchar_t *suffix );
 static void removeSuffix( wchar_t *dst, const wchar_t *src, const wchar_t *suffix );
 //static const wchar_t *removePath( const wchar_t *src );
@@ -700,6 +999,13 @@ void ClearCache()
 {
     Cache_Empty();
 }
+
+void ClearVolumeCache()
+{
+    free(gVolumeCache.boxData);
+    free(gVolumeCache.biome);
+    memset(&gVolumeCache,0,sizeof(VolumeCache));
+}
 ////////////////////////////////////////////////////////
 //
 // Main code begins
@@ -721,6 +1027,9 @@ int SaveVolume( wchar_t *saveFileName, int fileType, Options *options, const wch
     IBox worldBox;
     int retCode = MW_NO_ERROR;
     int needDifferentTextures = 0;
+    wchar_t terrainPath[MAX_PATH];
+    unsigned int terrainHash = 0;
+    int terrainRetCode = MW_NO_ERROR;
 
     // set up a bunch of globals
     gpCallback = &callback;
@@ -734,6 +1043,9 @@ int SaveVolume( wchar_t *saveFileName, int fileType, Options *options, const wch
     // clear all of gModel to zeroes
     memset(&gModel,0,sizeof(Model));
     gOptions = options;
+    writepng_setcompression(options->pngCompression);
+    Timing_Reset(options->timingReport != 0);
+    gOptions->timingReportError = MW_NO_ERROR;
     gOptions->totalBlocks = 0;
     gOptions->cost = 0.0f;
 
@@ -742,6 +1054,10 @@ int SaveVolume( wchar_t *saveFileName, int fileType, Options *options, const wch
     gPrint3D = (gOptions->exportFlags & EXPT_3DPRINT) ? 1 : 0;
     gModel.pInputTerrainImage = NULL;
 
+    // only OBJ can be written out while the model is being made
+    gStreamOBJ = ( (gOptions->exportFlags & EXPT_OUTPUT_OBJ_STREAMING) &&
+        ( fileType == FILE_TYPE_WAVEFRONT_REL_OBJ || fileType == FILE_TYPE_WAVEFRONT_ABS_OBJ ) ) ? 1 : 0;
+
     // Billboards and true geometry to be output?
     // True only if we're exporting all geometry.
     // Must be set now, as this influences whether we stretch textures.
@@ -763,6 +1079,7 @@ int SaveVolume( wchar_t *saveFileName, int fileType, Options *options, const wch
     // that are referenced, such as material and texture files. We will
     // use these elements to then build up the output names.
     getPathAndRoot( saveFileName, fileType, gOutputFilePath, gOutputFileRoot );
+    gSpongeSchematic = ( fileType == FILE_TYPE_SCHEMATIC ) && hasSuffix( saveFileName, L".schem" );
     wcscpy_s(gOutputFileRootClean,MAX_PATH,gOutputFileRoot);
     wcharCleanse(gOutputFileRootClean);
     spacesToUnderlines(gOutputFileRootClean);
@@ -795,29 +1112,27 @@ int SaveVolume( wchar_t *saveFileName, int fileType, Options *options, const wch
     {
         gModel.pInputTerrainImage = new progimage_info();
 
-        // note that any failure in readTerrainPNG will cause the "sub-error code" (in the shifted bits MW_NUM_CODES)
-        // to give a value > MW_BEGIN_ERRORS. This is fine, as any read PNG error is a real error.
-        retCode |= readTerrainPNG(curDir,gModel.pInputTerrainImage,terrainFileName);
-        if ( retCode >= MW_BEGIN_ERRORS )
+        // If the cached texture was made from this very terrain file, don't decode it yet, as the
+        // cached texture will likely be used as is. Just set up what reading it would.
+        if ( options->moreExportMemory )
         {
-            // couldn't read terrain image
-            goto Exit;
+            clearAtlasCache();
         }
-
-        // check if height of texture is sufficient.
-        if ( gModel.pInputTerrainImage->height / (gModel.pInputTerrainImage->width/16) < 16 )
+        else
         {
-            // image does not have the minimum 16 rows, something's really wrong
-            retCode |= MW_NEED_16_ROWS;
-            goto Exit;
+            terrainHash = hashTerrainFile( curDir, terrainFileName, terrainPath );
         }
-        if ( gModel.pInputTerrainImage->height / (gModel.pInputTerrainImage->width/16) < VERTICAL_TILES )
+        if ( !findAtlasTerrain( terrainPath, terrainHash, &terrainRetCode ) )
         {
-            // fix image, expanding the image with white. Warn user.
-            int tileSize = gModel.pInputTerrainImage->width/16;
-            // set empty area to all 1's
-            gModel.pInputTerrainImage->image_data.resize(VERTICAL_TILES*tileSize*gModel.pInputTerrainImage->width*4, 0xff);
-            retCode |= MW_NOT_ENOUGH_ROWS;
+            Timing_Start(TIMING_TEXTURE);
+            terrainRetCode = readTerrainImage( curDir, terrainFileName );
+            Timing_Stop(TIMING_TEXTURE);
+        }
+        retCode |= terrainRetCode;
+        if ( retCode >= MW_BEGIN_ERRORS )
+        {
+            // couldn't read terrain image
+            goto Exit;
         }
     }
 
@@ -825,7 +1140,25 @@ int SaveVolume( wchar_t *saveFileName, int fileType, Options *options, const wch
 
     initializeWorldData( &worldBox, xmin, ymin, zmin, xmax, ymax, zmax );
 
-    retCode |= populateBox(world, &worldBox);
+    // Was this volume just read in for the last export? Then use it again. Only done if asked for, as it holds on to the memory.
+    if ( !options->keepVolume || options->moreExportMemory )
+    {
+        ClearVolumeCache();
+        Timing_Start(TIMING_POPULATE_BOX);
+        retCode |= populateBox(world, &worldBox);
+        Timing_Stop(TIMING_POPULATE_BOX);
+    }
+    else if ( !readVolumeCache( world, &worldBox ) )
+    {
+        IBox selection = worldBox;
+        Timing_Start(TIMING_POPULATE_BOX);
+        retCode |= populateBox(world, &worldBox);
+        Timing_Stop(TIMING_POPULATE_BOX);
+        if ( retCode < MW_BEGIN_ERRORS )
+        {
+            writeVolumeCache( world, &selection, &worldBox );
+        }
+    }
     if ( retCode >= MW_BEGIN_ERRORS )
     {
         // nothing in box, so end.
@@ -860,7 +1193,24 @@ int SaveVolume( wchar_t *saveFileName, int fileType, Options *options, const wch
         gModel.textureUVPerTile = (float)gModel.tileSize / (float)gModel.textureResolution; // e.g. 16 / 256
         gModel.swatchListSize = gModel.swatchesPerRow*gModel.swatchesPerRow;
 
-        retCode |= createBaseMaterialTexture();
+        if ( !readAtlasCache( terrainPath, terrainHash ) )
+        {
+            Timing_Start(TIMING_TEXTURE);
+            // the terrain image was not decoded if the cached texture was expected to be used, so decode it now
+            if ( (gOptions->exportFlags & EXPT_OUTPUT_TEXTURE_IMAGES) && gModel.pInputTerrainImage->image_data.empty() )
+            {
+                retCode |= readTerrainImage( curDir, terrainFileName );
+            }
+            if ( retCode < MW_BEGIN_ERRORS )
+            {
+                retCode |= createBaseMaterialTexture();
+                if ( retCode < MW_BEGIN_ERRORS )
+                {
+                    writeAtlasCache( terrainPath, terrainHash, terrainRetCode );
+                }
+            }
+            Timing_Stop(TIMING_TEXTURE);
+        }
     }
 
     // all done with base input texture, free up its memory.
@@ -887,7 +1237,9 @@ int SaveVolume( wchar_t *saveFileName, int fileType, Options *options, const wch
 
     UPDATE_PROGRESS(0.60f*PG_MAKE_FACES);
 
+    Timing_Start(TIMING_FILTER_BOX);
     retCode |= filterBox();
+    Timing_Stop(TIMING_FILTER_BOX);
     // always return the worst error
     if ( retCode >= MW_BEGIN_ERRORS )
     {
@@ -901,11 +1253,15 @@ int SaveVolume( wchar_t *saveFileName, int fileType, Options *options, const wch
     // non-polygonal output format, like schematic. If so, do that and be done.
     if ( fileType == FILE_TYPE_SCHEMATIC )
     {
+        Timing_Start(TIMING_WRITE);
         retCode |= writeSchematicBox();
+        Timing_Stop(TIMING_WRITE);
         goto Exit;
     }
 
+    Timing_Start(TIMING_GROUPS);
     retCode |= determineScaleAndHollowAndMelt();
+    Timing_Stop(TIMING_GROUPS);
     if ( retCode >= MW_BEGIN_ERRORS )
     {
         // problem found
@@ -917,12 +1273,19 @@ int SaveVolume( wchar_t *saveFileName, int fileType, Options *options, const wch
     // a given ID are removed from the final model before output. This gives the user a way to connect
     // hollowed areas with interiors and let the building material out of "escape holes".
 
-    // create database and compute statistics for output
-    retCode |= generateBlockDataAndStatistics();
-    if ( retCode >= MW_BEGIN_ERRORS ) return retCode;
+    // create database and compute statistics for output.
+    // When streaming, writeOBJBox does this, writing out each slab as it is done.
+    if ( !gStreamOBJ )
+    {
+        Timing_Start(TIMING_FACES);
+        retCode |= generateBlockDataAndStatistics();
+        Timing_Stop(TIMING_FACES);
+        if ( retCode >= MW_BEGIN_ERRORS ) return retCode;
+    }
 
     UPDATE_PROGRESS(PG_OUTPUT);
 
+    Timing_Start(TIMING_WRITE);
     switch ( fileType )
     {
     case FILE_TYPE_WAVEFRONT_REL_OBJ:
@@ -938,9 +1301,16 @@ int SaveVolume( wchar_t *saveFileName, int fileType, Options *options, const wch
     case FILE_TYPE_ASCII_STL:
         retCode |= writeAsciiSTLBox( world, &worldBox );
         break;
+    case FILE_TYPE_BINARY_PLY:
+        retCode |= writeBinaryPLYBox( world, &worldBox );
+        break;
     case FILE_TYPE_VRML2:
         retCode |= writeVRML2Box( world, &worldBox );
         break;
+    case FILE_TYPE_GLTF:
+        // the single RGBA texture, as for VRML, is referenced by the .glb file
+        retCode |= writeGLTFBox( world, &worldBox );
+        break;
     //case FILE_TYPE_SETTINGS:
         //retCode |= writeSettings( world, &worldBox );
         //break;
@@ -948,6 +1318,7 @@ int SaveVolume( wchar_t *saveFileName, int fileType, Options *options, const wch
         assert(0);
         break;
     }
+    Timing_Stop(TIMING_WRITE);
 
     if ( retCode >= MW_BEGIN_ERRORS )
     {
@@ -1058,8 +1429,6 @@ Exit:
                 { SWATCH_INDEX( 15, 1 ), BLOCK_AIR }, // fire over air (black)
             };
 
-            int rc;
-
             // do only if true textures used
             if ( gOptions->exportFlags & EXPT_OUTPUT_TEXTURE_IMAGES )
             {
@@ -1146,6 +1515,10 @@ Exit:
                 wchar_t textureRGB[MAX_PATH];
                 wchar_t textureRGBA[MAX_PATH];
                 wchar_t textureAlpha[MAX_PATH];
+                progimage_info rgbTexture;
+                progimage_info *alphaTexture = NULL;
+                PNGWriteJob jobs[MAX_PNG_WRITE_JOBS];
+                int numJobs = 0;
 
                 // Write them out! We need three texture file names: -RGB, -RGBA, -Alpha.
                 // The RGB/RGBA split is needed for fast previewers like G3D to gain additional speed
@@ -1154,49 +1527,78 @@ Exit:
                 concatFileName4(textureRGBA, gOutputFilePath, gOutputFileRootClean, PNG_RGBA_SUFFIX, L".png");
                 concatFileName4(textureAlpha, gOutputFilePath, gOutputFileRootClean, PNG_ALPHA_SUFFIX, L".png");
 
+                // Make each image first, then compress them all at the same time, as compressing is what takes a while.
                 if ( gModel.usesRGBA )
                 {
                     // output RGBA version
-                    rc = writepng(gModel.pPNGtexture,4,textureRGBA);
-                    addOutputFilenameToList(textureRGBA);
-                    assert(rc == 0);
-                    retCode |= rc ? (MW_CANNOT_CREATE_PNG_FILE | (rc<<MW_NUM_CODES)) : MW_NO_ERROR;
+                    jobs[numJobs].image = gModel.pPNGtexture;
+                    jobs[numJobs].channels = 4;
+                    jobs[numJobs].filename = textureRGBA;
+                    numJobs++;
                 }
 
                 if ( gModel.usesRGB )
                 {
                     // output RGB version
-                    rc = convertRGBAtoRGBandWrite(gModel.pPNGtexture,textureRGB);
-                    assert(rc == 0);
-                    retCode |= rc ? (MW_CANNOT_CREATE_PNG_FILE | (rc<<MW_NUM_CODES)) : MW_NO_ERROR;
+                    convertRGBAtoRGB(gModel.pPNGtexture,&rgbTexture);
+                    jobs[numJobs].image = &rgbTexture;
+                    jobs[numJobs].channels = 3;
+                    jobs[numJobs].filename = textureRGB;
+                    numJobs++;
                 }
 
                 if ( gModel.usesAlpha )
                 {
-                    // output Alpha version, which is actually RGBA, to make 3DS MAX happy
-                    convertAlphaToGrayscale( gModel.pPNGtexture );
-                    rc = writepng(gModel.pPNGtexture,4,textureAlpha);
-                    addOutputFilenameToList(textureAlpha);
-                    assert(rc == 0);
-                    retCode |= rc ? (MW_CANNOT_CREATE_PNG_FILE | (rc<<MW_NUM_CODES)) : MW_NO_ERROR;
+                    // output Alpha version, which is actually RGBA, to make 3DS MAX happy.
+                    // Done in place if nothing else needs the texture, else on a copy.
+                    if ( gModel.usesRGBA )
+                    {
+                        alphaTexture = new progimage_info( *gModel.pPNGtexture );
+                    }
+                    else
+                    {
+                        alphaTexture = gModel.pPNGtexture;
+                    }
+                    convertAlphaToGrayscale( alphaTexture );
+                    jobs[numJobs].image = alphaTexture;
+                    jobs[numJobs].channels = 4;
+                    jobs[numJobs].filename = textureAlpha;
+                    numJobs++;
+                }
+
+                Timing_Start(TIMING_PNG_ENCODE);
+                retCode |= writePNGJobs( jobs, numJobs );
+                Timing_Stop(TIMING_PNG_ENCODE);
+
+                writepng_cleanup(&rgbTexture);
+                if ( alphaTexture != NULL && alphaTexture != gModel.pPNGtexture )
+                {
+                    delete alphaTexture;
                 }
             }
             else
             {
-                // just the one (VRML). If we're printing, and not debugging (debugging needs transparency), we can convert this one down to RGB
+                // just the one (VRML, glTF). If we're printing, and not debugging (debugging needs transparency), we can convert this one down to RGB
                 wchar_t textureFileName[MAX_PATH];
+                progimage_info rgbTexture;
+                PNGWriteJob job;
                 concatFileName3(textureFileName,gOutputFilePath,gOutputFileRootClean,L".png");
                 if ( gPrint3D && !(gOptions->exportFlags & EXPT_DEBUG_SHOW_GROUPS) )
                 {
-                    rc = convertRGBAtoRGBandWrite(gModel.pPNGtexture,textureFileName);
+                    convertRGBAtoRGB(gModel.pPNGtexture,&rgbTexture);
+                    job.image = &rgbTexture;
+                    job.channels = 3;
                 }
                 else
                 {
-                    rc = writepng(gModel.pPNGtexture,4,textureFileName);
-                    addOutputFilenameToList(textureFileName);
+                    job.image = gModel.pPNGtexture;
+                    job.channels = 4;
                 }
-                assert(rc == 0);
-                retCode |= rc ? (MW_CANNOT_CREATE_PNG_FILE | (rc<<MW_NUM_CODES)) : MW_NO_ERROR;
+                job.filename = textureFileName;
+                Timing_Start(TIMING_PNG_ENCODE);
+                retCode |= writePNGJobs( &job, 1 );
+                Timing_Stop(TIMING_PNG_ENCODE);
+                writepng_cleanup(&rgbTexture);
             }
 
             writepng_cleanup(gModel.pPNGtexture);
@@ -1205,6 +1607,12 @@ Exit:
 
     UPDATE_PROGRESS(PG_CLEANUP);
 
+    if ( gOptions->timingReport & TIMING_REPORT_JSON )
+    {
+        // the export is as good without it, so this doesn't go into retCode
+        gOptions->timingReportError = writeTimingReport( fileType );
+    }
+
     freeModel( &gModel );
 
     if ( gBoxData )
@@ -1215,6 +1623,10 @@ Exit:
         free(gBiome);
     gBiome = NULL;
 
+    if ( gOutputBuffer )
+        free(gOutputBuffer);
+    gOutputBuffer = NULL;
+
 
     // 90%
     UPDATE_PROGRESS(PG_END);
@@ -1270,6 +1682,7 @@ static void initializeWorldData( IBox *worldBox, int xmin, int ymin, int zmin, i
 static int initializeModelData()
 {
     int i, x,y,z, boxIndex, faceDirection;
+    int slabFaces;
 
     // allocate vertex index array for box (we can ignore all the outer edge
     // box cells, which is why this array is one smaller).
@@ -1286,7 +1699,13 @@ static int initializeModelData()
     }
     // There is an index location for each grid cell. It gets filled in as vertices are found to exist.
     // Each location is set with the vertex index in the list of vertices output. Not memory efficient...
-    gModel.vertexIndices = (int*)malloc(gBoxSizeXYZ*sizeof(int));   // this one never needs realloc
+    // When streaming, only the corner planes of one slab are needed, and these are reused as a ring.
+    gModel.vertexIndexPlanes = gBoxSize[X];
+    if ( gStreamOBJ )
+    {
+        gModel.vertexIndexPlanes = min( STREAM_SLAB_ROWS+1, gBoxSize[X] );
+    }
+    gModel.vertexIndices = (int*)malloc(gModel.vertexIndexPlanes*gBoxSizeYZ*sizeof(int));   // this one never needs realloc
     // These may be reallocated as we go.
     gModel.vertexListSize = startNumVerts;
     gModel.vertices = (Point*)malloc(startNumVerts*sizeof(Point));
@@ -1295,19 +1714,17 @@ static int initializeModelData()
         return MW_WORLD_EXPORT_TOO_LARGE;
     }
 
-    gModel.faceRecordPool = (FaceRecordPool *)malloc(sizeof(FaceRecordPool));
-    gModel.faceRecordPool->count = 0;
-    gModel.faceRecordPool->pPrev = NULL;
-
     VecScalar( gModel.billboardBounds.min, =,  999999);
     VecScalar( gModel.billboardBounds.max, =, -999999);
 
     // NO_INDEX_SET means vertex is not used
-    for ( i = 0; i < gBoxSizeXYZ; i++ )
+    for ( i = 0; i < gModel.vertexIndexPlanes*gBoxSizeYZ; i++ )
         gModel.vertexIndices[i] = NO_INDEX_SET;
 
     // count about how many faces we'll need to store and sort for output; this code will probably have to change
     // as we get more involved faces (welds, etc.)
+    // When streaming, only the largest slab's worth of faces is needed.
+    slabFaces = 0;
     for ( x = gSolidBox.min[X]; x <= gSolidBox.max[X]; x++ )
     {
         for ( z = gSolidBox.min[Z]; z <= gSolidBox.max[Z]; z++ )
@@ -1320,21 +1737,29 @@ static int initializeModelData()
                     if ( gBoxData[boxIndex].type > BLOCK_AIR ) 
                     {
                         if ( gBoxData[boxIndex + gFaceOffset[faceDirection]].type <= BLOCK_AIR )
-                            gModel.faceSize++;
+                            slabFaces++;
                     }
                 }
             }
         }
+        if ( gStreamOBJ && ( (x - gSolidBox.min[X] + 1) % STREAM_SLAB_ROWS == 0 ) )
+        {
+            gModel.faceSize = max( gModel.faceSize, slabFaces );
+            slabFaces = 0;
+        }
     }
+    gModel.faceSize = max( gModel.faceSize, slabFaces );
     // increase the face list size
     // - it can sometimes get even higher, with foliage + billboards
-    gModel.faceSize = (int)(gModel.faceSize*1.4 + 1);
-    gModel.faceList = (FaceRecord**)malloc(gModel.faceSize*sizeof(FaceRecord*));
+    if ( allocFaceStore( (int)(gModel.faceSize*1.4 + 1) ) != MW_NO_ERROR )
+    {
+        return MW_WORLD_EXPORT_TOO_LARGE;
+    }
 
     memset(gModel.uvSwatches,0,NUM_MAX_SWATCHES*sizeof(UVList));
     gModel.uvIndexListSize = 200;	// 50 blocks' worth of UVs, often enough
     gModel.uvIndexList = (UVOutput*)malloc(gModel.uvIndexListSize*sizeof(UVOutput));
-    if ( (gModel.faceList == NULL ) || ( gModel.uvIndexList == NULL ) )
+    if ( gModel.uvIndexList == NULL )
     {
         return MW_WORLD_EXPORT_TOO_LARGE;
     }
@@ -1358,7 +1783,7 @@ static int readTerrainPNG( const wchar_t *curDir, progimage_info *pII, wchar_t *
     }
     else
     {
-        concatFileName2(defaultTerrainFileName,curDir,L"\\terrainExt.png");
+        concatFileName2(defaultTerrainFileName,curDir,PORTA_SLASH L"terrainExt.png");
         rc = readpng(pII,defaultTerrainFileName);
         if ( rc )
             return (MW_CANNOT_READ_DEFAULT_TERRAIN_FILE|(rc<<MW_NUM_CODES));
@@ -1393,6 +1818,224 @@ static int readTerrainPNG( const wchar_t *curDir, progimage_info *pII, wchar_t *
     return MW_NO_ERROR;
 }
 
+// read the terrain image into gModel.pInputTerrainImage and check it, expanding it if it doesn't have enough rows
+static int readTerrainImage( const wchar_t *curDir, wchar_t *terrainFileName )
+{
+    // note that any failure in readTerrainPNG will cause the "sub-error code" (in the shifted bits MW_NUM_CODES)
+    // to give a value > MW_BEGIN_ERRORS. This is fine, as any read PNG error is a real error.
+    int retCode = readTerrainPNG(curDir,gModel.pInputTerrainImage,terrainFileName);
+    if ( retCode >= MW_BEGIN_ERRORS )
+    {
+        // couldn't read terrain image
+        return retCode;
+    }
+
+    // check if height of texture is sufficient.
+    if ( gModel.pInputTerrainImage->height / (gModel.pInputTerrainImage->width/16) < 16 )
+    {
+        // image does not have the minimum 16 rows, something's really wrong
+        return retCode|MW_NEED_16_ROWS;
+    }
+    if ( gModel.pInputTerrainImage->height / (gModel.pInputTerrainImage->width/16) < VERTICAL_TILES )
+    {
+        // fix image, expanding the image with white. Warn user.
+        int tileSize = gModel.pInputTerrainImage->width/16;
+        // set empty area to all 1's
+        gModel.pInputTerrainImage->image_data.resize(VERTICAL_TILES*tileSize*gModel.pInputTerrainImage->width*4, 0xff);
+        retCode |= MW_NOT_ENOUGH_ROWS;
+    }
+    return retCode;
+}
+
+// Return an FNV-1a hash of the terrain file that readTerrainPNG would read, and its name in terrainPath.
+// Returns 0 if the file can't be read.
+static unsigned int hashTerrainFile( const wchar_t *curDir, wchar_t *terrainFileName, wchar_t *terrainPath )
+{
+    std::vector<unsigned char> buffer;
+    unsigned int hash = 2166136261u;
+    size_t i;
+
+    if ( wcslen(terrainFileName) > 0 )
+    {
+        wcscpy_s(terrainPath,MAX_PATH,terrainFileName);
+    }
+    else
+    {
+        concatFileName2(terrainPath,curDir,PORTA_SLASH L"terrainExt.png");
+    }
+
+    lodepng::load_file(buffer, terrainPath);
+    if ( buffer.empty() )
+        return 0;
+
+    for ( i = 0; i < buffer.size(); i++ )
+    {
+        hash = (hash ^ buffer[i]) * 16777619u;
+    }
+    // 0 means "no hash"
+    return ( hash == 0 ) ? 1 : hash;
+}
+
+static void makeAtlasKey( AtlasKey *pKey, const wchar_t *terrainPath, unsigned int terrainHash )
+{
+    unsigned int hash = 2166136261u;
+    int i;
+
+    // cleared, so that keys can be compared with memcmp
+    memset(pKey,0,sizeof(AtlasKey));
+    wcscpy_s(pKey->terrainFileName,MAX_PATH,terrainPath);
+    pKey->terrainHash = terrainHash;
+
+    for ( i = 0; i < NUM_BLOCKS; i++ )
+    {
+        hash = (hash ^ gBlockDefinitions[i].color) * 16777619u;
+        hash = (hash ^ (unsigned int)(gBlockDefinitions[i].alpha*65535.0f)) * 16777619u;
+    }
+    pKey->colorHash = hash;
+
+    pKey->exportFlags = gOptions->exportFlags & (EXPT_OUTPUT_TEXTURE_SWATCHES|EXPT_OUTPUT_TEXTURE_IMAGES|EXPT_DEBUG_SHOW_GROUPS|EXPT_3DPRINT|EXPT_BIOME);
+    pKey->fileType = gOptions->pEFD->fileType;
+    pKey->solidTexture = gOptions->pEFD->radioExportSolidTexture[gOptions->pEFD->fileType];
+    pKey->noMaterials = gOptions->pEFD->radioExportNoMaterials[gOptions->pEFD->fileType];
+    pKey->exportAll = gOptions->pEFD->chkExportAll;
+    pKey->g3dMaterial = gOptions->pEFD->chkG3DMaterial;
+    // same biome as createBaseMaterialTexture uses
+    pKey->biome = ( gOptions->exportFlags & EXPT_BIOME ) ? gBiome[(int)(gBoxSize[X]/2)*gBoxSize[Z] + gBoxSize[Z]/2] : -1;
+    pKey->textureResolution = gModel.textureResolution;
+}
+
+// If the cached base texture was made from this very terrain file, set up what reading the file would, and
+// return 1. Else return 0.
+static int findAtlasTerrain( const wchar_t *terrainPath, unsigned int terrainHash, int *pInputRetCode )
+{
+    int found = 0;
+
+    if ( terrainHash == 0 )
+    {
+        return 0;
+    }
+    PortaLockShared(&gAtlasLock);
+    if ( gAtlasCache.pTexture != NULL &&
+        gAtlasCache.key.terrainHash == terrainHash && wcscmp( gAtlasCache.key.terrainFileName, terrainPath ) == 0 )
+    {
+        gModel.pInputTerrainImage->width = gAtlasCache.inputWidth;
+        gModel.pInputTerrainImage->height = gAtlasCache.inputHeight;
+        gModel.tileSize = gAtlasCache.tileSize;
+        gModel.verticalTiles = gAtlasCache.verticalTiles;
+        *pInputRetCode = gAtlasCache.inputRetCode;
+        found = 1;
+    }
+    PortaUnlockShared(&gAtlasLock);
+    return found;
+}
+
+// If the cached base texture matches what createBaseMaterialTexture would make, use it and return 1. Else return 0.
+// Only textures made from terrain images are cached, as those are the ones that take a while. Another export may
+// have replaced the texture since findAtlasTerrain found it, in which case the terrain file is decoded after all.
+static int readAtlasCache( const wchar_t *terrainPath, unsigned int terrainHash )
+{
+    AtlasKey key;
+    int i;
+
+    if ( terrainHash == 0 ||
+        (gOptions->exportFlags & (EXPT_OUTPUT_TEXTURE_IMAGES|EXPT_OUTPUT_TEXTURE_SWATCHES)) != EXPT_OUTPUT_TEXTURE_IMAGES )
+    {
+        return 0;
+    }
+    makeAtlasKey( &key, terrainPath, terrainHash );
+
+    PortaLockShared(&gAtlasLock);
+    if ( gAtlasCache.pTexture == NULL || memcmp( &key, &gAtlasCache.key, sizeof(AtlasKey) ) != 0 )
+    {
+        PortaUnlockShared(&gAtlasLock);
+        return 0;
+    }
+
+    gModel.pPNGtexture = new progimage_info( *gAtlasCache.pTexture );
+    gModel.swatchCount = gAtlasCache.swatchCount;
+    for ( i = 0; i < gAtlasCache.compositeCount; i++ )
+    {
+        SwatchComposite *pSwatch = (SwatchComposite *)malloc(sizeof(SwatchComposite));
+        *pSwatch = gAtlasCache.composites[i];
+        pSwatch->next = NULL;
+        if ( gModel.swatchCompositeListEnd != NULL )
+        {
+            gModel.swatchCompositeListEnd->next = pSwatch;
+            gModel.swatchCompositeListEnd = pSwatch;
+        }
+        else
+        {
+            gModel.swatchCompositeList = gModel.swatchCompositeListEnd = pSwatch;
+        }
+    }
+    PortaUnlockShared(&gAtlasLock);
+    return 1;
+}
+
+// save a copy of the base texture createBaseMaterialTexture just made, replacing whatever was cached
+static void writeAtlasCache( const wchar_t *terrainPath, unsigned int terrainHash, int inputRetCode )
+{
+    AtlasCache newCache;
+    SwatchComposite *pSwatch;
+    int i;
+
+    memset(&newCache,0,sizeof(AtlasCache));
+    if ( terrainHash == 0 ||
+        (gOptions->exportFlags & (EXPT_OUTPUT_TEXTURE_IMAGES|EXPT_OUTPUT_TEXTURE_SWATCHES)) != EXPT_OUTPUT_TEXTURE_IMAGES )
+    {
+        replaceAtlasCache( &newCache );
+        return;
+    }
+
+    // the copy is made before taking the lock, so exports copying from the old one aren't held up
+    for ( pSwatch = gModel.swatchCompositeList; pSwatch != NULL; pSwatch = pSwatch->next )
+    {
+        newCache.compositeCount++;
+    }
+    newCache.composites = (SwatchComposite *)malloc((newCache.compositeCount+1)*sizeof(SwatchComposite));
+    if ( newCache.composites == NULL )
+    {
+        replaceAtlasCache( &newCache );
+        return;
+    }
+    for ( i = 0, pSwatch = gModel.swatchCompositeList; pSwatch != NULL; i++, pSwatch = pSwatch->next )
+    {
+        newCache.composites[i] = *pSwatch;
+    }
+
+    makeAtlasKey( &newCache.key, terrainPath, terrainHash );
+    newCache.inputWidth = gModel.pInputTerrainImage->width;
+    newCache.inputHeight = gModel.pInputTerrainImage->height;
+    newCache.inputRetCode = inputRetCode;
+    newCache.tileSize = gModel.tileSize;
+    newCache.verticalTiles = gModel.verticalTiles;
+    newCache.swatchCount = gModel.swatchCount;
+    newCache.pTexture = new progimage_info( *gModel.pPNGtexture );
+    replaceAtlasCache( &newCache );
+}
+
+// swap in the new cached texture, then free the old one, which no export can be copying from any more
+static void replaceAtlasCache( AtlasCache *pNewCache )
+{
+    AtlasCache oldCache;
+
+    PortaLockExclusive(&gAtlasLock);
+    oldCache = gAtlasCache;
+    gAtlasCache = *pNewCache;
+    PortaUnlockExclusive(&gAtlasLock);
+
+    delete oldCache.pTexture;
+    free(oldCache.composites);
+}
+
+static void clearAtlasCache()
+{
+    AtlasCache emptyCache;
+
+    memset(&emptyCache,0,sizeof(AtlasCache));
+    replaceAtlasCache( &emptyCache );
+}
+
 static int populateBox(const wchar_t *world, IBox *worldBox)
 {
     int startxblock, startzblock;
@@ -1492,6 +2135,14 @@ static int populateBox(const wchar_t *world, IBox *worldBox)
         ClearCache();
     }
 
+    setSolidBoxes();
+
+    return MW_NO_ERROR;
+}
+
+// set the box coordinates of the solid blocks and the air around them, from gSolidWorldBox
+static void setSolidBoxes()
+{
     // convert to solid relative box (0 through boxSize-1)
     Vec3Op( gSolidBox.min, =, gSolidWorldBox.min, +, gWorld2BoxOffset );
     Vec3Op( gSolidBox.max, =, gSolidWorldBox.max, +, gWorld2BoxOffset );
@@ -1500,48 +2151,191 @@ static int populateBox(const wchar_t *world, IBox *worldBox)
     Vec2Op( gAirBox.min, =, -1 + gSolidBox.min );
     Vec2Op( gAirBox.max, =,  1 + gSolidBox.max );
     assert( (gAirBox.min[Y] >= 0) && (gAirBox.max[Y] < gBoxSize[Y]) );
+}
 
-    return MW_NO_ERROR;
+// If the volume cache holds this selection of this world, read with the same options, set up the box
+// data from it, as populateBox would, and return 1. Else return 0.
+static int readVolumeCache( const wchar_t *world, IBox *worldBox )
+{
+    int useBiomes = ( gOptions->exportFlags & EXPT_BIOME ) ? 1 : 0;
+
+    if ( gVolumeCache.boxData == NULL ||
+        wcscmp( gVolumeCache.world, world ) != 0 ||
+        gVolumeCache.worldType != ( gOptions->worldType & (HELL|ENDER) ) ||
+        gVolumeCache.useBiomes != useBiomes ||
+        gVolumeCache.notSchematic != ( gOptions->pEFD->fileType != FILE_TYPE_SCHEMATIC ) ||
+        memcmp( &gVolumeCache.selection, worldBox, sizeof(IBox) ) != 0 )
+    {
+        return 0;
+    }
+
+    initializeWorldData( worldBox, gVolumeCache.worldBox.min[X], gVolumeCache.worldBox.min[Y], gVolumeCache.worldBox.min[Z],
+        gVolumeCache.worldBox.max[X], gVolumeCache.worldBox.max[Y], gVolumeCache.worldBox.max[Z] );
+
+    gBoxData = (BoxCell*)malloc(gBoxSizeXYZ*sizeof(BoxCell));
+    if ( gBoxData == NULL )
+    {
+        // let populateBox try, from the original selection
+        initializeWorldData( worldBox, gVolumeCache.selection.min[X], gVolumeCache.selection.min[Y], gVolumeCache.selection.min[Z],
+            gVolumeCache.selection.max[X], gVolumeCache.selection.max[Y], gVolumeCache.selection.max[Z] );
+        return 0;
+    }
+    memcpy(gBoxData,gVolumeCache.boxData,gBoxSizeXYZ*sizeof(BoxCell));
+
+    if ( useBiomes )
+    {
+        gBiome = (unsigned char *)malloc(gBoxSize[X] * gBoxSize[Z] * sizeof(unsigned char));
+        if ( gBiome == NULL )
+        {
+            free(gBoxData);
+            gBoxData = NULL;
+            initializeWorldData( worldBox, gVolumeCache.selection.min[X], gVolumeCache.selection.min[Y], gVolumeCache.selection.min[Z],
+                gVolumeCache.selection.max[X], gVolumeCache.selection.max[Y], gVolumeCache.selection.max[Z] );
+            return 0;
+        }
+        memcpy(gBiome,gVolumeCache.biome,gBoxSize[X] * gBoxSize[Z] * sizeof(unsigned char));
+    }
+
+    gSolidWorldBox = gVolumeCache.solidWorldBox;
+    gBadBlocksInModel = gVolumeCache.badBlocks;
+    setSolidBoxes();
+
+    return 1;
 }
 
-#ifndef OLD_BUILD
-// test relevant part of a given chunk to find its size
-static void findChunkBounds(const wchar_t *world, int bx, int bz, IBox *worldBox )
+// save a copy of the box data populateBox just read in, replacing whatever was cached.
+static void writeVolumeCache( const wchar_t *world, IBox *selection, IBox *worldBox )
 {
-    int chunkX, chunkZ;
+    ClearVolumeCache();
 
-    int loopXmin, loopZmin;
-    int loopXmax, loopZmax;
-    int x,y,z;
+    if ( wcslen(world) >= MAX_PATH )
+        return;
 
-    int chunkIndex, boxIndex;
-    int blockID;
+    gVolumeCache.boxData = (BoxCell*)malloc(gBoxSizeXYZ*sizeof(BoxCell));
+    if ( gVolumeCache.boxData == NULL )
+        return;
+    memcpy(gVolumeCache.boxData,gBoxData,gBoxSizeXYZ*sizeof(BoxCell));
 
-    //unsigned char dataVal;
+    gVolumeCache.useBiomes = ( gOptions->exportFlags & EXPT_BIOME ) ? 1 : 0;
+    if ( gVolumeCache.useBiomes )
+    {
+        gVolumeCache.biome = (unsigned char *)malloc(gBoxSize[X] * gBoxSize[Z] * sizeof(unsigned char));
+        if ( gVolumeCache.biome == NULL )
+        {
+            ClearVolumeCache();
+            return;
+        }
+        memcpy(gVolumeCache.biome,gBiome,gBoxSize[X] * gBoxSize[Z] * sizeof(unsigned char));
+    }
+
+    wcscpy_s(gVolumeCache.world,MAX_PATH,world);
+    gVolumeCache.worldType = gOptions->worldType & (HELL|ENDER);
+    gVolumeCache.notSchematic = ( gOptions->pEFD->fileType != FILE_TYPE_SCHEMATIC );
+    gVolumeCache.selection = *selection;
+    gVolumeCache.worldBox = *worldBox;
+    gVolumeCache.solidWorldBox = gSolidWorldBox;
+    gVolumeCache.badBlocks = gBadBlocksInModel;
+}
 
+// Get chunk bx,bz from the chunk cache, reading it in if it's not there. Exports on other threads
+// share the cache, and adding a chunk can push out another, so the cache stays locked until
+// releaseChunk. Reading the chunk from disk is done without the lock, and adding it with the lock
+// exclusive; the lock is then taken shared again and the chunk found anew before it's copied, so
+// other exports can keep reading chunks meanwhile. Only if the chunk was pushed out in that gap,
+// by other exports adding many chunks to a small cache, is it read again and held exclusive.
+static WorldBlock *acquireChunk(const wchar_t *world, int bx, int bz, int *pExclusive )
+{
     WorldBlock *block;
+    int tries;
+
+    Cache_Lock_Shared();
     block=(WorldBlock *)Cache_Find(bx,bz);
+    if (block!=NULL)
+    {
+        Timing_Count(TIMING_CACHE_HITS,1);
+        *pExclusive = 0;
+        return block;
+    }
+    Cache_Unlock_Shared();
 
-    if (block==NULL)
+    wchar_t directory[256];
+    wcsncpy_s(directory,256,world,255);
+    wcscat_s(directory,256,L"/");
+    if (gOptions->worldType&HELL)
     {
-        wchar_t directory[256];
-        wcsncpy_s(directory,256,world,255);
-        wcscat_s(directory,256,L"/");
-        if (gOptions->worldType&HELL)
+        wcscat_s(directory,256,L"DIM-1/");
+    }
+    if (gOptions->worldType&ENDER)
+    {
+        wcscat_s(directory,256,L"DIM1/");
+    }
+
+    for ( tries = 0; ; tries++ )
+    {
+        Timing_Start(TIMING_CHUNK_LOAD);
+        block=LoadBlock(directory,bx,bz);
+        Timing_Stop(TIMING_CHUNK_LOAD);
+        if (block==NULL) //blank tile, nothing to do
+            return NULL;
+        Timing_Count(TIMING_CHUNKS_LOADED,1);
+
+        Cache_Lock_Exclusive();
+        // another export may have read in the same chunk in the meantime
+        WorldBlock *cachedBlock=(WorldBlock *)Cache_Find(bx,bz);
+        if (cachedBlock!=NULL)
         {
-            wcscat_s(directory,256,L"DIM-1/");
+            block_free(block);
+            block=cachedBlock;
         }
-        if (gOptions->worldType&ENDER)
+        else
         {
-            wcscat_s(directory,256,L"DIM1/");
+            Cache_Add(bx,bz,block);
         }
+        if ( tries > 0 )
+        {
+            *pExclusive = 1;
+            return block;
+        }
+        Cache_Unlock_Exclusive();
 
-        block=LoadBlock(directory,bx,bz);
-        if (block==NULL) //blank tile, nothing to do
-            return;
-
-        Cache_Add(bx,bz,block);
+        Cache_Lock_Shared();
+        block=(WorldBlock *)Cache_Find(bx,bz);
+        if (block!=NULL)
+        {
+            *pExclusive = 0;
+            return block;
+        }
+        Cache_Unlock_Shared();
     }
+}
+
+static void releaseChunk( int exclusive )
+{
+    if ( exclusive )
+        Cache_Unlock_Exclusive();
+    else
+        Cache_Unlock_Shared();
+}
+
+#ifndef OLD_BUILD
+// test relevant part of a given chunk to find its size
+static void findChunkBounds(const wchar_t *world, int bx, int bz, IBox *worldBox )
+{
+    int chunkX, chunkZ;
+
+    int loopXmin, loopZmin;
+    int loopXmax, loopZmax;
+    int x,y,z;
+
+    int chunkIndex, boxIndex;
+    int blockID;
+
+    //unsigned char dataVal;
+
+    int exclusive;
+    WorldBlock *block=acquireChunk(world,bx,bz,&exclusive);
+    if (block==NULL) //blank tile, nothing to do
+        return;
 
     // loop through area of box that overlaps with this chunk
     chunkX = bx * 16;
@@ -1575,6 +2369,7 @@ static void findChunkBounds(const wchar_t *world, int bx, int bz, IBox *worldBox
             }
         }
     }
+    releaseChunk(exclusive);
 }
 #endif
 
@@ -1595,29 +2390,10 @@ static void extractChunk(const wchar_t *world, int bx, int bz, IBox *worldBox )
     //IPoint loc;
     //unsigned char dataVal;
 
-    WorldBlock *block;
-    block=(WorldBlock *)Cache_Find(bx,bz);
-
-    if (block==NULL)
-    {
-        wchar_t directory[256];
-        wcsncpy_s(directory,256,world,255);
-        wcscat_s(directory,256,L"/");
-        if (gOptions->worldType&HELL)
-        {
-            wcscat_s(directory,256,L"DIM-1/");
-        }
-        if (gOptions->worldType&ENDER)
-        {
-            wcscat_s(directory,256,L"DIM1/");
-        }
-
-        block=LoadBlock(directory,bx,bz);
-        if (block==NULL) //blank tile, nothing to do
-            return;
-
-        Cache_Add(bx,bz,block);
-    }
+    int exclusive;
+    WorldBlock *block=acquireChunk(world,bx,bz,&exclusive);
+    if (block==NULL) //blank tile, nothing to do
+        return;
 
     // loop through area of box that overlaps with this chunk
     chunkX = bx * 16;
@@ -1696,13 +2472,14 @@ static void extractChunk(const wchar_t *world, int bx, int bz, IBox *worldBox )
             }
         }
     }
+    releaseChunk(exclusive);
 }
 
 // remove snow blocks and anything else not desired
 static int filterBox()
 {
     int boxIndex;
-    int x,y,z;
+    int i,j;
     // Push flattop onto block below
     int flatten = gOptions->pEFD->chkMergeFlattop;
 
@@ -1710,32 +2487,13 @@ static int filterBox()
     int foundBlock = 0;
 
     int outputFlags, retVal;
+    int specialFlags;
+    unsigned char keepType[256];
+    unsigned char specialType[256];
+    FilterSlabJob jobs[MAX_FILTER_THREADS];
+    FilterSlabQueue queue;
+    int numJobs, slabCount;
 
-    // Filter out all stuff that is not to be rendered. Done before anything, as these blocks simply
-    // should not exist for all operations beyond.
-    for ( x = gSolidBox.min[X]; x <= gSolidBox.max[X]; x++ )
-    {
-        for ( z = gSolidBox.min[Z]; z <= gSolidBox.max[Z]; z++ )
-        {
-            boxIndex = BOX_INDEX(x,gSolidBox.min[Y],z);
-            for ( y = gSolidBox.min[Y]; y <= gSolidBox.max[Y]; y++, boxIndex++ )
-            {
-                // sorry, air is never allowed to turn solid
-                if ( gBoxData[boxIndex].type != BLOCK_AIR )
-                {
-                    int flags = gBlockDefinitions[gBoxData[boxIndex].type].flags;
-
-                    // check if it's something to be filtered out: not in the output list or alpha is 0
-                    if ( !(flags & gOptions->saveFilterFlags) ||
-                        gBlockDefinitions[gBoxData[boxIndex].type].alpha <= 0.0 ) {
-                            // things that should not be saved should be gone, gone, gone
-                            gBoxData[boxIndex].type = gBoxData[boxIndex].origType = BLOCK_AIR;
-                            gBoxData[boxIndex].data = 0x0;
-                    }
-                }
-            }
-        }
-    }
     // what should we output? Only 3D bits (no billboards) if printing or if textures are off
     if ( gPrint3D || !(gOptions->exportFlags & EXPT_OUTPUT_TEXTURE_IMAGES) )
     {
@@ -1745,66 +2503,121 @@ static int filterBox()
     {
         outputFlags = (BLF_BILLBOARD|BLF_SMALL_BILLBOARD|BLF_TRUE_GEOMETRY);
     }
-    // check for billboards and lesser geometry - immediately output. Flatten that which should be flattened. 
-    for ( x = gSolidBox.min[X]; x <= gSolidBox.max[X]; x++ )
+
+    // Make tables of what happens to each type: is it filtered out, and is it a billboard or flattened
+    // and so needs the second pass? Air is never kept, so that nothing is done to it.
+    specialFlags = (gExportBillboards ? outputFlags : 0x0) | (flatten ? (BLF_FLATTOP|BLF_FLATSIDE) : 0x0);
+    for ( i = 0; i < 256; i++ )
     {
-        for ( z = gSolidBox.min[Z]; z <= gSolidBox.max[Z]; z++ )
-        {
-            boxIndex = BOX_INDEX(x,gSolidBox.min[Y],z);
-            for ( y = gSolidBox.min[Y]; y <= gSolidBox.max[Y]; y++, boxIndex++ )
-            {
-                // sorry, air is never allowed to turn solid
-                if ( gBoxData[boxIndex].type != BLOCK_AIR )
+        int flags = gBlockDefinitions[i].flags;
+        // check if it's something to be filtered out: not in the output list or alpha is 0
+        keepType[i] = (unsigned char)( (i != BLOCK_AIR) && (flags & gOptions->saveFilterFlags) && (gBlockDefinitions[i].alpha > 0.0) );
+        specialType[i] = (unsigned char)( (flags & specialFlags) ? 1 : 0 );
+    }
+
+    // Filter out all stuff that is not to be rendered. Done before anything, as these blocks simply
+    // should not exist for all operations beyond. Each block is independent here, so split the solid
+    // box into ranges of X slabs, one per processor. Also list the blocks the second pass needs to look at.
+    slabCount = gSolidBox.max[X] - gSolidBox.min[X] + 1;
+    numJobs = PortaProcessorCount();
+    if ( numJobs > MAX_FILTER_THREADS )
+        numJobs = MAX_FILTER_THREADS;
+    if ( numJobs > slabCount )
+        numJobs = slabCount;
+    if ( numJobs < 1 )
+        numJobs = 1;
+    for ( i = 0; i < numJobs; i++ )
+    {
+        jobs[i].minX = gSolidBox.min[X] + (int)(((long long)slabCount * i) / numJobs);
+        jobs[i].maxX = gSolidBox.min[X] + (int)(((long long)slabCount * (i+1)) / numJobs) - 1;
+        jobs[i].boxData = gBoxData;
+        jobs[i].solidBox = gSolidBox;
+        jobs[i].boxSizeY = gBoxSize[Y];
+        jobs[i].boxSizeYZ = gBoxSizeYZ;
+        jobs[i].keepType = keepType;
+        jobs[i].specialType = specialType;
+        jobs[i].specialList = NULL;
+        jobs[i].specialCount = 0;
+        jobs[i].specialListSize = 0;
+        jobs[i].foundBlock = 0;
+        jobs[i].outOfMemory = 0;
+    }
+    // this thread takes ranges, too; if a thread can't be made, the others do its range
+    queue.jobs = jobs;
+    queue.numJobs = numJobs;
+    queue.nextJob = 0;
+    RunOnWorkers( filterSlabs, &queue, numJobs );
+    for ( i = 0; i < numJobs; i++ )
+    {
+        foundBlock |= jobs[i].foundBlock;
+        if ( jobs[i].outOfMemory )
+            retCode |= MW_WORLD_EXPORT_TOO_LARGE;
+    }
+
+    // check for billboards and lesser geometry - immediately output. Flatten that which should be flattened.
+    // Done in the same order as a scan through the box, as billboards look at their processed neighbors.
+    for ( i = 0; i < numJobs && retCode < MW_BEGIN_ERRORS; i++ )
+    {
+        for ( j = 0; j < jobs[i].specialCount; j++ )
+        {
+            int flags;
+            int blockProcessed = 0;
+            boxIndex = jobs[i].specialList[j];
+            flags = gBlockDefinitions[gBoxData[boxIndex].type].flags;
+
+            // check: is it a billboard we can export? Clear it out if so.
+            if ( gExportBillboards )
+            {
+                // If we're 3d printing, or rendering without textures, then export 3D printable bits,
+                // on the assumption that the software can merge the data properly with the solid model.
+                // TODO: Should any blocks that are bits get used to note connected objects,
+                // so that floaters are not deleted? Probably... but we don't try to test.
+                if ( flags & outputFlags )
                 {
-                    int flags = gBlockDefinitions[gBoxData[boxIndex].type].flags;
-                    // check: is it a billboard we can export? Clear it out if so.
-                    int blockProcessed = 0;
-                    if ( gExportBillboards )
+                    // tricksy code, because I'm lazy: if the return value > 1, then it's an error
+                    // and should be treated as such.
+                    retVal = saveBillboardOrGeometry( boxIndex, gBoxData[boxIndex].type );
+                    if ( retVal == 1 )
                     {
-                        // If we're 3d printing, or rendering without textures, then export 3D printable bits,
-                        // on the assumption that the software can merge the data properly with the solid model.
-                        // TODO: Should any blocks that are bits get used to note connected objects,
-                        // so that floaters are not deleted? Probably... but we don't try to test.
-                        if ( flags & outputFlags )
-                        {
-                            // tricksy code, because I'm lazy: if the return value > 1, then it's an error
-                            // and should be treated as such.
-                            retVal = saveBillboardOrGeometry( boxIndex, gBoxData[boxIndex].type );
-                            if ( retVal == 1 )
-                            {
-                                // this block is then cleared out, since it's been processed.
-                                gBoxData[boxIndex].type = BLOCK_AIR;
-                                foundBlock = 1;
-                                blockProcessed = 1;
-                            }
-                            else if ( retVal >= MW_BEGIN_ERRORS )
-                            {
-                                return retVal;
-                            }
-                        }
+                        // this block is then cleared out, since it's been processed.
+                        gBoxData[boxIndex].type = BLOCK_AIR;
+                        foundBlock = 1;
+                        blockProcessed = 1;
                     }
-
-                    // not filtered out by the basics or billboard
-                    if ( !blockProcessed && flatten && ( flags & (BLF_FLATTOP|BLF_FLATSIDE) ) )
+                    else if ( retVal >= MW_BEGIN_ERRORS )
                     {
-                        // this block is redstone, a rail, a ladder, etc. - shove its face to the top of the next cell down,
-                        // or to its neighbor, or both (depends on dataval),
-                        // instead of rendering a block for it.
-
-                        // was: gBoxData[boxIndex-1].flatFlags = gBoxData[boxIndex].type;
-                        // if object was indeed flattened, set it to air
-                        if ( computeFlatFlags( boxIndex ) )
-                        {
-                            gBoxData[boxIndex].type = BLOCK_AIR;
-                        }
+                        retCode |= retVal;
+                        break;
                     }
-                    // note that we found any sort of block that was valid (flats don't count, whatever
-                    // they're pushed against needs to exist, too)
-                    foundBlock |= (gBoxData[boxIndex].type > BLOCK_AIR);
                 }
             }
+
+            // not filtered out by the basics or billboard
+            if ( !blockProcessed && flatten && ( flags & (BLF_FLATTOP|BLF_FLATSIDE) ) )
+            {
+                // this block is redstone, a rail, a ladder, etc. - shove its face to the top of the next cell down,
+                // or to its neighbor, or both (depends on dataval),
+                // instead of rendering a block for it.
+
+                // was: gBoxData[boxIndex-1].flatFlags = gBoxData[boxIndex].type;
+                // if object was indeed flattened, set it to air
+                if ( computeFlatFlags( boxIndex ) )
+                {
+                    gBoxData[boxIndex].type = BLOCK_AIR;
+                }
+            }
+            // note that we found any sort of block that was valid (flats don't count, whatever
+            // they're pushed against needs to exist, too)
+            foundBlock |= (gBoxData[boxIndex].type > BLOCK_AIR);
         }
     }
+    for ( i = 0; i < numJobs; i++ )
+    {
+        free( jobs[i].specialList );
+    }
+    if ( retCode >= MW_BEGIN_ERRORS )
+        return retCode;
+
     // 1%
     UPDATE_PROGRESS(0.70f*PG_MAKE_FACES);
     if ( foundBlock == 0 )
@@ -1867,7 +2680,9 @@ static int filterBox()
         {
             if ( gAirGroups > 1 )
             {
-                checkAndRemoveBubbles();
+                retCode |= checkAndRemoveBubbles();
+                if ( retCode >= MW_BEGIN_ERRORS )
+                    goto Exit;
             }
         }
         // 2%
@@ -1886,6 +2701,11 @@ static int filterBox()
             if ( gOptions->exportFlags & EXPT_CONNECT_PARTS )
             {
                 foundTouching = fixTouchingEdges();
+                if ( foundTouching < 0 )
+                {
+                    retCode |= MW_WORLD_EXPORT_TOO_LARGE;
+                    goto Exit;
+                }
             }
 
             // 4) Unattached corners. While it's perfectly legal to have blocks touch at corner tips, the object might fall apart
@@ -1927,7 +2747,9 @@ static int filterBox()
             {
                 // delete only groups that have a min Y > the base gMinY+1 level, i.e. aren't at ground level
                 // OR delete tree (even at ground level - who wants a tree that will fall over?).
-                deleteFloatingGroups();
+                retCode |= deleteFloatingGroups();
+                if ( retCode >= MW_BEGIN_ERRORS )
+                    goto Exit;
             }
 
             // it's possible that all groups are deleted
@@ -1965,10 +2787,75 @@ static int filterBox()
 
 Exit:
         free(gGroupList);
+        freeGroupGraph();
     }
     return retCode;
 }
 
+static DWORD WINAPI filterSlabs( LPVOID pParam )
+{
+    FilterSlabQueue *pQueue = (FilterSlabQueue *)pParam;
+    int job;
+
+    while ( ( job = (int)PortaIncrement( &pQueue->nextJob ) - 1 ) < pQueue->numJobs )
+    {
+        filterSlabRange( &pQueue->jobs[job] );
+    }
+    return 0;
+}
+
+// First pass of filterBox, for a range of X slabs: clear out types that are not exported, and
+// list blocks that are billboards or get flattened, for the second pass.
+static void filterSlabRange( FilterSlabJob *pJob )
+{
+    BoxCell *boxData = pJob->boxData;
+    IBox *solidBox = &pJob->solidBox;
+    int boxIndex;
+    int x,y,z;
+
+    for ( x = pJob->minX; x <= pJob->maxX; x++ )
+    {
+        for ( z = solidBox->min[Z]; z <= solidBox->max[Z]; z++ )
+        {
+            boxIndex = x*pJob->boxSizeYZ + z*pJob->boxSizeY + solidBox->min[Y];
+            for ( y = solidBox->min[Y]; y <= solidBox->max[Y]; y++, boxIndex++ )
+            {
+                int type = boxData[boxIndex].type;
+                // sorry, air is never allowed to turn solid
+                if ( !pJob->keepType[type] )
+                {
+                    if ( type != BLOCK_AIR )
+                    {
+                        // things that should not be saved should be gone, gone, gone
+                        boxData[boxIndex].type = boxData[boxIndex].origType = BLOCK_AIR;
+                        boxData[boxIndex].data = 0x0;
+                    }
+                }
+                else if ( pJob->specialType[type] )
+                {
+                    if ( pJob->specialCount >= pJob->specialListSize )
+                    {
+                        int *newList;
+                        pJob->specialListSize = pJob->specialListSize*2 + 256;
+                        newList = (int *)realloc( pJob->specialList, pJob->specialListSize*sizeof(int) );
+                        if ( newList == NULL )
+                        {
+                            pJob->outOfMemory = 1;
+                            return;
+                        }
+                        pJob->specialList = newList;
+                    }
+                    pJob->specialList[pJob->specialCount++] = boxIndex;
+                }
+                else
+                {
+                    pJob->foundBlock = 1;
+                }
+            }
+        }
+    }
+}
+
 static int computeFlatFlags( int boxIndex )
 {
     // for this box's contents, mark the neighbor(s) that should receive
@@ -5801,23 +6688,10 @@ static void setDefaultUVs( Point2 uvs[3], int skip )
     }
 }
 
-static FaceRecord * allocFaceRecordFromPool()
-{
-    if ( gModel.faceRecordPool->count >= FACE_RECORD_POOL_SIZE )
-    {
-        // allocate new pool
-        FaceRecordPool *pFRP = (FaceRecordPool *)malloc(sizeof(FaceRecordPool));
-        pFRP->count = 0;
-        pFRP->pPrev = gModel.faceRecordPool;
-        gModel.faceRecordPool = pFRP;
-    }
-    return &(gModel.faceRecordPool->fr[gModel.faceRecordPool->count++]);
-}
-
 // Output the face of triangle slope element
 static int saveTriangleFace( int boxIndex, int swatchLoc, int type, int faceDirection, int startVertexIndex, int vindex[3], Point2 uvs[3] )
 {
-    FaceRecord *face;
+    int face;
     int j;
     int uvIndices[3];
     int retCode = MW_NO_ERROR;
@@ -5842,40 +6716,34 @@ static int saveTriangleFace( int boxIndex, int swatchLoc, int type, int faceDire
             uvIndices[2] = saveTextureUV( swatchLoc, type, uvs[2][X], uvs[2][Y] );
         }
 
-        face = allocFaceRecordFromPool();
-        //face = allocFaceRecordFromPool();
-        if ( face == NULL )
-        {
-            return retCode|MW_WORLD_EXPORT_TOO_LARGE;
-        }
+        retCode |= checkFaceListSize();
+        if ( retCode >= MW_BEGIN_ERRORS ) return retCode;
+        face = gModel.faceCount;
 
         // if we sort, we want to keep faces in the order generated, which is
         // generally cache-coherent (and also just easier to view in the file)
-        //face->faceIndex = firstFaceModifier( 0, gModel.faceCount );
+        //gModel.faces.faceIndex[face] = firstFaceModifier( 0, gModel.faceCount );
         // never a first face, we know how we're using it currently (as sides for rails, and these simply aren't the first)
-        face->faceIndex = gModel.faceCount;
-        face->type = type;
+        gModel.faces.faceIndex[face] = gModel.faceCount;
+        gModel.faces.type[face] = type;
 
         // always the same normal, which directly corresponds to the normals[] array in gModel
-        face->normalIndex = gUsingTransform ? COMPUTE_NORMAL : faceDirection;
+        gModel.faces.normalIndex[face] = gUsingTransform ? COMPUTE_NORMAL : faceDirection;
 
         // get three face indices for the three corners of the triangular face, and always create each
         for ( j = 0; j < 3; j++ )
         {
-            face->vertexIndex[j] = startVertexIndex + vindex[j];
+            gModel.faces.vertexIndex[face][j] = startVertexIndex + vindex[j];
             if (gExportTexture)
-                face->uvIndex[j] = uvIndices[j];
+                gModel.faces.uvIndex[face][j] = uvIndices[j];
         }
         // double last point - we normally store four points in face records, so this tips us off that it's a triangle
-        face->vertexIndex[3] = face->vertexIndex[2];
+        gModel.faces.vertexIndex[face][3] = gModel.faces.vertexIndex[face][2];
         if (gExportTexture)
-            face->uvIndex[3] = face->uvIndex[2];
+            gModel.faces.uvIndex[face][3] = gModel.faces.uvIndex[face][2];
 
         // all set, so save it away
-        retCode |= checkFaceListSize();
-        if ( retCode >= MW_BEGIN_ERRORS ) return retCode;
-
-        gModel.faceList[gModel.faceCount++] = face;
+        gModel.faceCount++;
     }
 
     return retCode;
@@ -6572,38 +7440,33 @@ static int saveBoxFace( int swatchLoc, int type, int faceDirection, int markFirs
 
 static int saveBoxFaceUVs( int type, int faceDirection, int markFirstFace, int startVertexIndex, int vindex[4], int uvIndices[4] )
 {
-    FaceRecord *face;
+    int face;
     int j;
     int retCode = MW_NO_ERROR;
 
     // output each face
-    face = allocFaceRecordFromPool();
-    if ( face == NULL )
-    {
-        return retCode|MW_WORLD_EXPORT_TOO_LARGE;
-    }
+    retCode |= checkFaceListSize();
+    if ( retCode >= MW_BEGIN_ERRORS ) return retCode;
+    face = gModel.faceCount;
 
     // if we sort, we want to keep faces in the order generated, which is
     // generally cache-coherent (and also just easier to view in the file)
-    face->faceIndex = firstFaceModifier( markFirstFace, gModel.faceCount );
-    face->type = type;
+    gModel.faces.faceIndex[face] = firstFaceModifier( markFirstFace, gModel.faceCount );
+    gModel.faces.type[face] = type;
 
     // always the same normal, which directly corresponds to the normals[] array in gModel
-    face->normalIndex = gUsingTransform ? COMPUTE_NORMAL : faceDirection;
+    gModel.faces.normalIndex[face] = gUsingTransform ? COMPUTE_NORMAL : faceDirection;
 
     // get four face indices for the four corners of the face, and always create each
     for ( j = 0; j < 4; j++ )
     {
-        face->vertexIndex[j] = startVertexIndex + vindex[j];
+        gModel.faces.vertexIndex[face][j] = startVertexIndex + vindex[j];
         if ( gExportTexture )
-            face->uvIndex[j] = uvIndices[j];
+            gModel.faces.uvIndex[face][j] = uvIndices[j];
     }
 
     // all set, so save it away
-    retCode |= checkFaceListSize();
-    if ( retCode >= MW_BEGIN_ERRORS ) return retCode;
-
-    gModel.faceList[gModel.faceCount++] = face;
+    gModel.faceCount++;
 
     return retCode;
 }
@@ -6620,7 +7483,7 @@ static int saveBillboardFaces( int boxIndex, int type, int billboardType )
 static int saveBillboardFacesExtraData( int boxIndex, int type, int billboardType, int dataVal, int firstFace )
 {
     int i, j, fc, swatchLoc;
-    FaceRecord *face;
+    int face;
     int faceDir[8];
     Point vertexOffsets[4][4];
     IPoint anchor;
@@ -7127,19 +7990,17 @@ static int saveBillboardFacesExtraData( int boxIndex, int type, int billboardTyp
         // torches are 4 sides facing out: don't output 8 sides
         if ( doubleSided || (i % 2 == 0))
         {
-            face = allocFaceRecordFromPool();
-            if ( face == NULL )
-            {
-                return retCode|MW_WORLD_EXPORT_TOO_LARGE;
-            }
+            retCode |= checkFaceListSize();
+            if ( retCode >= MW_BEGIN_ERRORS ) return retCode;
+            face = gModel.faceCount;
 
             // if  we sort, we want to keep faces in the order generated, which is
             // generally cache-coherent (and also just easier to view in the file)
-            face->faceIndex = firstFaceModifier( (i == 0)&&firstFace, gModel.faceCount );
-            face->type = type;
+            gModel.faces.faceIndex[face] = firstFaceModifier( (i == 0)&&firstFace, gModel.faceCount );
+            gModel.faces.type[face] = type;
 
             // if no transform happens, then use faceDir index for normal index
-            face->normalIndex = normalUnknown ? COMPUTE_NORMAL : faceDir[i];
+            gModel.faces.normalIndex[face] = normalUnknown ? COMPUTE_NORMAL : faceDir[i];
 
             // two faces have the same vertices and uv's, just the normal is reversed.
             fc = i/2;
@@ -7164,9 +8025,9 @@ static int saveBillboardFacesExtraData( int boxIndex, int type, int billboardTyp
                     pt[Y] = (float)(anchor[Y] + vertexOffsets[fc][j][Y]);
                     pt[Z] = (float)(anchor[Z] + vertexOffsets[fc][j][Z]);
 
-                    face->vertexIndex[j] = startVertexCount + j;
+                    gModel.faces.vertexIndex[face][j] = startVertexCount + j;
                     if (gExportTexture)
-                        face->uvIndex[j] = uvIndices[j];
+                        gModel.faces.uvIndex[face][j] = uvIndices[j];
 
                     gModel.vertexCount++;
                     assert( gModel.vertexCount <= gModel.vertexListSize );
@@ -7182,17 +8043,14 @@ static int saveBillboardFacesExtraData( int boxIndex, int type, int billboardTyp
                 // these are always the same
                 for ( j = 0; j < 4; j++ )
                 {
-                    face->vertexIndex[3-j] = startVertexCount + j;
+                    gModel.faces.vertexIndex[face][3-j] = startVertexCount + j;
                     if (gExportTexture)
-                        face->uvIndex[3-j] = uvIndices[j];
+                        gModel.faces.uvIndex[face][3-j] = uvIndices[j];
                 }
             }
 
             // all set, so save it away
-            retCode |= checkFaceListSize();
-            if ( retCode >= MW_BEGIN_ERRORS ) return retCode;
-
-            gModel.faceList[gModel.faceCount++] = face;
+            gModel.faceCount++;
         }
     }
 
@@ -7388,33 +8246,59 @@ static int checkVertexListSize()
     }
     return MW_NO_ERROR;
 }
+// (Re)size all the arrays of the face store to hold faceSize faces; existing faces are kept.
+static int allocFaceStore( int faceSize )
+{
+    FaceStore *pFaces = &gModel.faces;
+    void *pMem;
+
+    pMem = realloc( pFaces->type, faceSize*sizeof(int) );
+    if ( pMem == NULL ) return MW_WORLD_EXPORT_TOO_LARGE;
+    pFaces->type = (int *)pMem;
+
+    pMem = realloc( pFaces->faceIndex, faceSize*sizeof(int) );
+    if ( pMem == NULL ) return MW_WORLD_EXPORT_TOO_LARGE;
+    pFaces->faceIndex = (int *)pMem;
+
+    pMem = realloc( pFaces->vertexIndex, faceSize*4*sizeof(int) );
+    if ( pMem == NULL ) return MW_WORLD_EXPORT_TOO_LARGE;
+    pFaces->vertexIndex = (int (*)[4])pMem;
+
+    pMem = realloc( pFaces->normalIndex, faceSize*sizeof(int) );
+    if ( pMem == NULL ) return MW_WORLD_EXPORT_TOO_LARGE;
+    pFaces->normalIndex = (int *)pMem;
+
+    pMem = realloc( pFaces->uvIndex, faceSize*4*sizeof(int) );
+    if ( pMem == NULL ) return MW_WORLD_EXPORT_TOO_LARGE;
+    pFaces->uvIndex = (int (*)[4])pMem;
+
+    gModel.faceSize = faceSize;
+    return MW_NO_ERROR;
+}
+
+// Make sure there is room for one more face, at location gModel.faceCount.
 static int checkFaceListSize()
 {
     assert(gModel.faceCount <= gModel.faceSize);
     if (gModel.faceCount == gModel.faceSize)
     {
-        FaceRecord **faceList;
-        gModel.faceSize = (int)(gModel.faceSize * 1.4 + 1);
-        faceList = (FaceRecord**)malloc(gModel.faceSize*sizeof(FaceRecord*));
-        if ( faceList == NULL )
-        {
-            return MW_WORLD_EXPORT_TOO_LARGE;
-        }
-        memcpy( faceList, gModel.faceList, gModel.faceCount*sizeof(FaceRecord*));
-        free( gModel.faceList );
-        gModel.faceList = faceList;
+        return allocFaceStore( (int)(gModel.faceSize * 1.4 + 1) );
     }
     return MW_NO_ERROR;
 }
 
+// Groups are found by labelling runs of cells along Y, then joining touching runs in neighboring columns with union-find.
+// A second pass in the same order as the old seed fill (X, then Z, then Y downward) numbers the groups, so the
+// surrounding air is still group 1, and groups get the same IDs as before.
 static int findGroups()
 {
     int boxIndex;
     IPoint loc;
-    IPoint seedLoc;
-    int seedSize = 1000;
-    IPoint *seedStack = (IPoint *)malloc(seedSize*sizeof(IPoint));
-    int seedCount = 0;
+    int sizeZ, colIndex, colCount;
+    int runCount, runListSize, run, groupID;
+    int sealEntrances = (gOptions->exportFlags & EXPT_SEAL_ENTRANCES) ? 1 : 0;
+    int *colStart;
+    GroupRun *runs;
     BoxGroup *pGroup;
     int retCode = MW_NO_ERROR;
 
@@ -7442,53 +8326,144 @@ static int findGroups()
         addVolumeToGroup( SURROUND_AIR_GROUP, gBoxSize[X]-1, 1, 1, gBoxSize[X]-1, gBoxSize[Y]-1, gBoxSize[Z]-2 );
     }
 
-    // We test *all* cells, including surrounding air, for connectivity to others. The idea here is to have the surrounding air group
-    // be created first, and find all connecting air. Note that the tunnel sealing, above, will stop this percolation of air along the sides and
-    // bottom, as those cells will already have a group.
+    sizeZ = gAirBox.max[Z] - gAirBox.min[Z] + 1;
+    colCount = (gAirBox.max[X] - gAirBox.min[X] + 1) * sizeZ;
+    colStart = (int *)malloc((colCount+1)*sizeof(int));
+    runListSize = 2*colCount;
+    runs = (GroupRun *)malloc(runListSize*sizeof(GroupRun));
+    if ( (colStart == NULL) || (runs == NULL) )
+    {
+        free(colStart);
+        free(runs);
+        return MW_WORLD_EXPORT_TOO_LARGE;
+    }
+
+    // First pass: break each column into runs of solid or air, and join each run to the runs it touches in the
+    // columns at -X and -Z. Cells already in a group (sealed sides) are in no run. Air that was an entrance is a
+    // run of its own that is never joined, as the seed fill does not propagate out of it.
+    runCount = 0;
+    colIndex = 0;
     for ( loc[X] = gAirBox.min[X]; loc[X] <= gAirBox.max[X]; loc[X]++ )
     {
-        for ( loc[Z] = gAirBox.min[Z]; loc[Z] <= gAirBox.max[Z]; loc[Z]++ )
+        for ( loc[Z] = gAirBox.min[Z]; loc[Z] <= gAirBox.max[Z]; loc[Z]++, colIndex++ )
         {
-            // IMPORTANT: Note that we start at the top and work down, as we want to ensure that outside air is the top group.
+            int inRun = 0;
+            colStart[colIndex] = runCount;
             boxIndex = BOX_INDEX(loc[X],gAirBox.max[Y],loc[Z]);
             for ( loc[Y] = gAirBox.max[Y]; loc[Y] >= gAirBox.min[Y]; loc[Y]--, boxIndex-- )
             {
-                // check if the object has no group
-                if ( gBoxData[boxIndex].group == NO_GROUP_SET )
+                int solid, entrance;
+                if ( gBoxData[boxIndex].group != NO_GROUP_SET )
+                {
+                    inRun = 0;
+                    continue;
+                }
+                solid = (gBoxData[boxIndex].type > BLOCK_AIR);
+                entrance = sealEntrances && !solid && (gBlockDefinitions[gBoxData[boxIndex].origType].flags & BLF_ENTRANCE);
+                if ( inRun && !entrance && runs[runCount-1].solid == solid )
+                {
+                    runs[runCount-1].bottom = loc[Y];
+                    continue;
+                }
+
+                // start a new run
+                if ( runCount == runListSize )
+                {
+                    GroupRun *newRuns;
+                    runListSize = (int)(runListSize * 1.4 + 1);
+                    newRuns = (GroupRun *)realloc(runs, runListSize*sizeof(GroupRun));
+                    if ( newRuns == NULL )
+                    {
+                        free(colStart);
+                        free(runs);
+                        return MW_WORLD_EXPORT_TOO_LARGE;
+                    }
+                    runs = newRuns;
+                }
+                runs[runCount].parent = runCount;
+                runs[runCount].group = NO_GROUP_SET;
+                runs[runCount].top = runs[runCount].bottom = loc[Y];
+                runs[runCount].solid = (unsigned char)solid;
+                runs[runCount].entrance = (unsigned char)(entrance ? 1 : 0);
+                runCount++;
+                inRun = !entrance;
+            }
+            colStart[colIndex+1] = runCount;
+
+            if ( loc[Z] > gAirBox.min[Z] )
+            {
+                joinGroupRunColumns( runs, colStart, colIndex, colIndex-1 );
+            }
+            if ( loc[X] > gAirBox.min[X] )
+            {
+                joinGroupRunColumns( runs, colStart, colIndex, colIndex-sizeZ );
+            }
+        }
+    }
+
+    // Second pass: number the groups in the order their first cells are reached, and fill in the cells,
+    // populations, and bounds.
+    colIndex = 0;
+    for ( loc[X] = gAirBox.min[X]; loc[X] <= gAirBox.max[X]; loc[X]++ )
+    {
+        for ( loc[Z] = gAirBox.min[Z]; loc[Z] <= gAirBox.max[Z]; loc[Z]++, colIndex++ )
+        {
+            for ( run = colStart[colIndex]; run < colStart[colIndex+1]; run++ )
+            {
+                GroupRun *pRoot;
+                if ( runs[run].entrance )
+                {
+                    // An entrance joins the first-numbered air group next to it, if that group is numbered yet;
+                    // the seed fill from that group would have reached it before the scan did.
+                    loc[Y] = runs[run].top;
+                    runs[run].group = findEntranceGroup( runs, colStart, colIndex, sizeZ, loc );
+                    pRoot = &runs[run];
+                }
+                else
+                {
+                    pRoot = &runs[findGroupRunRoot( runs, run )];
+                }
+
+                if ( pRoot->group == NO_GROUP_SET )
                 {
                     gGroupCount++;
                     retCode |= checkGroupListSize();
-                    if ( retCode >= MW_BEGIN_ERRORS ) return retCode;
+                    if ( retCode >= MW_BEGIN_ERRORS )
+                        goto Exit;
 
-                    // no group, so make a new seed.
                     // Note that group index 0 is not used at all.
+                    pRoot->group = gGroupCount;
                     pGroup = &gGroupList[gGroupCount];
                     pGroup->groupID = gGroupCount;
-                    pGroup->population = (gGroupCount == SURROUND_AIR_GROUP) ? pGroup->population+1 : 1;   // the solid air group might already exist with a population
+                    // the solid air group might already exist with a population
+                    if ( gGroupCount != SURROUND_AIR_GROUP )
+                        pGroup->population = 0;
                     // the solid air group will need to have its bounds fixed at the end if tunnel sealing is going on
+                    loc[Y] = runs[run].top;
                     Vec2Op( pGroup->bounds.min, =, loc );
                     Vec2Op( pGroup->bounds.max, =, loc );
-                    pGroup->solid = (gBoxData[boxIndex].type > BLOCK_AIR);
+                    pGroup->solid = runs[run].solid;
+                    pGroup->mergedTo = NO_GROUP_SET;
+                    pGroup->fillType = GROUP_NO_FILL;
 
-                    gBoxData[boxIndex].group = gGroupCount;
                     if ( pGroup->solid )
                         gSolidGroups++;
                     else
                         gAirGroups++;
-                    // propagate seed: make neighbors with same type (solid or air) and no group to be this group.
-                    propagateSeed(loc,pGroup,&seedStack,&seedSize,&seedCount);
+                }
+                groupID = pRoot->group;
 
-                    // When this is done, seedStack has a list of seeds that had no ID before and now have one.
-                    // Each of these seeds' neighbors needs to be tested .
+                pGroup = &gGroupList[groupID];
+                pGroup->population += runs[run].top - runs[run].bottom + 1;
+                loc[Y] = runs[run].top;
+                addBounds( loc, &pGroup->bounds );
+                loc[Y] = runs[run].bottom;
+                addBounds( loc, &pGroup->bounds );
 
-                    // while seedCount > 0, propagate
-                    while ( seedCount > 0 )
-                    {
-                        // copy test point over, so we don't trample it when seedStack gets increased
-                        seedCount--;
-                        Vec2Op( seedLoc, =, seedStack[seedCount]);
-                        propagateSeed(seedLoc,pGroup,&seedStack,&seedSize,&seedCount);
-                    }
+                boxIndex = BOX_INDEX(loc[X],runs[run].top,loc[Z]);
+                for ( loc[Y] = runs[run].top; loc[Y] >= runs[run].bottom; loc[Y]--, boxIndex-- )
+                {
+                    gBoxData[boxIndex].group = groupID;
                 }
             }
         }
@@ -7500,137 +8475,431 @@ static int findGroups()
         addBoundsToBounds( gAirBox, &gGroupList[SURROUND_AIR_GROUP].bounds );
     }
 
-    free(seedStack);
+    // nothing is merged yet
+    gGroupList[NO_GROUP_SET].mergedTo = NO_GROUP_SET;
+    VecScalar( gGroupMergeBounds.min, =,  999999);
+    VecScalar( gGroupMergeBounds.max, =, -999999);
+
+    retCode |= buildGroupGraph();
+
+Exit:
+    free(colStart);
+    free(runs);
 
     return retCode;
 }
 
-
-// Add a volume of space to a group. Group is assumed to exist, have solidity assigned, blocks are assumed to not be in a group already.
-static void addVolumeToGroup( int groupID, int minx, int miny, int minz, int maxx, int maxy, int maxz )
+static int findGroupRunRoot( GroupRun *runs, int run )
 {
-    int boxIndex;
-    IPoint loc;
-    BoxGroup *pGroup = &gGroupList[groupID];
-    // actually meaningless for our particular use of this method right now,
-    // as (a) the bounds are set when the group is created (which is later),
-    // and (b) the group's bounds at this point are all zeros (which is OK in this case,
-    // but normally is not what bounds should have).
-    //IBox bounds;
-    //Vec3Scalar( bounds.min, =, minx, miny, minz );
-    //Vec3Scalar( bounds.max, =, maxx, maxy, maxz ); 
-    //addBoundsToBounds( bounds, &pGroup->bounds );
-
-    for ( loc[X] = minx; loc[X] <= maxx; loc[X]++ )
+    while ( runs[run].parent != run )
     {
-        for ( loc[Z] = minz; loc[Z] <= maxz; loc[Z]++ )
-        {
-            boxIndex = BOX_INDEX(loc[X],miny,loc[Z]);
-            // Note that we start at the top and work down, as we want to ensure that outside air is the top group.
-            for ( loc[Y] = miny; loc[Y] <= maxy; loc[Y]++, boxIndex++ )
-            {
-                assert(gBoxData[boxIndex].group == NO_GROUP_SET);
+        // path halving
+        runs[run].parent = runs[runs[run].parent].parent;
+        run = runs[run].parent;
+    }
+    return run;
+}
 
-                pGroup->population++;   // the solid air group might already exist with a population
-                gBoxData[boxIndex].group = groupID;
-            }
+// Join the runs in column colA to the overlapping runs of the same kind in column colB.
+// Runs in a column are in order from the top down.
+static void joinGroupRunColumns( GroupRun *runs, int *colStart, int colA, int colB )
+{
+    int a = colStart[colA];
+    int b = colStart[colB];
+    while ( a < colStart[colA+1] && b < colStart[colB+1] )
+    {
+        if ( runs[a].bottom <= runs[b].top && runs[b].bottom <= runs[a].top &&
+            runs[a].solid == runs[b].solid && !runs[a].entrance && !runs[b].entrance )
+        {
+            int rootA = findGroupRunRoot( runs, a );
+            int rootB = findGroupRunRoot( runs, b );
+            // keep the earlier run as the root
+            if ( rootA < rootB )
+                runs[rootB].parent = rootA;
+            else if ( rootB < rootA )
+                runs[rootA].parent = rootB;
+        }
+        // step past whichever run ends first, going down
+        if ( runs[a].bottom > runs[b].bottom )
+            a++;
+        else if ( runs[b].bottom > runs[a].bottom )
+            b++;
+        else
+        {
+            a++;
+            b++;
         }
     }
 }
 
-
-static void propagateSeed(IPoint point, BoxGroup *pGroup, IPoint **pSeedStack, int *seedSize, int *seedCount)
+// Return the run in column col holding height y, or -1 if the cell is in no run (it was already in a group).
+static int findGroupRunAt( GroupRun *runs, int *colStart, int col, int y )
 {
-    int faceDirection;
-    int boxIndex,newBoxIndex;
-    IPoint newPt;
-    int sindex;
-    IPoint *seedStack;
-
-    // check that there's not enough room for seedStack to grow by 6 points
-    if ( *seedSize <= *seedCount + 6 )
-    {
-        IPoint *seeds;
-        *seedSize += 6;
-        *seedSize = (int)(*seedSize * 1.4 + 1);
-        seeds = (IPoint*)malloc(*seedSize*sizeof(IPoint));
-        memcpy( seeds, (*pSeedStack), *seedCount*sizeof(IPoint));
-        free( (*pSeedStack) );
-        (*pSeedStack) = seeds;
-    }
-
-    seedStack = *pSeedStack;
-
-    // special test: if the seed is air, and the original type of this block was solid, not air (was: was an entrance), then
-    // don't propagate the seed. This is useful for structures, where you don't necessarily want to see
-    // the ladder or whatever that closes the building off from the world but you do want the ladder
-    // to stop propagation. Note that this means two air groups can be next to each other, i.e., neighbors,
-    // so we need to check for this case elsewhere.
-    if ( (gOptions->exportFlags & EXPT_SEAL_ENTRANCES) && !pGroup->solid )
-    {
-        boxIndex = BOX_INDEXV(point);
-        if ( gBlockDefinitions[gBoxData[boxIndex].origType].flags & BLF_ENTRANCE )
-            // In this way, you can use things like snow blocks set to display an alpha of 0 to seal off entrances,
-            // and the hole will be visible at the end.  TODO: document - removed, too obscure!!!
-            //if ( gBoxData[boxIndex].origType > BLOCK_AIR )
-        {
-            // This air block was actually something (like a ladder) that got culled out early on. Use it to seal the entrance.
-            // Old code: This air block is actually an entrance, so don't propagate it further.
-            return;
-        }
+    int lo = colStart[col];
+    int hi = colStart[col+1]-1;
+    while ( lo <= hi )
+    {
+        int mid = (lo + hi) / 2;
+        if ( y > runs[mid].top )
+            hi = mid-1;
+        else if ( y < runs[mid].bottom )
+            lo = mid+1;
+        else
+            return mid;
     }
+    return -1;
+}
 
-    // check the six neighbors for if they're not in a group already and have the same type, filled or unfilled
+// Return the lowest group number among the air groups touching the entrance at loc, or NO_GROUP_SET if none are numbered yet.
+static int findEntranceGroup( GroupRun *runs, int *colStart, int col, int sizeZ, IPoint loc )
+{
+    int faceDirection;
+    int groupID = NO_GROUP_SET;
     for ( faceDirection = 0; faceDirection < 6; faceDirection++ )
     {
-        // check that new location is valid for testing
-        Vec2Op( newPt, =, point );
+        IPoint newPt;
+        Vec2Op( newPt, =, loc );
         if ( getNeighbor( faceDirection, newPt ) )
         {
-            newBoxIndex = BOX_INDEXV(newPt);
-            // is neighbor not in a group, and the same sort of thing as our seed (solid or not)?
-            if ( (gBoxData[newBoxIndex].group == NO_GROUP_SET) &&
-                ((gBoxData[newBoxIndex].type > BLOCK_AIR) == pGroup->solid) ) {
-
-                    // note the block is a part of this group now
-                    gBoxData[newBoxIndex].group = pGroup->groupID;
-                    // update the group's population, and check if this one touches a side.
-                    pGroup->population++;
-                    addBounds(newPt,&pGroup->bounds);
-
-                    // and add it to the list of potential seeds to continue to propagate
-                    sindex = *seedCount;
-                    Vec2Op(seedStack[sindex], =, newPt);
-                    (*seedCount)++;
-                    // it's possible that we could run out, I think: each seed could add its six neighbors, etc.?
-                    assert((*seedCount)<gBoxSizeXYZ);
+            int newCol = col + (newPt[X]-loc[X])*sizeZ + (newPt[Z]-loc[Z]);
+            int run = findGroupRunAt( runs, colStart, newCol, newPt[Y] );
+            if ( run >= 0 && !runs[run].solid && !runs[run].entrance )
+            {
+                int neighborGroup = runs[findGroupRunRoot( runs, run )].group;
+                if ( neighborGroup != NO_GROUP_SET && (groupID == NO_GROUP_SET || neighborGroup < groupID) )
+                {
+                    groupID = neighborGroup;
+                }
             }
         }
     }
+    return groupID;
 }
 
-// return 1 if there's a valid neighbor, which is put in newx, etc.
-// NOTE: it's important that "point" be copied over here, not as a point. It is changed locally.
-static int getNeighbor( int faceDirection, IPoint newPoint )
+// Find which groups touch which, once, right after the groups are labelled. The result is kept as a list of
+// neighbor group IDs for each group, neighbors of group i in gGroupNeighbors[gGroupNeighborStart[i]] up to
+// gGroupNeighborStart[i+1]. Merges done later are found through each group's mergedTo.
+static int buildGroupGraph()
 {
-    switch (faceDirection)
+    int boxIndex, i;
+    IPoint loc;
+    int pairSize, pairCount, pairMask;
+    int *pairs;
+    int *fill;
+    int offsets[3];
+
+    freeGroupGraph();
+
+    // hash set of touching pairs, lower group ID first
+    pairSize = 1024;
+    pairMask = pairSize-1;
+    pairCount = 0;
+    pairs = (int *)malloc(pairSize*2*sizeof(int));
+    if ( pairs == NULL )
+        return MW_WORLD_EXPORT_TOO_LARGE;
+    memset(pairs,0,pairSize*2*sizeof(int));
+
+    // +Y, +Z, +X neighbors, so each touching face is checked once
+    offsets[0] = 1;
+    offsets[1] = gBoxSize[Y];
+    offsets[2] = gBoxSizeYZ;
+
+    for ( loc[X] = gAirBox.min[X]; loc[X] <= gAirBox.max[X]; loc[X]++ )
     {
-    case DIRECTION_BLOCK_SIDE_LO_X: // -X
-        newPoint[X]--;
-        if ( newPoint[X] < gAirBox.min[X] ) return 0;
-        break;
-    case DIRECTION_BLOCK_BOTTOM: // -Y
-        newPoint[Y]--;
-        if ( newPoint[Y] < gAirBox.min[Y] ) return 0;
-        break;
-    case DIRECTION_BLOCK_SIDE_LO_Z: // -Z
-        newPoint[Z]--;
-        if ( newPoint[Z] < gAirBox.min[Z] ) return 0;
-        break;
-    case DIRECTION_BLOCK_SIDE_HI_X: // +X
-        newPoint[X]++;
-        if ( newPoint[X] > gAirBox.max[X] ) return 0;
-        break;
+        for ( loc[Z] = gAirBox.min[Z]; loc[Z] <= gAirBox.max[Z]; loc[Z]++ )
+        {
+            boxIndex = BOX_INDEX(loc[X],gAirBox.min[Y],loc[Z]);
+            for ( loc[Y] = gAirBox.min[Y]; loc[Y] <= gAirBox.max[Y]; loc[Y]++, boxIndex++ )
+            {
+                int groupID = gBoxData[boxIndex].group;
+                int dir;
+                for ( dir = 0; dir < 3; dir++ )
+                {
+                    int neighborGroup, lo, hi, slot;
+                    // stay inside the air box
+                    if ( (dir == 0 && loc[Y] == gAirBox.max[Y]) || (dir == 1 && loc[Z] == gAirBox.max[Z]) || (dir == 2 && loc[X] == gAirBox.max[X]) )
+                        continue;
+                    neighborGroup = gBoxData[boxIndex+offsets[dir]].group;
+                    if ( neighborGroup == groupID )
+                        continue;
+                    lo = min( groupID, neighborGroup );
+                    hi = max( groupID, neighborGroup );
+                    slot = (int)(((unsigned int)lo*73856093u ^ (unsigned int)hi*19349663u) & pairMask);
+                    while ( pairs[slot*2] != NO_GROUP_SET && (pairs[slot*2] != lo || pairs[slot*2+1] != hi) )
+                    {
+                        slot = (slot+1) & pairMask;
+                    }
+                    if ( pairs[slot*2] == NO_GROUP_SET )
+                    {
+                        pairs[slot*2] = lo;
+                        pairs[slot*2+1] = hi;
+                        pairCount++;
+                        // keep the table at most half full
+                        if ( pairCount*2 > pairSize )
+                        {
+                            int *newPairs = (int *)malloc(pairSize*4*sizeof(int));
+                            if ( newPairs == NULL )
+                            {
+                                free(pairs);
+                                return MW_WORLD_EXPORT_TOO_LARGE;
+                            }
+                            memset(newPairs,0,pairSize*4*sizeof(int));
+                            pairMask = pairSize*2-1;
+                            for ( i = 0; i < pairSize; i++ )
+                            {
+                                if ( pairs[i*2] != NO_GROUP_SET )
+                                {
+                                    slot = (int)(((unsigned int)pairs[i*2]*73856093u ^ (unsigned int)pairs[i*2+1]*19349663u) & pairMask);
+                                    while ( newPairs[slot*2] != NO_GROUP_SET )
+                                    {
+                                        slot = (slot+1) & pairMask;
+                                    }
+                                    newPairs[slot*2] = pairs[i*2];
+                                    newPairs[slot*2+1] = pairs[i*2+1];
+                                }
+                            }
+                            free(pairs);
+                            pairs = newPairs;
+                            pairSize *= 2;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // turn the pairs into a neighbor list for each group, each pair listed under both its groups
+    gGroupNeighborStart = (int *)malloc((gGroupCount+2)*sizeof(int));
+    gGroupNeighbors = (int *)malloc((pairCount*2+1)*sizeof(int));
+    fill = (int *)malloc((gGroupCount+1)*sizeof(int));
+    if ( (gGroupNeighborStart == NULL) || (gGroupNeighbors == NULL) || (fill == NULL) )
+    {
+        free(pairs);
+        free(fill);
+        freeGroupGraph();
+        return MW_WORLD_EXPORT_TOO_LARGE;
+    }
+    memset(gGroupNeighborStart,0,(gGroupCount+2)*sizeof(int));
+    for ( i = 0; i < pairSize; i++ )
+    {
+        if ( pairs[i*2] != NO_GROUP_SET )
+        {
+            gGroupNeighborStart[pairs[i*2]+1]++;
+            gGroupNeighborStart[pairs[i*2+1]+1]++;
+        }
+    }
+    for ( i = 1; i <= gGroupCount+1; i++ )
+    {
+        gGroupNeighborStart[i] += gGroupNeighborStart[i-1];
+    }
+    memcpy(fill,gGroupNeighborStart,(gGroupCount+1)*sizeof(int));
+    for ( i = 0; i < pairSize; i++ )
+    {
+        if ( pairs[i*2] != NO_GROUP_SET )
+        {
+            gGroupNeighbors[fill[pairs[i*2]]++] = pairs[i*2+1];
+            gGroupNeighbors[fill[pairs[i*2+1]]++] = pairs[i*2];
+        }
+    }
+
+    free(pairs);
+    free(fill);
+    return MW_NO_ERROR;
+}
+
+static void freeGroupGraph()
+{
+    free(gGroupNeighborStart);
+    gGroupNeighborStart = NULL;
+    free(gGroupNeighbors);
+    gGroupNeighbors = NULL;
+}
+
+// Return the group that groupID's blocks now belong to, following any merges not yet applied to gBoxData.
+static int findMergedGroup( int groupID )
+{
+    while ( gGroupList[groupID].mergedTo != NO_GROUP_SET && gGroupList[groupID].mergedTo != groupID )
+    {
+        int next = gGroupList[groupID].mergedTo;
+        // shorten the chain as we go
+        if ( gGroupList[next].mergedTo != NO_GROUP_SET && gGroupList[next].mergedTo != next )
+            gGroupList[groupID].mergedTo = gGroupList[next].mergedTo;
+        groupID = next;
+    }
+    return groupID;
+}
+
+// Merge a group into the master group, without touching gBoxData yet: population and bounds move over now, the
+// blocks move when applyGroupMerges is called. If the group's solidity differs from "solid", its blocks become fillType.
+// The group can be its own master, in which case it is only filled.
+static void mergeGroupInto( int groupID, int masterGroupID, int solid, int fillType )
+{
+    BoxGroup *pGroup = &gGroupList[groupID];
+    BoxGroup *pMasterGroup = &gGroupList[masterGroupID];
+
+    pGroup->mergedTo = masterGroupID;
+    pGroup->fillType = ( pGroup->solid != solid ) ? fillType : GROUP_NO_FILL;
+    addBoundsToBounds( pGroup->bounds, &gGroupMergeBounds );
+    if ( groupID != masterGroupID )
+    {
+        // note that this makes this group's bounds meaningless, but since the group is going away, it doesn't matter
+        pMasterGroup->population += pGroup->population;
+        pGroup->population = 0;
+        addBoundsToBounds( pGroup->bounds, &pMasterGroup->bounds );
+    }
+}
+
+// Move the blocks of all merged groups to their master groups, in one pass over the area the merged groups cover.
+// Then fill the blocks that change solidity, a group at a time in group order, and each group's blocks in box order,
+// the order they'd be filled in if each group were merged on its own; fillGroupCell's leaf test looks at blocks that
+// were filled before, so this keeps its results the same.
+static int applyGroupMerges()
+{
+    int x,y,z;
+    int boxIndex, i, n;
+    // the blocks to fill, sorted by group: group i's are from fillEnd[i-1] to fillEnd[i]
+    int *fillEnd = NULL;
+    int *fillList = NULL;
+    int retCode = MW_NO_ERROR;
+
+    if ( gGroupMergeBounds.min[X] <= gGroupMergeBounds.max[X] )
+    {
+        fillEnd = (int *)calloc(gGroupCount+2,sizeof(int));
+        if ( fillEnd == NULL )
+        {
+            retCode = MW_WORLD_EXPORT_TOO_LARGE;
+            goto Exit;
+        }
+
+        // count each group's blocks to fill, just after where its list starts
+        for ( x = gGroupMergeBounds.min[X]; x <= gGroupMergeBounds.max[X]; x++ )
+        {
+            for ( z = gGroupMergeBounds.min[Z]; z <= gGroupMergeBounds.max[Z]; z++ )
+            {
+                boxIndex = BOX_INDEX(x,gGroupMergeBounds.min[Y],z);
+                for ( y = gGroupMergeBounds.min[Y]; y <= gGroupMergeBounds.max[Y]; y++, boxIndex++ )
+                {
+                    BoxGroup *pGroup = &gGroupList[gBoxData[boxIndex].group];
+                    if ( pGroup->mergedTo != NO_GROUP_SET && pGroup->fillType != GROUP_NO_FILL )
+                    {
+                        fillEnd[gBoxData[boxIndex].group+1]++;
+                    }
+                }
+            }
+        }
+        // make the counts into where each group's list starts
+        for ( i = 1; i <= gGroupCount+1; i++ )
+        {
+            fillEnd[i] += fillEnd[i-1];
+        }
+        if ( fillEnd[gGroupCount+1] > 0 )
+        {
+            fillList = (int *)malloc(fillEnd[gGroupCount+1]*sizeof(int));
+            if ( fillList == NULL )
+            {
+                retCode = MW_WORLD_EXPORT_TOO_LARGE;
+                goto Exit;
+            }
+        }
+
+        // relabel, and list the blocks to fill; each group's start moves up to its end as it's listed
+        for ( x = gGroupMergeBounds.min[X]; x <= gGroupMergeBounds.max[X]; x++ )
+        {
+            for ( z = gGroupMergeBounds.min[Z]; z <= gGroupMergeBounds.max[Z]; z++ )
+            {
+                boxIndex = BOX_INDEX(x,gGroupMergeBounds.min[Y],z);
+                for ( y = gGroupMergeBounds.min[Y]; y <= gGroupMergeBounds.max[Y]; y++, boxIndex++ )
+                {
+                    BoxGroup *pGroup = &gGroupList[gBoxData[boxIndex].group];
+                    if ( pGroup->mergedTo != NO_GROUP_SET )
+                    {
+                        if ( pGroup->fillType != GROUP_NO_FILL )
+                        {
+                            fillList[fillEnd[gBoxData[boxIndex].group]++] = boxIndex;
+                        }
+                        gBoxData[boxIndex].group = findMergedGroup( gBoxData[boxIndex].group );
+                    }
+                }
+            }
+        }
+
+        for ( i = 0, n = 0; i <= gGroupCount; i++ )
+        {
+            for ( ; n < fillEnd[i]; n++ )
+            {
+                fillGroupCell( fillList[n], gGroupList[i].fillType );
+            }
+        }
+    }
+
+Exit:
+    free(fillEnd);
+    free(fillList);
+    for ( i = 0; i <= gGroupCount; i++ )
+    {
+        gGroupList[i].mergedTo = NO_GROUP_SET;
+    }
+    VecScalar( gGroupMergeBounds.min, =,  999999);
+    VecScalar( gGroupMergeBounds.max, =, -999999);
+    return retCode;
+}
+
+
+// Add a volume of space to a group. Group is assumed to exist, have solidity assigned, blocks are assumed to not be in a group already.
+static void addVolumeToGroup( int groupID, int minx, int miny, int minz, int maxx, int maxy, int maxz )
+{
+    int boxIndex;
+    IPoint loc;
+    BoxGroup *pGroup = &gGroupList[groupID];
+    // actually meaningless for our particular use of this method right now,
+    // as (a) the bounds are set when the group is created (which is later),
+    // and (b) the group's bounds at this point are all zeros (which is OK in this case,
+    // but normally is not what bounds should have).
+    //IBox bounds;
+    //Vec3Scalar( bounds.min, =, minx, miny, minz );
+    //Vec3Scalar( bounds.max, =, maxx, maxy, maxz ); 
+    //addBoundsToBounds( bounds, &pGroup->bounds );
+
+    for ( loc[X] = minx; loc[X] <= maxx; loc[X]++ )
+    {
+        for ( loc[Z] = minz; loc[Z] <= maxz; loc[Z]++ )
+        {
+            boxIndex = BOX_INDEX(loc[X],miny,loc[Z]);
+            // Note that we start at the top and work down, as we want to ensure that outside air is the top group.
+            for ( loc[Y] = miny; loc[Y] <= maxy; loc[Y]++, boxIndex++ )
+            {
+                assert(gBoxData[boxIndex].group == NO_GROUP_SET);
+
+                pGroup->population++;   // the solid air group might already exist with a population
+                gBoxData[boxIndex].group = groupID;
+            }
+        }
+    }
+}
+
+
+// return 1 if there's a valid neighbor, which is put in newx, etc.
+// NOTE: it's important that "point" be copied over here, not as a point. It is changed locally.
+static int getNeighbor( int faceDirection, IPoint newPoint )
+{
+    switch (faceDirection)
+    {
+    case DIRECTION_BLOCK_SIDE_LO_X: // -X
+        newPoint[X]--;
+        if ( newPoint[X] < gAirBox.min[X] ) return 0;
+        break;
+    case DIRECTION_BLOCK_BOTTOM: // -Y
+        newPoint[Y]--;
+        if ( newPoint[Y] < gAirBox.min[Y] ) return 0;
+        break;
+    case DIRECTION_BLOCK_SIDE_LO_Z: // -Z
+        newPoint[Z]--;
+        if ( newPoint[Z] < gAirBox.min[Z] ) return 0;
+        break;
+    case DIRECTION_BLOCK_SIDE_HI_X: // +X
+        newPoint[X]++;
+        if ( newPoint[X] > gAirBox.max[X] ) return 0;
+        break;
     case DIRECTION_BLOCK_TOP: // +Y
         newPoint[Y]++;
         if ( newPoint[Y] > gAirBox.max[Y] ) return 0;
@@ -7671,16 +8940,26 @@ static void getNeighborUnsafe( int faceDirection, IPoint newPoint )
     }
 }
 
-static void checkAndRemoveBubbles()
+static int checkAndRemoveBubbles()
 {
-    int i, groupID, maxPop, masterGroupID;
-    IBox bounds;
+    int i, n, groupID, maxPop, masterGroupID, neighborCount;
+    int retCode;
 
-    int *neighborGroups = (int *)malloc((gGroupCount+1)*sizeof(int));
+    // the solid neighbors of the bubble being processed, and a mark for each group that is already on this list
+    int *neighborList = (int *)malloc((gGroupCount+1)*sizeof(int));
+    int *neighborMark = (int *)malloc((gGroupCount+1)*sizeof(int));
 
     // if we are simply merging groups, then air bubbles are left as air and merely act to merge groups (I hope...)
     int fillType = (gOptions->exportFlags & EXPT_FILL_BUBBLES) ? BLOCK_GLASS : BLOCK_AIR;
 
+    if ( neighborList == NULL || neighborMark == NULL )
+    {
+        free(neighborList);
+        free(neighborMark);
+        return MW_WORLD_EXPORT_TOO_LARGE;
+    }
+    memset(neighborMark,0,(gGroupCount+1)*sizeof(int));
+
     // only the very first group, which is air, will not be a bubble. All other air groups will be.
     for ( i = SURROUND_AIR_GROUP+1; i <= gGroupCount; i++ )
     {
@@ -7688,52 +8967,48 @@ static void checkAndRemoveBubbles()
         if ( !gGroupList[i].solid )
         {
             // a bubble is found, so merge it, along with all solid groups that border it, into one solid group.
-            memset(neighborGroups,0,(gGroupCount+1)*sizeof(int));
 
             // the first group should always be the outside air group, the second should be solid. Just in case,
             // see if this assumption is wrong. Really, we could probably change i = 2 as the starting condition.
             assert(i>=2);
 
-            // Find which solid groups are neighbors of this group i.
-            // Search the given bounds.
-            neighborGroups[gGroupList[i].groupID] = 1;
-            findNeighboringGroups( &gGroupList[i].bounds, gGroupList[i].groupID, neighborGroups );
+            // Find which solid groups are neighbors of this group i, as they are now, after earlier merges.
+            // Neighboring groups to air *could* also be air; these are simply not filled.
+            neighborCount = 0;
+            for ( n = gGroupNeighborStart[i]; n < gGroupNeighborStart[i+1]; n++ )
+            {
+                groupID = findMergedGroup( gGroupNeighbors[n] );
+                if ( neighborMark[groupID] != i && gGroupList[groupID].solid )
+                {
+                    int insert;
+                    neighborMark[groupID] = i;
+                    // keep the list in ID order, so ties on population go to the lowest ID
+                    for ( insert = neighborCount; insert > 0 && neighborList[insert-1] > groupID; insert-- )
+                    {
+                        neighborList[insert] = neighborList[insert-1];
+                    }
+                    neighborList[insert] = groupID;
+                    neighborCount++;
+                }
+            }
 
             // find the highest population solid group on the list: this will be the one we merge to.
-            // Turn this group off in this list.
             maxPop = 0;
             masterGroupID = -1;
-            // we loop through all groups here, as initial air group should get turned off from list
-            for ( groupID = SURROUND_AIR_GROUP; groupID <= gGroupCount; groupID++ )
+            for ( n = 0; n < neighborCount; n++ )
             {
-                // check if the group is a neighbor
-                if ( neighborGroups[groupID] > 0 )
+                groupID = neighborList[n];
+                // solid: find if it's larger than any previously-examined solid group
+                if ( gGroupList[groupID].population > maxPop )
                 {
-                    // neighboring group to air *could* also be air (and the original
-                    // group itself is air); check it's solid
-                    if ( gGroupList[groupID].solid)
-                    {
-                        // solid: find if it's larger than any previously-examined solid group
-                        if ( gGroupList[groupID].population > maxPop )
-                        {
-                            assert(gGroupList[groupID].solid == 1);
-                            maxPop = gGroupList[groupID].population;
-                            masterGroupID = groupID;
-                        }
-                        // at the same time, decrement count by how many groups will get merged
-                        // Really, at this point, all neighborGroups should be solid, but someday
-                        // I want to allow air groups to border each other, and for bubbles to
-                        // get formed inside of buildings, etc.
-                        gStats.solidGroupsMerged++;
-                        gSolidGroups--;
-                        assert(gSolidGroups >= 0);
-                    }
-                    else
-                    {
-                        // since the neighbor is air, simply don't fill it, clear it from the list
-                        neighborGroups[groupID] = 0;
-                    }
+                    assert(gGroupList[groupID].solid == 1);
+                    maxPop = gGroupList[groupID].population;
+                    masterGroupID = groupID;
                 }
+                // at the same time, decrement count by how many groups will get merged
+                gStats.solidGroupsMerged++;
+                gSolidGroups--;
+                assert(gSolidGroups >= 0);
             }
             // add one back in for the master solid group that won't get merged
             gStats.solidGroupsMerged--;
@@ -7745,91 +9020,36 @@ static void checkAndRemoveBubbles()
             // and as other bubbles are processed they'll merge with this solid (or not).
             if ( masterGroupID >= 0 )
             {
-                // A solid group was found next to the bubble
-
-                // Take the biggest group out of the list, as it's the one everyone merges to.
-                neighborGroups[masterGroupID] = 0;
-                // Get the union of the bounds of all groups found to merge.
-                VecScalar( bounds.min, =,  999999);
-                VecScalar( bounds.max, =, -999999);
-                // Turn the air bubble itself back on, as it will also be filled
-                neighborGroups[i] = 1;
-                for ( groupID = SURROUND_AIR_GROUP+1; groupID <= gGroupCount; groupID++ )
+                // A solid group was found next to the bubble. Everyone merges to the biggest one, including the bubble itself.
+                // We can fill air with whatever we want, since it won't be visible.
+                for ( n = 0; n < neighborCount; n++ )
                 {
-                    if ( neighborGroups[groupID] > 0 )
+                    if ( neighborList[n] != masterGroupID )
                     {
-                        addBoundsToBounds( gGroupList[groupID].bounds, &bounds );
+                        mergeGroupInto( neighborList[n], masterGroupID, 1, fillType );
                     }
                 }
-                assert( bounds.max[Y] >= bounds.min[Y]);
-
-                // Go through this sub-box and change all groups tagged to the new fill group.
-                // We can fill air with whatever we want, since it won't be visible.
-                fillGroups( &bounds, masterGroupID, 1, fillType, neighborGroups );
-                // delete the air group from the count
-                gStats.bubblesFound++;
-                gAirGroups--;
-                assert(gAirGroups>=1);
+                mergeGroupInto( i, masterGroupID, 1, fillType );
             }
             else
             {
                 // no solid group found, so make only the bubble itself solid
-
-                // Get the union of the bounds of all groups found to merge.
-                bounds = gGroupList[i].bounds;
-                // Turn the air bubble itself on, as it will be (the only thing) filled
-                neighborGroups[i] = 1;
-
-                // Go through this sub-box and change all groups tagged to the new fill group.
-                // We can fill air with whatever we want, since it won't be visible.
-                fillGroups( &bounds, i, 1, fillType, neighborGroups );
-
-                // delete the air group from the count
-                gStats.bubblesFound++;
-                gAirGroups--;
-                assert(gAirGroups>=1);
+                mergeGroupInto( i, i, 1, fillType );
             }
+
+            // delete the air group from the count
+            gStats.bubblesFound++;
+            gAirGroups--;
+            assert(gAirGroups>=1);
         }
     }
-    free(neighborGroups);
-}
-
-// go through box. Whichever blocks have same group, mark all neighbors into neighborGroups array.
-// Note that the groupID neighborGroup entry is likely to be set, also.
-static void findNeighboringGroups( IBox *bounds, int groupID, int *neighborGroups )
-{
-    int x,y,z;
-    int boxIndex, faceDirection;
 
-    assert(bounds->min[X]>0);
-    assert(bounds->min[Y]>0);
-    assert(bounds->min[Z]>0);
-    assert(bounds->max[X]<gBoxSize[X]-1);
-    assert(bounds->max[Y]<gBoxSize[Y]-1);
-    assert(bounds->max[Z]<gBoxSize[Z]-1);
+    // now actually change the blocks
+    retCode = applyGroupMerges();
 
-    for ( x = bounds->min[X]; x <= bounds->max[X]; x++ )
-    {
-        for ( z = bounds->min[Z]; z <= bounds->max[Z]; z++ )
-        {
-            boxIndex = BOX_INDEX(x,bounds->min[Y],z);
-            for ( y = bounds->min[Y]; y <= bounds->max[Y]; y++, boxIndex++ )
-            {
-                if ( gBoxData[boxIndex].group == groupID )
-                {
-                    // mark the neighbors
-                    for ( faceDirection = 0; faceDirection < 6; faceDirection++ )
-                    {
-                        // get the neighbor's box index, to get the neighbor box's group,
-                        // and set this as a group that touches the group specified. Simply set them
-                        // all, again and again, brute force.
-                        // Note that we don't have to check if a neighbor block location is valid! They're all inside air.
-                        neighborGroups[gBoxData[boxIndex + gFaceOffset[faceDirection]].group] = 1;
-                    }
-                }
-            }
-        }
-    }
+    free(neighborList);
+    free(neighborMark);
+    return retCode;
 }
 
 
@@ -7908,48 +9128,7 @@ static void fillGroups( IBox *bounds, int masterGroupID, int solid, int fillType
                         // target is not solid, and master is solid, so needs to be made solid OR
                         // target is solid, and master is not solid, so need to be made air (fillType is
                         // assumed to be set correctly, to air.
-                        // Note that we don't bother setting the "data" to anything;
-                        // we assume the master fill type doesn't have a sub-field.
-
-                        // special test: if a location is surrounded by trees and leaves and air, fill in with a leaf
-                        if ( solid && (( fillType == BLOCK_GLASS ) || (fillType == BLOCK_STAINED_GLASS)) )
-                        {
-                            int i;
-                            int leafFound = 0;
-                            int woodSearch = 1;
-                            unsigned char leafData = 0;
-                            for ( i = 0; i < 6 && woodSearch; i++ )
-                            {
-                                int index = boxIndex+gFaceOffset[i];
-                                // leaf found?
-                                if ( gBlockDefinitions[gBoxData[index].type].flags & BLF_LEAF_PART )
-                                {
-                                    leafFound = 1;
-                                    leafData = gBoxData[index].data;
-                                }
-                                else if ( !(gBlockDefinitions[gBoxData[index].type].flags & BLF_TREE_PART) && gBoxData[index].type != BLOCK_AIR )
-                                {
-                                    // not a leaf, log, or air, so we won't fill it in.
-                                    woodSearch = 0;
-                                }
-                            }
-                            if ( woodSearch && leafFound )
-                            {
-                                // leaf fill
-                                gBoxData[boxIndex].type = BLOCK_LEAVES;
-                                gBoxData[boxIndex].data = leafData;
-                            }
-                            else
-                            {
-                                // normal fill
-                                gBoxData[boxIndex].type = (unsigned char)fillType;
-                            }
-                        }
-                        else
-                        {
-                            gBoxData[boxIndex].type = (unsigned char)fillType;
-                        }
-                        gBoxData[boxIndex].data = 0x0;
+                        fillGroupCell( boxIndex, fillType );
                     }
                     // transfer to master group
                     gBoxData[boxIndex].group = masterGroupID;
@@ -7966,6 +9145,53 @@ static void fillGroups( IBox *bounds, int masterGroupID, int solid, int fillType
     }
 }
 
+// Fill a block that is changing solidity with fillType.
+static void fillGroupCell( int boxIndex, int fillType )
+{
+    // Note that we don't bother setting the "data" to anything;
+    // we assume the master fill type doesn't have a sub-field.
+
+    // special test: if a location is surrounded by trees and leaves and air, fill in with a leaf
+    if ( ( fillType == BLOCK_GLASS ) || (fillType == BLOCK_STAINED_GLASS) )
+    {
+        int i;
+        int leafFound = 0;
+        int woodSearch = 1;
+        unsigned char leafData = 0;
+        for ( i = 0; i < 6 && woodSearch; i++ )
+        {
+            int index = boxIndex+gFaceOffset[i];
+            // leaf found?
+            if ( gBlockDefinitions[gBoxData[index].type].flags & BLF_LEAF_PART )
+            {
+                leafFound = 1;
+                leafData = gBoxData[index].data;
+            }
+            else if ( !(gBlockDefinitions[gBoxData[index].type].flags & BLF_TREE_PART) && gBoxData[index].type != BLOCK_AIR )
+            {
+                // not a leaf, log, or air, so we won't fill it in.
+                woodSearch = 0;
+            }
+        }
+        if ( woodSearch && leafFound )
+        {
+            // leaf fill
+            gBoxData[boxIndex].type = BLOCK_LEAVES;
+            gBoxData[boxIndex].data = leafData;
+        }
+        else
+        {
+            // normal fill
+            gBoxData[boxIndex].type = (unsigned char)fillType;
+        }
+    }
+    else
+    {
+        gBoxData[boxIndex].type = (unsigned char)fillType;
+    }
+    gBoxData[boxIndex].data = 0x0;
+}
+
 static void addBounds( IPoint loc, IBox *bounds )
 {
     if ( loc[X] < bounds->min[X] )
@@ -8121,6 +9347,7 @@ static int fixTouchingEdges()
     // If so, mark the two empty cells with a count and with flags pointing to the
     // neighboring cell.
 
+    // The empty cells are kept in a hash table, so only cells next to touching edges take any memory.
     // Once all empty cells are marked like this, go through them and make records for sorting:
     // record has box index, count, and distance from center of model (computed in first pass,
     // as a by-product). Sort these records, first by count, then distance as a tie-breaker.
@@ -8129,19 +9356,30 @@ static int fixTouchingEdges()
     // be subtracted. Some records will therefore have a count of zero when they're found on the
     // sorted list, as previous elements processed will have decremented their counts.
     //
+    // Returns 1 if any edges were fixed, 0 if none were found, or -1 if there's not enough memory.
+    //
     // When filling a location, do a merge of groups if needed. Choose material for new cell as
     // that of the +Y object first, then X and Z, then -Y last. Update group population and bounds.
     int boxIndex;
     int x,y,z;
     int touchCount,i;
     Point avgLoc,floc;
+    IPoint cellLoc;
     int solidBlocks=0;
     TouchRecord *touchList;
+    TouchCell *pCell;
     //int maxVal;
 
-    // big allocation, not much to be done about it.
-    gTouchGrid = (TouchCell*)malloc(gBoxSizeXYZ*sizeof(TouchCell));
-    memset(gTouchGrid,0,gBoxSizeXYZ*sizeof(TouchCell));
+    gTouchGridSize = TOUCH_GRID_START_SIZE;
+    gTouchGridUsed = 0;
+    gTouchOutOfMemory = 0;
+    gTouchGrid = (TouchCell*)malloc(gTouchGridSize*sizeof(TouchCell));
+    if ( gTouchGrid == NULL )
+        return -1;
+    for ( i = 0; i < gTouchGridSize; i++ )
+    {
+        gTouchGrid[i].boxIndex = TOUCH_EMPTY_SLOT;
+    }
 
     gTouchSize = 0;
 
@@ -8191,9 +9429,13 @@ static int fixTouchingEdges()
     }
     assert( solidBlocks );
 
-    // were no touching edges found? Then return!
-    if ( gTouchSize == 0 )
-        return 0;
+    // were no touching edges found, or is there no memory to fix them? Then return!
+    if ( gTouchSize == 0 || gTouchOutOfMemory )
+    {
+        free(gTouchGrid);
+        gTouchGrid = NULL;
+        return gTouchOutOfMemory ? -1 : 0;
+    }
 
     // get average location
     VecScalar( avgLoc, /=, solidBlocks );
@@ -8206,6 +9448,12 @@ static int fixTouchingEdges()
 
     // allocate space for touched air cells
     touchList = (TouchRecord *)malloc(gTouchSize*sizeof(TouchRecord));
+    if ( touchList == NULL )
+    {
+        free(gTouchGrid);
+        gTouchGrid = NULL;
+        return -1;
+    }
     touchCount = 0;
 
     // what is the distance from corner to corner of the solid box? We choose this distance because
@@ -8215,35 +9463,34 @@ static int fixTouchingEdges()
     // in for a block that connects two edges.
     float norm = (float)sqrt((float)gBoxSize[X] * (float)gBoxSize[X] + (float)gBoxSize[Z] * (float)gBoxSize[Z]);
 
-    // go through the grid, collecting up the locations needing processing
-    for ( x = gSolidBox.min[X]; x <= gSolidBox.max[X]; x++ )
+    // go through the hash table, collecting up the locations needing processing
+    for ( i = 0; i < gTouchGridSize; i++ )
     {
-        for ( z = gSolidBox.min[Z]; z <= gSolidBox.max[Z]; z++ )
+        // find potential fill locations and put them in a list
+        if ( gTouchGrid[i].boxIndex != TOUCH_EMPTY_SLOT && gTouchGrid[i].count > 0 )
         {
-            boxIndex = BOX_INDEX(x,gSolidBox.min[Y],z);
-            for ( y = gSolidBox.min[Y]; y <= gSolidBox.max[Y]; y++, boxIndex++ )
-            {
-                // find potential fill locations and put them in a list
-                if ( gTouchGrid[boxIndex].count > 0 )
-                {
-                    // here's a possible manifold-fill location, an air block that if
-                    // we fill it in we will get rid of a manifold edge.
-                    // So add a record.
-                    touchList[touchCount].obscurity = gTouchGrid[boxIndex].obscurity;
-                    touchList[touchCount].count = gTouchGrid[boxIndex].count;
-                    touchList[touchCount].boxIndex = boxIndex;
-                    assert(gBoxData[boxIndex].type == BLOCK_AIR );
-
-                    Vec3Scalar(floc, = (float), x,y,z);
-                    touchList[touchCount].distance = computeHidingDistance(floc, avgLoc, norm);
-                    touchCount++;
-                }
-            }
+            // here's a possible manifold-fill location, an air block that if
+            // we fill it in we will get rid of a manifold edge.
+            // So add a record.
+            boxIndex = gTouchGrid[i].boxIndex;
+            touchList[touchCount].obscurity = gTouchGrid[i].obscurity;
+            touchList[touchCount].count = gTouchGrid[i].count;
+            touchList[touchCount].boxIndex = boxIndex;
+            assert(gBoxData[boxIndex].type == BLOCK_AIR );
+
+            boxIndexToLoc( cellLoc, boxIndex );
+            Vec3Scalar(floc, = (float), cellLoc[X],cellLoc[Y],cellLoc[Z]);
+            touchList[touchCount].distance = computeHidingDistance(floc, avgLoc, norm);
+            touchCount++;
         }
     }
 
     assert( touchCount == gTouchSize );
 
+    // Put the list in the order a scan through the box finds the cells, so that the sort below, which
+    // can leave equal records in any order, gets the same list to start with as a scan of the box would.
+    qsort(touchList,touchCount,sizeof(TouchRecord),touchIndexCompare);
+
     // we have the list of touched air cells that could be filled - sort it!
     qsort_s(touchList,touchCount,sizeof(TouchRecord),touchRecordCompare,NULL);
 
@@ -8266,11 +9513,12 @@ static int fixTouchingEdges()
         // are useless. We're going to decrement the count on the gTouchGrid and its neighbors,
         // which is why this count is the one to access.
         boxIndex = touchList[i].boxIndex;
+        pCell = findTouchCell( boxIndex );
+        assert( pCell );
 
         // Any edges left to fix in the touch grid cell on the sorted list? Previous operations
         // might have decremented its count to 0.
-
-        if ( gTouchGrid[boxIndex].count > 0 )
+        if ( pCell->count > 0 )
         {
             int boxMtlIndex=-999;
             int foundBlock=0;
@@ -8405,11 +9653,93 @@ static int fixTouchingEdges()
 
     free(touchList);
     free(gTouchGrid);
+    gTouchGrid = NULL;
     gStats.numberManifoldPasses++;
 
     return touchCount ? 1 : 0;
 }
 
+// return the touch grid cell for this air block, or NULL if it's not in the grid
+static TouchCell *findTouchCell( int boxIndex )
+{
+    unsigned int mask = (unsigned int)gTouchGridSize - 1;
+    unsigned int slot = ((unsigned int)boxIndex * 2654435761u) >> 7;
+
+    for (;;)
+    {
+        slot &= mask;
+        if ( gTouchGrid[slot].boxIndex == boxIndex )
+            return &gTouchGrid[slot];
+        if ( gTouchGrid[slot].boxIndex == TOUCH_EMPTY_SLOT )
+            return NULL;
+        slot++;
+    }
+}
+
+// return the touch grid cell for this air block, adding an empty one if it's not in the grid, or NULL if
+// there's no memory to add it. Adding can grow the grid, so any pointers to other cells are no longer valid after this call.
+static TouchCell *addTouchCell( int boxIndex )
+{
+    unsigned int mask;
+    unsigned int slot;
+
+    // keep the table at most half full
+    if ( (gTouchGridUsed+1)*2 > gTouchGridSize )
+    {
+        TouchCell *oldGrid = gTouchGrid;
+        int oldSize = gTouchGridSize;
+        int i;
+
+        // if the table can't grow, leave it as it is, for fixTouchingEdges to free
+        TouchCell *newGrid = (TouchCell*)malloc(oldSize*2*sizeof(TouchCell));
+        if ( newGrid == NULL )
+            return NULL;
+        gTouchGrid = newGrid;
+        gTouchGridSize = oldSize*2;
+        for ( i = 0; i < gTouchGridSize; i++ )
+        {
+            gTouchGrid[i].boxIndex = TOUCH_EMPTY_SLOT;
+        }
+        mask = (unsigned int)gTouchGridSize - 1;
+        for ( i = 0; i < oldSize; i++ )
+        {
+            if ( oldGrid[i].boxIndex != TOUCH_EMPTY_SLOT )
+            {
+                slot = ((unsigned int)oldGrid[i].boxIndex * 2654435761u) >> 7;
+                while ( gTouchGrid[slot & mask].boxIndex != TOUCH_EMPTY_SLOT )
+                    slot++;
+                gTouchGrid[slot & mask] = oldGrid[i];
+            }
+        }
+        free(oldGrid);
+    }
+
+    mask = (unsigned int)gTouchGridSize - 1;
+    slot = ((unsigned int)boxIndex * 2654435761u) >> 7;
+    for (;;)
+    {
+        slot &= mask;
+        if ( gTouchGrid[slot].boxIndex == boxIndex )
+            return &gTouchGrid[slot];
+        if ( gTouchGrid[slot].boxIndex == TOUCH_EMPTY_SLOT )
+        {
+            gTouchGridUsed++;
+            gTouchGrid[slot].boxIndex = boxIndex;
+            gTouchGrid[slot].connections = 0;
+            gTouchGrid[slot].count = 0;
+            gTouchGrid[slot].obscurity = 0;
+            return &gTouchGrid[slot];
+        }
+        slot++;
+    }
+}
+
+// order of box index, which is the order a scan through the box in X, then Z, then Y finds cells
+static int touchIndexCompare( const void *str1, const void *str2 )
+{
+    return ((const TouchRecord*)str1)->boxIndex - ((const TouchRecord*)str2)->boxIndex;
+}
+
 static int touchRecordCompare( void* context, const void *str1, const void *str2)
 {
     TouchRecord *t1;
@@ -8539,28 +9869,33 @@ static void checkForTouchingEdge(int boxIndex, int offx, int offy, int offz)
                 assert(n2index>=0);
                 n1obscurity = computeObscurity(n1index);
                 n2obscurity = computeObscurity(n2index);
+                if ( gTouchOutOfMemory )
+                    return;
                 obscurityMatches = (n1obscurity == n2obscurity);
 
                 // We check if one obscurity is larger than the other;
                 // if it is, it wins, and the other won't need to get added.
                 // Note that the count in a cell, by this code, then does *not* match
                 // how many neighbors it will subtract from others when it is filled.
+                // (both cells were added to the grid by computeObscurity, so no new cells get added here)
                 if ( n1obscurity >= n2obscurity)
                 {
+                    TouchCell *pCell = findTouchCell(n1index);
                     // adding a new cell? Note it
-                    if ( gTouchGrid[n1index].count == 0 )
+                    if ( pCell->count == 0 )
                         gTouchSize++;
                     // add the fact that this cell touches one manifold edge
-                    gTouchGrid[n1index].count++;
+                    pCell->count++;
                     // note which neighbor it connects to
-                    gTouchGrid[n1index].connections |=  obscurityMatches ? n1neighbor : 0x0;
+                    pCell->connections |=  obscurityMatches ? n1neighbor : 0x0;
                 }
                 if ( n2obscurity >= n1obscurity)
                 {
-                    if ( gTouchGrid[n2index].count == 0 )
+                    TouchCell *pCell = findTouchCell(n2index);
+                    if ( pCell->count == 0 )
                         gTouchSize++;
-                    gTouchGrid[n2index].count++;
-                    gTouchGrid[n2index].connections |= obscurityMatches ? n2neighbor : 0x0;
+                    pCell->count++;
+                    pCell->connections |= obscurityMatches ? n2neighbor : 0x0;
                 }
 
                 //// adding a new cell? Note it
@@ -8580,10 +9915,19 @@ static void checkForTouchingEdge(int boxIndex, int offx, int offy, int offz)
     }
 }
 
-// count how many of the six directions for this cell are blocked by something solid
+// count how many of the six directions for this cell are blocked by something solid.
+// Adds the cell to the touch grid, where the result is saved for next time.
 static int computeObscurity( int boxIndex )
 {
-    int obscurity = gTouchGrid[boxIndex].obscurity;
+    TouchCell *pCell = addTouchCell( boxIndex );
+    int obscurity;
+
+    if ( pCell == NULL )
+    {
+        gTouchOutOfMemory = 1;
+        return 0;
+    }
+    obscurity = pCell->obscurity;
 
     // we know that obscurity must be 2 or more; so 0 means "not set"
     if ( obscurity == 0 )
@@ -8639,7 +9983,7 @@ static int computeObscurity( int boxIndex )
             }
             obscurity += hit;
         }
-
+        pCell->obscurity = (unsigned char)obscurity;
     }
     return obscurity;
 }
@@ -8648,116 +9992,117 @@ static int computeObscurity( int boxIndex )
 static void decrementNeighbors( int boxIndex )
 {
     int nc = 0;
-    int offset;
-    int connections = gTouchGrid[boxIndex].connections;
+    TouchCell *pCell = findTouchCell( boxIndex );
+    TouchCell *pNeighbor;
+    int connections = pCell->connections;
 
     if ( connections & TOUCH_MX_MY )
     {
         nc++;
-        offset = boxIndex - gBoxSizeYZ - 1;
-        assert(gTouchGrid[offset].count>0);
-        gTouchGrid[offset].count--;
-        gTouchGrid[offset].connections &= ~TOUCH_PX_PY;
+        pNeighbor = findTouchCell( boxIndex - gBoxSizeYZ - 1 );
+        assert(pNeighbor && pNeighbor->count>0);
+        pNeighbor->count--;
+        pNeighbor->connections &= ~TOUCH_PX_PY;
     }
     if ( connections & TOUCH_MX_MZ )
     {
         nc++;
-        offset = boxIndex - gBoxSizeYZ - gBoxSize[Y];
-        assert(gTouchGrid[offset].count>0);
-        gTouchGrid[offset].count--;
-        gTouchGrid[offset].connections &= ~TOUCH_PX_PZ;
+        pNeighbor = findTouchCell( boxIndex - gBoxSizeYZ - gBoxSize[Y] );
+        assert(pNeighbor && pNeighbor->count>0);
+        pNeighbor->count--;
+        pNeighbor->connections &= ~TOUCH_PX_PZ;
     }
     if ( connections & TOUCH_MY_MZ )
     {
         nc++;
-        offset = boxIndex - 1 - gBoxSize[Y];
-        assert(gTouchGrid[offset].count>0);
-        gTouchGrid[offset].count--;
-        gTouchGrid[offset].connections &= ~TOUCH_PY_PZ;
+        pNeighbor = findTouchCell( boxIndex - 1 - gBoxSize[Y] );
+        assert(pNeighbor && pNeighbor->count>0);
+        pNeighbor->count--;
+        pNeighbor->connections &= ~TOUCH_PY_PZ;
     }
 
     if ( connections & TOUCH_MX_PY )
     {
         nc++;
-        offset = boxIndex - gBoxSizeYZ + 1;
-        assert(gTouchGrid[offset].count>0);
-        gTouchGrid[offset].count--;
-        gTouchGrid[offset].connections &= ~TOUCH_PX_MY;
+        pNeighbor = findTouchCell( boxIndex - gBoxSizeYZ + 1 );
+        assert(pNeighbor && pNeighbor->count>0);
+        pNeighbor->count--;
+        pNeighbor->connections &= ~TOUCH_PX_MY;
     }
     if ( connections & TOUCH_MX_PZ )
     {
         nc++;
-        offset = boxIndex - gBoxSizeYZ + gBoxSize[Y];
-        assert(gTouchGrid[offset].count>0);
-        gTouchGrid[offset].count--;
-        gTouchGrid[offset].connections &= ~TOUCH_PX_MZ;
+        pNeighbor = findTouchCell( boxIndex - gBoxSizeYZ + gBoxSize[Y] );
+        assert(pNeighbor && pNeighbor->count>0);
+        pNeighbor->count--;
+        pNeighbor->connections &= ~TOUCH_PX_MZ;
     }
     if ( connections & TOUCH_MY_PZ )
     {
         nc++;
-        offset = boxIndex - 1 + gBoxSize[Y];
-        assert(gTouchGrid[offset].count>0);
-        gTouchGrid[offset].count--;
-        gTouchGrid[offset].connections &= ~TOUCH_PY_MZ;
+        pNeighbor = findTouchCell( boxIndex - 1 + gBoxSize[Y] );
+        assert(pNeighbor && pNeighbor->count>0);
+        pNeighbor->count--;
+        pNeighbor->connections &= ~TOUCH_PY_MZ;
     }
 
     if ( connections & TOUCH_PX_MY )
     {
         nc++;
-        offset = boxIndex + gBoxSizeYZ - 1;
-        assert(gTouchGrid[offset].count>0);
-        gTouchGrid[offset].count--;
-        gTouchGrid[offset].connections &= ~TOUCH_MX_PY;
+        pNeighbor = findTouchCell( boxIndex + gBoxSizeYZ - 1 );
+        assert(pNeighbor && pNeighbor->count>0);
+        pNeighbor->count--;
+        pNeighbor->connections &= ~TOUCH_MX_PY;
     }
     if ( connections & TOUCH_PX_MZ )
     {
         nc++;
-        offset = boxIndex + gBoxSizeYZ - gBoxSize[Y];
-        assert(gTouchGrid[offset].count>0);
-        gTouchGrid[offset].count--;
-        gTouchGrid[offset].connections &= ~TOUCH_MX_PZ;
+        pNeighbor = findTouchCell( boxIndex + gBoxSizeYZ - gBoxSize[Y] );
+        assert(pNeighbor && pNeighbor->count>0);
+        pNeighbor->count--;
+        pNeighbor->connections &= ~TOUCH_MX_PZ;
     }
     if ( connections & TOUCH_PY_MZ )
     {
         nc++;
-        offset = boxIndex + 1 - gBoxSize[Y];
-        assert(gTouchGrid[offset].count>0);
-        gTouchGrid[offset].count--;
-        gTouchGrid[offset].connections &= ~TOUCH_MY_PZ;
+        pNeighbor = findTouchCell( boxIndex + 1 - gBoxSize[Y] );
+        assert(pNeighbor && pNeighbor->count>0);
+        pNeighbor->count--;
+        pNeighbor->connections &= ~TOUCH_MY_PZ;
     }
 
     if ( connections & TOUCH_PX_PY )
     {
         nc++;
-        offset = boxIndex + gBoxSizeYZ + 1;
-        assert(gTouchGrid[offset].count>0);
-        gTouchGrid[offset].count--;
-        gTouchGrid[offset].connections &= ~TOUCH_MX_MY;
+        pNeighbor = findTouchCell( boxIndex + gBoxSizeYZ + 1 );
+        assert(pNeighbor && pNeighbor->count>0);
+        pNeighbor->count--;
+        pNeighbor->connections &= ~TOUCH_MX_MY;
     }
     if ( connections & TOUCH_PX_PZ )
     {
         nc++;
-        offset = boxIndex + gBoxSizeYZ + gBoxSize[Y];
-        assert(gTouchGrid[offset].count>0);
-        gTouchGrid[offset].count--;
-        gTouchGrid[offset].connections &= ~TOUCH_MX_MZ;
+        pNeighbor = findTouchCell( boxIndex + gBoxSizeYZ + gBoxSize[Y] );
+        assert(pNeighbor && pNeighbor->count>0);
+        pNeighbor->count--;
+        pNeighbor->connections &= ~TOUCH_MX_MZ;
     }
     if ( connections & TOUCH_PY_PZ )
     {
         nc++;
-        offset = boxIndex + 1 + gBoxSize[Y];
-        assert(gTouchGrid[offset].count>0);
-        gTouchGrid[offset].count--;
-        gTouchGrid[offset].connections &= ~TOUCH_MY_MZ;
+        pNeighbor = findTouchCell( boxIndex + 1 + gBoxSize[Y] );
+        assert(pNeighbor && pNeighbor->count>0);
+        pNeighbor->count--;
+        pNeighbor->connections &= ~TOUCH_MY_MZ;
     }
     // we should have cleared as many as we had in the cell
     // Well, no longer true: we can now have a count > nc,
     // since we now use obscurity to win early on.
-    assert(nc <= gTouchGrid[boxIndex].count);
+    assert(nc <= pCell->count);
 
     // clear cell itself
-    gTouchGrid[boxIndex].connections = 0;
-    gTouchGrid[boxIndex].count = 0;
+    pCell->connections = 0;
+    pCell->count = 0;
 }
 
 // norm is half the distance from the gBox corner to center, in XZ plane, squared.
@@ -8783,14 +10128,24 @@ static void boxIndexToLoc( IPoint loc, int boxIndex )
 }
 
 
-static void deleteFloatingGroups()
+static int deleteFloatingGroups()
 {
     BoxGroup *pGroup;
     int deleteGroup;
-    int i,x,y,z;
+    int i;
     int boxIndex;
-    int treeParts;
-    int *neighborGroups;
+    IPoint loc;
+    int retCode;
+    // for each group, which tree parts it has, and whether it has anything that's not a tree part
+    int *treeParts = (int *)malloc((gGroupCount+1)*sizeof(int));
+    unsigned char *notTree = (unsigned char *)malloc((gGroupCount+1)*sizeof(unsigned char));
+
+    if ( treeParts == NULL || notTree == NULL )
+    {
+        free(treeParts);
+        free(notTree);
+        return MW_WORLD_EXPORT_TOO_LARGE;
+    }
 
     // Find largest group and don't delete it, so there's always something left.
     // If there's a tie on size, lower Y bounds is the tie breaker
@@ -8818,6 +10173,38 @@ static void deleteFloatingGroups()
     }
     assert(maxPop > 0);
 
+    // Is each group all tree? Test all objects in all groups in one pass - are they all tree parts?
+    // TODO?: a better rule might be "if any group is hanging and is also touching the solid box X or Z faces, delete it"
+    // This would certainly be good for trees, though I think deleting hanging trees always is a safe thing.
+    memset(treeParts,0,(gGroupCount+1)*sizeof(int));
+    memset(notTree,0,(gGroupCount+1)*sizeof(unsigned char));
+    for ( loc[X] = gAirBox.min[X]; loc[X] <= gAirBox.max[X]; loc[X]++ )
+    {
+        for ( loc[Z] = gAirBox.min[Z]; loc[Z] <= gAirBox.max[Z]; loc[Z]++ )
+        {
+            boxIndex = BOX_INDEX(loc[X],gAirBox.min[Y],loc[Z]);
+            for ( loc[Y] = gAirBox.min[Y]; loc[Y] <= gAirBox.max[Y]; loc[Y]++, boxIndex++ )
+            {
+                int groupID = gBoxData[boxIndex].group;
+                if ( gGroupList[groupID].solid )
+                {
+                    // is it a tree part? Or is it a glass bubble that is
+                    // is surrounded by tree bits? (this can happen, some trees grow funny)
+                    if ( (gBlockDefinitions[gBoxData[boxIndex].type].flags & BLF_TREE_PART) ||
+                        (gBoxData[boxIndex].origType == BLOCK_AIR) || (gBoxData[boxIndex].origType == BLOCK_VINES) )
+                    {
+                        // tree part, mark which parts
+                        treeParts[groupID] |= gBlockDefinitions[gBoxData[boxIndex].type].flags;
+                    }
+                    else
+                    {
+                        notTree[groupID] = 1;
+                    }
+                }
+            }
+        }
+    }
+
     // [don't need to look at air group]
     for ( i = SURROUND_AIR_GROUP+1; i <= gGroupCount; i++ )
     {
@@ -8835,68 +10222,29 @@ static void deleteFloatingGroups()
             }
             else
             {
-                // If not too small, is it all tree?
-                // Test all objects in group - are they all tree parts?
-
-                // TODO?: a better rule might be "if any group is hanging and is also touching the solid box X or Z faces, delete it"
-                // This would certainly be good for trees, though I think deleting hanging trees always is a safe thing.
-
-                // assume delete unless we find something non-wood
-                deleteGroup = 1;
-                treeParts = 0x0;
-                for ( x = pGroup->bounds.min[X]; deleteGroup && x <= pGroup->bounds.max[X]; x++ )
-                {
-                    for ( z = pGroup->bounds.min[Z]; deleteGroup && z <= pGroup->bounds.max[Z]; z++ )
-                    {
-                        boxIndex = BOX_INDEX(x,pGroup->bounds.min[Y],z);
-                        for ( y = pGroup->bounds.min[Y]; deleteGroup && y <= pGroup->bounds.max[Y]; y++, boxIndex++ )
-                        {
-                            // is this group one that should get filled by the master group?
-                            if ( gBoxData[boxIndex].group == i)
-                            {
-                                // group matches: is it a tree part? Or is it a glass bubble that is
-                                // is surrounded by tree bits? (this can happen, some trees grow funny)
-                                if ( (gBlockDefinitions[gBoxData[boxIndex].type].flags & BLF_TREE_PART) ||
-                                    (gBoxData[boxIndex].origType == BLOCK_AIR) || (gBoxData[boxIndex].origType == BLOCK_VINES) )
-                                {
-                                    // tree part, mark which parts
-                                    treeParts |= gBlockDefinitions[gBoxData[boxIndex].type].flags;
-                                }
-                                else
-                                {
-                                    deleteGroup = 0;
-                                }
-                            }
-                        }
-                    }
-                }
-                if ( deleteGroup )
-                {
-                    // final test; were there any leaves? If no leaves in leaves & trunk, then just trunk,
-                    // which could be fine: totem pole, house, etc.
-                    if ( !(treeParts & BLF_LEAF_PART) )
-                    {
-                        // no leaves, so don't delete
-                        deleteGroup = 0;
-                    }
-                }
+                // If not too small, is it all tree? If no leaves in leaves & trunk, then just trunk,
+                // which could be fine: totem pole, house, etc.
+                deleteGroup = !notTree[i] && (treeParts[i] & BLF_LEAF_PART);
             }
             // ok, tests done: delete?
             if ( deleteGroup )
             {
                 assert( i == pGroup->groupID );
-                neighborGroups = (int *)malloc((gGroupCount+1)*sizeof(int));
-                memset(neighborGroups,0,(gGroupCount+1)*sizeof(int));
-                neighborGroups[i] = 1;
                 gStats.blocksFloaterDeleted += pGroup->population;
-                fillGroups( &(pGroup->bounds), SURROUND_AIR_GROUP, 0, BLOCK_AIR, neighborGroups );
+                mergeGroupInto( i, SURROUND_AIR_GROUP, 0, BLOCK_AIR );
                 gStats.floaterGroupsDeleted++;
                 gSolidGroups--;
                 assert(gSolidGroups >= 0);
-                free(neighborGroups);
             }
         }
     }
+
+    // now actually delete the blocks
+    retCode = applyGroupMerges();
+
+    free(treeParts);
+    free(notTree);
+    return retCode;
 }
 
 static int determineScaleAndHollowAndMelt()
@@ -8970,7 +10318,17 @@ static int determineScaleAndHollowAndMelt()
         // this location. Save the location in a list and move on (since this location will
         // affect other picks).
         // [We could try to share neighbors samples from location to location, but that's messy.]
-        hollowBottomOfModel();
+        // Or, hollow everything far enough inside the model at once, using the distance to the nearest air.
+        if ( gOptions->exportFlags & EXPT_HOLLOW_BY_DISTANCE )
+        {
+            int retCode = hollowByDistance();
+            if ( retCode >= MW_BEGIN_ERRORS )
+                return retCode;
+        }
+        else
+        {
+            hollowBottomOfModel();
+        }
     }
 
     if ( gOptions->pEFD->chkMeltSnow )
@@ -9398,6 +10756,289 @@ static void hollowSeed( int x, int y, int z, IPoint **pSeedList, int *seedSize,
     }
 }
 
+// Lower envelope of parabolas (Meijster et al.) for one line of a squared distance transform:
+// dist[i*stride] becomes the minimum over j of dist[j*stride] + (i-j)^2, clamped to cap.
+// g, s and t are scratch arrays of at least n entries.
+static void distanceTransformLine( unsigned short *dist, int stride, int n, int cap, int *g, int *s, int *t )
+{
+    int i,k,w;
+
+    for ( i = 0; i < n; i++ )
+    {
+        g[i] = dist[i*stride];
+    }
+
+    // find which parabolas make up the lower envelope, s is each parabola's center, t where it starts to be lowest
+    k = 0;
+    s[0] = 0;
+    t[0] = 0;
+    for ( i = 1; i < n; i++ )
+    {
+        while ( k >= 0 &&
+            (t[k]-s[k])*(t[k]-s[k]) + g[s[k]] > (t[k]-i)*(t[k]-i) + g[i] )
+        {
+            k--;
+        }
+        if ( k < 0 )
+        {
+            k = 0;
+            s[0] = i;
+        }
+        else
+        {
+            // where the new parabola becomes lower than the last one on the envelope
+            w = 1 + ( i*i - s[k]*s[k] + g[i] - g[s[k]] ) / ( 2*(i-s[k]) );
+            if ( w < n )
+            {
+                k++;
+                s[k] = i;
+                t[k] = w;
+            }
+        }
+    }
+
+    // and read the envelope back out
+    for ( i = n-1; i >= 0; i-- )
+    {
+        int d = (i-s[k])*(i-s[k]) + g[s[k]];
+        dist[i*stride] = (unsigned short)((d < cap) ? d : cap);
+        if ( i == t[k] )
+            k--;
+    }
+}
+
+// Hollow out the model using a distance transform: every solid block that is more than gHollowBlockThickness blocks
+// from any air is removed, all at once. The bottom of the solid box is not treated as air, so hollows reaching
+// the bottom layer open up there, same as hollowBottomOfModel. If EXPT_HOLLOW_DRAIN_HOLES is set, hollows that
+// are closed off are also removed, and a hole is drilled straight down from the lowest block of each to the
+// next air below, so material can drain out. Otherwise closed hollows are left solid.
+static int hollowByDistance()
+{
+    int x,y,z,i,boxIndex,distIndex;
+    int sx,sy,sz,sizeYZ,maxSize;
+    int cap,linearCap;
+    unsigned short *dist;
+    int *g, *s, *t;
+    int *cellList;
+    int cellListSize = 1000;
+    int drainHoles = ( gOptions->exportFlags & EXPT_HOLLOW_DRAIN_HOLES ) ? 1 : 0;
+
+    assert(gOptions->pEFD->hollowThicknessVal[gOptions->pEFD->fileType] > 0.0f);
+    gHollowBlockThickness = (int)(ceil(gOptions->pEFD->hollowThicknessVal[gOptions->pEFD->fileType]*MM_TO_METERS/gModel.scale));
+    // squared distances are kept as unsigned shorts, so limit the thickness; nothing will get hollowed that thick anyway.
+    if ( gHollowBlockThickness > 254 )
+        gHollowBlockThickness = 254;
+    // removed blocks are those at least this squared distance from air, i.e. with gHollowBlockThickness blocks between
+    // them and the air. This also means any block with air in its 26 neighbors is never removed, so walls stay manifold.
+    linearCap = gHollowBlockThickness+1;
+    cap = linearCap*linearCap;
+
+    sx = gSolidBox.max[X] - gSolidBox.min[X] + 1;
+    sy = gSolidBox.max[Y] - gSolidBox.min[Y] + 1;
+    sz = gSolidBox.max[Z] - gSolidBox.min[Z] + 1;
+    sizeYZ = sy*sz;
+    maxSize = ( sx > sy ) ? sx : sy;
+    maxSize = ( sz > maxSize ) ? sz : maxSize;
+
+    dist = (unsigned short *)malloc(sx*sizeYZ*sizeof(unsigned short));
+    g = (int *)malloc(maxSize*sizeof(int));
+    s = (int *)malloc(maxSize*sizeof(int));
+    t = (int *)malloc(maxSize*sizeof(int));
+    cellList = (int *)malloc(cellListSize*sizeof(int));
+    if ( dist == NULL || g == NULL || s == NULL || t == NULL || cellList == NULL )
+    {
+        free(dist);
+        free(g);
+        free(s);
+        free(t);
+        free(cellList);
+        return MW_WORLD_EXPORT_TOO_LARGE;
+    }
+
+    // 1) Y: distance up and down each column to the nearest air. Above the solid box is air, below is not.
+    for ( x = 0; x < sx; x++ )
+    {
+        for ( z = 0; z < sz; z++ )
+        {
+            int d = linearCap;
+            boxIndex = BOX_INDEX(gSolidBox.min[X]+x,gSolidBox.min[Y],gSolidBox.min[Z]+z);
+            distIndex = x*sizeYZ + z*sy;
+            for ( y = 0; y < sy; y++ )
+            {
+                if ( gBoxData[boxIndex+y].type == BLOCK_AIR )
+                    d = 0;
+                else if ( d < linearCap )
+                    d++;
+                dist[distIndex+y] = (unsigned short)d;
+            }
+            d = 1;
+            for ( y = sy-1; y >= 0; y-- )
+            {
+                if ( dist[distIndex+y] == 0 )
+                    d = 0;
+                else if ( d < dist[distIndex+y] )
+                    dist[distIndex+y] = (unsigned short)d;
+                if ( d < linearCap )
+                    d++;
+            }
+            // now square the distances, which are at most linearCap
+            for ( y = 0; y < sy; y++ )
+            {
+                dist[distIndex+y] = (unsigned short)(dist[distIndex+y]*dist[distIndex+y]);
+            }
+        }
+    }
+
+    // 2) Z: each row, then the air just off the -Z and +Z sides of the box.
+    for ( x = 0; x < sx; x++ )
+    {
+        for ( y = 0; y < sy; y++ )
+        {
+            distIndex = x*sizeYZ + y;
+            distanceTransformLine( &dist[distIndex], sy, sz, cap, g, s, t );
+            for ( z = 0; z < sz; z++ )
+            {
+                int d2 = (z+1)*(z+1);
+                if ( (sz-z)*(sz-z) < d2 )
+                    d2 = (sz-z)*(sz-z);
+                if ( d2 < dist[distIndex+z*sy] )
+                    dist[distIndex+z*sy] = (unsigned short)d2;
+            }
+        }
+    }
+
+    // 3) X: same, for the air off the -X and +X sides.
+    for ( z = 0; z < sz; z++ )
+    {
+        for ( y = 0; y < sy; y++ )
+        {
+            distIndex = z*sy + y;
+            distanceTransformLine( &dist[distIndex], sizeYZ, sx, cap, g, s, t );
+            for ( x = 0; x < sx; x++ )
+            {
+                int d2 = (x+1)*(x+1);
+                if ( (sx-x)*(sx-x) < d2 )
+                    d2 = (sx-x)*(sx-x);
+                if ( d2 < dist[distIndex+x*sizeYZ] )
+                    dist[distIndex+x*sizeYZ] = (unsigned short)d2;
+            }
+        }
+    }
+
+    // Find each hollow, i.e. each connected set of blocks at distance cap. Blocks are marked as visited
+    // by setting their distance to 0, as if they were air.
+    for ( x = 0; x < sx; x++ )
+    {
+        for ( z = 0; z < sz; z++ )
+        {
+            for ( y = 0; y < sy; y++ )
+            {
+                int cellCount, cellsDone, open, lowest;
+                distIndex = x*sizeYZ + z*sy + y;
+                if ( dist[distIndex] != cap )
+                    continue;
+
+                // flood out through the six neighbors, listing the blocks in the hollow
+                dist[distIndex] = 0;
+                cellList[0] = distIndex;
+                cellCount = 1;
+                open = 0;
+                lowest = distIndex;
+                for ( cellsDone = 0; cellsDone < cellCount; cellsDone++ )
+                {
+                    int cell = cellList[cellsDone];
+                    int cx = cell / sizeYZ;
+                    int cz = (cell % sizeYZ) / sy;
+                    int cy = cell % sy;
+                    int neighbor[6];
+                    int nc = 0;
+
+                    if ( cy == 0 )
+                        // touches the bottom, so will open up there
+                        open = 1;
+                    else if ( cy < lowest % sy )
+                        lowest = cell;
+
+                    if ( cx > 0 ) neighbor[nc++] = cell - sizeYZ;
+                    if ( cx < sx-1 ) neighbor[nc++] = cell + sizeYZ;
+                    if ( cy > 0 ) neighbor[nc++] = cell - 1;
+                    if ( cy < sy-1 ) neighbor[nc++] = cell + 1;
+                    if ( cz > 0 ) neighbor[nc++] = cell - sy;
+                    if ( cz < sz-1 ) neighbor[nc++] = cell + sy;
+
+                    // make sure there's room for all six
+                    if ( cellCount + 6 > cellListSize )
+                    {
+                        int *newList;
+                        cellListSize = (int)(cellListSize * 1.4 + 6);
+                        newList = (int *)realloc(cellList,cellListSize*sizeof(int));
+                        if ( newList == NULL )
+                        {
+                            free(cellList);
+                            free(dist);
+                            free(g);
+                            free(s);
+                            free(t);
+                            return MW_WORLD_EXPORT_TOO_LARGE;
+                        }
+                        cellList = newList;
+                    }
+                    for ( i = 0; i < nc; i++ )
+                    {
+                        if ( dist[neighbor[i]] == cap )
+                        {
+                            dist[neighbor[i]] = 0;
+                            cellList[cellCount++] = neighbor[i];
+                        }
+                    }
+                }
+
+                if ( open || drainHoles )
+                {
+                    for ( i = 0; i < cellCount; i++ )
+                    {
+                        int cell = cellList[i];
+                        boxIndex = BOX_INDEX(gSolidBox.min[X] + cell / sizeYZ, gSolidBox.min[Y] + cell % sy, gSolidBox.min[Z] + (cell % sizeYZ) / sy);
+                        assert(gBoxData[boxIndex].type != BLOCK_AIR);
+                        // as with hollowBottomOfModel, populations are not updated, hollowing is the last operation.
+                        gBoxData[boxIndex].type = BLOCK_AIR;
+                        // special use of group 0 - for hollow
+                        gBoxData[boxIndex].group = HOLLOW_AIR_GROUP;
+                        gBlockCount--;
+                        gStats.blocksHollowed++;
+                    }
+                }
+
+                if ( !open && drainHoles )
+                {
+                    // Drill down from the lowest block until air is reached, or the bottom of the box. Any hollow found
+                    // below has a lower block than this one, so it is open or gets its own hole, and so drains.
+                    // A hollow not yet found also stops the drill, as it will get hollowed in turn.
+                    int holeIndex = lowest - 1;
+                    boxIndex = BOX_INDEX(gSolidBox.min[X] + lowest / sizeYZ, gSolidBox.min[Y] + lowest % sy - 1, gSolidBox.min[Z] + (lowest % sizeYZ) / sy);
+                    for ( i = lowest % sy - 1; i >= 0; i--, holeIndex--, boxIndex-- )
+                    {
+                        if ( gBoxData[boxIndex].type == BLOCK_AIR || dist[holeIndex] == cap )
+                            break;
+                        gBoxData[boxIndex].type = BLOCK_AIR;
+                        gBoxData[boxIndex].group = HOLLOW_AIR_GROUP;
+                        gBlockCount--;
+                        gStats.blocksDrained++;
+                    }
+                }
+            }
+        }
+    }
+
+    free(cellList);
+    free(dist);
+    free(g);
+    free(s);
+    free(t);
+
+    return MW_NO_ERROR;
+}
+
 static void meltSnow()
 {
     int x,y,z,boxIndex;
@@ -9520,12 +11161,42 @@ static int generateBlockDataAndStatistics()
                 }
             }
         }
+
+        // when streaming, write out each slab as it is finished
+        if ( gStreamOBJ && ( ( (loc[X] - gSolidBox.min[X] + 1) % STREAM_SLAB_ROWS == 0 ) || ( loc[X] == gSolidBox.max[X] ) ) )
+        {
+            retCode |= streamOBJSlab( loc[X]+1 );
+            if ( retCode >= MW_BEGIN_ERRORS ) return retCode;
+        }
     }
 
     UPDATE_PROGRESS(pgFaceStart + pgFaceOffset);
 
+    // streamed slabs have already been transformed, sorted and written
+    if ( gStreamOBJ )
+    {
+        return retCode;
+    }
+
     // now that we have the scale and world offset, and all vertices are now generated, transform all points to their proper locations
-    for ( i = 0; i < gModel.vertexCount; i++ )
+    transformVertices( 0 );
+
+    // If we are grouping by material (e.g., STL does not need this), then we need to sort by material
+    if ( gOptions->exportFlags & EXPT_GROUP_BY_MATERIAL )
+    {
+        Timing_Start(TIMING_SORT);
+        retCode |= sortFacesByMaterial();
+        Timing_Stop(TIMING_SORT);
+    }
+
+    return retCode;
+}
+
+// Move vertices from block coordinates to their output locations, given the scale and world offset.
+static void transformVertices( int startVertex )
+{
+    int i;
+    for ( i = startVertex; i < gModel.vertexCount; i++ )
     {
         float *pt = (float *)gModel.vertices[i];
         float anchor[3];
@@ -9537,21 +11208,68 @@ static int generateBlockDataAndStatistics()
         // rotate location as needed
         rotateLocation( pt );
     }
+}
 
-    // If we are grouping by material (e.g., STL does not need this), then we need to sort by material
-    if ( gOptions->exportFlags & EXPT_GROUP_BY_MATERIAL )
-    {
-        qsort_s(gModel.faceList,gModel.faceCount,sizeof(FaceRecord*),faceIdCompare,NULL);
+// Sort a small key per face, then gather each array of the face store into the sorted order.
+static int sortFacesByMaterial()
+{
+    int i;
+    FaceSortKey *keys;
+    int *scalarList;
+    int (*vectorList)[4];
+    int *swapScalar;
+    int (*swapVector)[4];
+
+    keys = (FaceSortKey *)malloc(gModel.faceCount*sizeof(FaceSortKey));
+    scalarList = (int *)malloc(gModel.faceSize*sizeof(int));
+    vectorList = (int (*)[4])malloc(gModel.faceSize*4*sizeof(int));
+    if ( (keys == NULL) || (scalarList == NULL) || (vectorList == NULL) )
+    {
+        free(keys);
+        free(scalarList);
+        free(vectorList);
+        return MW_WORLD_EXPORT_TOO_LARGE;
     }
 
-    return retCode;
+    for ( i = 0; i < gModel.faceCount; i++ )
+    {
+        keys[i].type = gModel.faces.type[i];
+        keys[i].faceIndex = gModel.faces.faceIndex[i];
+        keys[i].face = i;
+    }
+    qsort_s(keys,gModel.faceCount,sizeof(FaceSortKey),faceIdCompare,NULL);
+
+    // each gather writes into the spare list, which is then swapped with the old array and reused
+#define GATHER_FACE_SCALARS( field ) \
+    for ( i = 0; i < gModel.faceCount; i++ ) \
+        scalarList[i] = gModel.faces.field[keys[i].face]; \
+    swapScalar = gModel.faces.field; gModel.faces.field = scalarList; scalarList = swapScalar;
+#define GATHER_FACE_VECTORS( field ) \
+    for ( i = 0; i < gModel.faceCount; i++ ) \
+        memcpy( vectorList[i], gModel.faces.field[keys[i].face], 4*sizeof(int) ); \
+    swapVector = gModel.faces.field; gModel.faces.field = vectorList; vectorList = swapVector;
+
+    GATHER_FACE_SCALARS( type );
+    GATHER_FACE_SCALARS( faceIndex );
+    GATHER_FACE_SCALARS( normalIndex );
+    GATHER_FACE_VECTORS( vertexIndex );
+    GATHER_FACE_VECTORS( uvIndex );
+
+#undef GATHER_FACE_SCALARS
+#undef GATHER_FACE_VECTORS
+
+    free(keys);
+    free(scalarList);
+    free(vectorList);
+    return MW_NO_ERROR;
 }
+
 static int faceIdCompare( void* context, const void *str1, const void *str2)
 {
-    FaceRecord *f1;
-    FaceRecord *f2;
-    f1 = *(FaceRecord**)str1;
-    f2 = *(FaceRecord**)str2;
+    FaceSortKey *f1;
+    FaceSortKey *f2;
+    f1 = (FaceSortKey*)str1;
+    f2 = (FaceSortKey*)str2;
     context;    // make a useless reference to the unused variable, to avoid C4100 warning
     if ( f1->type == f2->type )
     {
@@ -10300,13 +12018,13 @@ static int saveSpecialVertices( int boxIndex, int faceDirection, IPoint loc, flo
         else
         {
 UseGridLoc:
-            if ( gModel.vertexIndices[vertexIndex] == NO_INDEX_SET )
+            if ( gModel.vertexIndices[vertexIndexSlot(vertexIndex)] == NO_INDEX_SET )
             {
                 // need to give an index and write out vertex location
                 retCode |= checkVertexListSize();
                 if ( retCode >= MW_BEGIN_ERRORS ) return retCode;
 
-                gModel.vertexIndices[vertexIndex] = gModel.vertexCount;
+                gModel.vertexIndices[vertexIndexSlot(vertexIndex)] = gModel.vertexCount;
                 pt = (float *)gModel.vertices[gModel.vertexCount];
 
                 // for now, we use exactly the same coordinates as Minecraft does.
@@ -10328,6 +12046,17 @@ UseGridLoc:
 
 // check if each face vertex has an index;
 // if it doesn't, give it one and save out the vertex location itself
+// Where a grid corner's vertex index is stored. Normally this is the corner's own location; when streaming,
+// the X planes of corners reuse a ring of vertexIndexPlanes planes.
+static int vertexIndexSlot( int vertexIndex )
+{
+    if ( gModel.vertexIndexPlanes == gBoxSize[X] )
+    {
+        return vertexIndex;
+    }
+    return ( (vertexIndex / gBoxSizeYZ) % gModel.vertexIndexPlanes ) * gBoxSizeYZ + vertexIndex % gBoxSizeYZ;
+}
+
 static int saveVertices( int boxIndex, int faceDirection, IPoint loc )
 {
     int vertexIndex;
@@ -10354,13 +12083,13 @@ static int saveVertices( int boxIndex, int faceDirection, IPoint loc )
             return retCode|MW_INTERNAL_ERROR;
         }
 
-        if ( gModel.vertexIndices[vertexIndex] == NO_INDEX_SET )
+        if ( gModel.vertexIndices[vertexIndexSlot(vertexIndex)] == NO_INDEX_SET )
         {
             // need to give an index and write out vertex location
             retCode |= checkVertexListSize();
             if ( retCode >= MW_BEGIN_ERRORS ) return retCode;
 
-            gModel.vertexIndices[vertexIndex] = gModel.vertexCount;
+            gModel.vertexIndices[vertexIndexSlot(vertexIndex)] = gModel.vertexCount;
             pt = (float *)gModel.vertices[gModel.vertexCount];
 
             // for now, we use exactly the same coordinates as Minecraft does.
@@ -10382,21 +12111,23 @@ static int saveVertices( int boxIndex, int faceDirection, IPoint loc )
 static int saveFaceLoop( int boxIndex, int faceDirection, float heights[4], int heightIndices[4] )
 {
     int i;
-    FaceRecord *face;
+    int face;
     int dataVal = 0;
     unsigned char originalType = gBoxData[boxIndex].type;
     int computedSpecialUVs = 0;
     int specialUVindices[4];
     int retCode = MW_NO_ERROR;
 
-    face = allocFaceRecordFromPool();
+    retCode |= checkFaceListSize();
+    if ( retCode >= MW_BEGIN_ERRORS ) return retCode;
+    face = gModel.faceCount;
 
     // if  we sort, we want to keep faces in the order generated, which is
     // generally cache-coherent (and also just easier to view in the file)
-    face->faceIndex = firstFaceModifier( faceDirection == 0, gModel.faceCount );
+    gModel.faces.faceIndex[face] = firstFaceModifier( faceDirection == 0, gModel.faceCount );
 
     // always the same normal, which directly corresponds to the normals[6] array in gModel
-    face->normalIndex = gUsingTransform ? COMPUTE_NORMAL : faceDirection;
+    gModel.faces.normalIndex[face] = gUsingTransform ? COMPUTE_NORMAL : faceDirection;
 
     // get four face indices for the four corners
     for ( i = 0; i < 4; i++ )
@@ -10419,7 +12150,7 @@ static int saveFaceLoop( int boxIndex, int faceDirection, float heights[4], int
             {
                 // use the vertex added in for this location
                 assert(heightIndices[heightLoc] != NO_INDEX_SET);
-                face->vertexIndex[i] = heightIndices[heightLoc];
+                gModel.faces.vertexIndex[face][i] = heightIndices[heightLoc];
 
                 // Since we're saving a special location, we also need a special UV index
                 // to go along with it and use later.
@@ -10487,7 +12218,7 @@ UseGridLoc:
                 offset[Y] +
                 offset[Z] * gBoxSize[Y];
 
-            face->vertexIndex[i] = gModel.vertexIndices[vertexIndex];
+            gModel.faces.vertexIndex[face][i] = gModel.vertexIndices[vertexIndexSlot(vertexIndex)];
         }
     }
 
@@ -10497,7 +12228,7 @@ UseGridLoc:
         // as the material
         if (gOptions->exportFlags & EXPT_DEBUG_SHOW_GROUPS)
         {
-            face->type = getMaterialUsingGroup(gBoxData[boxIndex].group);
+            gModel.faces.type[face] = getMaterialUsingGroup(gBoxData[boxIndex].group);
         }
         else
         {
@@ -10512,7 +12243,7 @@ UseGridLoc:
                 case DIRECTION_BLOCK_TOP:
                     if ( gBoxData[boxIndex].flatFlags & FLAT_FACE_ABOVE )
                     {
-                        face->type = gBoxData[boxIndex+1].origType;
+                        gModel.faces.type[face] = gBoxData[boxIndex+1].origType;
                         dataVal = gBoxData[boxIndex+1].data;    // this should still be intact, even if neighbor block is cleared to air
                         special = 1;
                     }
@@ -10520,7 +12251,7 @@ UseGridLoc:
                 case DIRECTION_BLOCK_BOTTOM:
                     if ( gBoxData[boxIndex].flatFlags & FLAT_FACE_BELOW )
                     {
-                        face->type = gBoxData[boxIndex-1].origType;
+                        gModel.faces.type[face] = gBoxData[boxIndex-1].origType;
                         dataVal = gBoxData[boxIndex-1].data;    // this should still be intact, even if neighbor block is cleared to air
                         special = 1;
                     }
@@ -10528,7 +12259,7 @@ UseGridLoc:
                 case DIRECTION_BLOCK_SIDE_LO_X:
                     if ( gBoxData[boxIndex].flatFlags & FLAT_FACE_LO_X )
                     {
-                        face->type = gBoxData[boxIndex-gBoxSizeYZ].origType;
+                        gModel.faces.type[face] = gBoxData[boxIndex-gBoxSizeYZ].origType;
                         dataVal = gBoxData[boxIndex-gBoxSizeYZ].data;
                         special = 1;
                     }
@@ -10536,7 +12267,7 @@ UseGridLoc:
                 case DIRECTION_BLOCK_SIDE_HI_X:
                     if ( gBoxData[boxIndex].flatFlags & FLAT_FACE_HI_X )
                     {
-                        face->type = gBoxData[boxIndex+gBoxSizeYZ].origType;
+                        gModel.faces.type[face] = gBoxData[boxIndex+gBoxSizeYZ].origType;
                         dataVal = gBoxData[boxIndex+gBoxSizeYZ].data;
                         special = 1;
                     }
@@ -10544,7 +12275,7 @@ UseGridLoc:
                 case DIRECTION_BLOCK_SIDE_LO_Z:
                     if ( gBoxData[boxIndex].flatFlags & FLAT_FACE_LO_Z )
                     {
-                        face->type = gBoxData[boxIndex-gBoxSize[Y]].origType;
+                        gModel.faces.type[face] = gBoxData[boxIndex-gBoxSize[Y]].origType;
                         dataVal = gBoxData[boxIndex-gBoxSize[Y]].data;
                         special = 1;
                     }
@@ -10552,7 +12283,7 @@ UseGridLoc:
                 case DIRECTION_BLOCK_SIDE_HI_Z:
                     if ( gBoxData[boxIndex].flatFlags & FLAT_FACE_HI_Z )
                     {
-                        face->type = gBoxData[boxIndex+gBoxSize[Y]].origType;
+                        gModel.faces.type[face] = gBoxData[boxIndex+gBoxSize[Y]].origType;
                         dataVal = gBoxData[boxIndex+gBoxSize[Y]].data;
                         special = 1;
                     }
@@ -10564,23 +12295,23 @@ UseGridLoc:
             }
             if ( !special )
             {
-                face->type = originalType;
+                gModel.faces.type[face] = originalType;
                 dataVal = gBoxData[boxIndex].data;
             }
             else
             {
                 // A flattening has happened.
                 // Test just in case something's wedged
-                if ( face->type == BLOCK_AIR )
+                if ( gModel.faces.type[face] == BLOCK_AIR )
                 {
                     assert(0);
-                    face->type = originalType;
+                    gModel.faces.type[face] = originalType;
                     return retCode|MW_INTERNAL_ERROR;
                 }
             }
         }
 
-        assert(face->type);
+        assert(gModel.faces.type[face]);
     }
     // else no material, so type is not needed
 
@@ -10589,13 +12320,13 @@ UseGridLoc:
         // I guess we really don't need the swatch location returned; it's
         // main effect is to set the proper indices in the texture map itself
         // and note that the swatch is being used
-        (int)getSwatch( face->type, dataVal, faceDirection, boxIndex, face->uvIndex );
+        (int)getSwatch( gModel.faces.type[face], dataVal, faceDirection, boxIndex, gModel.faces.uvIndex[face] );
 
         if ( computedSpecialUVs )
         {
             for ( i = 0; i < 4; i++ )
             {
-                face->uvIndex[i] = specialUVindices[i];
+                gModel.faces.uvIndex[face][i] = specialUVindices[i];
             }
         }
 
@@ -10603,16 +12334,11 @@ UseGridLoc:
         // we might then actually want to use the original type
         //if ( Options.exportFlags & EXPT_OUTPUT_TEXTURE_IMAGES )
         //{
-        //    face->type = originalType;
+        //    gModel.faces.type[face] = originalType;
         //}
     }
 
-    retCode |= checkFaceListSize();
-    if ( retCode >= MW_BEGIN_ERRORS ) return retCode;
-
-    gModel.faceList[gModel.faceCount++] = face;
-    // make sure we're not running off the edge, out of memory.
-    // We don't need this memory when not writing out materials, as we instantly write out the faces
+    gModel.faceCount++;
 
     return retCode;
 }
@@ -12674,33 +14400,19 @@ static void freeModel(Model *pModel)
         free(pModel->vertexIndices);
         pModel->vertexIndices = NULL;
     }
-    if ( pModel->faceList )
+    if ( pModel->carriedVertexIndex )
     {
-        FaceRecordPool *pPool = gModel.faceRecordPool;
-        int i = 0;
-        while (pPool)
-        {
-            UPDATE_PROGRESS( PG_CLEANUP + 0.9f*(PG_END-PG_CLEANUP)*((float)i/(float)pModel->faceCount));
-            i += FACE_RECORD_POOL_SIZE;
-            FaceRecordPool *pPrev = pPool->pPrev;
-            free( pPool );
-            pPool = pPrev;
-        }
-        gModel.faceRecordPool = NULL;
-
-        // about a hundred times slower, without a pool:
-        //int i;
-        //for ( i = 0; i < pModel->faceCount; i++ )
-        //{
-        //    if ( i % 10000 == 0 )
-        //        UPDATE_PROGRESS( PG_CLEANUP + 0.9f*(PG_END-PG_CLEANUP)*((float)i/(float)pModel->faceCount));
-        //    assert( pModel->faceList[i] );
-        //    free( pModel->faceList[i] );
-        //}
-        free(pModel->faceList);
-        pModel->faceList = NULL;
-        pModel->faceSize = 0;
+        free(pModel->carriedVertexIndex);
+        pModel->carriedVertexIndex = NULL;
     }
+    // face store arrays are allocated together, and free(NULL) is fine if one failed
+    free(pModel->faces.type);
+    free(pModel->faces.faceIndex);
+    free(pModel->faces.vertexIndex);
+    free(pModel->faces.normalIndex);
+    free(pModel->faces.uvIndex);
+    memset(&pModel->faces,0,sizeof(FaceStore));
+    pModel->faceSize = 0;
 
     if ( pModel->uvIndexList )
     {
@@ -12729,13 +14441,13 @@ static void freeModel(Model *pModel)
     }
 }
 
-static int findMatchingNormal( FaceRecord *pFace, Vector normal, Vector *normalList, int normalListCount )
+static int findMatchingNormal( int vertexIndex[4], Vector normal, Vector *normalList, int normalListCount )
 {
     // compute the normal for a face
     Vector edge1, edge2;
-    int index0 = pFace->vertexIndex[0];
-    Vec3Op( edge1, =, gModel.vertices[index0], -, gModel.vertices[pFace->vertexIndex[1]] );
-    Vec3Op( edge2, =, gModel.vertices[index0], -, gModel.vertices[pFace->vertexIndex[2]] );
+    int index0 = vertexIndex[0];
+    Vec3Op( edge1, =, gModel.vertices[index0], -, gModel.vertices[vertexIndex[1]] );
+    Vec3Op( edge2, =, gModel.vertices[index0], -, gModel.vertices[vertexIndex[2]] );
     VecCross( normal, =, edge1, X, edge2 );
     float vecdot = VecDot( normal, normal );
     if ( vecdot == 0.0f )
@@ -12788,20 +14500,20 @@ static void resolveFaceNormals()
     for ( int i = 0; i < gModel.faceCount; i++ )
     {
         // output the actual face
-        FaceRecord *pFace = gModel.faceList[i];
-        if ( pFace->normalIndex == COMPUTE_NORMAL )
+        int *pNormalIndex = &gModel.faces.normalIndex[i];
+        if ( *pNormalIndex == COMPUTE_NORMAL )
         {
             // Object may have undergone a transform that changes its normal, so we need to compute
             // the normal now. First try to retrieve it from the list, then add a new one if not found.
             Vector normal;
-            pFace->normalIndex = findMatchingNormal( pFace, normal, gModel.normals, gModel.normalListCount );
+            *pNormalIndex = findMatchingNormal( gModel.faces.vertexIndex[i], normal, gModel.normals, gModel.normalListCount );
 
             // Check if a good match was not found; need to save a new normal if not
-            if ( pFace->normalIndex == COMPUTE_NORMAL )
+            if ( *pNormalIndex == COMPUTE_NORMAL )
             {
-                pFace->normalIndex = addNormalToList( normal, gModel.normals, &gModel.normalListCount, NORMAL_LIST_SIZE );
+                *pNormalIndex = addNormalToList( normal, gModel.normals, &gModel.normalListCount, NORMAL_LIST_SIZE );
             }
-            assert( pFace->normalIndex != COMPUTE_NORMAL );
+            assert( *pNormalIndex != COMPUTE_NORMAL );
         }
 // to test if the normal direction saved by the code is in agreement with the normal direction computed.
 // We could simply take out the normalIndex == COMPUTE_NORMAL test at the start and have every normal get computed and
@@ -12810,8 +14522,8 @@ static void resolveFaceNormals()
 //        else
 //        {
 //            Vector tnormal;
-//            int index = findMatchingNormal( pFace, tnormal, gModel.normals, gModel.normalListCount );
-//            assert( pFace->normalIndex == index );
+//            int index = findMatchingNormal( gModel.faces.vertexIndex[i], tnormal, gModel.normals, gModel.normalListCount );
+//            assert( *pNormalIndex == index );
 //        }
 //#endif
     }
@@ -12820,39 +14532,22 @@ static void resolveFaceNormals()
 // return 0 if no write
 static int writeOBJBox( const wchar_t *world, IBox *worldBox, const wchar_t *curDir, const wchar_t *terrainFileName )
 {
-    // set to 1 if you want absolute (positive) indices used in the faces
-    int absoluteIndices = (gOptions->exportFlags & EXPT_OUTPUT_OBJ_REL_COORDINATES) ? 0 : 1;
-
-#ifdef WIN32
-    DWORD br;
-#endif
     wchar_t objFileNameWithSuffix[MAX_PATH];
 
     char outputString[MAX_PATH];
-    char mtlName[MAX_PATH];
     const char *justWorldFileName;
     char justMtlFileName[MAX_PATH];
 
-    int i, groupCount;
-
-    unsigned char outputMaterial[NUM_BLOCKS];
-
     int exportMaterials;
 
     int retCode = MW_NO_ERROR;
 
     char worldNameUnderlined[256];
-    int prevType;
-
-    FaceRecord *pFace;
 
     char worldChar[MAX_PATH];
     char outChar[MAX_PATH];
 
 #define OUTPUT_NORMALS
-#ifdef OUTPUT_NORMALS
-    int outputFaceDirection;
-#endif
 
     exportMaterials = gOptions->exportFlags & EXPT_OUTPUT_MATERIALS;
 
@@ -12860,16 +14555,15 @@ static int writeOBJBox( const wchar_t *world, IBox *worldBox, const wchar_t *cur
 
     // create the Wavefront OBJ file
     //DeleteFile(objFileNameWithSuffix);
-    gModelFile=PortaCreate(objFileNameWithSuffix);
-    addOutputFilenameToList(objFileNameWithSuffix);
-    if (gModelFile == INVALID_HANDLE_VALUE)
+    gModelFile = createOutputFile(objFileNameWithSuffix);
+    if (gModelFile == NULL)
         return retCode|MW_CANNOT_CREATE_FILE;
 
     wcharToChar(world,worldChar);	// don't touch worldChar after this, as justWorldFileName depends on it
     justWorldFileName = removePathChar(worldChar);
 
     sprintf_s(outputString,256,"# Wavefront OBJ file made by Mineways version %d.%d, http://mineways.com\n", gMajorVersion, gMinorVersion );
-    WERROR(PortaWrite(gModelFile, outputString, strlen(outputString) ));
+    WERROR(writeOutputFile(gModelFile, outputString, strlen(outputString) ));
 
     retCode |= writeStatistics( gModelFile, justWorldFileName, worldBox );
     if ( retCode >= MW_BEGIN_ERRORS )
@@ -12877,15 +14571,15 @@ static int writeOBJBox( const wchar_t *world, IBox *worldBox, const wchar_t *cur
 
     // Debug info, to figure out Mac paths:
     sprintf_s(outputString,256,"\n# Full world path: %s\n", worldChar );
-    WERROR(PortaWrite(gModelFile, outputString, strlen(outputString) ));
+    WERROR(writeOutputFile(gModelFile, outputString, strlen(outputString) ));
 
     wcharToChar(terrainFileName,outChar);
     sprintf_s(outputString,256,"# Full terrainExt.png path: %s\n", outChar );
-    WERROR(PortaWrite(gModelFile, outputString, strlen(outputString) ));
+    WERROR(writeOutputFile(gModelFile, outputString, strlen(outputString) ));
 
     wcharToChar(curDir,outChar);
     sprintf_s(outputString,256,"# Full current path: %s\n", outChar );
-    WERROR(PortaWrite(gModelFile, outputString, strlen(outputString) ));
+    WERROR(writeOutputFile(gModelFile, outputString, strlen(outputString) ));
 
 
     // If we use materials, say where the file is
@@ -12894,7 +14588,7 @@ static int writeOBJBox( const wchar_t *world, IBox *worldBox, const wchar_t *cur
         sprintf_s(justMtlFileName,MAX_PATH,"%s.mtl",gOutputFileRootCleanChar);
 
         sprintf_s(outputString,256,"\nmtllib %s\n", justMtlFileName );
-        WERROR(PortaWrite(gModelFile, outputString, strlen(outputString) ));
+        WERROR(writeOutputFile(gModelFile, outputString, strlen(outputString) ));
     }
 
     // replace spaces with underscores for world name output
@@ -12905,66 +14599,191 @@ static int writeOBJBox( const wchar_t *world, IBox *worldBox, const wchar_t *cur
     sprintf_s(outputString,256,"\no %s__%d_%d_%d_to_%d_%d_%d\n", worldNameUnderlined,
         worldBox->min[X], worldBox->min[Y], worldBox->min[Z],
         worldBox->max[X], worldBox->max[Y], worldBox->max[Z] );
-    WERROR(PortaWrite(gModelFile, outputString, strlen(outputString) ));
+    WERROR(writeOutputFile(gModelFile, outputString, strlen(outputString) ));
 
-#ifdef OUTPUT_NORMALS
-    resolveFaceNormals();
+    // from here on, all lines go through the output buffer; flushed at Exit
+    retCode |= startBufferedOutput();
+    if ( retCode >= MW_BEGIN_ERRORS )
+        goto Exit;
 
-    // write out normals, texture coordinates, vertices, and then faces grouped by material
-    for ( i = 0; i < gModel.normalListCount; i++ )
+    if ( gOptions->exportFlags & EXPT_OUTPUT_OBJ_FIXED_PRECISION )
+    {
+        // Enough decimals to resolve a sixteenth of a block (one texel of a standard tile) in the
+        // output units, plus two more digits; for UVs, enough to resolve a texel of the output texture.
+        gVertexDecimals = (int)ceil( -log10( gModel.scale*gUnitsScale/16.0f ) ) + 2;
+        gVertexDecimals = clamp( gVertexDecimals, 0, 9 );
+        gUVDecimals = gExportTexture ? (int)ceil( log10( (float)gModel.textureResolution ) ) + 2 : 6;
+        gUVDecimals = clamp( gUVDecimals, 0, 9 );
+    }
+    else
+    {
+        gVertexDecimals = -1;
+        gUVDecimals = -1;
+    }
+
+    gOBJPrevType = -1;
+    gOBJGroupCount = 0;
+    gOBJSingleMaterialOutput = 0;
+    // gOBJOutputMaterial notes when a material is used for the first time;
+    // needed when objects are not sorted by material (grouped by block), or are sorted only within a slab.
+    memset(gOBJOutputMaterial,0,sizeof(gOBJOutputMaterial));
+
+    if ( gStreamOBJ )
+    {
+        // make the faces, writing out each slab as it is done
+        Timing_Start(TIMING_FACES);
+        retCode |= generateBlockDataAndStatistics();
+        Timing_Stop(TIMING_FACES);
+        if ( retCode >= MW_BEGIN_ERRORS )
+            goto Exit;
+
+        // the header could not give these, as they were not known yet
+        sprintf_s(outputString,256,"\n# %d vertices, %d faces (%d triangles)\n", gModel.writtenVertexCount, gModel.writtenFaceCount, 2*gModel.writtenFaceCount);
+        WERROR(bufferedWrite(outputString));
+    }
+    else
+    {
+        retCode |= writeOBJSlab();
+        if ( retCode >= MW_BEGIN_ERRORS )
+            goto Exit;
+    }
+
+    WERROR(flushBufferedOutput());
+
+Exit:
+    closeOutputFile(&gModelFile);
+
+    // should we call it a day here?
+    if ( retCode >= MW_BEGIN_ERRORS ) return retCode;
+
+    // write materials file
+    if ( exportMaterials )
     {
-        sprintf_s(outputString,256,"vn %g %g %g\n", gModel.normals[i][0], gModel.normals[i][1], gModel.normals[i][2]);
-        WERROR(PortaWrite(gModelFile, outputString, strlen(outputString)));
+        // write material file
+        retCode |= writeOBJMtlFile();
+        if ( retCode >= MW_BEGIN_ERRORS ) return retCode;
     }
+
+    return retCode;
+}
+
+// Write out the normals, texture coordinates and vertices not yet in the file, then the faces in the list.
+// Without streaming this is called once, for the whole model.
+static int writeOBJSlab()
+{
+    // set to 1 if you want absolute (positive) indices used in the faces
+    int absoluteIndices = (gOptions->exportFlags & EXPT_OUTPUT_OBJ_REL_COORDINATES) ? 0 : 1;
+
+    char outputString[MAX_PATH];
+    char mtlName[MAX_PATH];
+
+    int i, j;
+
+    int exportMaterials = gOptions->exportFlags & EXPT_OUTPUT_MATERIALS;
+
+    int retCode = MW_NO_ERROR;
+
+    char *pOut;
+    int vertexOffset, uvOffset;
+    int firstNewVertex;
+
+    int outputFaceDirection;
+
+#ifdef OUTPUT_NORMALS
+    resolveFaceNormals();
+
+    // write out normals, texture coordinates, vertices, and then faces grouped by material
+    for ( i = gModel.writtenNormalCount; i < gModel.normalListCount; i++ )
+    {
+        // normals are few, so always use full precision
+        pOut = bufferedOutputLine();
+        WERROR(pOut == NULL);
+        pOut = appendString(pOut, "vn ");
+        pOut = appendFloat(pOut, gModel.normals[i][0], -1);
+        *pOut++ = ' ';
+        pOut = appendFloat(pOut, gModel.normals[i][1], -1);
+        *pOut++ = ' ';
+        pOut = appendFloat(pOut, gModel.normals[i][2], -1);
+        *pOut++ = '\n';
+        endBufferedOutputLine(pOut);
+    }
+    gModel.writtenNormalCount = gModel.normalListCount;
 #endif
 
     if ( gExportTexture )
     {
-        int prevSwatch = -1;
-        for ( i = 0; i < gModel.uvIndexCount; i++ )
+        int prevSwatch = ( gModel.writtenUVCount > 0 ) ? gModel.uvIndexList[gModel.writtenUVCount-1].swatchLoc : -1;
+        for ( i = gModel.writtenUVCount; i < gModel.uvIndexCount; i++ )
         {
             retCode |= writeOBJTextureUV(gModel.uvIndexList[i].uc, gModel.uvIndexList[i].vc, prevSwatch!=gModel.uvIndexList[i].swatchLoc, gModel.uvIndexList[i].swatchLoc);
             prevSwatch = gModel.uvIndexList[i].swatchLoc;
             if (retCode >= MW_BEGIN_ERRORS)
-                goto Exit;
+                return retCode;
         }
+        gModel.writtenUVCount = gModel.uvIndexCount;
     }
 
-    for ( i = 0; i < gModel.vertexCount; i++ )
+    // vertices carried over from the previous slab are already in the file
+    for ( i = gModel.carriedVertexCount; i < gModel.vertexCount; i++ )
     {
-        if ( i % 1000 == 0 )
+        if ( !gStreamOBJ && ( i % 1000 == 0 ) )
             UPDATE_PROGRESS( PG_OUTPUT + 0.5f*(PG_TEXTURE-PG_OUTPUT)*((float)i/(float)gModel.vertexCount));
 
-        sprintf_s(outputString,256,"v %g %g %g\n", gModel.vertices[i][X], gModel.vertices[i][Y], gModel.vertices[i][Z] );
-        WERROR(PortaWrite(gModelFile, outputString, strlen(outputString) ));
+        pOut = bufferedOutputLine();
+        WERROR(pOut == NULL);
+        *pOut++ = 'v';
+        *pOut++ = ' ';
+        pOut = appendFloat(pOut, gModel.vertices[i][X], gVertexDecimals);
+        *pOut++ = ' ';
+        pOut = appendFloat(pOut, gModel.vertices[i][Y], gVertexDecimals);
+        *pOut++ = ' ';
+        pOut = appendFloat(pOut, gModel.vertices[i][Z], gVertexDecimals);
+        *pOut++ = '\n';
+        endBufferedOutputLine(pOut);
+    }
+    firstNewVertex = gModel.writtenVertexCount;
+    gModel.writtenVertexCount += gModel.vertexCount - gModel.carriedVertexCount;
+
+    // when streaming, turn the face vertex indices in this slab's list into indices in the file
+    if ( firstNewVertex > 0 || gModel.carriedVertexCount > 0 )
+    {
+        for ( i = 0; i < gModel.faceCount; i++ )
+        {
+            int *pVertexIndex = gModel.faces.vertexIndex[i];
+            for ( j = 0; j < 4; j++ )
+            {
+                pVertexIndex[j] = ( pVertexIndex[j] < gModel.carriedVertexCount ) ?
+                    gModel.carriedVertexIndex[pVertexIndex[j]] :
+                    firstNewVertex + pVertexIndex[j] - gModel.carriedVertexCount;
+            }
+        }
     }
 
     //if ( exportMaterials && (gOptions->exportFlags & EXPT_OUTPUT_NEUTRAL_MATERIAL) )
     //{
     //    sprintf_s(outputString,256,"\ng world\nusemtl object_material\n");
-    //    WERROR(PortaWrite(gModelFile, outputString, strlen(outputString) ));
+    //    WERROR(writeOutputFile(gModelFile, outputString, strlen(outputString) ));
     //}
 
-    prevType = -1;
-    groupCount = 0;
-    // outputMaterial notes when a material is used for the first time;
-    // should only be needed for when objects are not sorted by material (grouped by block).
-    memset(outputMaterial,0,sizeof(outputMaterial));
-
     // test for a single material output. If so, do it now and reset materials in general
-    if ( exportMaterials )
+    if ( exportMaterials && !gOBJSingleMaterialOutput )
     {
         // should there be just one single material in this OBJ file?
         if ( !(gOptions->exportFlags & EXPT_OUTPUT_OBJ_MATERIAL_PER_TYPE) )
         {
             sprintf_s(outputString,256,"\nusemtl %s\n", MINECRAFT_SINGLE_MATERIAL);
-            WERROR(PortaWrite(gModelFile, outputString, strlen(outputString) ));
+            WERROR(bufferedWrite(outputString));
         }
+        gOBJSingleMaterialOutput = 1;
     }
 
+    // face vertex and UV indices are either absolute (1 is the first) or relative (-1 is the last one output)
+    vertexOffset = absoluteIndices ? 1 : -gModel.writtenVertexCount;
+    uvOffset = absoluteIndices ? 1 : -gModel.writtenUVCount;
+
     for ( i = 0; i < gModel.faceCount; i++ )
     {
-        if ( i % 1000 == 0 )
+        if ( !gStreamOBJ && ( i % 1000 == 0 ) )
             UPDATE_PROGRESS( PG_OUTPUT + 0.5f*(PG_TEXTURE-PG_OUTPUT) + 0.5f*(PG_TEXTURE-PG_OUTPUT)*((float)i/(float)gModel.faceCount));
 
         if ( exportMaterials )
@@ -12973,13 +14792,13 @@ static int writeOBJBox( const wchar_t *world, IBox *worldBox, const wchar_t *cur
             if ( gOptions->exportFlags & (EXPT_OUTPUT_OBJ_MATERIAL_PER_TYPE|EXPT_OUTPUT_OBJ_GROUPS) )
             {
                 // did we reach a new material?
-                if ( prevType != gModel.faceList[i]->type )
+                if ( gOBJPrevType != gModel.faces.type[i] )
                 {
-                    prevType = gModel.faceList[i]->type;
+                    gOBJPrevType = gModel.faces.type[i];
                     // new ID encountered, so output it: material name, and group
                     // group isn't really required, but can be useful.
                     // Output group only if we're not already using it for individual blocks
-                    strcpy_s(mtlName,256,gBlockDefinitions[prevType].name);
+                    strcpy_s(mtlName,256,gBlockDefinitions[gOBJPrevType].name);
 
                     // substitute ' ' to '_'
                     spacesToUnderlinesChar( mtlName );
@@ -12987,29 +14806,33 @@ static int writeOBJBox( const wchar_t *world, IBox *worldBox, const wchar_t *cur
                     if ( gOptions->exportFlags & EXPT_GROUP_BY_BLOCK )
                     {
                         sprintf_s(outputString,256,"\nusemtl %s\n", mtlName);
-                        WERROR(PortaWrite(gModelFile, outputString, strlen(outputString) ));
+                        WERROR(bufferedWrite(outputString));
                         // note which material is to be output, if not output already
-                        if ( outputMaterial[prevType] == 0 )
+                        if ( gOBJOutputMaterial[gOBJPrevType] == 0 )
                         {
-                            gModel.mtlList[gModel.mtlCount++] = prevType;
-                            outputMaterial[prevType] = 1;
+                            gModel.mtlList[gModel.mtlCount++] = gOBJPrevType;
+                            gOBJOutputMaterial[gOBJPrevType] = 1;
                         }
                     }
                     else
                     {
-                        strcpy_s(outputString,256,"\n");
-                        WERROR(PortaWrite(gModelFile, outputString, strlen(outputString) ));
+                        WERROR(bufferedWrite("\n"));
 
                         if ( gOptions->exportFlags & EXPT_OUTPUT_OBJ_GROUPS )
                         {
                             sprintf_s(outputString,256,"g %s\n", mtlName);
-                            WERROR(PortaWrite(gModelFile, outputString, strlen(outputString) ));
+                            WERROR(bufferedWrite(outputString));
                         }
                         if ( gOptions->exportFlags & EXPT_OUTPUT_OBJ_MATERIAL_PER_TYPE )
                         {
                             sprintf_s(outputString,256,"usemtl %s\n", mtlName);
-                            WERROR(PortaWrite(gModelFile, outputString, strlen(outputString) ));
-                            gModel.mtlList[gModel.mtlCount++] = prevType;
+                            WERROR(bufferedWrite(outputString));
+                            // a streamed material can show up again in a later slab
+                            if ( gOBJOutputMaterial[gOBJPrevType] == 0 )
+                            {
+                                gModel.mtlList[gModel.mtlCount++] = gOBJPrevType;
+                                gOBJOutputMaterial[gOBJPrevType] = 1;
+                            }
                         }
                         // else don't output material
                     }
@@ -13017,260 +14840,169 @@ static int writeOBJBox( const wchar_t *world, IBox *worldBox, const wchar_t *cur
             }
         }
 
-        // output the actual face
-        pFace = gModel.faceList[i];
-
         // if we're outputting each individual block, set a unique group name here.
-        if ( (gOptions->exportFlags & EXPT_GROUP_BY_BLOCK) && pFace->faceIndex <= 0 )
+        if ( (gOptions->exportFlags & EXPT_GROUP_BY_BLOCK) && gModel.faces.faceIndex[i] <= 0 )
         {
-            sprintf_s(outputString,256,"\ng block_%05d\n", ++groupCount);
-            WERROR(PortaWrite(gModelFile, outputString, strlen(outputString) ));
+            sprintf_s(outputString,256,"\ng block_%05d\n", ++gOBJGroupCount);
+            WERROR(bufferedWrite(outputString));
         }
 
 #ifdef OUTPUT_NORMALS
+        // with normals - not really needed by most renderers, but good to include;
+        // GLC, for example, does smoothing if normals are not present.
         if ( absoluteIndices )
         {
-            outputFaceDirection = pFace->normalIndex+1;
+            outputFaceDirection = gModel.faces.normalIndex[i]+1;
         }
         else
         {
-            outputFaceDirection = pFace->normalIndex-gModel.normalListCount;
-        }
-#endif
-
-        // first, are there texture coordinates?
-        if ( gExportTexture )
-        {
-#ifdef OUTPUT_NORMALS
-            // with normals - not really needed by most renderers, but good to include;
-            // GLC, for example, does smoothing if normals are not present.
-            // Check if last two vertices match - if so, output a triangle instead 
-            if ( pFace->vertexIndex[2] == pFace->vertexIndex[3] )
-            {
-                // triangle
-                if ( absoluteIndices )
-                {
-                    sprintf_s(outputString,256,"f %d/%d/%d %d/%d/%d %d/%d/%d\n",
-                        pFace->vertexIndex[0]+1, pFace->uvIndex[0]+1, outputFaceDirection,
-                        pFace->vertexIndex[1]+1, pFace->uvIndex[1]+1, outputFaceDirection,
-                        pFace->vertexIndex[2]+1, pFace->uvIndex[2]+1, outputFaceDirection
-                        );
-                }
-                else
-                {
-                    sprintf_s(outputString,256,"f %d/%d/%d %d/%d/%d %d/%d/%d\n",
-                        pFace->vertexIndex[0]-gModel.vertexCount, pFace->uvIndex[0]-gModel.uvIndexCount, outputFaceDirection,
-                        pFace->vertexIndex[1]-gModel.vertexCount, pFace->uvIndex[1]-gModel.uvIndexCount, outputFaceDirection,
-                        pFace->vertexIndex[2]-gModel.vertexCount, pFace->uvIndex[2]-gModel.uvIndexCount, outputFaceDirection
-                        );
-                }
-            }
-            else
-            {
-                if ( absoluteIndices )
-                {
-                    sprintf_s(outputString,256,"f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d\n",
-                        pFace->vertexIndex[0]+1, pFace->uvIndex[0]+1, outputFaceDirection,
-                        pFace->vertexIndex[1]+1, pFace->uvIndex[1]+1, outputFaceDirection,
-                        pFace->vertexIndex[2]+1, pFace->uvIndex[2]+1, outputFaceDirection,
-                        pFace->vertexIndex[3]+1, pFace->uvIndex[3]+1, outputFaceDirection
-                        );
-                }
-                else
-                {
-                    sprintf_s(outputString,256,"f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d\n",
-                        pFace->vertexIndex[0]-gModel.vertexCount, pFace->uvIndex[0]-gModel.uvIndexCount, outputFaceDirection,
-                        pFace->vertexIndex[1]-gModel.vertexCount, pFace->uvIndex[1]-gModel.uvIndexCount, outputFaceDirection,
-                        pFace->vertexIndex[2]-gModel.vertexCount, pFace->uvIndex[2]-gModel.uvIndexCount, outputFaceDirection,
-                        pFace->vertexIndex[3]-gModel.vertexCount, pFace->uvIndex[3]-gModel.uvIndexCount, outputFaceDirection
-                        );
-                }
-            }
-#else
-            // check if last two vertices match - if so, output a triangle instead 
-            if ( pFace->vertexIndex[2] == pFace->vertexIndex[3] )
-            {
-                // triangle
-                if ( absoluteIndices )
-                {
-                    sprintf_s(outputString,256,"f %d/%d %d/%d %d/%d\n",
-                        pFace->vertexIndex[0]+1, pFace->uvIndex[0]+1,
-                        pFace->vertexIndex[1]+1, pFace->uvIndex[1]+1,
-                        pFace->vertexIndex[2]+1, pFace->uvIndex[2]+1
-                        );
-                }
-                else
-                {
-                    sprintf_s(outputString,256,"f %d/%d %d/%d %d/%d\n",
-                        pFace->vertexIndex[0]-gModel.vertexCount, pFace->uvIndex[0]-gModel.uvIndexCount,
-                        pFace->vertexIndex[1]-gModel.vertexCount, pFace->uvIndex[1]-gModel.uvIndexCount,
-                        pFace->vertexIndex[2]-gModel.vertexCount, pFace->uvIndex[2]-gModel.uvIndexCount
-                        );
-                }
-            }
-            else
-            {
-                if ( absoluteIndices )
-                {
-                    sprintf_s(outputString,256,"f %d/%d %d/%d %d/%d %d/%d\n",
-                        pFace->vertexIndex[0]+1, pFace->uvIndex[0]+1,
-                        pFace->vertexIndex[1]+1, pFace->uvIndex[1]+1,
-                        pFace->vertexIndex[2]+1, pFace->uvIndex[2]+1,
-                        pFace->vertexIndex[3]+1, pFace->uvIndex[3]+1
-                        );
-                }
-                else
-                {
-                    sprintf_s(outputString,256,"f %d/%d %d/%d %d/%d %d/%d\n",
-                        pFace->vertexIndex[0]-gModel.vertexCount, pFace->uvIndex[0]-gModel.uvIndexCount,
-                        pFace->vertexIndex[1]-gModel.vertexCount, pFace->uvIndex[1]-gModel.uvIndexCount,
-                        pFace->vertexIndex[2]-gModel.vertexCount, pFace->uvIndex[2]-gModel.uvIndexCount,
-                        pFace->vertexIndex[3]-gModel.vertexCount, pFace->uvIndex[3]-gModel.uvIndexCount
-                        );
-                }
-            }
-#endif
+            outputFaceDirection = gModel.faces.normalIndex[i]-gModel.writtenNormalCount;
         }
-        else
-        {
-#ifdef OUTPUT_NORMALS
-            // check if last two vertices match - if so, output a triangle instead 
-            if ( pFace->vertexIndex[2] == pFace->vertexIndex[3] )
-            {
-                // triangle
-                if ( absoluteIndices )
-                {
-                    sprintf_s(outputString,256,"f %d//%d %d//%d %d//%d\n",
-                        pFace->vertexIndex[0]+1, outputFaceDirection,
-                        pFace->vertexIndex[1]+1, outputFaceDirection,
-                        pFace->vertexIndex[2]+1, outputFaceDirection
-                        );
-                }
-                else
-                {
-                    sprintf_s(outputString,256,"f %d//%d %d//%d %d//%d\n",
-                        pFace->vertexIndex[0]-gModel.vertexCount, outputFaceDirection,
-                        pFace->vertexIndex[1]-gModel.vertexCount, outputFaceDirection,
-                        pFace->vertexIndex[2]-gModel.vertexCount, outputFaceDirection
-                        );
-                }
-            }
-            else
-            {
-                if ( absoluteIndices )
-                {
-                    sprintf_s(outputString,256,"f %d//%d %d//%d %d//%d %d//%d\n",
-                        pFace->vertexIndex[0]+1, outputFaceDirection,
-                        pFace->vertexIndex[1]+1, outputFaceDirection,
-                        pFace->vertexIndex[2]+1, outputFaceDirection,
-                        pFace->vertexIndex[3]+1, outputFaceDirection
-                        );
-                }
-                else
-                {
-                    sprintf_s(outputString,256,"f %d//%d %d//%d %d//%d %d//%d\n",
-                        pFace->vertexIndex[0]-gModel.vertexCount, outputFaceDirection,
-                        pFace->vertexIndex[1]-gModel.vertexCount, outputFaceDirection,
-                        pFace->vertexIndex[2]-gModel.vertexCount, outputFaceDirection,
-                        pFace->vertexIndex[3]-gModel.vertexCount, outputFaceDirection
-                        );
-                }
-            }
 #else
-            // check if last two vertices match - if so, output a triangle instead 
-            if ( pFace->vertexIndex[2] == pFace->vertexIndex[3] )
-            {
-                // triangle
-                if ( absoluteIndices )
-                {
-                    sprintf_s(outputString,256,"f %d %d %d\n",
-                        pFace->vertexIndex[0]+1,
-                        pFace->vertexIndex[1]+1,
-                        pFace->vertexIndex[2]+1
-                        );
-                }
-                else
-                {
-                    sprintf_s(outputString,256,"f %d %d %d\n",
-                        pFace->vertexIndex[0]-gModel.vertexCount,
-                        pFace->vertexIndex[1]-gModel.vertexCount,
-                        pFace->vertexIndex[2]-gModel.vertexCount
-                        );
-                }
-            }
-            else
-            {
-                if ( absoluteIndices )
-                {
-                    sprintf_s(outputString,256,"f %d %d %d %d\n",
-                        pFace->vertexIndex[0]+1,
-                        pFace->vertexIndex[1]+1,
-                        pFace->vertexIndex[2]+1,
-                        pFace->vertexIndex[3]+1
-                        );
-                }
-                else
-                {
-                    sprintf_s(outputString,256,"f %d %d %d %d\n",
-                        pFace->vertexIndex[0]-gModel.vertexCount,
-                        pFace->vertexIndex[1]-gModel.vertexCount,
-                        pFace->vertexIndex[2]-gModel.vertexCount,
-                        pFace->vertexIndex[3]-gModel.vertexCount
-                        );
-                }
-            }
+        // 0 means no normal index is output
+        outputFaceDirection = 0;
 #endif
-        }
-        WERROR(PortaWrite(gModelFile, outputString, strlen(outputString) ));
+
+        // output the actual face, with texture coordinates if there are any
+        pOut = bufferedOutputLine();
+        WERROR(pOut == NULL);
+        pOut = appendOBJFace(pOut, i, vertexOffset, gExportTexture ? uvOffset : 0, outputFaceDirection);
+        endBufferedOutputLine(pOut);
     }
+    gModel.writtenFaceCount += gModel.faceCount;
 
-Exit:
-    PortaClose(gModelFile);
+    return retCode;
+}
 
-    // should we call it a day here?
-    if ( retCode >= MW_BEGIN_ERRORS ) return retCode;
+// Streamed OBJ output: the slab of blocks before nextPlane is done. Transform, sort and write out its vertices and faces,
+// then drop them, keeping only the vertices on nextPlane, which are shared with the next slab.
+static int streamOBJSlab( int nextPlane )
+{
+    int i, planeStart, vertex, carriedCount, firstNewVertex;
+    int *carriedIndex;
+    Point *carriedVertices;
+    int retCode = MW_NO_ERROR;
 
-    // write materials file
-    if ( exportMaterials )
+    transformVertices( gModel.carriedVertexCount );
+
+    // a slab can be empty
+    if ( (gOptions->exportFlags & EXPT_GROUP_BY_MATERIAL) && gModel.faceCount > 0 )
     {
-        // write material file
-        retCode |= writeOBJMtlFile();
+        Timing_Start(TIMING_SORT);
+        retCode |= sortFacesByMaterial();
+        Timing_Stop(TIMING_SORT);
         if ( retCode >= MW_BEGIN_ERRORS ) return retCode;
     }
 
+    firstNewVertex = gModel.writtenVertexCount;
+    retCode |= writeOBJSlab();
+    if ( retCode >= MW_BEGIN_ERRORS ) return retCode;
+
+    carriedIndex = (int*)malloc(gBoxSizeYZ*sizeof(int));
+    carriedVertices = (Point*)malloc(gBoxSizeYZ*sizeof(Point));
+    if ( (carriedIndex == NULL) || (carriedVertices == NULL) )
+    {
+        free(carriedIndex);
+        free(carriedVertices);
+        return retCode|MW_WORLD_EXPORT_TOO_LARGE;
+    }
+
+    // gather the vertices on the shared plane, renumbering them from the start of the list
+    planeStart = vertexIndexSlot( nextPlane*gBoxSizeYZ );
+    carriedCount = 0;
+    for ( i = 0; i < gBoxSizeYZ; i++ )
+    {
+        vertex = gModel.vertexIndices[planeStart+i];
+        if ( vertex != NO_INDEX_SET )
+        {
+            carriedIndex[carriedCount] = ( vertex < gModel.carriedVertexCount ) ?
+                gModel.carriedVertexIndex[vertex] :
+                firstNewVertex + vertex - gModel.carriedVertexCount;
+            Vec2Op( carriedVertices[carriedCount], =, gModel.vertices[vertex] );
+            gModel.vertexIndices[planeStart+i] = carriedCount++;
+        }
+    }
+    memcpy( gModel.vertices, carriedVertices, carriedCount*sizeof(Point) );
+    free( gModel.carriedVertexIndex );
+    gModel.carriedVertexIndex = carriedIndex;
+    free( carriedVertices );
+
+    gModel.carriedVertexCount = gModel.vertexCount = carriedCount;
+    gModel.faceCount = 0;
+
+    // clear the rest of the ring of planes, for the next slab
+    for ( i = 0; i < gModel.vertexIndexPlanes*gBoxSizeYZ; i++ )
+    {
+        if ( i < planeStart || i >= planeStart + gBoxSizeYZ )
+            gModel.vertexIndices[i] = NO_INDEX_SET;
+    }
+
     return retCode;
 }
 
-
 static int writeOBJTextureUV( float u, float v, int addComment, int swatchLoc )
 {
-#ifdef WIN32
-    DWORD br;
-#endif
-    char outputString[1024];
+    char *pOut = bufferedOutputLine();
+    WERROR(pOut == NULL);
 
     if ( addComment )
     {
-        sprintf_s(outputString,1024,"# %s\nvt %g %g\n",
-            gBlockDefinitions[gModel.uvSwatchToType[swatchLoc]].name,
-            u, v );
-    }
-    else
-    {
-        sprintf_s(outputString,1024,"vt %g %g\n",
-            u, v );
+        *pOut++ = '#';
+        *pOut++ = ' ';
+        pOut = appendString(pOut, gBlockDefinitions[gModel.uvSwatchToType[swatchLoc]].name);
+        *pOut++ = '\n';
     }
-    WERROR(PortaWrite(gModelFile, outputString, strlen(outputString) ));
+    *pOut++ = 'v';
+    *pOut++ = 't';
+    *pOut++ = ' ';
+    pOut = appendFloat(pOut, u, gUVDecimals);
+    *pOut++ = ' ';
+    pOut = appendFloat(pOut, v, gUVDecimals);
+    *pOut++ = '\n';
+    endBufferedOutputLine(pOut);
 
     return MW_NO_ERROR;
 }
 
+// Add a face line, "f v/vt/vn ...", to the output. The offsets turn stored indices into absolute or relative
+// OBJ indices. A uvOffset of 0 means no texture coordinates, a normalIndex of 0 means no normal.
+// A face with its last two vertices the same is a triangle.
+static char *appendOBJFace( char *pOut, int face, int vertexOffset, int uvOffset, int normalIndex )
+{
+    int j;
+    int *pVertexIndex = gModel.faces.vertexIndex[face];
+    int *pUVIndex = gModel.faces.uvIndex[face];
+    int numVertices = ( pVertexIndex[2] == pVertexIndex[3] ) ? 3 : 4;
+
+    *pOut++ = 'f';
+    for ( j = 0; j < numVertices; j++ )
+    {
+        *pOut++ = ' ';
+        pOut = appendInt(pOut, pVertexIndex[j]+vertexOffset);
+        if ( uvOffset )
+        {
+            *pOut++ = '/';
+            pOut = appendInt(pOut, pUVIndex[j]+uvOffset);
+            if ( normalIndex )
+            {
+                *pOut++ = '/';
+                pOut = appendInt(pOut, normalIndex);
+            }
+        }
+        else if ( normalIndex )
+        {
+            *pOut++ = '/';
+            *pOut++ = '/';
+            pOut = appendInt(pOut, normalIndex);
+        }
+    }
+    *pOut++ = '\n';
+    return pOut;
+}
+
 
 static int writeOBJMtlFile()
 {
-#ifdef WIN32
-    DWORD br;
-#endif
     wchar_t mtlFileName[MAX_PATH];
     char outputString[1024];
 
@@ -13280,14 +15012,13 @@ static int writeOBJMtlFile()
 
     concatFileName3(mtlFileName, gOutputFilePath, gOutputFileRootClean, L".mtl");
 
-    gMtlFile=PortaCreate(mtlFileName);
-    addOutputFilenameToList(mtlFileName);
-    if (gMtlFile == INVALID_HANDLE_VALUE)
+    gMtlFile = createOutputFile(mtlFileName);
+    if (gMtlFile == NULL)
         return MW_CANNOT_CREATE_FILE;
 
     sprintf_s(outputString,1024,"Wavefront OBJ material file\n# Contains %d materials\n",
         (gOptions->exportFlags & EXPT_OUTPUT_OBJ_MATERIAL_PER_TYPE) ? gModel.mtlCount : 1 );
-    WERROR(PortaWrite(gMtlFile, outputString, strlen(outputString) ));
+    WERROR(writeOutputFile(gMtlFile, outputString, strlen(outputString) ));
 
     if (gExportTexture )
     {
@@ -13337,7 +15068,7 @@ static int writeOBJMtlFile()
                 ,
                 MINECRAFT_SINGLE_MATERIAL );
         }
-        WERROR(PortaWrite(gModelFile, outputString, strlen(outputString) ));
+        WERROR(writeOutputFile(gModelFile, outputString, strlen(outputString) ));
 
     }
     else
@@ -13459,7 +15190,7 @@ static int writeOBJMtlFile()
                 }
                 else
                 {
-                    typeTextureFileName = '\0'; 
+                    typeTextureFileName = NULL; 
                 }
                 mapdString[0] = '\0';
             }
@@ -13549,11 +15280,11 @@ static int writeOBJMtlFile()
                     (float)(alpha),
                     fullMtl,tfString);
             }
-            WERROR(PortaWrite(gMtlFile, outputString, strlen(outputString) ));
+            WERROR(writeOutputFile(gMtlFile, outputString, strlen(outputString) ));
         }
     }
 
-    PortaClose(gMtlFile);
+    closeOutputFile(&gMtlFile);
 
     return MW_NO_ERROR;
 }
@@ -14281,9 +16012,6 @@ static int createBaseMaterialTexture()
 
 static int writeBinarySTLBox( const wchar_t *world, IBox *worldBox )
 {
-#ifdef WIN32
-    DWORD br;
-#endif
 
     wchar_t stlFileNameWithSuffix[MAX_PATH];
     const char *justWorldFileName;
@@ -14295,7 +16023,6 @@ static int writeBinarySTLBox( const wchar_t *world, IBox *worldBox )
 
     int retCode = MW_NO_ERROR;
 
-    FaceRecord *pFace;
     Point *vertex[4];
     // Normally each face has two triangles; triangle faces have only one, so subtract the "extra faces"
     // due to multiplying by two.
@@ -14309,7 +16036,7 @@ static int writeBinarySTLBox( const wchar_t *world, IBox *worldBox )
 
     wchar_t statsFileName[MAX_PATH];
 
-    HANDLE statsFile;
+    OutputFile *statsFile;
 
     char worldChar[MAX_PATH];
 
@@ -14319,9 +16046,8 @@ static int writeBinarySTLBox( const wchar_t *world, IBox *worldBox )
     concatFileName3(stlFileNameWithSuffix, gOutputFilePath, gOutputFileRoot, L".stl");
 
     // create the STL file
-    gModelFile = PortaCreate(stlFileNameWithSuffix);
-    addOutputFilenameToList(stlFileNameWithSuffix);
-    if (gModelFile == INVALID_HANDLE_VALUE)
+    gModelFile = createOutputFile(stlFileNameWithSuffix);
+    if (gModelFile == NULL)
         return MW_CANNOT_CREATE_FILE;
 
     // find last \ in world string
@@ -14339,11 +16065,11 @@ static int writeBinarySTLBox( const wchar_t *world, IBox *worldBox )
         // make it all 0x20 as we will output exactly 80 characters
         sprintf_s(outputString,256,"COLOR=");
         // start to write file
-        WERROR(PortaWrite(gModelFile, outputString, 6 ));
-        WERROR(PortaWrite(gModelFile, &allFF, 4 ));
+        WERROR(writeOutputFile(gModelFile, outputString, 6 ));
+        WERROR(writeOutputFile(gModelFile, &allFF, 4 ));
         // in the example file, all the rest was 0x20's (space)
         memset(outputString,0x20,256);
-        WERROR(PortaWrite(gModelFile, outputString, 70 ));
+        WERROR(writeOutputFile(gModelFile, outputString, 70 ));
     }
     else
     {
@@ -14354,11 +16080,11 @@ static int writeBinarySTLBox( const wchar_t *world, IBox *worldBox )
             worldBox->min[X], worldBox->min[Y], worldBox->min[Z],
             worldBox->max[X], worldBox->max[Y], worldBox->max[Z] );
         // start to write file
-        WERROR(PortaWrite(gModelFile, outputString, 80 ));
+        WERROR(writeOutputFile(gModelFile, outputString, 80 ));
     }
 
     // number of triangles in model, unsigned int
-    WERROR(PortaWrite(gModelFile, &numTri, 4 ));
+    WERROR(writeOutputFile(gModelFile, &numTri, 4 ));
 
     // write out the faces, it's just that simple
     for ( faceNo = 0; faceNo < gModel.faceCount; faceNo++ )
@@ -14368,11 +16094,10 @@ static int writeBinarySTLBox( const wchar_t *world, IBox *worldBox )
         if ( faceNo % 1000 == 0 )
             UPDATE_PROGRESS( PG_OUTPUT + (PG_TEXTURE-PG_OUTPUT)*((float)faceNo/(float)gModel.faceCount));
 
-        pFace = gModel.faceList[faceNo];
         // get four face indices for the four corners
         for ( i = 0; i < 4; i++ )
         {
-            vertex[i] = &gModel.vertices[pFace->vertexIndex[i]];
+            vertex[i] = &gModel.vertices[gModel.faces.vertexIndex[faceNo][i]];
         }
 
         faceTriCount = (vertex[2] == vertex[3]) ? 1:2;
@@ -14381,11 +16106,11 @@ static int writeBinarySTLBox( const wchar_t *world, IBox *worldBox )
         for ( i = 0; i < faceTriCount; i++ )
         {
             // 3 float normals
-            WERROR(PortaWrite(gModelFile, &gModel.normals[pFace->normalIndex], 12 ));
+            WERROR(writeOutputFile(gModelFile, &gModel.normals[gModel.faces.normalIndex[faceNo]], 12 ));
 
-            WERROR(PortaWrite(gModelFile, vertex[0], 12 ));
-            WERROR(PortaWrite(gModelFile, vertex[i+1], 12 ));
-            WERROR(PortaWrite(gModelFile, vertex[i+2], 12 ));
+            WERROR(writeOutputFile(gModelFile, vertex[0], 12 ));
+            WERROR(writeOutputFile(gModelFile, vertex[i+1], 12 ));
+            WERROR(writeOutputFile(gModelFile, vertex[i+2], 12 ));
 
             if ( writeColor )
             {
@@ -14393,7 +16118,7 @@ static int writeBinarySTLBox( const wchar_t *world, IBox *worldBox )
                 if ( isMagics )
                 {
                     // Materialise Magics 
-                    colorBytes = gBlockDefinitions[pFace->type].color;
+                    colorBytes = gBlockDefinitions[gModel.faces.type[faceNo]].color;
                     r=(unsigned char)(colorBytes>>16);
                     g=(unsigned char)(colorBytes>>8);
                     b=(unsigned char)(colorBytes);
@@ -14406,7 +16131,7 @@ static int writeBinarySTLBox( const wchar_t *world, IBox *worldBox )
                 else
                 {
                     // VisCAM/SolidView 
-                    colorBytes = gBlockDefinitions[pFace->type].color;
+                    colorBytes = gBlockDefinitions[gModel.faces.type[faceNo]].color;
                     r=(unsigned char)(colorBytes>>16);
                     g=(unsigned char)(colorBytes>>8);
                     b=(unsigned char)(colorBytes);
@@ -14417,61 +16142,56 @@ static int writeBinarySTLBox( const wchar_t *world, IBox *worldBox )
                     outColor = (1<<15) | (r<<10) | (g<<5) | b;
                 }
             }
-            WERROR(PortaWrite(gModelFile, &outColor, 2 ));
+            WERROR(writeOutputFile(gModelFile, &outColor, 2 ));
         }
     }
 
     // if not ok, then we will have closed the file earlier
-    PortaClose(gModelFile);
+    closeOutputFile(&gModelFile);
 
     concatFileName3(statsFileName, gOutputFilePath, gOutputFileRoot, L".txt");
 
     // write the stats to a separate file
-    statsFile = PortaCreate(statsFileName);
-    addOutputFilenameToList(statsFileName);
-    if (statsFile == INVALID_HANDLE_VALUE)
+    statsFile = createOutputFile(statsFileName);
+    if (statsFile == NULL)
         return retCode|MW_CANNOT_CREATE_FILE;
 
     //
     retCode |= writeStatistics( statsFile, justWorldFileName, worldBox );
     if ( retCode >= MW_BEGIN_ERRORS ) return retCode;
 
-    PortaClose(statsFile);
+    closeOutputFile(&statsFile);
 
     return retCode;
 }
 
-static int writeAsciiSTLBox( const wchar_t *world, IBox *worldBox )
+// Binary PLY: the vertex list, then each face as a list of vertex indices, optionally with its block's color.
+// Unlike STL, each vertex is stored once. All numbers are written as they are in memory, so little-endian.
+static int writeBinaryPLYBox( const wchar_t *world, IBox *worldBox )
 {
-#ifdef WIN32
-    DWORD br;
-#endif
 
-    wchar_t stlFileNameWithSuffix[MAX_PATH];
+    wchar_t plyFileNameWithSuffix[MAX_PATH];
+    char outputString[1024];
     const char *justWorldFileName;
-    char worldNameUnderlined[MAX_PATH];
-    wchar_t statsFileName[MAX_PATH];
-
-    HANDLE statsFile;
-
-    char outputString[256];
-
-    int faceNo,i;
+    char worldNameUnderlined[256];
 
+    int faceNo, i;
     int retCode = MW_NO_ERROR;
 
-    int normalIndex;
-    FaceRecord *pFace;
-    Point *vertex[4],*pt;
+    wchar_t statsFileName[MAX_PATH];
+
+    OutputFile *statsFile;
 
     char worldChar[MAX_PATH];
 
-    concatFileName3(stlFileNameWithSuffix, gOutputFilePath, gOutputFileRoot, L".stl");
+    // export color if file format mode set that way
+    int writeColor = (gOptions->exportFlags & (EXPT_OUTPUT_MATERIALS|EXPT_OUTPUT_TEXTURE));
 
-    // create the STL file
-    gModelFile = PortaCreate(stlFileNameWithSuffix);
-    addOutputFilenameToList(stlFileNameWithSuffix);
-    if (gModelFile == INVALID_HANDLE_VALUE)
+    concatFileName3(plyFileNameWithSuffix, gOutputFilePath, gOutputFileRoot, L".ply");
+
+    // create the PLY file
+    gModelFile = createOutputFile(plyFileNameWithSuffix);
+    if (gModelFile == NULL)
         return MW_CANNOT_CREATE_FILE;
 
     // find last \ in world string
@@ -14482,38 +16202,159 @@ static int writeAsciiSTLBox( const wchar_t *world, IBox *worldBox )
     strcpy_s(worldNameUnderlined,256,justWorldFileName);
     spacesToUnderlinesChar(worldNameUnderlined);
 
-    // Object name - give them a hint where it's from: world name and coordinates
-    sprintf_s(outputString,256,"solid %s__%d_%d_%d_to_%d_%d_%d\n", worldNameUnderlined,
+    sprintf_s(outputString,1024,
+        "ply\n"
+        "format binary_little_endian 1.0\n"
+        "comment PLY file made by Mineways version %d.%d, http://mineways.com\n"
+        "comment world %s %d %d %d to %d %d %d\n"
+        "element vertex %d\n"
+        "property float x\n"
+        "property float y\n"
+        "property float z\n"
+        "element face %d\n"
+        "property list uchar int vertex_indices\n"
+        "%s"
+        "end_header\n",
+        gMajorVersion, gMinorVersion,
+        worldNameUnderlined,
         worldBox->min[X], worldBox->min[Y], worldBox->min[Z],
-        worldBox->max[X], worldBox->max[Y], worldBox->max[Z] );
-    // start to write file
-    WERROR(PortaWrite(gModelFile, outputString, strlen(outputString) ));
-
-    // ready the normals for direct output, since we reuse them a zillion times
-    resolveFaceNormals();
-
-    char facetNormalString[NORMAL_LIST_SIZE][256];
-    for ( i = 0; i < gModel.normalListCount; i++ )
+        worldBox->max[X], worldBox->max[Y], worldBox->max[Z],
+        gModel.vertexCount,
+        gModel.faceCount,
+        writeColor ? "property uchar red\nproperty uchar green\nproperty uchar blue\n" : "" );
+    WERROR(writeOutputFile(gModelFile, outputString, strlen(outputString) ));
+
+    // the vertices and faces are gathered in the output buffer and written out in large blocks
+    retCode |= startBufferedOutput();
+    if ( retCode >= MW_BEGIN_ERRORS )
     {
-        sprintf_s(facetNormalString[i],256,"facet normal %e %e %e\n",gModel.normals[i][X],gModel.normals[i][Y],gModel.normals[i][Z]);
+        closeOutputFile(&gModelFile);
+        return retCode;
     }
 
-    // write out the faces, it's just that simple
-    for ( faceNo = 0; faceNo < gModel.faceCount; faceNo++ )
+    for ( i = 0; i < gModel.vertexCount; i++ )
+    {
+        char *pOut = bufferedOutputLine();
+        if ( pOut == NULL )
+        {
+            WERROR(1);
+        }
+        memcpy( pOut, gModel.vertices[i], 3*sizeof(float) );
+        endBufferedOutputLine( pOut + 3*sizeof(float) );
+    }
+
+    for ( faceNo = 0; faceNo < gModel.faceCount; faceNo++ )
+    {
+        int *pVertexIndex = gModel.faces.vertexIndex[faceNo];
+        unsigned char cornerCount = (pVertexIndex[2] == pVertexIndex[3]) ? 3 : 4;
+        char *pOut;
+
+        if ( faceNo % 1000 == 0 )
+            UPDATE_PROGRESS( PG_OUTPUT + (PG_TEXTURE-PG_OUTPUT)*((float)faceNo/(float)gModel.faceCount));
+
+        pOut = bufferedOutputLine();
+        if ( pOut == NULL )
+        {
+            WERROR(1);
+        }
+        *pOut++ = (char)cornerCount;
+        memcpy( pOut, pVertexIndex, cornerCount*sizeof(int) );
+        pOut += cornerCount*sizeof(int);
+        if ( writeColor )
+        {
+            int colorBytes = gBlockDefinitions[gModel.faces.type[faceNo]].color;
+            *pOut++ = (char)(colorBytes>>16);
+            *pOut++ = (char)(colorBytes>>8);
+            *pOut++ = (char)colorBytes;
+        }
+        endBufferedOutputLine( pOut );
+    }
+    WERROR(flushBufferedOutput());
+
+    closeOutputFile(&gModelFile);
+
+    concatFileName3(statsFileName, gOutputFilePath, gOutputFileRoot, L".txt");
+
+    // write the stats to a separate file
+    statsFile = createOutputFile(statsFileName);
+    if (statsFile == NULL)
+        return retCode|MW_CANNOT_CREATE_FILE;
+
+    retCode |= writeStatistics( statsFile, justWorldFileName, worldBox );
+    if ( retCode >= MW_BEGIN_ERRORS ) return retCode;
+
+    closeOutputFile(&statsFile);
+
+    return retCode;
+}
+
+static int writeAsciiSTLBox( const wchar_t *world, IBox *worldBox )
+{
+
+    wchar_t stlFileNameWithSuffix[MAX_PATH];
+    const char *justWorldFileName;
+    char worldNameUnderlined[MAX_PATH];
+    wchar_t statsFileName[MAX_PATH];
+
+    OutputFile *statsFile;
+
+    char outputString[256];
+
+    int faceNo,i;
+
+    int retCode = MW_NO_ERROR;
+
+    int normalIndex;
+    Point *vertex[4],*pt;
+
+    char worldChar[MAX_PATH];
+
+    concatFileName3(stlFileNameWithSuffix, gOutputFilePath, gOutputFileRoot, L".stl");
+
+    // create the STL file
+    gModelFile = createOutputFile(stlFileNameWithSuffix);
+    if (gModelFile == NULL)
+        return MW_CANNOT_CREATE_FILE;
+
+    // find last \ in world string
+    wcharToChar(world,worldChar);
+    justWorldFileName = removePathChar(worldChar);
+
+    // replace spaces with underscores for world name output
+    strcpy_s(worldNameUnderlined,256,justWorldFileName);
+    spacesToUnderlinesChar(worldNameUnderlined);
+
+    // Object name - give them a hint where it's from: world name and coordinates
+    sprintf_s(outputString,256,"solid %s__%d_%d_%d_to_%d_%d_%d\n", worldNameUnderlined,
+        worldBox->min[X], worldBox->min[Y], worldBox->min[Z],
+        worldBox->max[X], worldBox->max[Y], worldBox->max[Z] );
+    // start to write file
+    WERROR(writeOutputFile(gModelFile, outputString, strlen(outputString) ));
+
+    // ready the normals for direct output, since we reuse them a zillion times
+    resolveFaceNormals();
+
+    char facetNormalString[NORMAL_LIST_SIZE][256];
+    for ( i = 0; i < gModel.normalListCount; i++ )
+    {
+        sprintf_s(facetNormalString[i],256,"facet normal %e %e %e\n",gModel.normals[i][X],gModel.normals[i][Y],gModel.normals[i][Z]);
+    }
+
+    // write out the faces, it's just that simple
+    for ( faceNo = 0; faceNo < gModel.faceCount; faceNo++ )
     {
         int faceTriCount;
 
         if ( faceNo % 1000 == 0 )
             UPDATE_PROGRESS( PG_OUTPUT + (PG_TEXTURE-PG_OUTPUT)*((float)faceNo/(float)gModel.faceCount));
 
-        pFace = gModel.faceList[faceNo];
         // get four face indices for the four corners
         for ( i = 0; i < 4; i++ )
         {
-            vertex[i] = &gModel.vertices[pFace->vertexIndex[i]];
+            vertex[i] = &gModel.vertices[gModel.faces.vertexIndex[faceNo][i]];
         }
 
-        normalIndex = pFace->normalIndex;
+        normalIndex = gModel.faces.normalIndex[faceNo];
 
         // typical output:
         //facet normal 0.000000e+000 -1.000000e+000 0.000000e+000
@@ -14528,42 +16369,41 @@ static int writeAsciiSTLBox( const wchar_t *world, IBox *worldBox )
 
         for ( i = 0; i < faceTriCount; i++ )
         {
-            WERROR(PortaWrite(gModelFile, facetNormalString[normalIndex], strlen(facetNormalString[normalIndex]) ));
-            WERROR(PortaWrite(gModelFile, "outer loop\n", strlen("outer loop\n") ));
+            WERROR(writeOutputFile(gModelFile, facetNormalString[normalIndex], strlen(facetNormalString[normalIndex]) ));
+            WERROR(writeOutputFile(gModelFile, "outer loop\n", strlen("outer loop\n") ));
 
             pt = vertex[0];
             sprintf_s(outputString,256,"vertex  %e %e %e\n",(double)((*pt)[X]),(double)((*pt)[Y]),(double)((*pt)[Z]));
-            WERROR(PortaWrite(gModelFile, outputString, strlen(outputString) ));
+            WERROR(writeOutputFile(gModelFile, outputString, strlen(outputString) ));
             pt = vertex[i+1];
             sprintf_s(outputString,256,"vertex  %e %e %e\n",(double)((*pt)[X]),(double)((*pt)[Y]),(double)((*pt)[Z]));
-            WERROR(PortaWrite(gModelFile, outputString, strlen(outputString) ));
+            WERROR(writeOutputFile(gModelFile, outputString, strlen(outputString) ));
             pt = vertex[i+2];
             sprintf_s(outputString,256,"vertex  %e %e %e\n",(double)((*pt)[X]),(double)((*pt)[Y]),(double)((*pt)[Z]));
-            WERROR(PortaWrite(gModelFile, outputString, strlen(outputString) ));
+            WERROR(writeOutputFile(gModelFile, outputString, strlen(outputString) ));
 
-            WERROR(PortaWrite(gModelFile, "endloop\nendfacet\n", strlen("endloop\nendfacet\n") ));
+            WERROR(writeOutputFile(gModelFile, "endloop\nendfacet\n", strlen("endloop\nendfacet\n") ));
         }
     }
 
     sprintf_s(outputString,256,"endsolid %s\n",worldNameUnderlined);
-    WERROR(PortaWrite(gModelFile, outputString, strlen(outputString) ));
+    WERROR(writeOutputFile(gModelFile, outputString, strlen(outputString) ));
 
     // if not ok, then we will have closed the file earlier
-    PortaClose(gModelFile);
+    closeOutputFile(&gModelFile);
 
     concatFileName3(statsFileName, gOutputFilePath, gOutputFileRoot, L".txt");
 
     // write the stats to a separate file
-    statsFile = PortaCreate(statsFileName);
-    addOutputFilenameToList(statsFileName);
-    if (statsFile == INVALID_HANDLE_VALUE)
+    statsFile = createOutputFile(statsFileName);
+    if (statsFile == NULL)
         return retCode|MW_CANNOT_CREATE_FILE;
 
     //
     retCode |= writeStatistics( statsFile, justWorldFileName, worldBox );
     if ( retCode >= MW_BEGIN_ERRORS ) return retCode;
 
-    PortaClose(statsFile);
+    closeOutputFile(&statsFile);
 
     return retCode;
 }
@@ -14571,9 +16411,6 @@ static int writeAsciiSTLBox( const wchar_t *world, IBox *worldBox )
 
 static int writeVRML2Box( const wchar_t *world, IBox *worldBox )
 {
-#ifdef WIN32
-    DWORD br;
-#endif
 
     wchar_t wrlFileNameWithSuffix[MAX_PATH];
     const char *justWorldFileName;
@@ -14589,7 +16426,8 @@ static int writeVRML2Box( const wchar_t *world, IBox *worldBox )
 
     //char worldNameUnderlined[256];
 
-    FaceRecord *pFace;
+    int *pVertexIndex;
+    int *pUVIndex;
 
     char worldChar[MAX_PATH];
 
@@ -14609,9 +16447,8 @@ static int writeVRML2Box( const wchar_t *world, IBox *worldBox )
     concatFileName3(wrlFileNameWithSuffix, gOutputFilePath, gOutputFileRoot, L".wrl");
 
     // create the VRML wrl file
-    gModelFile=PortaCreate(wrlFileNameWithSuffix);
-    addOutputFilenameToList(wrlFileNameWithSuffix);
-    if (gModelFile == INVALID_HANDLE_VALUE)
+    gModelFile = createOutputFile(wrlFileNameWithSuffix);
+    if (gModelFile == NULL)
         return retCode|MW_CANNOT_CREATE_FILE;
 
     exportSolidColors = (gOptions->exportFlags & EXPT_OUTPUT_MATERIALS) && !gExportTexture;
@@ -14623,7 +16460,7 @@ static int writeVRML2Box( const wchar_t *world, IBox *worldBox )
     justWorldFileName = removePathChar(worldChar);
 
     sprintf_s(outputString,256,"#VRML V2.0 utf8\n\n# VRML 97 (VRML2) file made by Mineways version %d.%d, http://mineways.com\n", gMajorVersion, gMinorVersion );
-    WERROR(PortaWrite(gModelFile, outputString, strlen(outputString) ));
+    WERROR(writeOutputFile(gModelFile, outputString, strlen(outputString) ));
 
     retCode |= writeStatistics( gModelFile, justWorldFileName, worldBox );
     if ( retCode >= MW_BEGIN_ERRORS )
@@ -14638,7 +16475,7 @@ static int writeVRML2Box( const wchar_t *world, IBox *worldBox )
     //for ( i = 0; i < 6; i++ )
     //{
     //    sprintf_s(outputString,256,"vn %g %g %g\n", gModel.normals[i][0], gModel.normals[i][1], gModel.normals[i][2]);
-    //    WERROR(PortaWrite(gModelFile, outputString, strlen(outputString)));
+    //    WERROR(writeOutputFile(gModelFile, outputString, strlen(outputString)));
     //}
 
     // output vertex coordinate loops
@@ -14673,7 +16510,7 @@ static int writeVRML2Box( const wchar_t *world, IBox *worldBox )
         }
         else
         {
-            strcpy_s(mtlName,256,gBlockDefinitions[gModel.faceList[currentFace]->type].name);
+            strcpy_s(mtlName,256,gBlockDefinitions[gModel.faces.type[currentFace]].name);
             spacesToUnderlinesChar(mtlName);
         }
         sprintf_s( outputString, 256, shapeString, 
@@ -14681,14 +16518,14 @@ static int writeVRML2Box( const wchar_t *world, IBox *worldBox )
             gPrint3D ? "TRUE" : "FALSE",
             firstShape ? "DEF" : "USE",
             firstShape ? " Coordinate" : "" );
-        WERROR(PortaWrite(gModelFile, outputString, strlen(outputString) ));
+        WERROR(writeOutputFile(gModelFile, outputString, strlen(outputString) ));
 
         // if first shape, output coords and texture coords
         if ( firstShape )
         {
             // Note that we just dump everything to a single indexed face set coordinate list, which then gets reused
             strcpy_s( outputString, 256, "        {\n          point\n          [\n" );
-            WERROR(PortaWrite(gModelFile, outputString, strlen(outputString) ));
+            WERROR(writeOutputFile(gModelFile, outputString, strlen(outputString) ));
 
             for ( j = 0; j < gModel.vertexCount; j++ )
             {
@@ -14704,7 +16541,7 @@ static int writeVRML2Box( const wchar_t *world, IBox *worldBox )
                 {
                     sprintf_s(outputString,256,"            %g %g %g,\n", gModel.vertices[j][X], gModel.vertices[j][Y], gModel.vertices[j][Z] );
                 }
-                WERROR(PortaWrite(gModelFile, outputString, strlen(outputString) ));
+                WERROR(writeOutputFile(gModelFile, outputString, strlen(outputString) ));
             }
 
             // textures need texture coordinates output, only needed when texturing
@@ -14713,7 +16550,7 @@ static int writeVRML2Box( const wchar_t *world, IBox *worldBox )
                 int prevSwatch = -1;
                 int k;
                 strcpy_s(outputString,256,"          ]\n        }\n        texCoord DEF texCoord_Craft TextureCoordinate\n        {\n          point\n          [\n");
-                WERROR(PortaWrite(gModelFile, outputString, strlen(outputString) ));
+                WERROR(writeOutputFile(gModelFile, outputString, strlen(outputString) ));
 
                 for ( k = 0; k < gModel.uvIndexCount; k++ )
                 {
@@ -14725,50 +16562,50 @@ static int writeVRML2Box( const wchar_t *world, IBox *worldBox )
             }
             // close up coordinates themselves
             strcpy_s(outputString,256,"          ]\n        }\n");
-            WERROR(PortaWrite(gModelFile, outputString, strlen(outputString) ));
+            WERROR(writeOutputFile(gModelFile, outputString, strlen(outputString) ));
         }
         else
         {
             if ( gExportTexture )
             {
                 strcpy_s(outputString,256,"        texCoord USE texCoord_Craft\n");
-                WERROR(PortaWrite(gModelFile, outputString, strlen(outputString) ));
+                WERROR(writeOutputFile(gModelFile, outputString, strlen(outputString) ));
             }
         }
 
         beginIndex = currentFace;
-        currentType = exportSingleMaterial ? BLOCK_STONE : gModel.faceList[currentFace]->type;
+        currentType = exportSingleMaterial ? BLOCK_STONE : gModel.faces.type[currentFace];
 
         strcpy_s(outputString,256,"        coordIndex\n        [\n");
-        WERROR(PortaWrite(gModelFile, outputString, strlen(outputString) ));
+        WERROR(writeOutputFile(gModelFile, outputString, strlen(outputString) ));
 
         // output face loops until next material is found, or all, if exporting no material
         while ( (currentFace < gModel.faceCount) &&
-            ( (currentType == gModel.faceList[currentFace]->type) || exportSingleMaterial ) )
+            ( (currentType == gModel.faces.type[currentFace]) || exportSingleMaterial ) )
         {
             char commaString[256];
-            strcpy_s(commaString,256,( currentFace == gModel.faceCount-1 || (currentType != gModel.faceList[currentFace+1]->type) ) ? "" : "," );
+            strcpy_s(commaString,256,( currentFace == gModel.faceCount-1 || (currentType != gModel.faces.type[currentFace+1]) ) ? "" : "," );
 
-            pFace = gModel.faceList[currentFace];
+            pVertexIndex = gModel.faces.vertexIndex[currentFace];
 
-            if ( pFace->vertexIndex[2] == pFace->vertexIndex[3] )
+            if ( pVertexIndex[2] == pVertexIndex[3] )
             {
                 sprintf_s(outputString,256,"          %d,%d,%d,-1%s\n",
-                    pFace->vertexIndex[0],
-                    pFace->vertexIndex[1],
-                    pFace->vertexIndex[2],
+                    pVertexIndex[0],
+                    pVertexIndex[1],
+                    pVertexIndex[2],
                     commaString);
             }
             else
             {
                 sprintf_s(outputString,256,"          %d,%d,%d,%d,-1%s\n",
-                    pFace->vertexIndex[0],
-                    pFace->vertexIndex[1],
-                    pFace->vertexIndex[2],
-                    pFace->vertexIndex[3],
+                    pVertexIndex[0],
+                    pVertexIndex[1],
+                    pVertexIndex[2],
+                    pVertexIndex[3],
                     commaString);
             }
-            WERROR(PortaWrite(gModelFile, outputString, strlen(outputString) ));
+            WERROR(writeOutputFile(gModelFile, outputString, strlen(outputString) ));
 
             currentFace++;
         }
@@ -14777,7 +16614,7 @@ static int writeVRML2Box( const wchar_t *world, IBox *worldBox )
         if ( gExportTexture )
         {
             strcpy_s(outputString,256,"        ]\n        texCoordIndex\n        [\n");
-            WERROR(PortaWrite(gModelFile, outputString, strlen(outputString) ));
+            WERROR(writeOutputFile(gModelFile, outputString, strlen(outputString) ));
 
             endIndex = currentFace;
 
@@ -14785,30 +16622,30 @@ static int writeVRML2Box( const wchar_t *world, IBox *worldBox )
             for ( currentFace = beginIndex; currentFace < endIndex; currentFace++ )
             {
                 // output the face loop
-                pFace = gModel.faceList[currentFace];
+                pUVIndex = gModel.faces.uvIndex[currentFace];
 
-                if ( pFace->uvIndex[2] == pFace->uvIndex[3] )
+                if ( pUVIndex[2] == pUVIndex[3] )
                 {
                     sprintf_s(outputString,256,"          %d %d %d -1\n",
-                        pFace->uvIndex[0],
-                        pFace->uvIndex[1],
-                        pFace->uvIndex[2]);
+                        pUVIndex[0],
+                        pUVIndex[1],
+                        pUVIndex[2]);
                 }
                 else
                 {
                     sprintf_s(outputString,256,"          %d %d %d %d -1\n",
-                        pFace->uvIndex[0],
-                        pFace->uvIndex[1],
-                        pFace->uvIndex[2],
-                        pFace->uvIndex[3]);
+                        pUVIndex[0],
+                        pUVIndex[1],
+                        pUVIndex[2],
+                        pUVIndex[3]);
                 }
-                WERROR(PortaWrite(gModelFile, outputString, strlen(outputString) ));
+                WERROR(writeOutputFile(gModelFile, outputString, strlen(outputString) ));
             }
         }
 
         // close up the geometry
         strcpy_s(outputString,256,"        ]\n      }\n");
-        WERROR(PortaWrite(gModelFile, outputString, strlen(outputString) ));
+        WERROR(writeOutputFile(gModelFile, outputString, strlen(outputString) ));
 
         // now output material
         // - if a single material or if textures are output, we use the GENERIC_MATERIAL for the type to output
@@ -14824,17 +16661,17 @@ static int writeVRML2Box( const wchar_t *world, IBox *worldBox )
 
         // close up shape
         strcpy_s(outputString,256,"    }\n");
-        WERROR(PortaWrite(gModelFile, outputString, strlen(outputString) ));
+        WERROR(writeOutputFile(gModelFile, outputString, strlen(outputString) ));
 
         firstShape = 0;
     }
 
     // close up Transform children
     strcpy_s(outputString,256,"  ]\n}\n");
-    WERROR(PortaWrite(gModelFile, outputString, strlen(outputString) ));
+    WERROR(writeOutputFile(gModelFile, outputString, strlen(outputString) ));
 
 Exit:
-    PortaClose(gModelFile);
+    closeOutputFile(&gModelFile);
 
     return retCode;
 }
@@ -14842,9 +16679,6 @@ Exit:
 // if type is GENERIC_MATERIAL, set the generic. If textureOutputString is set, output texture.
 static int writeVRMLAttributeShapeSplit( int type, char *mtlName, char *textureOutputString )
 {
-#ifdef WIN32
-    DWORD br;
-#endif
 
     char outputString[1024];
     char tfString[256];
@@ -14856,7 +16690,7 @@ static int writeVRMLAttributeShapeSplit( int type, char *mtlName, char *textureO
     float ka, kd, ks, ke;
     float alpha;
 
-    WERROR(PortaWrite(gModelFile, attributeString, strlen(attributeString) ));
+    WERROR(writeOutputFile(gModelFile, attributeString, strlen(attributeString) ));
 
     if ( type == GENERIC_MATERIAL )
     {
@@ -14946,25 +16780,22 @@ static int writeVRMLAttributeShapeSplit( int type, char *mtlName, char *textureO
         tfString
         );
 
-    WERROR(PortaWrite(gModelFile, outputString, strlen(outputString) ));
+    WERROR(writeOutputFile(gModelFile, outputString, strlen(outputString) ));
 
     if ( textureOutputString != NULL )
     {
-        WERROR(PortaWrite(gModelFile, textureOutputString, strlen(textureOutputString) ));
+        WERROR(writeOutputFile(gModelFile, textureOutputString, strlen(textureOutputString) ));
     }
 
     // close up appearance
     strcpy_s(outputString,256,"      }\n");
-    WERROR(PortaWrite(gModelFile, outputString, strlen(outputString) ));
+    WERROR(writeOutputFile(gModelFile, outputString, strlen(outputString) ));
 
     return MW_NO_ERROR;
 }
 
 static int writeVRMLTextureUV( float u, float v, int addComment, int swatchLoc )
 {
-#ifdef WIN32
-    DWORD br;
-#endif
     char outputString[1024];
 
     if ( addComment )
@@ -14978,36 +16809,476 @@ static int writeVRMLTextureUV( float u, float v, int addComment, int swatchLoc )
         sprintf_s(outputString,1024,"            %g %g\n",
             u, v );
     }
-    WERROR(PortaWrite(gModelFile, outputString, strlen(outputString) ));
+    WERROR(writeOutputFile(gModelFile, outputString, strlen(outputString) ));
 
     return MW_NO_ERROR;
 }
 
 
-static int writeSchematicBox()
+// Binary glTF: a JSON chunk describing the scene, followed by one binary chunk holding all vertex and index data.
+// Vertices are interleaved position, normal, and (if textured) UV, and are shared among the faces of a primitive.
+static int writeGLTFBox( const wchar_t *world, IBox *worldBox )
 {
-#ifdef WIN32
-    //DWORD br;
-#endif
-    FILE *fptr;
-    int err;
-    gzFile gz;
 
+    wchar_t glbFileNameWithSuffix[MAX_PATH];
+    wchar_t statsFileName[MAX_PATH];
+    const char *justWorldFileName;
+    char worldChar[MAX_PATH];
+    char worldNameUnderlined[MAX_PATH];
+    char worldNameJSON[MAX_PATH*6];
+
+    OutputFile *statsFile;
+
+    int retCode = MW_NO_ERROR;
+
+    int exportPerType;
+    int floatsPerVertex;
+    size_t vertexStride, maxVertices, maxIndices, hashSize;
+    unsigned int hashMask;
+    int primCount, vertexCount, indexCount;
+    int face, i, j, p;
+    int jsonSize, jsonLength;
+    unsigned int vertexLength, indexLength, binLength;
+    unsigned int header[3];
+    unsigned int chunkHeader[2];
+
+    GLTFPrimitive *prims = NULL;
+    GLTFPrimitive *prim;
+    float *vertexData = NULL;
+    unsigned int *indexData = NULL;
+    int (*vertexKey)[3] = NULL;
+    int *hashTable = NULL;
+    char *json = NULL;
+
+    concatFileName3(glbFileNameWithSuffix, gOutputFilePath, gOutputFileRoot, L".glb");
+
+    // create the glTF binary file
+    gModelFile = createOutputFile(glbFileNameWithSuffix);
+    if (gModelFile == NULL)
+        return MW_CANNOT_CREATE_FILE;
+
+    wcharToChar(world,worldChar);
+    justWorldFileName = removePathChar(worldChar);
+
+    // replace spaces with underscores for world name output
+    strcpy_s(worldNameUnderlined,MAX_PATH,justWorldFileName);
+    spacesToUnderlinesChar(worldNameUnderlined);
+    // world names can hold anything a folder name can, such as quotes, which JSON needs escaped
+    escapeJSONChar(worldNameJSON,MAX_PATH*6,worldNameUnderlined);
+
+    resolveFaceNormals();
+
+    // a primitive per block type if materials are output, else one primitive for everything
+    exportPerType = (gOptions->exportFlags & EXPT_OUTPUT_MATERIALS) ? 1 : 0;
+    if ( exportPerType && !(gOptions->exportFlags & EXPT_GROUP_BY_MATERIAL) )
+    {
+        // individual blocks were asked for, but a glTF mesh has no groups, so materials are all that's left
+        Timing_Start(TIMING_SORT);
+        retCode |= sortFacesByMaterial();
+        Timing_Stop(TIMING_SORT);
+        if ( retCode >= MW_BEGIN_ERRORS )
+            goto Exit;
+    }
+
+    floatsPerVertex = gExportTexture ? 8 : 6;
+    vertexStride = floatsPerVertex*sizeof(float);
+
+    // At most four vertices and six indices per face. The JSON is at most 2K per primitive, see below.
+    maxVertices = 4*(size_t)gModel.faceCount;
+    maxIndices = 6*(size_t)gModel.faceCount;
+    jsonSize = (NUM_BLOCKS+4)*2048;
+    if ( maxVertices*vertexStride + maxIndices*sizeof(unsigned int) + jsonSize + 12 + 8 + 8 > GLB_MAX_LENGTH )
+    {
+        retCode |= MW_WORLD_EXPORT_TOO_LARGE;
+        goto Exit;
+    }
+
+    // the hash table is at least twice the vertex count
+    for ( hashSize = 1024; hashSize < 2*maxVertices && hashSize < GLTF_MAX_HASH_SIZE; hashSize <<= 1 )
+        ;
+    hashMask = (unsigned int)(hashSize - 1);
+
+    prims = (GLTFPrimitive *)malloc(NUM_BLOCKS*sizeof(GLTFPrimitive));
+    vertexData = (float *)malloc(maxVertices*vertexStride);
+    indexData = (unsigned int *)malloc(maxIndices*sizeof(unsigned int));
+    vertexKey = (int (*)[3])malloc(maxVertices*3*sizeof(int));
+    hashTable = (int *)malloc(hashSize*sizeof(int));
+    if ( (prims == NULL) || (vertexData == NULL) || (indexData == NULL) || (vertexKey == NULL) || (hashTable == NULL) )
+    {
+        retCode |= MW_WORLD_EXPORT_TOO_LARGE;
+        goto Exit;
+    }
+    memset(hashTable,0xff,hashSize*sizeof(int));
+
+    primCount = 0;
+    vertexCount = 0;
+    indexCount = 0;
+    prim = NULL;
+    for ( face = 0; face < gModel.faceCount; face++ )
+    {
+        int faceType = exportPerType ? gModel.faces.type[face] : GENERIC_MATERIAL;
+        int *pVertexIndex = gModel.faces.vertexIndex[face];
+        int *pUVIndex = gModel.faces.uvIndex[face];
+        int normalIndex = gModel.faces.normalIndex[face];
+        int outIndex[4];
+        int cornerCount;
+
+        if ( face % 1000 == 0 )
+            UPDATE_PROGRESS( PG_OUTPUT + (PG_TEXTURE-PG_OUTPUT)*((float)face/(float)gModel.faceCount));
+
+        // faces are sorted by material, so a new type starts a new primitive
+        if ( prim == NULL || prim->type != faceType )
+        {
+            assert( primCount < NUM_BLOCKS );
+            prim = &prims[primCount++];
+            prim->type = faceType;
+            prim->firstVertex = vertexCount;
+            prim->vertexCount = 0;
+            prim->firstIndex = indexCount;
+            prim->indexCount = 0;
+        }
+
+        cornerCount = (pVertexIndex[2] == pVertexIndex[3]) ? 3 : 4;
+        for ( i = 0; i < cornerCount; i++ )
+        {
+            int uvIndex = gExportTexture ? pUVIndex[i] : 0;
+            unsigned int hash = ((unsigned int)pVertexIndex[i]*73856093u) ^ ((unsigned int)uvIndex*19349663u) ^ ((unsigned int)normalIndex*83492791u);
+            int slot = (int)(hash & hashMask);
+
+            // Look for this corner's vertex, UV, and normal combination among the vertices of this primitive.
+            // Entries from earlier primitives count as empty, so the table never has to be cleared.
+            for (;;)
+            {
+                int v = hashTable[slot];
+                if ( v < prim->firstVertex )
+                {
+                    float *pOut = &vertexData[(size_t)vertexCount*floatsPerVertex];
+                    float *pOutNormal = pOut + 3;
+                    float *pVertex = gModel.vertices[pVertexIndex[i]];
+
+                    // new vertex
+                    hashTable[slot] = vertexCount;
+                    vertexKey[vertexCount][0] = pVertexIndex[i];
+                    vertexKey[vertexCount][1] = uvIndex;
+                    vertexKey[vertexCount][2] = normalIndex;
+                    Vec2Op( pOut, =, pVertex );
+                    Vec2Op( pOutNormal, =, gModel.normals[normalIndex] );
+                    if ( gExportTexture )
+                    {
+                        // glTF's texture origin is the upper left corner
+                        pOut[6] = gModel.uvIndexList[uvIndex].uc;
+                        pOut[7] = 1.0f - gModel.uvIndexList[uvIndex].vc;
+                    }
+                    if ( vertexCount == prim->firstVertex )
+                    {
+                        Vec2Op( prim->min, =, pVertex );
+                        Vec2Op( prim->max, =, pVertex );
+                    }
+                    else
+                    {
+                        for ( j = 0; j < 3; j++ )
+                        {
+                            prim->min[j] = min( prim->min[j], pVertex[j] );
+                            prim->max[j] = max( prim->max[j], pVertex[j] );
+                        }
+                    }
+                    outIndex[i] = vertexCount++;
+                    break;
+                }
+                if ( vertexKey[v][0] == pVertexIndex[i] && vertexKey[v][1] == uvIndex && vertexKey[v][2] == normalIndex )
+                {
+                    outIndex[i] = v;
+                    break;
+                }
+                slot = (slot + 1) & hashMask;
+            }
+        }
+
+        // indices are relative to the primitive's first vertex, as each primitive gets its own accessors
+        indexData[indexCount++] = outIndex[0] - prim->firstVertex;
+        indexData[indexCount++] = outIndex[1] - prim->firstVertex;
+        indexData[indexCount++] = outIndex[2] - prim->firstVertex;
+        if ( cornerCount == 4 )
+        {
+            indexData[indexCount++] = outIndex[0] - prim->firstVertex;
+            indexData[indexCount++] = outIndex[2] - prim->firstVertex;
+            indexData[indexCount++] = outIndex[3] - prim->firstVertex;
+        }
+        prim->vertexCount = vertexCount - prim->firstVertex;
+        prim->indexCount = indexCount - prim->firstIndex;
+    }
+
+    // the vertex data is a multiple of 4 bytes long, so the indices that follow stay aligned
+    vertexLength = (unsigned int)(vertexCount*vertexStride);
+    indexLength = (unsigned int)(indexCount*sizeof(unsigned int));
+    binLength = vertexLength + indexLength;
+
+    // Now the JSON. Each primitive's entries are well under 1K, as are the fixed parts.
+    json = (char *)malloc(jsonSize);
+    if ( json == NULL )
+    {
+        retCode |= MW_WORLD_EXPORT_TOO_LARGE;
+        goto Exit;
+    }
+
+    jsonLength = sprintf_s(json, jsonSize,
+        "{\"asset\":{\"version\":\"2.0\",\"generator\":\"Mineways version %d.%d, http://mineways.com\"},"
+        "\"scene\":0,\"scenes\":[{\"nodes\":[0]}],"
+        "\"nodes\":[{\"mesh\":0,\"name\":\"%s__%d_%d_%d_to_%d_%d_%d\"}],"
+        "\"meshes\":[{\"primitives\":[",
+        gMajorVersion, gMinorVersion,
+        worldNameJSON,
+        worldBox->min[X], worldBox->min[Y], worldBox->min[Z],
+        worldBox->max[X], worldBox->max[Y], worldBox->max[Z] );
+    for ( p = 0; p < primCount; p++ )
+    {
+        // accessors go position, normal, [UV,] indices for each primitive
+        int accessor = p*(gExportTexture ? 4 : 3);
+        if ( gExportTexture )
+        {
+            jsonLength += sprintf_s(json+jsonLength, jsonSize-jsonLength,
+                "%s{\"attributes\":{\"POSITION\":%d,\"NORMAL\":%d,\"TEXCOORD_0\":%d},\"indices\":%d,\"material\":%d}",
+                p ? "," : "", accessor, accessor+1, accessor+2, accessor+3, p );
+        }
+        else
+        {
+            jsonLength += sprintf_s(json+jsonLength, jsonSize-jsonLength,
+                "%s{\"attributes\":{\"POSITION\":%d,\"NORMAL\":%d},\"indices\":%d,\"material\":%d}",
+                p ? "," : "", accessor, accessor+1, accessor+2, p );
+        }
+    }
+    jsonLength += sprintf_s(json+jsonLength, jsonSize-jsonLength, "]}],\"materials\":[");
+    for ( p = 0; p < primCount; p++ )
+    {
+        jsonLength += writeGLTFMaterial(json+jsonLength, jsonSize-jsonLength, prims[p].type, (p == 0));
+    }
+    jsonLength += sprintf_s(json+jsonLength, jsonSize-jsonLength, "],");
+    if ( gExportTexture )
+    {
+        // The texture is not embedded, as it is made after the model is written; it is the same single PNG VRML uses.
+        jsonLength += sprintf_s(json+jsonLength, jsonSize-jsonLength,
+            "\"textures\":[{\"sampler\":0,\"source\":0}],"
+            "\"samplers\":[{\"magFilter\":%d,\"minFilter\":%d,\"wrapS\":%d,\"wrapT\":%d}],"
+            "\"images\":[{\"uri\":\"%s.png\"}],",
+            GLTF_NEAREST, GLTF_NEAREST, GLTF_CLAMP_TO_EDGE, GLTF_CLAMP_TO_EDGE, gOutputFileRootCleanChar );
+    }
+    jsonLength += sprintf_s(json+jsonLength, jsonSize-jsonLength, "\"accessors\":[");
+    for ( p = 0; p < primCount; p++ )
+    {
+        unsigned int byteOffset = (unsigned int)(prims[p].firstVertex*vertexStride);
+        jsonLength += sprintf_s(json+jsonLength, jsonSize-jsonLength,
+            "%s{\"bufferView\":0,\"byteOffset\":%u,\"componentType\":%d,\"count\":%d,\"type\":\"VEC3\",\"min\":[%.9g,%.9g,%.9g],\"max\":[%.9g,%.9g,%.9g]},"
+            "{\"bufferView\":0,\"byteOffset\":%u,\"componentType\":%d,\"count\":%d,\"type\":\"VEC3\"},",
+            p ? "," : "",
+            byteOffset, GLTF_FLOAT, prims[p].vertexCount,
+            prims[p].min[X], prims[p].min[Y], prims[p].min[Z], prims[p].max[X], prims[p].max[Y], prims[p].max[Z],
+            byteOffset+12, GLTF_FLOAT, prims[p].vertexCount );
+        if ( gExportTexture )
+        {
+            jsonLength += sprintf_s(json+jsonLength, jsonSize-jsonLength,
+                "{\"bufferView\":0,\"byteOffset\":%u,\"componentType\":%d,\"count\":%d,\"type\":\"VEC2\"},",
+                byteOffset+24, GLTF_FLOAT, prims[p].vertexCount );
+        }
+        jsonLength += sprintf_s(json+jsonLength, jsonSize-jsonLength,
+            "{\"bufferView\":1,\"byteOffset\":%u,\"componentType\":%d,\"count\":%d,\"type\":\"SCALAR\"}",
+            (unsigned int)(prims[p].firstIndex*sizeof(unsigned int)), GLTF_UNSIGNED_INT, prims[p].indexCount );
+    }
+    jsonLength += sprintf_s(json+jsonLength, jsonSize-jsonLength,
+        "],\"bufferViews\":["
+        "{\"buffer\":0,\"byteOffset\":0,\"byteLength\":%u,\"byteStride\":%d,\"target\":%d},"
+        "{\"buffer\":0,\"byteOffset\":%u,\"byteLength\":%u,\"target\":%d}],"
+        "\"buffers\":[{\"byteLength\":%u}]}",
+        vertexLength, (int)vertexStride, GLTF_ARRAY_BUFFER,
+        vertexLength, indexLength, GLTF_ELEMENT_ARRAY_BUFFER,
+        binLength );
+
+    // chunks must be 4-byte aligned; the JSON chunk is padded with spaces
+    while ( jsonLength % 4 )
+    {
+        json[jsonLength++] = ' ';
+    }
+
+    header[0] = GLB_MAGIC;
+    header[1] = 2;
+    header[2] = 12 + 8 + jsonLength + 8 + binLength;
+    if ( writeOutputFile(gModelFile, header, 12) )
+        goto WriteError;
+
+    chunkHeader[0] = jsonLength;
+    chunkHeader[1] = GLB_CHUNK_JSON;
+    if ( writeOutputFile(gModelFile, chunkHeader, 8) || writeOutputFile(gModelFile, json, jsonLength) )
+        goto WriteError;
+
+    chunkHeader[0] = binLength;
+    chunkHeader[1] = GLB_CHUNK_BIN;
+    if ( writeOutputFile(gModelFile, chunkHeader, 8) ||
+        writeOutputFile(gModelFile, vertexData, vertexLength) ||
+        writeOutputFile(gModelFile, indexData, indexLength) )
+        goto WriteError;
+
+    closeOutputFile(&gModelFile);
+
+    // glTF has no place for comments, so write the stats to a separate file, as for binary STL
+    concatFileName3(statsFileName, gOutputFilePath, gOutputFileRoot, L".txt");
+
+    statsFile = createOutputFile(statsFileName);
+    if (statsFile == NULL)
+    {
+        retCode |= MW_CANNOT_CREATE_FILE;
+    }
+    else
+    {
+        retCode |= writeStatistics( statsFile, justWorldFileName, worldBox );
+        closeOutputFile(&statsFile);
+    }
+    goto Cleanup;
+
+WriteError:
+    assert(0);
+    retCode |= MW_CANNOT_WRITE_TO_FILE;
+Exit:
+    closeOutputFile(&gModelFile);
+Cleanup:
+    free(prims);
+    free(vertexData);
+    free(indexData);
+    free(vertexKey);
+    free(hashTable);
+    free(json);
+
+    return retCode;
+}
+
+// Add a glTF metallic-roughness material for the block type, following the VRML rules for color and alpha.
+// Returns the number of characters added to json.
+static int writeGLTFMaterial( char *json, int jsonSize, int type, int firstMaterial )
+{
+    char mtlName[256];
+    char alphaModeString[256];
+    char textureString[256];
+    char emissiveString[256];
+    float fRed, fGreen, fBlue;
+    float alpha;
+    int isGeneric = (type == GENERIC_MATERIAL);
+
+    if ( isGeneric )
+    {
+        strcpy_s(mtlName,256,"Neutral_White");
+        // note that this "generic" type will never match the debug type
+        type = BLOCK_STONE;
+    }
+    else
+    {
+        strcpy_s(mtlName,256,gBlockDefinitions[type].name);
+        spacesToUnderlinesChar(mtlName);
+    }
+
+    // the texture supplies the color, so the material itself is white
+    if ( gExportTexture || isGeneric )
+    {
+        fRed = fGreen = fBlue = 1.0f;
+    }
+    else
+    {
+        fRed = (gBlockDefinitions[type].color >> 16)/255.0f;
+        fGreen = ((gBlockDefinitions[type].color >> 8) & 0xff)/255.0f;
+        fBlue = (gBlockDefinitions[type].color & 0xff)/255.0f;
+    }
+
+    alpha = gBlockDefinitions[type].alpha;
+    if (gOptions->exportFlags & EXPT_DEBUG_SHOW_GROUPS)
+    {
+        // if showing groups, make the alpha of the largest group transparent
+        alpha = ( gDebugTransparentType == type ) ? DEBUG_DISPLAY_ALPHA : 1.0f;
+    }
+    else if ( gPrint3D )
+    {
+        // for 3d printing, alpha is always 1.0
+        alpha = 1.0f;
+    }
+
+    // Cutouts get their alpha from the texture; truly transparent things, such as water, are blended.
+    if ( alpha < 1.0f && (gOptions->exportFlags & EXPT_OUTPUT_TEXTURE_IMAGES) && !(gBlockDefinitions[type].flags & BLF_TRANSPARENT) )
+    {
+        alpha = 1.0f;
+    }
+    if ( alpha < 1.0f )
+    {
+        strcpy_s(alphaModeString,256,",\"alphaMode\":\"BLEND\"");
+    }
+    else if ( (gOptions->exportFlags & EXPT_OUTPUT_TEXTURE_IMAGES) && !gPrint3D && (gBlockDefinitions[type].flags & (BLF_CUTOUTS|BLF_TRANSPARENT)) )
+    {
+        strcpy_s(alphaModeString,256,",\"alphaMode\":\"MASK\"");
+    }
+    else
+    {
+        alphaModeString[0] = '\0';
+    }
+
+    if ( gExportTexture )
+    {
+        strcpy_s(textureString,256,",\"baseColorTexture\":{\"index\":0}");
+    }
+    else
+    {
+        textureString[0] = '\0';
+    }
+
+    if ( !gPrint3D && (gBlockDefinitions[type].flags & BLF_EMITTER) )
+    {
+        sprintf_s(emissiveString,256,",\"emissiveFactor\":[%g,%g,%g]%s", fRed, fGreen, fBlue,
+            gExportTexture ? ",\"emissiveTexture\":{\"index\":0}" : "" );
+    }
+    else
+    {
+        emissiveString[0] = '\0';
+    }
+
+    return sprintf_s(json, jsonSize,
+        "%s{\"name\":\"%s\",\"pbrMetallicRoughness\":{\"baseColorFactor\":[%g,%g,%g,%g]%s,\"metallicFactor\":0,\"roughnessFactor\":1}%s%s%s}",
+        firstMaterial ? "" : ",",
+        mtlName,
+        fRed, fGreen, fBlue, alpha,
+        textureString,
+        emissiveString,
+        alphaModeString,
+        gPrint3D ? "" : ",\"doubleSided\":true" );
+}
+
+
+static int writeSchematicBox()
+{
     wchar_t schematicFileNameWithSuffix[MAX_PATH];
 
     int retCode = MW_NO_ERROR;
 
     int width, height, length, totalSize, maxShortSize;
-    unsigned char *blocks, *block_ptr;
-    unsigned char *blockData, *blockData_ptr;
-    IPoint loc;
+    SchematicBuffer sb;
+    size_t blocksOffset, blockDataOffset, blockDataLengthOffset = 0;
+    unsigned char *blockType, *blockData;
+    int outStride, layerSize;
+    size_t layerStep;
+    int boxStart, boxStepX, boxStepZ;
+    int x, y, z;
     float progressStart, progressOffset;
 
-    int xStart, xEnd, xIncr;
-    int zStart, zEnd, zIncr;
+    // Sponge palette: the entry for each type and data value, and the block state names
+    int *paletteIndex = NULL;
+    char *paletteName = NULL;
+    int paletteCount = 0;
+    int i;
+
+    int xStart, xIncr;
+    int zStart, zIncr;
 
     int rotateQuarter = 0;
 
+    // locals for the per-block loop, as the compiler can't tell that writing the output doesn't change the globals
+    BoxCell *boxData = gBoxData;
+    int boxSizeYZ = gBoxSizeYZ;
+    int boxSizeY = gBoxSize[Y];
+    int sponge = gSpongeSchematic;
+
     width = gSolidBox.max[X] - gSolidBox.min[X] + 1;
     height = gSolidBox.max[Y] - gSolidBox.min[Y] + 1;
     length = gSolidBox.max[Z] - gSolidBox.min[Z] + 1;
@@ -15027,44 +17298,27 @@ static int writeSchematicBox()
         // Length of region too large for a .schematic");
         return retCode|MW_DIMENSION_TOO_LARGE;
     }
-
-    concatFileName3(schematicFileNameWithSuffix, gOutputFilePath, gOutputFileRoot, L".schematic");
-
-    // create the schematic file
-    err = _wfopen_s(&fptr, schematicFileNameWithSuffix, L"wb");
-    if (fptr == NULL || err != 0)
-    {
-        return retCode|MW_CANNOT_CREATE_FILE;
-    }
-    // now make it a gzip file
-    gz = gzdopen(_fileno(fptr),"wb");
-    if (gz == NULL)
-    {
-        return retCode|MW_CANNOT_CREATE_FILE;
+    // NBT byte arrays have a 32 bit length
+    if ((long long)width * height * length > INT_MAX) {
+        return retCode|MW_DIMENSION_TOO_LARGE;
     }
 
-    addOutputFilenameToList(schematicFileNameWithSuffix);
-
-    blocks = blockData = NULL;
+    concatFileName3(schematicFileNameWithSuffix, gOutputFilePath, gOutputFileRoot, sponge ? L".schem" : L".schematic");
 
     if ( gOptions->pEFD->radioRotate0 )
     {
         //angle = 0;
         xStart = gSolidBox.min[X];
-        xEnd = gSolidBox.max[X];
         xIncr = 1;
         zStart = gSolidBox.min[Z];
-        zEnd = gSolidBox.max[Z];
         zIncr = 1;
     }
     else if ( gOptions->pEFD->radioRotate90 )
     {
         //angle = 90;
         xStart = gSolidBox.max[Z];
-        xEnd = gSolidBox.min[Z];
         xIncr = -1;
         zStart = gSolidBox.min[X];
-        zEnd = gSolidBox.max[X];
         zIncr = 1;
 
         rotateQuarter = 1;
@@ -15073,10 +17327,8 @@ static int writeSchematicBox()
     {
         //angle = 180;
         xStart = gSolidBox.max[X];
-        xEnd = gSolidBox.min[X];
         xIncr = -1;
         zStart = gSolidBox.max[Z];
-        zEnd = gSolidBox.min[Z];
         zIncr = -1;
     }
     else
@@ -15085,10 +17337,8 @@ static int writeSchematicBox()
         assert(gOptions->pEFD->radioRotate270);
 
         xStart = gSolidBox.min[Z];
-        xEnd = gSolidBox.max[Z];
         xIncr = 1;
         zStart = gSolidBox.max[X];
-        zEnd = gSolidBox.min[X];
         zIncr = -1;
 
         rotateQuarter = 1;
@@ -15102,208 +17352,660 @@ static int writeSchematicBox()
         length = swapper;
     }
 
+    // The whole file is put together in memory, then compressed in one go. Either format needs
+    // at most two bytes a block: block and data bytes, or a Sponge palette index of up to 4096.
+    totalSize = width * height * length;
+    sb.count = 0;
+    sb.size = 2*(size_t)totalSize + 1024;
+    sb.data = (unsigned char *)malloc(sb.size);
+    if ( sb.data == NULL )
+    {
+        return retCode|MW_WORLD_EXPORT_TOO_LARGE;
+    }
+
 #define CHECK_SCHEMATIC_QUIT( b )			\
     if ( (b) == 0 ) {						\
-    if ( blocks ) free( blocks );		\
-    if ( blockData ) free( blockData );	\
-    gzclose(gz);						\
-    return retCode|MW_CANNOT_WRITE_TO_FILE;		\
+    free( sb.data );					\
+    if ( paletteIndex ) free( paletteIndex );	\
+    if ( paletteName ) free( paletteName );	\
+    return retCode|MW_WORLD_EXPORT_TOO_LARGE;	\
     }
 
     // check if return codes are 0, if so failed and we should abort
-    CHECK_SCHEMATIC_QUIT( schematicWriteCompoundTag(gz, "Schematic") );
-    // follow a typical file structure from schematics site, giving an order
-    CHECK_SCHEMATIC_QUIT( schematicWriteShortTag(gz, "Height", (short)height ) );
-    CHECK_SCHEMATIC_QUIT( schematicWriteShortTag(gz, "Length", (short)length ) );
-    CHECK_SCHEMATIC_QUIT( schematicWriteShortTag(gz, "Width", (short)width ) );
-
-    //// WorldEdit likes to add these, not sure what they are. TODO someday, figure these out.
-    ////schematicWriteInt("WEOriginX", new IntTag("WEOriginX", clipboard.getOrigin().getBlockX()));
-    ////schematicWriteInt("WEOriginY", new IntTag("WEOriginY", clipboard.getOrigin().getBlockY()));
-    ////schematicWriteInt("WEOriginZ", new IntTag("WEOriginZ", clipboard.getOrigin().getBlockZ()));
-    ////schematicWriteInt("WEOffsetX", new IntTag("WEOffsetX", clipboard.getOffset().getBlockX()));
-    ////schematicWriteInt("WEOffsetY", new IntTag("WEOffsetY", clipboard.getOffset().getBlockY()));
-    ////schematicWriteInt("WEOffsetZ", new IntTag("WEOffsetZ", clipboard.getOffset().getBlockZ()));
-
-    CHECK_SCHEMATIC_QUIT( schematicWriteEmptyListTag(gz, "Entities" ) );
-    CHECK_SCHEMATIC_QUIT( schematicWriteEmptyListTag(gz, "TileEntities" ) );
-
-    CHECK_SCHEMATIC_QUIT( schematicWriteString(gz, "Materials", "Alpha" ) );
-
-    // Copy
-    totalSize = width * height * length;
-    blocks = block_ptr = (unsigned char *)malloc(totalSize);
-    blockData = blockData_ptr = (unsigned char *)malloc(totalSize);
+    CHECK_SCHEMATIC_QUIT( schematicWriteCompoundTag(&sb, "Schematic") );
+    if ( sponge )
+    {
+        // Sponge schematic, version 2: https://github.com/SpongePowered/Schematic-Specification
+        CHECK_SCHEMATIC_QUIT( schematicWriteIntTag(&sb, "Version", 2 ) );
+        CHECK_SCHEMATIC_QUIT( schematicWriteIntTag(&sb, "DataVersion", BLOCK_STATE_DATA_VERSION ) );
+        // these are really unsigned
+        CHECK_SCHEMATIC_QUIT( schematicWriteShortTag(&sb, "Width", (short)width ) );
+        CHECK_SCHEMATIC_QUIT( schematicWriteShortTag(&sb, "Height", (short)height ) );
+        CHECK_SCHEMATIC_QUIT( schematicWriteShortTag(&sb, "Length", (short)length ) );
+        CHECK_SCHEMATIC_QUIT( schematicWriteEmptyListTag(&sb, "BlockEntities" ) );
+
+        // the varint block data's length isn't known until it's written, so is filled in after
+        CHECK_SCHEMATIC_QUIT( schematicWriteTagValue(&sb, 0x07, "BlockData" ) );
+        blockDataLengthOffset = sb.count;
+        CHECK_SCHEMATIC_QUIT( schematicWriteIntValue(&sb, 0 ) );
+
+        paletteIndex = (int *)malloc(256*16*sizeof(int));
+        paletteName = (char *)malloc(256*16*SCHEMATIC_STATE_LENGTH);
+        CHECK_SCHEMATIC_QUIT( paletteIndex != NULL && paletteName != NULL );
+        for ( i = 0; i < 256*16; i++ )
+        {
+            paletteIndex[i] = -1;
+        }
+    }
+    else
+    {
+        // follow a typical file structure from schematics site, giving an order
+        CHECK_SCHEMATIC_QUIT( schematicWriteShortTag(&sb, "Height", (short)height ) );
+        CHECK_SCHEMATIC_QUIT( schematicWriteShortTag(&sb, "Length", (short)length ) );
+        CHECK_SCHEMATIC_QUIT( schematicWriteShortTag(&sb, "Width", (short)width ) );
+
+        //// WorldEdit likes to add these, not sure what they are. TODO someday, figure these out.
+        ////schematicWriteInt("WEOriginX", new IntTag("WEOriginX", clipboard.getOrigin().getBlockX()));
+        ////schematicWriteInt("WEOriginY", new IntTag("WEOriginY", clipboard.getOrigin().getBlockY()));
+        ////schematicWriteInt("WEOriginZ", new IntTag("WEOriginZ", clipboard.getOrigin().getBlockZ()));
+        ////schematicWriteInt("WEOffsetX", new IntTag("WEOffsetX", clipboard.getOffset().getBlockX()));
+        ////schematicWriteInt("WEOffsetY", new IntTag("WEOffsetY", clipboard.getOffset().getBlockY()));
+        ////schematicWriteInt("WEOffsetZ", new IntTag("WEOffsetZ", clipboard.getOffset().getBlockZ()));
+
+        CHECK_SCHEMATIC_QUIT( schematicWriteEmptyListTag(&sb, "Entities" ) );
+        CHECK_SCHEMATIC_QUIT( schematicWriteEmptyListTag(&sb, "TileEntities" ) );
+
+        CHECK_SCHEMATIC_QUIT( schematicWriteString(&sb, "Materials", "Alpha" ) );
+    }
+
+    // The block arrays are filled in place. The buffer was made large enough that it's not reallocated.
+    // For Sponge, the type and data of each block go in pairs, turned into palette entries after.
+    if ( sponge )
+    {
+        blockDataOffset = sb.count;
+        CHECK_SCHEMATIC_QUIT( schematicReserve(&sb, 2*(size_t)totalSize ) );
+        blockType = sb.data + blockDataOffset;
+        blockData = blockType + 1;
+        outStride = 2;
+    }
+    else
+    {
+        CHECK_SCHEMATIC_QUIT( schematicWriteByteArrayTag(&sb, "Blocks", NULL, totalSize ) );
+        blocksOffset = sb.count - totalSize;
+        CHECK_SCHEMATIC_QUIT( schematicWriteByteArrayTag(&sb, "Data", NULL, totalSize ) );
+        blockDataOffset = sb.count - totalSize;
+        blockType = sb.data + blocksOffset;
+        blockData = sb.data + blockDataOffset;
+        outStride = 1;
+    }
+
+    // Box index steps for one block along the output's X and Z. If we rotate 90 or 270, X and Z are swapped.
+    if ( rotateQuarter )
+    {
+        boxStepX = xIncr*boxSizeY;
+        boxStepZ = zIncr*boxSizeYZ;
+        boxStart = zStart*boxSizeYZ + xStart*boxSizeY + gSolidBox.min[Y];
+    }
+    else
+    {
+        boxStepX = xIncr*boxSizeYZ;
+        boxStepZ = zIncr*boxSizeY;
+        boxStart = xStart*boxSizeYZ + zStart*boxSizeY + gSolidBox.min[Y];
+    }
+    layerSize = width*length;
+    layerStep = (size_t)outStride*layerSize;
 
     progressStart = 0.80f*PG_MAKE_FACES;
-    progressOffset = PG_END - progressStart;
+    progressOffset = 0.5f*(PG_END - progressStart);
 
-    // go through blocks and see which is solid; use solid blocks to generate faces
-    // Order is YZX according to http://www.minecraftwiki.net/wiki/Schematic_file_format
-    for ( loc[Y] = gSolidBox.min[Y]; loc[Y] <= gSolidBox.max[Y]; loc[Y]++ )
+    // Order is YZX according to http://www.minecraftwiki.net/wiki/Schematic_file_format, but the box
+    // is stored by column, so a run of blocks up each column is copied to that many layers at once.
+    for ( y = 0; y < height; y += SCHEMATIC_LAYERS )
     {
-        float localT = ((float)(loc[Y]-gSolidBox.min[Y]+1)/(float)(gSolidBox.max[Y]-gSolidBox.min[Y]+1));
+        int layers = min( SCHEMATIC_LAYERS, height - y );
+        float localT = (float)(y + layers)/(float)height;
         float globalT = progressStart + progressOffset*localT;
         UPDATE_PROGRESS( globalT );
 
-        for ( loc[Z] = zStart; loc[Z]*zIncr <= zEnd*zIncr; loc[Z]+=zIncr )
+        for ( z = 0; z < length; z++ )
         {
-            for ( loc[X] = xStart; loc[X]*xIncr <= xEnd*xIncr; loc[X]+=xIncr )
+            BoxCell *column = boxData + boxStart + z*boxStepZ + y;
+            size_t outIndex = (size_t)y*layerSize + (size_t)z*width;
+            for ( x = 0; x < width; x++, column += boxStepX, outIndex++ )
             {
-                unsigned char type, data;
-                int boxIndex;
-                // if we rotate 90 or 270, X and Z are swapped for rotation. This allows us to
-                // have just one set of loops, above.
-                if ( rotateQuarter )
-                {
-                    boxIndex = BOX_INDEX(loc[Z],loc[Y],loc[X]);
-                }
-                else
-                {
-                    boxIndex = BOX_INDEX(loc[X],loc[Y],loc[Z]);
-                }
-
-                type = gBoxData[boxIndex].type;
-                data = gBoxData[boxIndex].data;
-                if ( gBoxData[boxIndex].type >= BLOCK_UNKNOWN )
+                unsigned char *outType = blockType + outStride*outIndex;
+                unsigned char *outData = blockData + outStride*outIndex;
+                for ( i = 0; i < layers; i++ )
                 {
+                    unsigned char type = column[i].type;
+                    unsigned char data = column[i].data;
                     // unknown block?
-                    if ( gBoxData[boxIndex].type == BLOCK_UNKNOWN )
+                    if ( type == BLOCK_UNKNOWN )
                     {
                         // convert to bedrock, I guess...
                         data = 0x0;
                         type = BLOCK_BEDROCK;
                         retCode |= MW_UNKNOWN_BLOCK_TYPE_ENCOUNTERED;
                     }
+                    outType[i*layerStep] = type;
+                    outData[i*layerStep] = data;
                 }
-                *block_ptr++ = type;
-                *blockData_ptr++ = data;
             }
         }
     }
 
-    CHECK_SCHEMATIC_QUIT( schematicWriteByteArrayTag(gz, "Blocks", blocks, totalSize ) );
-    CHECK_SCHEMATIC_QUIT( schematicWriteByteArrayTag(gz, "Data", blockData, totalSize ) );
+    if ( sponge )
+    {
+        // Turn each type and data pair into its palette entry, as a varint: seven bits a byte, low bits
+        // first, high bit set if more follow. Entries are under 4096, so at most two bytes, and so are
+        // never written past the pair being read.
+        unsigned char *pair = sb.data + blockDataOffset;
+        unsigned char *varInt = pair;
+        unsigned char *pairEnd = pair + 2*(size_t)totalSize;
+        int blockDataLength;
+        for ( ; pair < pairEnd; pair += 2 )
+        {
+            int key = (pair[0]<<4) | (pair[1]&0xf);
+            int index = paletteIndex[key];
+            if ( index < 0 )
+            {
+                // first time this type and data is seen. Different data can give the same
+                // state, and each state must be in the palette just once.
+                char *name = paletteName + paletteCount*SCHEMATIC_STATE_LENGTH;
+                GetBlockStateString( pair[0], pair[1], name, SCHEMATIC_STATE_LENGTH );
+                for ( index = 0; index < paletteCount; index++ )
+                {
+                    if ( strcmp( name, paletteName + index*SCHEMATIC_STATE_LENGTH ) == 0 )
+                        break;
+                }
+                if ( index == paletteCount )
+                {
+                    paletteCount++;
+                }
+                paletteIndex[key] = index;
+            }
+            if ( index & ~0x7f )
+            {
+                *varInt++ = (unsigned char)((index & 0x7f) | 0x80);
+                index >>= 7;
+            }
+            *varInt++ = (unsigned char)index;
+        }
+
+        // drop the unused part of the space reserved, and fill in the length
+        blockDataLength = (int)(varInt - (sb.data + blockDataOffset));
+        sb.count = blockDataOffset + blockDataLength;
+        for ( i = 0; i < 4; i++ )
+        {
+            sb.data[blockDataLengthOffset+i] = (unsigned char)((blockDataLength >> (24-8*i)) & 0xff);
+        }
+
+        CHECK_SCHEMATIC_QUIT( schematicWriteIntTag(&sb, "PaletteMax", paletteCount ) );
+        CHECK_SCHEMATIC_QUIT( schematicWriteCompoundTag(&sb, "Palette") );
+        for ( i = 0; i < paletteCount; i++ )
+        {
+            CHECK_SCHEMATIC_QUIT( schematicWriteIntTag(&sb, paletteName + i*SCHEMATIC_STATE_LENGTH, i ) );
+        }
+        // TAG_End of the palette
+        CHECK_SCHEMATIC_QUIT( schematicWriteUnsignedCharValue(&sb, 0x0 ) );
+    }
 
     // TAG_End
-    CHECK_SCHEMATIC_QUIT( schematicWriteUnsignedCharValue( gz, 0x0 ) );
+    CHECK_SCHEMATIC_QUIT( schematicWriteUnsignedCharValue(&sb, 0x0 ) );
 
-    gzclose(gz);
+    retCode |= writeSchematicFile( schematicFileNameWithSuffix, &sb, progressStart + progressOffset, PG_END );
+
+    free( sb.data );
+    if ( paletteIndex ) free( paletteIndex );
+    if ( paletteName ) free( paletteName );
+
+    return retCode;
+}
+
+// Gzip the schematic in memory into the file, at the zlib level asked for in the options
+static int writeSchematicFile( const wchar_t *fileName, SchematicBuffer *sb, float progressStart, float progressEnd )
+{
+    OutputFile *fh;
+    z_stream strm;
+    unsigned char *out;
+    size_t remaining = sb->count;
+    int level = ( gOptions->schematicCompression > 0 ) ? min( gOptions->schematicCompression, 9 ) : Z_DEFAULT_COMPRESSION;
+    int flush;
+    int retCode = MW_NO_ERROR;
+
+    out = (unsigned char *)malloc(SCHEMATIC_OUTPUT_SIZE);
+    if ( out == NULL )
+    {
+        return MW_WORLD_EXPORT_TOO_LARGE;
+    }
+
+    memset( &strm, 0, sizeof(z_stream) );
+    // 15+16 window bits gives a gzip header and trailer, as NBT files have
+    if ( deflateInit2( &strm, level, Z_DEFLATED, 15+16, 8, Z_DEFAULT_STRATEGY ) != Z_OK )
+    {
+        free( out );
+        return MW_WORLD_EXPORT_TOO_LARGE;
+    }
+
+    fh = createOutputFile( fileName );
+    if ( fh == NULL )
+    {
+        deflateEnd( &strm );
+        free( out );
+        return MW_CANNOT_CREATE_FILE;
+    }
 
-    free( blocks );
-    free( blockData );
+    strm.next_in = sb->data;
+    do {
+        // zlib counts its input in 32 bits, so feed it a gigabyte at most at a time
+        uInt piece = ( remaining > (1<<30) ) ? (1<<30) : (uInt)remaining;
+        strm.avail_in = piece;
+        remaining -= piece;
+        flush = ( remaining > 0 ) ? Z_NO_FLUSH : Z_FINISH;
+        do {
+            size_t have;
+            strm.next_out = out;
+            strm.avail_out = SCHEMATIC_OUTPUT_SIZE;
+            deflate( &strm, flush );
+            have = SCHEMATIC_OUTPUT_SIZE - strm.avail_out;
+            if ( have > 0 && writeOutputFile( fh, out, have ) )
+            {
+                retCode = MW_CANNOT_WRITE_TO_FILE;
+                goto Exit;
+            }
+            UPDATE_PROGRESS( progressStart + (progressEnd-progressStart)*
+                (float)(sb->count - remaining - strm.avail_in)/(float)sb->count );
+        } while ( strm.avail_out == 0 );
+    } while ( flush != Z_FINISH );
 
+Exit:
+    deflateEnd( &strm );
+    closeOutputFile( &fh );
+    free( out );
     return retCode;
 }
 
-static int schematicWriteCompoundTag( gzFile gz, char *tag )
+// Make room for size more bytes at the end of the buffer, and return where they go, or NULL if out of memory.
+static unsigned char *schematicReserve( SchematicBuffer *sb, size_t size )
+{
+    unsigned char *space;
+    if ( sb->count + size > sb->size )
+    {
+        size_t newSize = 2*sb->size;
+        unsigned char *newData;
+        if ( newSize < sb->count + size )
+            newSize = sb->count + size;
+        newData = (unsigned char *)realloc( sb->data, newSize );
+        if ( newData == NULL )
+            return NULL;
+        sb->data = newData;
+        sb->size = newSize;
+    }
+    space = sb->data + sb->count;
+    sb->count += size;
+    return space;
+}
+
+static int schematicWriteCompoundTag( SchematicBuffer *sb, char *tag )
 {
-    int totWrite = schematicWriteTagValue( gz, 0x0A, tag );
-    assert(totWrite);
-    return totWrite;
+    return schematicWriteTagValue( sb, 0x0A, tag );
 }
 
-static int schematicWriteShortTag( gzFile gz, char *tag, short value )
+static int schematicWriteShortTag( SchematicBuffer *sb, char *tag, short value )
 {
-    int totWrite = schematicWriteTagValue( gz, 0x02, tag );
-    totWrite += schematicWriteShortValue( gz, value );
-    assert(totWrite);
-    return totWrite;
+    return schematicWriteTagValue( sb, 0x02, tag ) && schematicWriteShortValue( sb, value );
 }
 
-static int schematicWriteEmptyListTag( gzFile gz, char *tag )
+static int schematicWriteIntTag( SchematicBuffer *sb, char *tag, int value )
+{
+    return schematicWriteTagValue( sb, 0x03, tag ) && schematicWriteIntValue( sb, value );
+}
+
+static int schematicWriteEmptyListTag( SchematicBuffer *sb, char *tag )
 {
-    int totWrite = schematicWriteTagValue( gz, 0x09, tag );
     // cheat: just force in empty data. Not sure what I'd normally see here...
-    totWrite += schematicWriteUnsignedCharValue( gz, 0x0A );
-    totWrite += schematicWriteIntValue( gz, 0 );
-    assert(totWrite);
-    return totWrite;
+    return schematicWriteTagValue( sb, 0x09, tag ) &&
+        schematicWriteUnsignedCharValue( sb, 0x0A ) &&
+        schematicWriteIntValue( sb, 0 );
 }
 
-static int schematicWriteString( gzFile gz, char *tag, char *field )
+static int schematicWriteString( SchematicBuffer *sb, char *tag, char *field )
 {
-    int totWrite = schematicWriteTagValue( gz, 0x08, tag );
-    totWrite += schematicWriteUnsignedShortValue( gz, (unsigned short)strlen(field) );
-    totWrite += schematicWriteStringValue( gz, field );
-    assert(totWrite);
-    return totWrite;
+    return schematicWriteTagValue( sb, 0x08, tag ) &&
+        schematicWriteUnsignedShortValue( sb, (unsigned short)strlen(field) ) &&
+        schematicWriteStringValue( sb, field );
 }
 
-static int schematicWriteByteArrayTag( gzFile gz, char *tag, unsigned char *byteData, int totalSize )
+// If byteData is NULL, the space for the array is left for the caller to fill in
+static int schematicWriteByteArrayTag( SchematicBuffer *sb, char *tag, unsigned char *byteData, int totalSize )
 {
-    int totWrite = schematicWriteTagValue( gz, 0x07, tag );
-    totWrite += schematicWriteIntValue( gz, totalSize );
-    totWrite += gzwrite( gz, byteData, totalSize );
-    assert(totWrite);
-    return totWrite;
+    unsigned char *space;
+    if ( !schematicWriteTagValue( sb, 0x07, tag ) || !schematicWriteIntValue( sb, totalSize ) )
+        return 0;
+    space = schematicReserve( sb, totalSize );
+    if ( space == NULL )
+        return 0;
+    if ( byteData )
+        memcpy( space, byteData, totalSize );
+    return 1;
 }
 
 
 // writes tag value, length of string, and string
-static int schematicWriteTagValue( gzFile gz, unsigned char tagValue, char *tag )
+static int schematicWriteTagValue( SchematicBuffer *sb, unsigned char tagValue, char *tag )
 {
-    int totWrite = schematicWriteUnsignedCharValue( gz, tagValue );
-    totWrite += schematicWriteUnsignedShortValue( gz, (unsigned short)strlen(tag) );
-    totWrite += schematicWriteStringValue( gz, tag );
-    assert(totWrite);
-    return totWrite;
+    return schematicWriteUnsignedCharValue( sb, tagValue ) &&
+        schematicWriteUnsignedShortValue( sb, (unsigned short)strlen(tag) ) &&
+        schematicWriteStringValue( sb, tag );
 }
 
-static int schematicWriteUnsignedCharValue( gzFile gz, unsigned char charValue )
+static int schematicWriteUnsignedCharValue( SchematicBuffer *sb, unsigned char charValue )
 {
-    int totWrite = gzwrite( gz, &charValue, 1 );
-    assert(totWrite);
-    return totWrite;
+    unsigned char *space = schematicReserve( sb, 1 );
+    if ( space == NULL )
+        return 0;
+    space[0] = charValue;
+    return 1;
 }
 
-static int schematicWriteUnsignedShortValue( gzFile gz, unsigned short shortValue )
+static int schematicWriteUnsignedShortValue( SchematicBuffer *sb, unsigned short shortValue )
 {
-    unsigned char writeByte = (shortValue>>8)&0xff;
-    int totWrite = gzwrite( gz, &writeByte, 1 );
-    writeByte = shortValue&0xff;
-    totWrite += gzwrite( gz, &writeByte, 1 );
-    assert(totWrite);
-    return totWrite;
+    unsigned char *space = schematicReserve( sb, 2 );
+    if ( space == NULL )
+        return 0;
+    space[0] = (shortValue>>8)&0xff;
+    space[1] = shortValue&0xff;
+    return 1;
 }
 
 // really, identical to the one above, just a different signature
-static int schematicWriteShortValue( gzFile gz, short shortValue )
+static int schematicWriteShortValue( SchematicBuffer *sb, short shortValue )
+{
+    return schematicWriteUnsignedShortValue( sb, (unsigned short)shortValue );
+}
+
+static int schematicWriteIntValue( SchematicBuffer *sb, int intValue )
 {
-    unsigned char writeByte = (shortValue>>8)&0xff;
-    int totWrite = gzwrite( gz, &writeByte, 1 );
-    writeByte = shortValue&0xff;
-    totWrite += gzwrite( gz, &writeByte, 1 );
-    assert(totWrite);
-    return totWrite;
+    return schematicWriteUnsignedShortValue( sb, (unsigned short)((intValue>>16) & 0xffff) ) &&
+        schematicWriteUnsignedShortValue( sb, (unsigned short)(intValue & 0xffff) );
 }
 
-static int schematicWriteIntValue( gzFile gz, int intValue )
+static int schematicWriteStringValue( SchematicBuffer *sb, char *stringValue )
 {
-    int totWrite = schematicWriteUnsignedShortValue( gz, (unsigned short)((intValue>>16) & 0xffff) );
-    totWrite += schematicWriteUnsignedShortValue( gz, (unsigned short)(intValue & 0xffff) );
-    assert(totWrite);
-    return totWrite;
+    size_t len = strlen(stringValue);
+    unsigned char *space = schematicReserve( sb, len );
+    if ( space == NULL )
+        return 0;
+    memcpy( space, stringValue, len );
+    return 1;
 }
 
-static int schematicWriteStringValue( gzFile gz, char *stringValue )
-{
-    int totWrite = gzwrite( gz, stringValue, (unsigned int)strlen(stringValue) );
-    assert(totWrite);
-    return totWrite;
+
+// Allocate the output buffer, if needed, and empty it.
+static int startBufferedOutput()
+{
+    gOutputBufferCount = 0;
+    if ( gOutputBuffer == NULL )
+    {
+        gOutputBuffer = (char *)malloc(OUTPUT_BUFFER_SIZE);
+        if ( gOutputBuffer == NULL )
+        {
+            return MW_WORLD_EXPORT_TOO_LARGE;
+        }
+    }
+    return MW_NO_ERROR;
+}
+
+// Return where the next line of text goes in the output buffer, first writing out the buffer if there
+// might not be room for a line. Returns NULL if the write failed.
+static char *bufferedOutputLine()
+{
+    if ( gOutputBufferCount > OUTPUT_BUFFER_SIZE - OUTPUT_BUFFER_LINE_ROOM )
+    {
+        if ( flushBufferedOutput() )
+            return NULL;
+    }
+    return gOutputBuffer + gOutputBufferCount;
+}
+
+// Mark the text up to pOut as part of the buffered output.
+static void endBufferedOutputLine( char *pOut )
+{
+    gOutputBufferCount = (int)(pOut - gOutputBuffer);
+    assert( gOutputBufferCount <= OUTPUT_BUFFER_SIZE );
+}
+
+// Write out whatever is in the output buffer. Like PortaWrite, returns non-zero on failure.
+static int flushBufferedOutput()
+{
+    int count = gOutputBufferCount;
+    gOutputBufferCount = 0;
+    if ( count > 0 )
+    {
+        return writeOutputFile(gModelFile, gOutputBuffer, count);
+    }
+    return 0;
+}
+
+// Add a string of any length up to OUTPUT_BUFFER_LINE_ROOM to the output buffer. Returns non-zero on failure.
+static int bufferedWrite( const char *str )
+{
+    char *pOut = bufferedOutputLine();
+    if ( pOut == NULL )
+        return 1;
+    endBufferedOutputLine( appendString( pOut, str ) );
+    return 0;
+}
+
+static char *appendString( char *pOut, const char *str )
+{
+    while ( *str )
+    {
+        *pOut++ = *str++;
+    }
+    return pOut;
+}
+
+static char *appendInt( char *pOut, int value )
+{
+    return pOut + formatInt( pOut, value );
+}
+
+// decimals of -1 gives "%g" output, else fixed precision with trailing zeroes removed
+static char *appendFloat( char *pOut, float value, int decimals )
+{
+    if ( decimals < 0 )
+        return pOut + formatFloatG( pOut, value );
+    else
+        return pOut + formatFloatFixed( pOut, value, decimals );
+}
+
+// Write an integer as decimal text, the same as "%d". Returns number of characters written.
+static int formatInt( char *dst, int value )
+{
+    char digits[12];
+    int count = 0;
+    int length = 0;
+    // work in unsigned so that the most negative int is handled
+    unsigned int uvalue = (unsigned int)value;
+    if ( value < 0 )
+    {
+        dst[length++] = '-';
+        uvalue = 0u - uvalue;
+    }
+    do {
+        digits[count++] = (char)('0' + uvalue % 10);
+        uvalue /= 10;
+    } while ( uvalue );
+    while ( count )
+    {
+        dst[length++] = digits[--count];
+    }
+    return length;
+}
+
+// Write a float the same as "%g" does, i.e. six significant digits with trailing zeroes removed.
+// The float's exact binary value is scaled to a six digit integer with 64-bit integer math, which
+// covers the usual range of output values; anything else (exponential notation, exact ties in
+// rounding, NaN and so on) is handed to sprintf_s, so the output is always byte-identical.
+static int formatFloatG( char *dst, float value )
+{
+    static const unsigned long long powersOfTen[10] = { 1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL,
+        1000000ULL, 10000000ULL, 100000000ULL, 1000000000ULL };
+    int length = 0;
+    int exp2, shift, decExp, i, numDigits;
+    unsigned long long mantissa, scaled, quotient, remainder, half;
+    char digits[6];
+    float absValue;
+
+    if ( value == 0.0f )
+    {
+        // keeps the sign of negative zero, as %g does
+        if ( _copysign(1.0, (double)value) < 0.0 )
+            dst[length++] = '-';
+        dst[length++] = '0';
+        return length;
+    }
+    absValue = (float)fabs(value);
+    // 1e-4 to 1e6 is where %g uses plain decimal notation
+    if ( !(absValue >= 0.0001f && absValue < 1000000.0f) )
+    {
+        goto UseSprintf;
+    }
+
+    // value = mantissa * 2^-shift, exactly; mantissa has at most 24 bits
+    mantissa = (unsigned long long)ldexp( frexp( (double)absValue, &exp2 ), 24 );
+    shift = 24 - exp2;
+    if ( shift < 1 || shift > 62 )
+    {
+        goto UseSprintf;
+    }
+
+    // first guess at the decimal exponent, corrected below once the value is rounded
+    decExp = (int)floor( log10( (double)absValue ) );
+    for ( i = 0; i < 3; i++ )
+    {
+        // scale to six significant digits: mantissa * 10^(5-decExp) / 2^shift, which fits in 64 bits
+        if ( 5 - decExp < 0 || 5 - decExp > 9 )
+        {
+            goto UseSprintf;
+        }
+        scaled = mantissa * powersOfTen[5 - decExp];
+        quotient = scaled >> shift;
+        remainder = scaled & ((1ULL << shift) - 1);
+        half = 1ULL << (shift - 1);
+        if ( remainder == half )
+        {
+            // exact tie: leave the rounding choice to the C runtime
+            goto UseSprintf;
+        }
+        if ( remainder > half )
+        {
+            quotient++;
+        }
+        if ( quotient >= 1000000ULL )
+            decExp++;
+        else if ( quotient < 100000ULL )
+            decExp--;
+        else
+            break;
+    }
+    if ( i == 3 || decExp < -4 || decExp > 5 )
+    {
+        goto UseSprintf;
+    }
+
+    // six digits, most significant first
+    for ( i = 5; i >= 0; i-- )
+    {
+        digits[i] = (char)('0' + quotient % 10);
+        quotient /= 10;
+    }
+    // drop trailing zeroes, but never the digits before the decimal point
+    numDigits = 6;
+    while ( numDigits > decExp + 1 && digits[numDigits-1] == '0' )
+    {
+        numDigits--;
+    }
+
+    if ( value < 0.0f )
+        dst[length++] = '-';
+    if ( decExp < 0 )
+    {
+        dst[length++] = '0';
+        dst[length++] = '.';
+        for ( i = -1; i > decExp; i-- )
+            dst[length++] = '0';
+        for ( i = 0; i < numDigits; i++ )
+            dst[length++] = digits[i];
+    }
+    else
+    {
+        for ( i = 0; i < numDigits; i++ )
+        {
+            if ( i == decExp + 1 )
+                dst[length++] = '.';
+            dst[length++] = digits[i];
+        }
+    }
+    return length;
+
+UseSprintf:
+    return sprintf_s( dst, 32, "%g", value );
+}
+
+// Write a float with at most the given number of decimals, trailing zeroes removed. Faster and
+// often shorter than %g, but not identical to it, so it is used only when asked for.
+static int formatFloatFixed( char *dst, float value, int decimals )
+{
+    static const double powersOfTen[10] = { 1.0, 10.0, 100.0, 1000.0, 10000.0, 100000.0,
+        1000000.0, 10000000.0, 100000000.0, 1000000000.0 };
+    char digits[24];
+    int count = 0;
+    int length = 0;
+    unsigned long long whole;
+    double scaled = fabs( (double)value ) * powersOfTen[decimals] + 0.5;
+
+    if ( !(scaled < 9.0e18) )
+    {
+        // out of range of this simple method, or NaN
+        return sprintf_s( dst, 32, "%g", value );
+    }
+    whole = (unsigned long long)scaled;
+    if ( whole == 0 )
+    {
+        dst[length++] = '0';
+        return length;
+    }
+    // drop trailing zeroes of the fraction
+    while ( decimals > 0 && whole % 10 == 0 )
+    {
+        whole /= 10;
+        decimals--;
+    }
+    do {
+        digits[count++] = (char)('0' + whole % 10);
+        whole /= 10;
+    } while ( whole || count <= decimals );
+
+    if ( value < 0.0f )
+        dst[length++] = '-';
+    while ( count )
+    {
+        if ( count == decimals )
+            dst[length++] = '.';
+        dst[length++] = digits[--count];
+    }
+    return length;
 }
 
-
-static int writeLines( HANDLE file, char **textLines, int lines )
+static int writeLines( OutputFile *file, char **textLines, int lines )
 {
-#ifdef WIN32
-    DWORD br;
-#endif
 
     int i;
     for ( i = 0; i < lines; i++ )
     {
-        WERROR(PortaWrite(file, textLines[i], strlen(textLines[i]) ));
+        WERROR(writeOutputFile(file, textLines[i], strlen(textLines[i]) ));
     }
 
     return MW_NO_ERROR;
@@ -15331,11 +18033,8 @@ static float min3( Point pt )
     return min( retVal, pt[2] );
 }
 
-static int writeStatistics( HANDLE fh, const char *justWorldFileName, IBox *worldBox )
+static int writeStatistics( OutputFile *fh, const char *justWorldFileName, IBox *worldBox )
 {
-#ifdef WIN32
-    DWORD br;
-#endif
 
     char outputString[256];
     char timeString[256];
@@ -15358,7 +18057,7 @@ static int writeStatistics( HANDLE fh, const char *justWorldFileName, IBox *worl
     float inCM3 = inCM * inCM * inCM;
 
     sprintf_s(outputString,256,"# Extracted from Minecraft world %s\n", justWorldFileName );
-    WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+    WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
 
 
     _time32( &aclock );   // Get time in seconds.
@@ -15369,14 +18068,14 @@ static int writeStatistics( HANDLE fh, const char *justWorldFileName, IBox *worl
     if (!errNum)
     {
         sprintf_s(outputString,256,"# %s", timeString );
-        WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+        WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
     }
 
     // put the selection box near the top, since I find I use these values most of all
     sprintf_s(outputString,256,"\n# Selection location min to max: %d, %d, %d to %d, %d, %d\n\n",
         worldBox->min[X], worldBox->min[Y], worldBox->min[Z],
         worldBox->max[X], worldBox->max[Y], worldBox->max[Z] );
-    WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+    WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
 
     // If STL, say which type of STL, etc.
     switch ( gOptions->pEFD->fileType )
@@ -15396,16 +18095,22 @@ static int writeStatistics( HANDLE fh, const char *justWorldFileName, IBox *worl
     case FILE_TYPE_ASCII_STL:
         strcpy_s( formatString, 256, "ASCII STL");
         break;
+    case FILE_TYPE_BINARY_PLY:
+        strcpy_s( formatString, 256, "Binary PLY");
+        break;
     case FILE_TYPE_VRML2:
         strcpy_s( formatString, 256, "VRML 2.0");
         break;
+    case FILE_TYPE_GLTF:
+        strcpy_s( formatString, 256, "glTF 2.0 binary");
+        break;
     default:
         strcpy_s( formatString, 256, "Unknown file type");
         assert(0);
         break;
     }
     sprintf_s(outputString,256,"# Created for %s - %s\n", gPrint3D ? "3D printing" : "Viewing", formatString );
-    WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+    WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
 
     if ( gPrint3D )
     {
@@ -15416,20 +18121,20 @@ static int writeStatistics( HANDLE fh, const char *justWorldFileName, IBox *worl
         {
             // If we add materials, put the material chosen here.
             sprintf_s(outputString,256,"\n# Cost estimate for this model:\n");
-            WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+            WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
 
             sprintf_s(warningString,256,"%s", (gModel.scale < gMtlCostTable[PRINT_MATERIAL_WHITE_STRONG_FLEXIBLE].minWall) ? " *** WARNING, thin wall ***" : "" );
             sprintf_s(outputString,256,"#   if made using the white, strong & flexible material: $ %0.2f%s\n",
                 computeMaterialCost( PRINT_MATERIAL_WHITE_STRONG_FLEXIBLE, gModel.scale, gBlockCount, gMinorBlockCount ),
                 warningString);
-            WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+            WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
         }
 
         sprintf_s(warningString,256,"%s", (gModel.scale < gMtlCostTable[isSculpteo ? PRINT_MATERIAL_FCS_SCULPTEO : PRINT_MATERIAL_FULL_COLOR_SANDSTONE].minWall) ? " *** WARNING, thin wall ***" : "" );
         sprintf_s(outputString,256,"#   if made using the full color sandstone material:     $ %0.2f%s\n",
             computeMaterialCost( isSculpteo ? PRINT_MATERIAL_FCS_SCULPTEO : PRINT_MATERIAL_FULL_COLOR_SANDSTONE, gModel.scale, gBlockCount, gMinorBlockCount ),
             warningString);
-        WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+        WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
 
         // if material is not one of these, print its cost
         if ( gPhysMtl > PRINT_MATERIAL_FULL_COLOR_SANDSTONE && gPhysMtl != PRINT_MATERIAL_FCS_SCULPTEO )
@@ -15440,17 +18145,17 @@ static int writeStatistics( HANDLE fh, const char *justWorldFileName, IBox *worl
                 gMtlCostTable[gPhysMtl].name,
                 computeMaterialCost( gPhysMtl, gModel.scale, gBlockCount, gMinorBlockCount ),
                 warningString);
-            WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+            WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
         }
         gOptions->cost = computeMaterialCost( gPhysMtl, gModel.scale, gBlockCount, gMinorBlockCount );
 
         sprintf_s(outputString,256, "# For %s printer, minimum wall is %g mm, maximum size is %g x %g x %g cm\n", gMtlCostTable[gPhysMtl].name, gMtlCostTable[gPhysMtl].minWall*METERS_TO_MM,
             gMtlCostTable[gPhysMtl].maxSize[0], gMtlCostTable[gPhysMtl].maxSize[1], gMtlCostTable[gPhysMtl].maxSize[2] );
-        WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+        WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
     }
 
     sprintf_s(outputString,256,"# Units for the model vertex data itself: %s\n", gUnitTypeTable[gOptions->pEFD->comboModelUnits[gOptions->pEFD->fileType]].name );
-    WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+    WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
 
     if ( gPrint3D )
     {
@@ -15473,52 +18178,58 @@ static int writeStatistics( HANDLE fh, const char *justWorldFileName, IBox *worl
         gOptions->dim_cm[Z] = inCM * gFilledBoxSize[Z];
         sprintf_s(outputString,256,"\n# world dimensions: %0.2f x %0.2f x %0.2f cm%s\n",
             gOptions->dim_cm[X], gOptions->dim_cm[Y], gOptions->dim_cm[Z], errorString);
-        WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+        WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
 
         gOptions->dim_inches[X] = inCM * gFilledBoxSize[X]/2.54f;
         gOptions->dim_inches[Y] = inCM * gFilledBoxSize[Y]/2.54f;
         gOptions->dim_inches[Z] = inCM * gFilledBoxSize[Z]/2.54f;
         sprintf_s(outputString,256,"#   in inches: %0.2f x %0.2f x %0.2f inches%s\n",
             gOptions->dim_inches[X], gOptions->dim_inches[Y], gOptions->dim_inches[Z], errorString );
-        WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+        WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
 
         gOptions->block_mm = gModel.scale*METERS_TO_MM;
         gOptions->block_inch = gOptions->block_mm / 25.4f;
         sprintf_s(outputString,256,"# each block is %0.2f mm on a side, and has a volume of %g mm^3\n", gOptions->block_mm, inCM3*1000 );
-        WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+        WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
 
         sumOfDimensions = 10*inCM *(gFilledBoxSize[X]+gFilledBoxSize[Y]+gFilledBoxSize[Z]);
         sprintf_s(outputString,256,"# sum of dimensions: %g mm\n", sumOfDimensions );
-        WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+        WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
 
         volume = inCM3 * gBlockCount;
         sprintf_s(outputString,256,"# volume is %g cm^3\n", volume );
-        WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+        WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
 
         area = AREA_IN_CM2 ;
         sprintf_s(outputString,256,"# surface area is %g cm^2\n", area );
-        WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+        WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
 
         sprintf_s(outputString,256,"# block density: %d%% of volume\n",
             (int)(gStats.density*100.0f+0.5f));
-        WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+        WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
     }
 
     // write out a summary, useful for various reasons
-    if ( gExportBillboards )
+    if ( gStreamOBJ )
+    {
+        // vertices and faces are not made yet; their counts go at the end of the file
+        sprintf_s(outputString,256,"\n# %d blocks, %d billboards/bits\n", gBlockCount, gModel.billboardCount);
+        WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
+    }
+    else if ( gExportBillboards )
     {
         sprintf_s(outputString,256,"\n# %d vertices, %d faces (%d triangles), %d blocks, %d billboards/bits\n", gModel.vertexCount, gModel.faceCount, 2*gModel.faceCount, gBlockCount, gModel.billboardCount);
-        WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+        WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
     }
     else
     {
         sprintf_s(outputString,256,"\n# %d vertices, %d faces (%d triangles), %d blocks\n", gModel.vertexCount, gModel.faceCount, 2*gModel.faceCount, gBlockCount);
-        WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+        WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
     }
     gOptions->totalBlocks = gBlockCount;
 
     sprintf_s(outputString,256,"# block dimensions: X=%g by Y=%g (height) by Z=%g blocks\n", gFilledBoxSize[X], gFilledBoxSize[Y], gFilledBoxSize[Z] );
-    WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+    WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
     Vec2Op(gOptions->dimensions, =, (int)gFilledBoxSize);
 
     // Summarize all the options used for output
@@ -15535,54 +18246,60 @@ static int writeStatistics( HANDLE fh, const char *justWorldFileName, IBox *worl
         radio = 0;
 
     sprintf_s(outputString,256,"# File type: %s\n", outputTypeString[radio] );
-    WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+    WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
 
     if ( ( gOptions->pEFD->fileType == FILE_TYPE_WAVEFRONT_ABS_OBJ ) || ( gOptions->pEFD->fileType == FILE_TYPE_WAVEFRONT_REL_OBJ ) )
     {
         if ( gOptions->pEFD->fileType == FILE_TYPE_WAVEFRONT_REL_OBJ )
         {
             strcpy_s(outputString,256,"# OBJ relative coordinates" );
-            WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+            WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
         }
 
         sprintf_s(outputString,256,"# Export separate objects: %s\n", gOptions->pEFD->chkMultipleObjects ? "YES" : "no" );
-        WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+        WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
         if ( gOptions->pEFD->chkMultipleObjects )
         {
             sprintf_s(outputString,256,"#  Material per object: %s\n", gOptions->pEFD->chkMaterialPerType ? "YES" : "no" );
-            WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+            WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
             if ( gOptions->pEFD->chkMaterialPerType )
             {
                 sprintf_s(outputString,256,"#   G3D full material: %s\n", gOptions->pEFD->chkG3DMaterial ? "YES" : "no" );
-                WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+                WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
             }
         }
+
+        sprintf_s(outputString,256,"# Write geometry as it is made: %s\n", gOptions->pEFD->chkStreamOBJ ? "YES" : "no" );
+        WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
+
+        sprintf_s(outputString,256,"# Fixed precision coordinates: %s\n", gOptions->pEFD->chkFixedPrecisionOBJ ? "YES" : "no" );
+        WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
     }
 
     sprintf_s(outputString,256,"# Make Z the up direction instead of Y: %s\n", gOptions->pEFD->chkMakeZUp[gOptions->pEFD->fileType] ? "YES" : "no" );
-    WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+    WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
 
     sprintf_s(outputString,256,"# Center model: %s\n", gOptions->pEFD->chkCenterModel ? "YES" : "no" );
-    WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+    WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
 
     sprintf_s(outputString,256,"# Export lesser blocks: %s\n", gOptions->pEFD->chkExportAll ? "YES" : "no" );
-    WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+    WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
 
     if ( gOptions->pEFD->chkExportAll )
     {
         sprintf_s(outputString,256,"# Fatten lesser blocks: %s\n", gOptions->pEFD->chkFatten ? "YES" : "no" );
-        WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+        WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
     }
 
     sprintf_s(outputString,256,"# Individual blocks: %s\n", gOptions->pEFD->chkIndividualBlocks ? "YES" : "no" );
-    WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+    WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
 
     sprintf_s(outputString,256,"# Use biomes: %s\n", gOptions->pEFD->chkBiome ? "YES" : "no" );
-    WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+    WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
 
     // now always on by default
     //sprintf_s(outputString,256,"# Merge flat blocks with neighbors: %s\n", gOptions->pEFD->chkMergeFlattop ? "YES" : "no" );
-    //WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+    //WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
 
     if ( gOptions->pEFD->radioRotate0 )
         angle = 0;
@@ -15597,130 +18314,193 @@ static int writeStatistics( HANDLE fh, const char *justWorldFileName, IBox *worl
     }
 
     sprintf_s(outputString,256,"# Rotate model %f degrees\n", angle );
-    WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+    WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
 
     if ( gOptions->pEFD->radioScaleByBlock )
     {
         sprintf_s(outputString,256,"# Scale model by making each block %g mm high\n", gOptions->pEFD->blockSizeVal[gOptions->pEFD->fileType] );
-        WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+        WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
     }
     else if ( gOptions->pEFD->radioScaleByCost )
     {
         sprintf_s(outputString,256,"# Scale model by aiming for a cost of %0.2f for the %s material\n", gOptions->pEFD->costVal, gMtlCostTable[gPhysMtl].name );
-        WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+        WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
     }
     else if ( gOptions->pEFD->radioScaleToHeight )
     {
         sprintf_s(outputString,256,"# Scale model by fitting to a height of %g cm\n", gOptions->pEFD->modelHeightVal );
-        WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+        WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
     }
     else if ( gOptions->pEFD->radioScaleToMaterial )
     {
         sprintf_s(outputString,256,"# Scale model by using the minimum wall thickness for the %s material\n", gMtlCostTable[gPhysMtl].name );
-        WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+        WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
     }
 
     sprintf_s(outputString,256,"# Data operation options:\n#   Fill air bubbles: %s; Seal off entrances: %s; Fill in isolated tunnels in base of model: %s\n",
         (gOptions->pEFD->chkFillBubbles ? "YES" : "no"),
         (gOptions->pEFD->chkSealEntrances ? "YES" : "no"),
         (gOptions->pEFD->chkSealSideTunnels ? "YES" : "no"));
-    WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+    WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
 
     sprintf_s(outputString,256,"#   Connect parts sharing an edge: %s; Connect corner tips: %s; Weld all shared edges: %s\n",
         (gOptions->pEFD->chkConnectParts ? "YES" : "no"),
         (gOptions->pEFD->chkConnectCornerTips ? "YES" : "no"),
         (gOptions->pEFD->chkConnectAllEdges ? "YES" : "no"));
-    WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+    WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
 
     sprintf_s(outputString,256,"#   Delete floating objects: trees and parts smaller than %d blocks: %s\n",
         gOptions->pEFD->floaterCountVal,
         (gOptions->pEFD->chkDeleteFloaters ? "YES" : "no"));
-    WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+    WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
 
     sprintf_s(outputString,256,"#   Hollow out bottom of model, making the walls %g mm thick: %s; Superhollow: %s\n",
         gOptions->pEFD->hollowThicknessVal[gOptions->pEFD->fileType],
         (gOptions->pEFD->chkHollow[gOptions->pEFD->fileType] ? "YES" : "no"),
         (gOptions->pEFD->chkSuperHollow[gOptions->pEFD->fileType] ? "YES" : "no"));
-    WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+    WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
+
+    sprintf_s(outputString,256,"#   Hollow by distance to the surface: %s; Drill drain holes: %s\n",
+        (gOptions->pEFD->chkHollowByDistance[gOptions->pEFD->fileType] ? "YES" : "no"),
+        (gOptions->pEFD->chkDrainHoles[gOptions->pEFD->fileType] ? "YES" : "no"));
+    WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
 
     sprintf_s(outputString,256,"# Melt snow blocks: %s\n", gOptions->pEFD->chkMeltSnow ? "YES" : "no" );
-    WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+    WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
 
     sprintf_s(outputString,256,"#   Debug: show separate parts as colors: %s\n", gOptions->pEFD->chkShowParts ? "YES" : "no" );
-    WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+    WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
 
     sprintf_s(outputString,256,"#   Debug: show weld blocks in bright colors: %s\n", gOptions->pEFD->chkShowWelds ? "YES" : "no" );
-    WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+    WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
 
     // write out processing stats for 3D printing
     if ( gOptions->exportFlags & (EXPT_FILL_BUBBLES|EXPT_CONNECT_PARTS|EXPT_DELETE_FLOATING_OBJECTS) )
     {
         sprintf_s(outputString,256,"\n# Cleanup processing summary:\n#   Solid parts: %d\n",
             gStats.numSolidGroups);
-        WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+        WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
     }
 
     if ( gOptions->exportFlags & EXPT_FILL_BUBBLES )
     {
         sprintf_s(outputString,256,"#   Air bubbles found and filled (with glass): %d\n",
             gStats.bubblesFound);
-        WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+        WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
     }
 
     if ( gOptions->exportFlags & (EXPT_FILL_BUBBLES|EXPT_CONNECT_PARTS) )
     {
         sprintf_s(outputString,256,"#   Total solid parts merged: %d\n",
             gStats.solidGroupsMerged);
-        WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+        WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
     }
 
     if ( gOptions->exportFlags & EXPT_CONNECT_PARTS )
     {
         sprintf_s(outputString,256,"#   Number of edge passes made: %d\n",
             gStats.numberManifoldPasses);
-        WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+        WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
 
         sprintf_s(outputString,256,"#     Edges found to fix: %d\n",
             gStats.nonManifoldEdgesFound);
-        WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+        WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
 
         sprintf_s(outputString,256,"#     Weld blocks added: %d\n",
             gStats.blocksManifoldWelded);
-        WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+        WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
     }
 
     if ( gOptions->exportFlags & EXPT_CONNECT_CORNER_TIPS )
     {
         sprintf_s(outputString,256,"#     Tip blocks added: %d\n",
             gStats.blocksCornertipWelded);
-        WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+        WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
     }
 
     if ( gOptions->exportFlags & EXPT_DELETE_FLOATING_OBJECTS )
     {
         sprintf_s(outputString,256,"#   Floating parts removed: %d\n",
             gStats.floaterGroupsDeleted);
-        WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+        WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
 
         sprintf_s(outputString,256,"#     In these floaters, total blocks removed: %d\n",
             gStats.blocksFloaterDeleted);
-        WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+        WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
     }
 
     if ( gOptions->exportFlags & EXPT_HOLLOW_BOTTOM )
     {
         sprintf_s(outputString,256,"#   Blocks removed by hollowing: %d\n",
             gStats.blocksHollowed);
-        WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+        WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
+
+        if ( gOptions->exportFlags & EXPT_HOLLOW_BY_DISTANCE )
+        {
+            sprintf_s(outputString,256,"#   Blocks removed to make drain holes for closed hollows: %d\n",
+                gStats.blocksDrained);
+        }
+        else
+        {
+            sprintf_s(outputString,256,"#   Blocks removed by further super-hollowing (i.e. not just vertical hollowing): %d\n",
+                gStats.blocksSuperHollowed);
+        }
+        WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
+    }
 
-        sprintf_s(outputString,256,"#   Blocks removed by further super-hollowing (i.e. not just vertical hollowing): %d\n",
-            gStats.blocksSuperHollowed);
-        WERROR(PortaWrite(fh, outputString, strlen(outputString) ));
+    // the stages done by the time the header is written
+    if ( gOptions->timingReport & TIMING_REPORT_HEADER )
+    {
+        int stage;
+        strcpy_s(outputString,256,"\n# Export timing so far, in seconds:\n");
+        WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
+        for ( stage = 0; stage < TIMING_STAGE_COUNT; stage++ )
+        {
+            double wall, cpu;
+            int calls;
+            Timing_GetStage( stage, &wall, &cpu, &calls );
+            if ( calls > 0 )
+            {
+                sprintf_s(outputString,256,"#   %s: %.3f wall, %.3f CPU, %d times\n", Timing_StageName(stage), wall, cpu, calls);
+                WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
+            }
+        }
+        sprintf_s(outputString,256,"#   Chunks loaded: %lld; found in cache: %lld; region bytes read: %lld\n",
+            Timing_GetCounter(TIMING_CHUNKS_LOADED), Timing_GetCounter(TIMING_CACHE_HITS), Timing_GetCounter(TIMING_BYTES_READ));
+        WERROR(writeOutputFile(fh, outputString, strlen(outputString) ));
     }
 
     return MW_NO_ERROR;
 }
 
+// Write how long each stage took, and the counts, to <output>-timing.json
+static int writeTimingReport( int fileType )
+{
+    wchar_t timingFileName[MAX_PATH];
+    long long bytesWritten = 0;
+    int i;
+
+    Timing_Set( TIMING_FACES_OUTPUT, gStreamOBJ ? gModel.writtenFaceCount : gModel.faceCount );
+    Timing_Set( TIMING_VERTICES_OUTPUT, gStreamOBJ ? gModel.writtenVertexCount : gModel.vertexCount );
+    for ( i = 0; i < gOutputFileList->count; i++ )
+    {
+        unsigned long long fileSize;
+        if ( gOutputFileList->inMemory && gOutputFileList->data[i] != NULL )
+        {
+            bytesWritten += (long long)gOutputFileList->size[i];
+        }
+        else if ( PortaFileSize( gOutputFileList->name[i], &fileSize ) )
+        {
+            bytesWritten += (long long)fileSize;
+        }
+    }
+    Timing_Set( TIMING_BYTES_WRITTEN, bytesWritten );
+    Timing_SetPeakMemory();
+
+    concatFileName3(timingFileName,gOutputFilePath,gOutputFileRoot,L"-timing.json");
+    return Timing_WriteJSON( timingFileName, fileType );
+}
+
 // final checks:
 // if color, is sum of dimensions too small?
 // else, is wall thickness dangerous?
@@ -15759,7 +18539,7 @@ static int finalModelChecks()
 
         // it's not clear from http://www.shapeways.com/tutorials/how_to_use_meshlab_and_netfabb whether
         // it's one million polygons (we use quads) or one million triangles. We opt for triangles here:
-        if ( gModel.faceCount*2 > 1000000 )
+        if ( (gStreamOBJ ? gModel.writtenFaceCount : gModel.faceCount)*2 > 1000000 )
         {
             retCode |= MW_TOO_MANY_POLYGONS;
         }
@@ -15787,14 +18567,113 @@ static float computeMaterialCost( int printMaterialType, float blockEdgeSize, in
         gMtlCostTable[printMaterialType].costPerCubicCentimeter * ccmMaterial );
 }
 
-static void addOutputFilenameToList(wchar_t *filename)
+static void addOutputFilenameToList(const wchar_t *filename)
 {
     assert ( gOutputFileList->count < MAX_OUTPUT_FILES );
 
     wcsncpy_s(gOutputFileList->name[gOutputFileList->count],MAX_PATH,filename,MAX_PATH);
+    gOutputFileList->data[gOutputFileList->count] = NULL;
+    gOutputFileList->size[gOutputFileList->count] = 0;
     gOutputFileList->count++;
 }
 
+// Start an output file and add it to the output file list. It's kept in memory if the list says so.
+// Returns NULL if the file can't be created.
+static OutputFile *createOutputFile( const wchar_t *filename )
+{
+    OutputFile *pFile = (OutputFile *)malloc(sizeof(OutputFile));
+
+    addOutputFilenameToList(filename);
+    if ( pFile == NULL )
+        return NULL;
+    pFile->index = gOutputFileList->count-1;
+    pFile->fh = INVALID_HANDLE_VALUE;
+    if ( gOutputFileList->inMemory )
+    {
+        // more memory is allocated as it's written; if there's none at all, it goes to disk
+        pFile->capacity = 64*1024;
+        gOutputFileList->data[pFile->index] = (unsigned char *)malloc(pFile->capacity);
+        if ( gOutputFileList->data[pFile->index] != NULL )
+            return pFile;
+    }
+    pFile->fh = PortaCreate(filename);
+    if ( pFile->fh == INVALID_HANDLE_VALUE )
+    {
+        free(pFile);
+        return NULL;
+    }
+    return pFile;
+}
+
+// Like PortaWrite, returns non-zero on failure. A file in memory that would make the output take up more than
+// MAX_OUTPUT_MEMORY, or that can't get more memory, is written to disk from then on.
+static int writeOutputFile( OutputFile *pFile, const void *data, size_t size )
+{
+#ifdef WIN32
+    DWORD br;
+#endif
+    if ( pFile->fh == INVALID_HANDLE_VALUE )
+    {
+        FileList *pList = gOutputFileList;
+        int i = pFile->index;
+        if ( pList->size[i] + size > pFile->capacity )
+        {
+            size_t capacity = pFile->capacity;
+            unsigned char *newData = NULL;
+            while ( capacity < pList->size[i] + size )
+            {
+                capacity *= 2;
+            }
+            if ( outputMemorySize() - pList->size[i] + capacity <= MAX_OUTPUT_MEMORY )
+            {
+                newData = (unsigned char *)realloc(pList->data[i], capacity);
+            }
+            if ( newData == NULL )
+            {
+                // to disk with it, what's been written so far first
+                pFile->fh = PortaCreate(pList->name[i]);
+                if ( pFile->fh == INVALID_HANDLE_VALUE ||
+                    ( pList->size[i] > 0 && PortaWrite(pFile->fh, pList->data[i], pList->size[i]) ) )
+                {
+                    return 1;
+                }
+                free(pList->data[i]);
+                pList->data[i] = NULL;
+                pList->size[i] = 0;
+                return PortaWrite(pFile->fh, data, size);
+            }
+            pList->data[i] = newData;
+            pFile->capacity = capacity;
+        }
+        memcpy(pList->data[i] + pList->size[i], data, size);
+        pList->size[i] += size;
+        return 0;
+    }
+    return PortaWrite(pFile->fh, data, size);
+}
+
+// The file's data, if it's in memory, stays in the output file list for the zip
+static void closeOutputFile( OutputFile **ppFile )
+{
+    if ( *ppFile == NULL )
+        return;
+    if ( (*ppFile)->fh != INVALID_HANDLE_VALUE )
+        PortaClose((*ppFile)->fh);
+    free(*ppFile);
+    *ppFile = NULL;
+}
+
+// how much of the output is being kept in memory
+static size_t outputMemorySize()
+{
+    size_t total = 0;
+    for ( int i = 0; i < gOutputFileList->count; i++ )
+    {
+        total += gOutputFileList->size[i];
+    }
+    return total;
+}
+
 // substitute ' ' to '_'
 static void spacesToUnderlines( wchar_t *targetString )
 {
@@ -15823,6 +18702,32 @@ static void spacesToUnderlinesChar( char *targetString )
     }
 }
 
+// Copy sourceString into a JSON string's contents, escaping quotes, backslashes and control characters.
+// Each character takes at most 6, so size should be 6 times the source's length, plus 1.
+static void escapeJSONChar( char *targetString, int size, const char *sourceString )
+{
+    int length = 0;
+
+    for ( ; *sourceString && length < size-7; sourceString++ )
+    {
+        unsigned char c = (unsigned char)*sourceString;
+        if ( c == '"' || c == '\\' )
+        {
+            targetString[length++] = '\\';
+            targetString[length++] = (char)c;
+        }
+        else if ( c < 0x20 )
+        {
+            length += sprintf_s(targetString+length, size-length, "\\u%04x", c );
+        }
+        else
+        {
+            targetString[length++] = (char)c;
+        }
+    }
+    targetString[length] = 0;
+}
+
 #define GET_PNG_TEXEL( r,g,b,a, ip ) \
     (r) = (unsigned char)((ip) & 0xff); \
     (g) = (unsigned char)(((ip)>>8) & 0xff); \
@@ -16006,17 +18911,65 @@ static void addNoisePNGTile(progimage_info *dst, int x, int y, int tileSize, uns
     }
 }
 
+// Set only by TexelSelfTest, to run the plain loops on the same texels as the SSE2 ones.
+static int gScalarTexels = 0;
+
+#ifdef USE_SSE2_TEXELS
+// divide each 16-bit lane, 0 to 65535, by 255, rounding down
+static __m128i divide255Epu16( __m128i n )
+{
+    return _mm_srli_epi16( _mm_mulhi_epu16( n, _mm_set1_epi16((short)0x8081) ), 7 );
+}
+
+// divide each 32-bit lane, 0 to 2*255*255*255, by 255*255, rounding down
+static __m128i divide65025Epu32( __m128i n )
+{
+    const __m128i magic = _mm_set1_epi32(33818121);
+    // _mm_mul_epu32 multiplies lanes 0 and 2, so do those, then shift lanes 1 and 3 down and do those
+    __m128i even = _mm_srli_epi64( _mm_mul_epu32( n, magic ), 41 );
+    __m128i odd = _mm_srli_epi64( _mm_mul_epu32( _mm_srli_epi64( n, 32 ), magic ), 41 );
+    return _mm_or_si128( even, _mm_slli_epi64( odd, 32 ) );
+}
+
+// 16-bit lanes of two texels, with each texel's alpha copied to all four of its lanes
+static __m128i spreadAlphaEpi16( __m128i texels16 )
+{
+    return _mm_shufflehi_epi16( _mm_shufflelo_epi16( texels16, _MM_SHUFFLE(3,3,3,3) ), _MM_SHUFFLE(3,3,3,3) );
+}
+
+// where mask is set use a, elsewhere b
+static __m128i selectTexels( __m128i mask, __m128i a, __m128i b )
+{
+    return _mm_or_si128( _mm_and_si128( mask, a ), _mm_andnot_si128( mask, b ) );
+}
+#endif
+
 static void multiplyPNGTile(progimage_info *dst, int x, int y, int tileSize, unsigned char r, unsigned char g, unsigned char b, unsigned char a )
 {
     int row, col;
     unsigned int *di;
+#ifdef USE_SSE2_TEXELS
+    __m128i zero = _mm_setzero_si128();
+    __m128i mult = _mm_setr_epi16( r,g,b,a, r,g,b,a );
+#endif
 
     assert( x*tileSize+tileSize-1 < (int)dst->width );
 
     for ( row = 0; row < tileSize; row++ )
     {
         di = ((unsigned int *)(&dst->image_data[0])) + ((y*tileSize + row) * dst->width + x*tileSize);
-        for ( col = 0; col < tileSize; col++ )
+        col = 0;
+#ifdef USE_SSE2_TEXELS
+        for ( ; !gScalarTexels && col+4 <= tileSize; col += 4 )
+        {
+            __m128i value = _mm_loadu_si128( (__m128i *)di );
+            __m128i lo = divide255Epu16( _mm_mullo_epi16( _mm_unpacklo_epi8( value, zero ), mult ) );
+            __m128i hi = divide255Epu16( _mm_mullo_epi16( _mm_unpackhi_epi8( value, zero ), mult ) );
+            _mm_storeu_si128( (__m128i *)di, _mm_packus_epi16( lo, hi ) );
+            di += 4;
+        }
+#endif
+        for ( ; col < tileSize; col++ )
         {
             unsigned int value = *di;
             unsigned char dr,dg,db,da;
@@ -16104,9 +19057,60 @@ static void rotatePNGTile(progimage_info *dst, int dcol, int drow, int scol, int
         break;
     }
     {
+        // the part of the swatch done in 4x4 blocks; the plain loop does the rest
+        int blockSize = 0;
+#ifdef USE_SSE2_TEXELS
+        blockSize = gScalarTexels ? 0 : swatchSize & ~3;
+        for ( row = 0; row < blockSize; row += 4 )
+        {
+            for ( col = 0; col < blockSize; col += 4 )
+            {
+                // load four rows and transpose, so that c[i] is column col+i, rows row to row+3
+                unsigned int *si = sul + col + row*dst->width;
+                __m128i r0 = _mm_loadu_si128( (__m128i *)si );
+                __m128i r1 = _mm_loadu_si128( (__m128i *)(si + dst->width) );
+                __m128i r2 = _mm_loadu_si128( (__m128i *)(si + 2*dst->width) );
+                __m128i r3 = _mm_loadu_si128( (__m128i *)(si + 3*dst->width) );
+                __m128i t0 = _mm_unpacklo_epi32( r0, r1 );
+                __m128i t1 = _mm_unpacklo_epi32( r2, r3 );
+                __m128i t2 = _mm_unpackhi_epi32( r0, r1 );
+                __m128i t3 = _mm_unpackhi_epi32( r2, r3 );
+                __m128i c[4];
+                int i;
+                c[0] = _mm_unpacklo_epi64( t0, t1 );
+                c[1] = _mm_unpackhi_epi64( t0, t1 );
+                c[2] = _mm_unpacklo_epi64( t2, t3 );
+                c[3] = _mm_unpackhi_epi64( t2, t3 );
+
+                for ( i = 0; i < 4; i++ )
+                {
+                    switch ( angle )
+                    {
+                    default:
+                    case 0:
+                        _mm_storeu_si128( (__m128i *)(dul + col + (row+i)*dst->width), (i == 0) ? r0 : (i == 1) ? r1 : (i == 2) ? r2 : r3 );
+                        break;
+                    case 90:
+                        // column col+i becomes row col+i, reversed
+                        _mm_storeu_si128( (__m128i *)(dul + swatchSize-4-row + (col+i)*dst->width), _mm_shuffle_epi32( c[i], _MM_SHUFFLE(0,1,2,3) ) );
+                        break;
+                    case 180:
+                        // row row+i is flipped both ways
+                        _mm_storeu_si128( (__m128i *)(dul + swatchSize-4-col + (swatchSize-1-row-i)*dst->width),
+                            _mm_shuffle_epi32( (i == 0) ? r0 : (i == 1) ? r1 : (i == 2) ? r2 : r3, _MM_SHUFFLE(0,1,2,3) ) );
+                        break;
+                    case 270:
+                        // column col+i becomes row swatchSize-1-col-i
+                        _mm_storeu_si128( (__m128i *)(dul + row + (swatchSize-1-col-i)*dst->width), c[i] );
+                        break;
+                    }
+                }
+            }
+        }
+#endif
         for ( row = 0; row < swatchSize; row++ )
         {
-            for ( col = 0; col < swatchSize; col++ )
+            for ( col = ( row < blockSize ) ? blockSize : 0; col < swatchSize; col++ )
             {
                 unsigned int *di;
                 unsigned int *si = sul + col + row*dst->width;
@@ -16132,6 +19136,13 @@ static void blendTwoSwatches( progimage_info *dst, int txrSwatch, int solidSwatc
 
     int row,col;
     unsigned int *cti,*csi;
+#ifdef USE_SSE2_TEXELS
+    __m128i zero = _mm_setzero_si128();
+    __m128 blend4 = _mm_set1_ps( blend );
+    __m128 oneMinusBlend4 = _mm_set1_ps( 1.0f - blend );
+    __m128i rgbMask = _mm_set1_epi32( 0x00ffffff );
+    __m128i alpha4 = _mm_set1_epi32( (int)((unsigned int)alpha<<24) );
+#endif
 
     for ( row = 0; row < gModel.swatchSize; row++ )
     {
@@ -16139,7 +19150,36 @@ static void blendTwoSwatches( progimage_info *dst, int txrSwatch, int solidSwatc
         cti = ti + offset;
         csi = si + offset;
 
-        for ( col = 0; col < gModel.swatchSize; col++ )
+        col = 0;
+#ifdef USE_SSE2_TEXELS
+        for ( ; !gScalarTexels && col+4 <= gModel.swatchSize; col += 4 )
+        {
+            __m128i t = _mm_loadu_si128( (__m128i *)cti );
+            __m128i st = _mm_loadu_si128( (__m128i *)csi );
+            __m128i t16[2], s16[2], result16[2];
+            int half;
+            t16[0] = _mm_unpacklo_epi8( t, zero );
+            t16[1] = _mm_unpackhi_epi8( t, zero );
+            s16[0] = _mm_unpacklo_epi8( st, zero );
+            s16[1] = _mm_unpackhi_epi8( st, zero );
+            for ( half = 0; half < 2; half++ )
+            {
+                // same float math as the plain loop: t*(1-blend) + s*blend, truncated
+                __m128 tlo = _mm_cvtepi32_ps( _mm_unpacklo_epi16( t16[half], zero ) );
+                __m128 thi = _mm_cvtepi32_ps( _mm_unpackhi_epi16( t16[half], zero ) );
+                __m128 slo = _mm_cvtepi32_ps( _mm_unpacklo_epi16( s16[half], zero ) );
+                __m128 shi = _mm_cvtepi32_ps( _mm_unpackhi_epi16( s16[half], zero ) );
+                __m128i lo = _mm_cvttps_epi32( _mm_add_ps( _mm_mul_ps( tlo, oneMinusBlend4 ), _mm_mul_ps( slo, blend4 ) ) );
+                __m128i hi = _mm_cvttps_epi32( _mm_add_ps( _mm_mul_ps( thi, oneMinusBlend4 ), _mm_mul_ps( shi, blend4 ) ) );
+                result16[half] = _mm_packs_epi32( lo, hi );
+            }
+            t = _mm_or_si128( _mm_and_si128( _mm_packus_epi16( result16[0], result16[1] ), rgbMask ), alpha4 );
+            _mm_storeu_si128( (__m128i *)cti, t );
+            cti += 4;
+            csi += 4;
+        }
+#endif
+        for ( ; col < gModel.swatchSize; col++ )
         {
             unsigned char tr,tg,tb,ta;
             unsigned char sr,sg,sb,sa;
@@ -16290,7 +19330,23 @@ static void bleedPNGSwatch(progimage_info *dst, int dstSwatch, int xmin, int xma
     {
         int offset = row*dst->width;
         cdsti = dsti + offset;
-        for ( col = xmin*tileSize16; col < xmax*tileSize16; col++ )
+        col = xmin*tileSize16;
+#ifdef USE_SSE2_TEXELS
+        {
+            __m128i tag4 = _mm_set1_epi32( 123 );
+            __m128i rgbMask = _mm_set1_epi32( 0x00ffffff );
+            __m128i alpha4 = _mm_set1_epi32( (int)(alpha<<24) );
+            for ( ; !gScalarTexels && col+4 <= xmax*tileSize16; col += 4 )
+            {
+                __m128i value = _mm_loadu_si128( (__m128i *)cdsti );
+                __m128i tagged = _mm_cmpeq_epi32( _mm_srli_epi32( value, 24 ), tag4 );
+                value = selectTexels( tagged, _mm_or_si128( _mm_and_si128( value, rgbMask ), alpha4 ), value );
+                _mm_storeu_si128( (__m128i *)cdsti, value );
+                cdsti += 4;
+            }
+        }
+#endif
+        for ( ; col < xmax*tileSize16; col++ )
         {
             GET_PNG_TEXEL( dr,dg,db,da, *cdsti );
 
@@ -16324,6 +19380,13 @@ static void compositePNGSwatches(progimage_info *dst, int dstSwatch, int overSwa
     unsigned char ur,ug,ub,ua;
     unsigned char dr,dg,db,da;
     unsigned int *coveri,*cunderi,*cdsti;
+#ifdef USE_SSE2_TEXELS
+    __m128i zero = _mm_setzero_si128();
+    __m128i c255 = _mm_set1_epi16( 255 );
+    __m128i alphaLanes = _mm_setr_epi16( 0,0,0,-1, 0,0,0,-1 );
+    __m128i solidAlpha = _mm_set1_epi32( forceSolid ? (int)0xff000000 : 0 );
+    __m128i opaque4 = _mm_set1_epi32( 255 );
+#endif
 
     for ( row = 0; row < swatchSize; row++ )
     {
@@ -16331,7 +19394,48 @@ static void compositePNGSwatches(progimage_info *dst, int dstSwatch, int overSwa
         coveri = overi + offset;
         cunderi = underi + offset;
         cdsti = dsti + offset;
-        for ( col = 0; col < swatchSize; col++ )
+        col = 0;
+#ifdef USE_SSE2_TEXELS
+        for ( ; !gScalarTexels && col+4 <= swatchSize; col += 4 )
+        {
+            __m128i over = _mm_loadu_si128( (__m128i *)coveri );
+            __m128i under = _mm_or_si128( _mm_loadu_si128( (__m128i *)cunderi ), solidAlpha );
+            __m128i overAlpha = _mm_srli_epi32( over, 24 );
+            __m128i o16[2], u16[2], result16[2], result;
+            int half;
+            o16[0] = _mm_unpacklo_epi8( over, zero );
+            o16[1] = _mm_unpackhi_epi8( over, zero );
+            u16[0] = _mm_unpacklo_epi8( under, zero );
+            u16[1] = _mm_unpackhi_epi8( under, zero );
+            for ( half = 0; half < 2; half++ )
+            {
+                // Same integer math as the plain loop, o*oa*255 + u*ua*(255-oa), divided by 255*255.
+                // Using 255 for the alpha channels of o and u gives the plain loop's alpha, times 255.
+                __m128i oa16 = spreadAlphaEpi16( o16[half] );
+                __m128i ua16 = spreadAlphaEpi16( u16[half] );
+                __m128i oma16 = _mm_sub_epi16( c255, oa16 );
+                __m128i oTimesA = _mm_mullo_epi16( selectTexels( alphaLanes, c255, o16[half] ), oa16 );
+                __m128i uTimesA = _mm_mullo_epi16( selectTexels( alphaLanes, c255, u16[half] ), ua16 );
+                // 32-bit products of oTimesA*255 and uTimesA*oma
+                __m128i oLow = _mm_mullo_epi16( oTimesA, c255 );
+                __m128i oHigh = _mm_mulhi_epu16( oTimesA, c255 );
+                __m128i uLow = _mm_mullo_epi16( uTimesA, oma16 );
+                __m128i uHigh = _mm_mulhi_epu16( uTimesA, oma16 );
+                __m128i lo = divide65025Epu32( _mm_add_epi32( _mm_unpacklo_epi16( oLow, oHigh ), _mm_unpacklo_epi16( uLow, uHigh ) ) );
+                __m128i hi = divide65025Epu32( _mm_add_epi32( _mm_unpackhi_epi16( oLow, oHigh ), _mm_unpackhi_epi16( uLow, uHigh ) ) );
+                result16[half] = _mm_packs_epi32( lo, hi );
+            }
+            result = _mm_packus_epi16( result16[0], result16[1] );
+            // a transparent over texel gives the under texel, an opaque one gives the over texel
+            result = selectTexels( _mm_cmpeq_epi32( overAlpha, zero ), under, result );
+            result = selectTexels( _mm_cmpeq_epi32( overAlpha, opaque4 ), over, result );
+            _mm_storeu_si128( (__m128i *)cdsti, result );
+            coveri += 4;
+            cunderi += 4;
+            cdsti += 4;
+        }
+#endif
+        for ( ; col < swatchSize; col++ )
         {
             unsigned char oma;
 
@@ -16373,22 +19477,33 @@ static void compositePNGSwatches(progimage_info *dst, int dstSwatch, int overSwa
     }
 }
 
-static int convertRGBAtoRGBandWrite(progimage_info *src, wchar_t *filename)
+static void convertRGBAtoRGB(progimage_info *src, progimage_info *dst)
 {
-    int retCode = MW_NO_ERROR;
     int row, col;
     unsigned char *imageDst, *imageSrc;
-    progimage_info dst;
-    dst.height = src->height;
-    dst.width = src->width;
-    dst.image_data.resize(src->height*src->width * 3);
+    dst->height = src->height;
+    dst->width = src->width;
+    dst->image_data.resize(src->height*src->width * 3);
 
     imageSrc = &src->image_data[0];
-    imageDst = &dst.image_data[0];
+    imageDst = &dst->image_data[0];
 
-    for (row = 0; row < dst.height; row++)
+    for (row = 0; row < dst->height; row++)
     {
-        for (col = 0; col < dst.width; col++)
+        // pack four texels into three words at a time, then do any that are left one by one
+        for (col = 0; !gScalarTexels && col+4 <= dst->width; col += 4)
+        {
+            unsigned int *si = (unsigned int *)imageSrc;
+            unsigned char *di = imageDst;
+            unsigned int packed[3];
+            packed[0] = (si[0] & 0xffffff) | (si[1]<<24);
+            packed[1] = ((si[1]>>8) & 0xffff) | (si[2]<<16);
+            packed[2] = ((si[2]>>16) & 0xff) | (si[3]<<8);
+            memcpy(di, packed, 12);
+            imageSrc += 16;
+            imageDst += 12;
+        }
+        for (; col < dst->width; col++)
         {
             // copy RGB only
             *imageDst++ = *imageSrc++;
@@ -16397,15 +19512,86 @@ static int convertRGBAtoRGBandWrite(progimage_info *src, wchar_t *filename)
             imageSrc++;
         }
     }
+}
 
-    retCode |= writepng(&dst, 3, filename);
-    addOutputFilenameToList(filename);
-
-    writepng_cleanup(&dst);
+// Write out each texture file, compressing them all at once on their own threads, and add them to the output file
+// list in order. Returns the error codes, if any.
+static int writePNGJobs( PNGWriteJob *jobs, int numJobs )
+{
+#ifdef WIN32
+    DWORD br;
+#endif
+    int retCode = MW_NO_ERROR;
+    PNGWriteQueue queue;
+    int i;
 
+    for ( i = 0; i < numJobs; i++ )
+    {
+        jobs[i].compression = gOptions->pngCompression;
+        jobs[i].inMemory = gOutputFileList->inMemory;
+        jobs[i].data = NULL;
+        jobs[i].size = 0;
+    }
+    // this thread writes files, too; if a thread can't be made, the others write its file
+    queue.jobs = jobs;
+    queue.numJobs = numJobs;
+    queue.nextJob = 0;
+    if ( numJobs > 0 )
+    {
+        RunOnWorkers( writePNGJobQueue, &queue, numJobs );
+    }
+    for ( i = 0; i < numJobs; i++ )
+    {
+        assert(jobs[i].rc == 0);
+        retCode |= jobs[i].rc ? (MW_CANNOT_CREATE_PNG_FILE | (jobs[i].rc<<MW_NUM_CODES)) : MW_NO_ERROR;
+        addOutputFilenameToList(jobs[i].filename);
+        if ( jobs[i].data != NULL )
+        {
+            if ( outputMemorySize() + jobs[i].size <= MAX_OUTPUT_MEMORY )
+            {
+                gOutputFileList->data[gOutputFileList->count-1] = jobs[i].data;
+                gOutputFileList->size[gOutputFileList->count-1] = jobs[i].size;
+            }
+            else
+            {
+                // too much to hold on to, so it goes to disk after all
+                PORTAFILE fh = PortaCreate(jobs[i].filename);
+                if ( fh == INVALID_HANDLE_VALUE )
+                    retCode |= MW_CANNOT_CREATE_PNG_FILE;
+                else
+                {
+                    if ( PortaWrite(fh, jobs[i].data, jobs[i].size) )
+                        retCode |= MW_CANNOT_CREATE_PNG_FILE;
+                    PortaClose(fh);
+                }
+                free(jobs[i].data);
+            }
+        }
+    }
     return retCode;
 }
 
+static DWORD WINAPI writePNGJobQueue( LPVOID pParam )
+{
+    PNGWriteQueue *pQueue = (PNGWriteQueue *)pParam;
+    int job;
+
+    while ( ( job = (int)PortaIncrement( &pQueue->nextJob ) - 1 ) < pQueue->numJobs )
+    {
+        PNGWriteJob *pJob = &pQueue->jobs[job];
+        writepng_setcompression(pJob->compression);
+        if ( pJob->inMemory )
+        {
+            pJob->rc = writepng_memory(pJob->image, pJob->channels, &pJob->data, &pJob->size);
+        }
+        else
+        {
+            pJob->rc = writepng(pJob->image, pJob->channels, pJob->filename);
+        }
+    }
+    return 0;
+}
+
 // for debugging
 static void convertAlphaToGrayscale( progimage_info *dst )
 {
@@ -16414,7 +19600,17 @@ static void convertAlphaToGrayscale( progimage_info *dst )
 
     for ( row = 0; row < dst->height; row++ )
     {
-        for ( col = 0; col < dst->width; col++ )
+        col = 0;
+#ifdef USE_SSE2_TEXELS
+        for ( ; !gScalarTexels && col+4 <= dst->width; col += 4 )
+        {
+            __m128i da = _mm_srli_epi32( _mm_loadu_si128( (__m128i *)di ), 24 );
+            __m128i gray = _mm_or_si128( _mm_or_si128( da, _mm_slli_epi32( da, 8 ) ), _mm_slli_epi32( da, 16 ) );
+            _mm_storeu_si128( (__m128i *)di, _mm_or_si128( gray, _mm_set1_epi32( (int)0xff000000 ) ) );
+            di += 4;
+        }
+#endif
+        for ( ; col < dst->width; col++ )
         {
             // get alpha of pixel, use as grayscale
             unsigned int value = *di;
@@ -16426,15 +19622,168 @@ static void convertAlphaToGrayscale( progimage_info *dst )
     }
 }
 
+// next value of a small fixed-seed generator, so the self test is the same each run
+static unsigned int selfTestRandom( unsigned int *pSeed )
+{
+    *pSeed = *pSeed * 1664525 + 1013904223;
+    return *pSeed >> 8;
+}
+
+// Fill an image with random texels. A quarter of the alphas are 0 and a quarter 255, so that compositing
+// takes each of its paths.
+static void selfTestImage( progimage_info *image, int width, int height, unsigned int *pSeed )
+{
+    int i;
+    image->width = width;
+    image->height = height;
+    image->image_data.resize( width*height*4 );
+    for ( i = 0; i < width*height; i++ )
+    {
+        unsigned int value = selfTestRandom( pSeed );
+        unsigned int alpha = selfTestRandom( pSeed ) & 0xff;
+        switch ( alpha & 3 )
+        {
+        case 0:
+            alpha = 0;
+            break;
+        case 1:
+            alpha = 255;
+            break;
+        }
+        ((unsigned int *)(&image->image_data[0]))[i] = (value & 0x00ffffff) | (alpha << 24);
+    }
+}
+
+// Run the texture operations with and without their four-texel loops, on the same random swatches,
+// and count the images that come out different. The division helpers are checked over every value
+// they are used with. The report gets one line per operation. Not for use while exports are running.
+int TexelSelfTest( wchar_t *report, int reportSize )
+{
+    // swatch sizes used by 16x16 and 32x32 tiles, plus one with a width not a multiple of four
+    static const int swatchSizes[3] = { 18, 34, 23 };
+    static const wchar_t *opName[TEXEL_SELF_TEST_OPS] = { L"divide255Epu16", L"divide65025Epu32",
+        L"compositePNGSwatches", L"multiplyPNGTile", L"rotatePNGTile", L"blendTwoSwatches",
+        L"bleedPNGSwatch", L"convertRGBAtoRGB", L"convertAlphaToGrayscale" };
+    int mismatches[TEXEL_SELF_TEST_OPS];
+    int trials[TEXEL_SELF_TEST_OPS];
+    unsigned int seed = 12345;
+    int savedSwatchSize = gModel.swatchSize;
+    int savedSwatchesPerRow = gModel.swatchesPerRow;
+    int totalMismatches = 0;
+    int op, sizeNo, trial;
+
+    memset( mismatches, 0, sizeof(mismatches) );
+    memset( trials, 0, sizeof(trials) );
+
+#ifdef USE_SSE2_TEXELS
+    {
+        unsigned int n;
+        for ( n = 0; n < 65536; n += 8 )
+        {
+            unsigned short in[8], out[8];
+            int lane;
+            for ( lane = 0; lane < 8; lane++ )
+                in[lane] = (unsigned short)(n + lane);
+            _mm_storeu_si128( (__m128i *)out, divide255Epu16( _mm_loadu_si128( (__m128i *)in ) ) );
+            for ( lane = 0; lane < 8; lane++ )
+            {
+                if ( out[lane] != in[lane] / 255 )
+                    mismatches[0]++;
+            }
+            trials[0] += 8;
+        }
+        // compositing divides sums up to 2*255*255*255
+        for ( n = 0; n <= 2*255*255*255; n += 4 )
+        {
+            unsigned int in[4], out[4];
+            int lane;
+            for ( lane = 0; lane < 4; lane++ )
+                in[lane] = n + lane;
+            _mm_storeu_si128( (__m128i *)out, divide65025Epu32( _mm_loadu_si128( (__m128i *)in ) ) );
+            for ( lane = 0; lane < 4 && in[lane] <= 2*255*255*255; lane++ )
+            {
+                if ( out[lane] != in[lane] / (255*255) )
+                    mismatches[1]++;
+                trials[1]++;
+            }
+        }
+    }
+#endif
+
+    for ( sizeNo = 0; sizeNo < 3; sizeNo++ )
+    {
+        int swatchSize = swatchSizes[sizeNo];
+        int swatchesPerRow = 4;
+        gModel.swatchSize = swatchSize;
+        gModel.swatchesPerRow = swatchesPerRow;
+        for ( trial = 0; trial < 64; trial++ )
+        {
+            progimage_info start, result[2], rgb[2];
+            unsigned int choice = selfTestRandom( &seed );
+            int pass;
+            selfTestImage( &start, swatchSize*swatchesPerRow, swatchSize*swatchesPerRow, &seed );
+            for ( op = 2; op < TEXEL_SELF_TEST_OPS; op++ )
+            {
+                for ( pass = 0; pass < 2; pass++ )
+                {
+                    // pass 0 uses the four-texel loops, pass 1 the plain ones
+                    gScalarTexels = pass;
+                    result[pass] = start;
+                    switch ( op )
+                    {
+                    case 2:
+                        compositePNGSwatches( &result[pass], 0, 5, 10, swatchSize, swatchesPerRow, (int)(choice & 1) );
+                        break;
+                    case 3:
+                        multiplyPNGTile( &result[pass], 1, 2, swatchSize, (unsigned char)choice, (unsigned char)(choice>>4), (unsigned char)(choice>>8), (unsigned char)(choice>>12) );
+                        break;
+                    case 4:
+                        rotatePNGTile( &result[pass], 3, 3, 1, 0, 90*(int)(choice % 4), swatchSize );
+                        break;
+                    case 5:
+                        blendTwoSwatches( &result[pass], 6, 9, (float)(choice & 0xff)/255.0f, (unsigned char)(choice>>8) );
+                        break;
+                    case 6:
+                        bleedPNGSwatch( &result[pass], 7, 0, 16, 0, 16, swatchSize, swatchesPerRow, choice & 0xff );
+                        break;
+                    case 7:
+                        convertRGBAtoRGB( &result[pass], &rgb[pass] );
+                        break;
+                    case 8:
+                        convertAlphaToGrayscale( &result[pass] );
+                        break;
+                    }
+                }
+                if ( ( op == 7 ) ? ( rgb[0].image_data != rgb[1].image_data ) : ( result[0].image_data != result[1].image_data ) )
+                    mismatches[op]++;
+                trials[op]++;
+            }
+        }
+    }
+    gScalarTexels = 0;
+    gModel.swatchSize = savedSwatchSize;
+    gModel.swatchesPerRow = savedSwatchesPerRow;
+
+    report[0] = (wchar_t)0;
+    for ( op = 0; op < TEXEL_SELF_TEST_OPS; op++ )
+    {
+        wchar_t line[128];
+        if ( trials[op] == 0 )
+            swprintf_s( line, 128, L"%ls: no SSE2, not tested\n", opName[op] );
+        else
+            swprintf_s( line, 128, L"%ls: %d mismatches in %d %ls\n", opName[op], mismatches[op], trials[op], ( op < 2 ) ? L"values" : L"images" );
+        wcscat_s( report, reportSize, line );
+        totalMismatches += mismatches[op];
+    }
+    return totalMismatches;
+}
+
 ///////////////////////////////////////////////////////////
 //
 // Utility functions, headers not included above
 // suffix is of form ".stl" - includes dot
-static void ensureSuffix( wchar_t *dst, const wchar_t *src, const wchar_t *suffix )
+static int hasSuffix( const wchar_t *src, const wchar_t *suffix )
 {
-    int hasSuffix=0;
-
-    // Prep file name: see if it has suffix already
     if ( wcsnlen(src,MAX_PATH) > wcsnlen(suffix,MAX_PATH) )
     {
         // look for suffix
@@ -16443,13 +19792,20 @@ static void ensureSuffix( wchar_t *dst, const wchar_t *src, const wchar_t *suffi
         _wcslwr_s(foundSuffix,MAX_PATH);
         if (wcscmp(foundSuffix,suffix) == 0)
         {
-            hasSuffix = 1;
+            return 1;
         }
     }
+    return 0;
+}
+
+static void ensureSuffix( wchar_t *dst, const wchar_t *src, const wchar_t *suffix )
+{
+    // Prep file name: see if it has suffix already
+    int foundSuffix = hasSuffix( src, suffix );
 
     wcscpy_s(dst,MAX_PATH,src);
     // was the suffix found?
-    if ( !hasSuffix )
+    if ( !foundSuffix )
     {
         //// see if it has *any* suffix
         //const wchar_t *noPath = removePath( dst );
@@ -16505,7 +19861,7 @@ static const char *removePathChar( const char *src )
     else
     {
         // look for /
-        const char *strPtr = strrchr(src,(int)'/');
+        strPtr = strrchr(src,(int)'/');
         if ( strPtr )
             // found a /, so move up past it
             strPtr++;
@@ -16557,11 +19913,17 @@ static void getPathAndRoot( const wchar_t *src, int fileType, wchar_t *path, wch
     case FILE_TYPE_ASCII_STL:
         removeSuffix(root,tfilename,L".stl");
         break;
+    case FILE_TYPE_BINARY_PLY:
+        removeSuffix(root,tfilename,L".ply");
+        break;
     case FILE_TYPE_VRML2:
         removeSuffix(root,tfilename,L".wrl");
         break;
+    case FILE_TYPE_GLTF:
+        removeSuffix(root,tfilename,L".glb");
+        break;
     case FILE_TYPE_SCHEMATIC:
-        removeSuffix(root,tfilename,L".schematic");
+        removeSuffix(root,tfilename,hasSuffix(tfilename,L".schem") ? L".schem" : L".schematic");
     }
 }
 
@@ -36,6 +36,7 @@ THE POSSIBILITY OF SUCH DAMAGE.
 #endif
 
 // If you change something here, you must also change gPopupInfo array in Mineways.cpp
+// and gErrorName array in MinewaysCmd.cpp
 #define MW_NO_ERROR 0
 // informational
 #define MW_WALLS_MIGHT_BE_THIN                      1
@@ -73,8 +74,13 @@ THE POSSIBILITY OF SUCH DAMAGE.
 #define MW_NUM_CODES                                22
 
 
+// number of lines in the TexelSelfTest report
+#define TEXEL_SELF_TEST_OPS 9
+int TexelSelfTest( wchar_t *report, int reportSize );
+
 void ChangeCache( int size );
 void ClearCache();
+void ClearVolumeCache();
 
 int SaveVolume( wchar_t *objFileName, int fileType, Options *options, const wchar_t *world, const wchar_t *curDir, int minx, int miny, int minz, int maxx, int maxy, int maxz,
     ProgressCallback callback, wchar_t *terrainFileName, FileList *outputFileList, int majorVersion, int minorVersion );
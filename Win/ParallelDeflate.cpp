@@ -0,0 +1,222 @@
+/*
+Copyright (c) 2011, Eric Haines
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+// Not built with the precompiled header, so that TileMaker can compile it as-is.
+#define WIN32_LEAN_AND_MEAN
+#include "stdafx.h"
+#include <stdlib.h>
+#include <string.h>
+#include "zlib.h"
+#include "ParallelDeflate.h"
+#include "Workers.h"
+
+// Data bigger than this is compressed in pieces, on several threads
+#define DEFLATE_CHUNK_SIZE (256*1024)
+// most threads used to compress one image
+#define MAX_DEFLATE_THREADS 16
+// how far back each piece can look into the data before it, the largest deflate window
+#define DEFLATE_DICTIONARY_SIZE 32768
+
+// The pieces of one image being compressed. Threads take the next piece to do until there are none left.
+typedef struct DeflateJob {
+    const unsigned char *in;
+    size_t insize;
+    int level;              // zlib compression level
+    int numChunks;
+    volatile LONG nextChunk;
+    volatile LONG failed;
+    unsigned char **chunkData;  // compressed data of each piece
+    size_t *chunkSize;
+    unsigned long *chunkAdler;  // adler32 of each piece's uncompressed data
+} DeflateJob;
+
+static int deflateChunk( DeflateJob *pJob, int chunk );
+static DWORD WINAPI deflateChunks( LPVOID pParam );
+
+// Compress one piece of the image data, with the end of the piece before it as its dictionary.
+// Returns 1 on success.
+static int deflateChunk( DeflateJob *pJob, int chunk )
+{
+    size_t start = (size_t)chunk * DEFLATE_CHUNK_SIZE;
+    size_t length = pJob->insize - start;
+
+    if ( length > DEFLATE_CHUNK_SIZE )
+        length = DEFLATE_CHUNK_SIZE;
+
+    pJob->chunkData[chunk] = (unsigned char *)malloc(DeflatePieceBound(length));
+    if ( pJob->chunkData[chunk] == NULL )
+        return 0;
+    return DeflatePiece( pJob->in + start, length, start, pJob->level, ( chunk == pJob->numChunks-1 ),
+        DEFLATE_CHECK_ADLER32, &pJob->chunkAdler[chunk], pJob->chunkData[chunk], &pJob->chunkSize[chunk] );
+}
+
+static DWORD WINAPI deflateChunks( LPVOID pParam )
+{
+    DeflateJob *pJob = (DeflateJob *)pParam;
+    int chunk;
+
+    while ( !pJob->failed )
+    {
+        // PortaIncrement returns the new value, so subtract one to get the piece this thread took
+        chunk = (int)PortaIncrement(&pJob->nextChunk) - 1;
+        if ( chunk >= pJob->numChunks )
+            break;
+        if ( !deflateChunk( pJob, chunk ) )
+        {
+            pJob->failed = 1;
+        }
+    }
+    return 0;
+}
+
+size_t DeflatePieceBound( size_t length )
+{
+    // the worst case, plus the empty stored block a sync flush adds
+    return (size_t)compressBound( (uLong)length ) + 16;
+}
+
+int DeflatePiece( const unsigned char *in, size_t length, size_t history, int level, int last, int checkType,
+    unsigned long *pCheck, unsigned char *out, size_t *pOutSize )
+{
+    size_t outCapacity = DeflatePieceBound( length );
+    z_stream strm;
+    int zrc;
+
+    if ( checkType == DEFLATE_CHECK_CRC32 )
+        *pCheck = crc32( crc32(0L, Z_NULL, 0), in, (uInt)length );
+    else
+        *pCheck = adler32( adler32(0L, Z_NULL, 0), in, (uInt)length );
+
+    memset(&strm,0,sizeof(z_stream));
+    // negative window bits: raw deflate data, no zlib header or checksum, those are added once for the whole stream
+    if ( deflateInit2(&strm, level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK )
+        return 0;
+    if ( history > 0 )
+    {
+        size_t dictionarySize = ( history < DEFLATE_DICTIONARY_SIZE ) ? history : DEFLATE_DICTIONARY_SIZE;
+        deflateSetDictionary(&strm, in - dictionarySize, (uInt)dictionarySize);
+    }
+    strm.next_in = (Bytef *)in;
+    strm.avail_in = (uInt)length;
+    strm.next_out = out;
+    strm.avail_out = (uInt)outCapacity;
+    zrc = deflate(&strm, last ? Z_FINISH : Z_SYNC_FLUSH);
+    *pOutSize = outCapacity - strm.avail_out;
+    deflateEnd(&strm);
+
+    if ( last )
+        return ( zrc == Z_STREAM_END );
+    return ( zrc == Z_OK && strm.avail_in == 0 && strm.avail_out > 0 );
+}
+
+unsigned ParallelZlibCompress( unsigned char** out, size_t* outsize, const unsigned char* in, size_t insize, int level )
+{
+    DeflateJob job;
+    int numWorkers;
+    size_t total, pos;
+    unsigned long adler;
+    unsigned error = 0;
+    int i;
+
+    job.in = in;
+    job.insize = insize;
+    job.level = level;
+    job.numChunks = (int)((insize + DEFLATE_CHUNK_SIZE - 1) / DEFLATE_CHUNK_SIZE);
+    if ( job.numChunks == 0 )
+        job.numChunks = 1;
+    job.nextChunk = 0;
+    job.failed = 0;
+    job.chunkData = (unsigned char **)calloc(job.numChunks, sizeof(unsigned char *));
+    job.chunkSize = (size_t *)calloc(job.numChunks, sizeof(size_t));
+    job.chunkAdler = (unsigned long *)calloc(job.numChunks, sizeof(unsigned long));
+    if ( job.chunkData == NULL || job.chunkSize == NULL || job.chunkAdler == NULL )
+    {
+        error = 83;     // lodepng's "memory allocation failed"
+        goto Exit;
+    }
+
+    numWorkers = PortaProcessorCount();
+    if ( numWorkers > job.numChunks )
+        numWorkers = job.numChunks;
+    if ( numWorkers > MAX_DEFLATE_THREADS )
+        numWorkers = MAX_DEFLATE_THREADS;
+
+    RunOnWorkers( deflateChunks, &job, numWorkers );
+    if ( job.failed )
+    {
+        error = 83;
+        goto Exit;
+    }
+
+    // zlib header, as lodepng writes it, the pieces, then the adler32 of all the data, high byte first
+    total = 2 + 4;
+    for ( i = 0; i < job.numChunks; i++ )
+    {
+        total += job.chunkSize[i];
+    }
+    *out = (unsigned char *)malloc(total);
+    if ( *out == NULL )
+    {
+        error = 83;
+        goto Exit;
+    }
+    (*out)[0] = 0x78;
+    (*out)[1] = 0x01;
+    pos = 2;
+    adler = job.chunkAdler[0];
+    for ( i = 0; i < job.numChunks; i++ )
+    {
+        memcpy(*out + pos, job.chunkData[i], job.chunkSize[i]);
+        pos += job.chunkSize[i];
+        if ( i > 0 )
+        {
+            size_t length = ( i < job.numChunks-1 ) ? DEFLATE_CHUNK_SIZE : insize - (size_t)i * DEFLATE_CHUNK_SIZE;
+            adler = adler32_combine(adler, job.chunkAdler[i], (z_off_t)length);
+        }
+    }
+    (*out)[pos++] = (unsigned char)(adler >> 24);
+    (*out)[pos++] = (unsigned char)(adler >> 16);
+    (*out)[pos++] = (unsigned char)(adler >> 8);
+    (*out)[pos++] = (unsigned char)adler;
+    *outsize = pos;
+
+Exit:
+    if ( job.chunkData != NULL )
+    {
+        for ( i = 0; i < job.numChunks; i++ )
+        {
+            free(job.chunkData[i]);
+        }
+    }
+    free(job.chunkData);
+    free(job.chunkSize);
+    free(job.chunkAdler);
+    return error;
+}
+
+
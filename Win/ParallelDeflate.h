@@ -0,0 +1,52 @@
+/*
+Copyright (c) 2011, Eric Haines
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+// Compresses data into a zlib stream on several threads, pigz-style, for the PNG writers of both
+// Mineways and TileMaker.
+
+#pragma once
+
+// Compress insize bytes of in into a zlib stream at the given zlib level. *out is malloc'ed and must be
+// freed by the caller. Returns 0 on success, else lodepng's error code 83, memory allocation failed,
+// so it can be returned directly from a lodepng custom_zlib function.
+unsigned ParallelZlibCompress( unsigned char** out, size_t* outsize, const unsigned char* in, size_t insize, int level );
+
+// which checksum DeflatePiece takes of a piece's uncompressed data
+#define DEFLATE_CHECK_ADLER32   0   // zlib streams, such as in PNGs
+#define DEFLATE_CHECK_CRC32     1   // zip files
+
+// Bytes of room DeflatePiece needs to compress length bytes
+size_t DeflatePieceBound( size_t length );
+
+// Compress length bytes of in as one piece of a raw deflate stream, with no zlib header or trailer. The history bytes
+// just before in, up to 32K of them, are the piece's dictionary, so nothing is lost by splitting the data. The last
+// piece finishes the stream; the others end with a sync flush, on a byte boundary, so the pieces can just be put one
+// after the other. *pCheck is set to the checkType checksum of the piece's data, to be combined with the others'.
+// out must have room for DeflatePieceBound(length) bytes. Returns 1 on success.
+int DeflatePiece( const unsigned char *in, size_t length, size_t history, int level, int last, int checkType,
+    unsigned long *pCheck, unsigned char *out, size_t *pOutSize );
@@ -0,0 +1,392 @@
+/*
+Copyright (c) 2011, Eric Haines
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+// The Win32 calls the export code uses, done with POSIX ones, so that MinewaysCmd builds with gcc or clang.
+// Windows builds use the Win32 calls themselves, through the macros in stdafx.h.
+
+#include "stdafx.h"
+
+#ifndef WIN32
+#include <stdarg.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+// Like the Microsoft sscanf_s: each %s, %c and %[ is followed by the size of its buffer, which
+// sscanf doesn't take, so each conversion is done by itself. Returns the number of fields assigned,
+// or EOF if the input ended before the first one.
+int sscanf_s( const char *str, const char *format, ... )
+{
+    va_list args;
+    const char *in = str;
+    const char *fmt = format;
+    int assigned = 0;
+
+    va_start( args, format );
+    while ( *fmt )
+    {
+        char spec[64];
+        int specLength = 0;
+        int consumed = -1;
+        int suppress = 0;
+        int sized = 0;
+        int converted;
+
+        if ( *fmt != '%' || fmt[1] == '%' )
+        {
+            // plain text, white space or %%: match it, with sscanf's rules
+            if ( *fmt == '%' )
+                fmt++;
+            if ( isspace( (unsigned char)*fmt ) )
+            {
+                while ( isspace( (unsigned char)*in ) )
+                    in++;
+            }
+            else if ( *in++ != *fmt )
+            {
+                break;
+            }
+            fmt++;
+            continue;
+        }
+
+        // copy the one conversion, then add %n to find how much of the input it used
+        spec[specLength++] = *fmt++;
+        if ( *fmt == '*' )
+        {
+            suppress = 1;
+            spec[specLength++] = *fmt++;
+        }
+        while ( *fmt && strchr( "0123456789hlLjzt", *fmt ) && specLength < 48 )
+            spec[specLength++] = *fmt++;
+        if ( *fmt == '[' )
+        {
+            spec[specLength++] = *fmt++;
+            if ( *fmt == '^' && specLength < 48 )
+                spec[specLength++] = *fmt++;
+            if ( *fmt == ']' && specLength < 48 )
+                spec[specLength++] = *fmt++;
+            while ( *fmt && *fmt != ']' && specLength < 48 )
+                spec[specLength++] = *fmt++;
+            sized = 1;
+        }
+        else if ( *fmt == 's' || *fmt == 'c' )
+        {
+            sized = 1;
+        }
+        if ( *fmt == 0 )
+            break;
+        spec[specLength++] = *fmt++;
+        strcpy( spec + specLength, "%n" );
+
+        if ( *in == 0 && assigned == 0 )
+        {
+            va_end( args );
+            return EOF;
+        }
+        if ( suppress )
+        {
+            converted = sscanf( in, spec, &consumed );
+        }
+        else
+        {
+            void *target = va_arg( args, void * );
+            unsigned int size = sized ? va_arg( args, unsigned int ) : 0;
+            if ( sized )
+            {
+                // read into a temporary buffer and copy only what fits, as sscanf_s fails on overflow
+                char buffer[1024];
+                if ( size == 0 || size > sizeof(buffer) )
+                    break;
+                converted = sscanf( in, spec, buffer, &consumed );
+                if ( converted == 1 && consumed >= 0 )
+                {
+                    size_t length = ( spec[specLength-1] == 'c' ) ? 1 : strlen( buffer ) + 1;
+                    if ( length > size )
+                        break;
+                    memcpy( target, buffer, length );
+                }
+            }
+            else
+            {
+                converted = sscanf( in, spec, target, &consumed );
+            }
+        }
+        if ( consumed < 0 )
+            break;
+        if ( !suppress && converted == 1 )
+            assigned++;
+        in += consumed;
+    }
+    va_end( args );
+    return assigned;
+}
+
+void portaFileName( const wchar_t *fileName, char *utf8Name, int size )
+{
+    if ( WideCharToMultiByte( CP_UTF8, 0, fileName, -1, utf8Name, size, NULL, NULL ) == 0 && size > 0 )
+        utf8Name[0] = 0;
+}
+
+FILE *portaOpen( const wchar_t *fileName, const char *mode )
+{
+    char name[MAX_PATH*4];
+    portaFileName( fileName, name, MAX_PATH*4 );
+    return fopen( name, mode );
+}
+
+// Text modes are the same as binary ones here, and ", ccs=UTF-8" is left to fgetws and the locale.
+errno_t _wfopen_s( FILE **pFile, const wchar_t *fileName, const wchar_t *mode )
+{
+    char narrowMode[16];
+    int i = 0;
+
+    while ( mode[i] != 0 && mode[i] != (wchar_t)',' && i < 15 )
+    {
+        narrowMode[i] = ( mode[i] == (wchar_t)'t' ) ? 'b' : (char)mode[i];
+        i++;
+    }
+    narrowMode[i] = 0;
+    *pFile = portaOpen( fileName, narrowMode );
+    return ( *pFile == NULL ) ? errno : 0;
+}
+
+int portaDelete( const wchar_t *fileName )
+{
+    char name[MAX_PATH*4];
+    portaFileName( fileName, name, MAX_PATH*4 );
+    return ( remove( name ) == 0 );
+}
+
+int portaMakeDirectory( const wchar_t *dir )
+{
+    char name[MAX_PATH*4];
+    portaFileName( dir, name, MAX_PATH*4 );
+    return ( mkdir( name, 0777 ) == 0 );
+}
+
+wchar_t *portaGetCwd( wchar_t *buf, int size )
+{
+    char name[MAX_PATH*4];
+    if ( getcwd( name, MAX_PATH*4 ) == NULL || MultiByteToWideChar( CP_UTF8, 0, name, -1, buf, size ) == 0 )
+        return NULL;
+    return buf;
+}
+
+int portaFileSize( const wchar_t *fileName, unsigned long long *pSize )
+{
+    char name[MAX_PATH*4];
+    struct stat fileStat;
+    portaFileName( fileName, name, MAX_PATH*4 );
+    if ( stat( name, &fileStat ) != 0 )
+        return 0;
+    *pSize = (unsigned long long)fileStat.st_size;
+    return 1;
+}
+
+int PortaScanDirectory( const wchar_t *directory, int (*fn)(const wchar_t *, void *), void *context )
+{
+    char dirName[MAX_PATH*4];
+    char path[MAX_PATH*8];
+    wchar_t fileName[MAX_PATH];
+    struct dirent *pEntry;
+    struct stat fileStat;
+    int rc = 0;
+
+    portaFileName( directory, dirName, MAX_PATH*4 );
+    DIR *hDir = opendir( dirName );
+    if ( hDir == NULL )
+        return -1;
+    while ( rc == 0 && ( pEntry = readdir( hDir ) ) != NULL )
+    {
+        snprintf( path, sizeof(path), "%s/%s", dirName, pEntry->d_name );
+        if ( stat( path, &fileStat ) != 0 || S_ISDIR( fileStat.st_mode ) )
+            continue;
+        if ( MultiByteToWideChar( CP_UTF8, 0, pEntry->d_name, -1, fileName, MAX_PATH ) == 0 )
+            continue;
+        rc = fn( fileName, context );
+    }
+    closedir( hDir );
+    return rc;
+}
+
+// wlength and length are in characters and include the terminating 0 when length is -1, as for the Win32 calls
+int MultiByteToWideChar( unsigned int codePage, DWORD flags, const char *str, int length, wchar_t *wstr, int wlength )
+{
+    const unsigned char *in = (const unsigned char *)str;
+    const unsigned char *end = ( length < 0 ) ? NULL : in + length;
+    int count = 0;
+
+    (void)codePage;
+    while ( end == NULL || in < end )
+    {
+        unsigned int c = *in++;
+        int extra = 0;
+        if ( c >= 0xf0 ) { c &= 0x07; extra = 3; }
+        else if ( c >= 0xe0 ) { c &= 0x0f; extra = 2; }
+        else if ( c >= 0xc0 ) { c &= 0x1f; extra = 1; }
+        else if ( c >= 0x80 )
+        {
+            if ( flags & MB_ERR_INVALID_CHARS )
+                return 0;
+            c = 0xfffd;
+        }
+        for ( ; extra > 0; extra-- )
+        {
+            if ( ( *in & 0xc0 ) != 0x80 )
+            {
+                if ( flags & MB_ERR_INVALID_CHARS )
+                    return 0;
+                c = 0xfffd;
+                break;
+            }
+            c = ( c << 6 ) | ( *in++ & 0x3f );
+        }
+        if ( wstr != NULL && wlength > 0 )
+        {
+            if ( count >= wlength )
+                return 0;
+            wstr[count] = (wchar_t)c;
+        }
+        count++;
+        if ( c == 0 && end == NULL )
+            break;
+    }
+    return count;
+}
+
+int WideCharToMultiByte( unsigned int codePage, DWORD flags, const wchar_t *wstr, int wlength, char *str, int length, const char *defaultChar, BOOL *usedDefault )
+{
+    int count = 0;
+    int i;
+
+    (void)codePage;
+    (void)flags;
+    (void)defaultChar;
+    if ( usedDefault != NULL )
+        *usedDefault = FALSE;
+    for ( i = 0; wlength < 0 || i < wlength; i++ )
+    {
+        unsigned int c = (unsigned int)wstr[i];
+        unsigned char bytes[4];
+        int n, j;
+        if ( c < 0x80 ) { bytes[0] = (unsigned char)c; n = 1; }
+        else if ( c < 0x800 ) { bytes[0] = (unsigned char)(0xc0 | (c >> 6)); bytes[1] = (unsigned char)(0x80 | (c & 0x3f)); n = 2; }
+        else if ( c < 0x10000 ) { bytes[0] = (unsigned char)(0xe0 | (c >> 12)); bytes[1] = (unsigned char)(0x80 | ((c >> 6) & 0x3f)); bytes[2] = (unsigned char)(0x80 | (c & 0x3f)); n = 3; }
+        else { bytes[0] = (unsigned char)(0xf0 | (c >> 18)); bytes[1] = (unsigned char)(0x80 | ((c >> 12) & 0x3f)); bytes[2] = (unsigned char)(0x80 | ((c >> 6) & 0x3f)); bytes[3] = (unsigned char)(0x80 | (c & 0x3f)); n = 4; }
+        if ( str != NULL && length > 0 )
+        {
+            if ( count + n > length )
+                return 0;
+            for ( j = 0; j < n; j++ )
+                str[count+j] = (char)bytes[j];
+        }
+        count += n;
+        if ( c == 0 && wlength < 0 )
+            break;
+    }
+    return count;
+}
+
+// qsort_s passes the context first, qsort_r differs between C libraries, so pass it in a per-thread variable
+static THREAD_LOCAL int (*gQsortCompare)(void *, const void *, const void *);
+static THREAD_LOCAL void *gQsortContext;
+
+static int qsortCompare( const void *a, const void *b )
+{
+    return gQsortCompare( gQsortContext, a, b );
+}
+
+void qsort_s( void *base, size_t count, size_t size, int (*compare)(void *, const void *, const void *), void *context )
+{
+    gQsortCompare = compare;
+    gQsortContext = context;
+    qsort( base, count, size, qsortCompare );
+}
+
+typedef struct PortaThreadStart {
+    DWORD (*fn)(LPVOID);
+    LPVOID param;
+} PortaThreadStart;
+
+static void *portaThreadStart( void *pParam )
+{
+    PortaThreadStart start = *(PortaThreadStart *)pParam;
+    free( pParam );
+    start.fn( start.param );
+    return NULL;
+}
+
+pthread_t *portaCreateThread( DWORD (*fn)(LPVOID), LPVOID param )
+{
+    pthread_t *pThread = (pthread_t *)malloc( sizeof(pthread_t) );
+    PortaThreadStart *pStart = (PortaThreadStart *)malloc( sizeof(PortaThreadStart) );
+    if ( pThread == NULL || pStart == NULL )
+    {
+        free( pThread );
+        free( pStart );
+        return NULL;
+    }
+    pStart->fn = fn;
+    pStart->param = param;
+    if ( pthread_create( pThread, NULL, portaThreadStart, pStart ) != 0 )
+    {
+        free( pThread );
+        free( pStart );
+        return NULL;
+    }
+    return pThread;
+}
+
+// PortaCloseThread frees each
+void portaWaitForThreads( int count, pthread_t **threads )
+{
+    int i;
+    for ( i = 0; i < count; i++ )
+        pthread_join( *threads[i], NULL );
+}
+
+int PortaProcessorCount()
+{
+    long count = sysconf( _SC_NPROCESSORS_ONLN );
+    return ( count < 1 ) ? 1 : (int)count;
+}
+
+long long PortaTicks()
+{
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+long long PortaTicksPerSecond()
+{
+    return 1000000000LL;
+}
+#endif
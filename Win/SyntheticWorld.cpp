@@ -0,0 +1,682 @@
+/*
+Copyright (c) 2011, Eric Haines
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "stdafx.h"
+#include <stdio.h>
+#include <assert.h>
+#include "zlib.h"
+#include "SyntheticWorld.h"
+
+// each chunk as it's made: blockid and data arrays in Anvil order, [y*256 + z*16 + x]
+typedef struct SyntheticChunk {
+    unsigned char blocks[16*16*256];
+    unsigned char data[16*16*256];  // one value per block here, packed into nibbles when written
+    unsigned char biome;
+} SyntheticChunk;
+
+// a growing buffer the NBT for a chunk is written into
+typedef struct NBTBuffer {
+    unsigned char *data;
+    size_t size;
+    size_t allocated;
+    int failed;
+} NBTBuffer;
+
+#define SEA_LEVEL       62
+#define GROUND_LEVEL    63
+
+#define REGION_SECTOR   4096
+
+static const wchar_t *gSyntheticWorldName[SYNTHETIC_KIND_COUNT] = {
+    L"terrain",
+    L"caves",
+    L"buildings",
+    L"ocean",
+};
+
+static void makeChunk( SyntheticChunk *pChunk, int kind, int cx, int cz );
+static void makeTerrain( SyntheticChunk *pChunk, int cx, int cz, int caves );
+static void makeBuildings( SyntheticChunk *pChunk, int cx, int cz );
+static void makeOcean( SyntheticChunk *pChunk, int cx, int cz );
+static void addTree( SyntheticChunk *pChunk, int x, int y, int z );
+static unsigned int hash3( int x, int y, int z, unsigned int seed );
+static float noise2( int x, int z, int cell, unsigned int seed );
+static float noise3( int x, int y, int z, int cell, unsigned int seed );
+static int writeRegion( const wchar_t *regionDir, int kind, int rx, int rz, int size );
+static int writeLevelDat( const wchar_t *directory, int size );
+static void nbtChunk( NBTBuffer *pNBT, SyntheticChunk *pChunk, int cx, int cz );
+static void putBytes( NBTBuffer *pNBT, const void *bytes, size_t count );
+static void putByte( NBTBuffer *pNBT, unsigned char value );
+static void putShort( NBTBuffer *pNBT, int value );
+static void putInt( NBTBuffer *pNBT, int value );
+static void putTag( NBTBuffer *pNBT, unsigned char type, const char *name );
+
+#define SET_BLOCK(pChunk,x,y,z,type,dataVal) { int blockIndex_ = ((y)<<8)|((z)<<4)|(x); (pChunk)->blocks[blockIndex_] = (unsigned char)(type); (pChunk)->data[blockIndex_] = (unsigned char)(dataVal); }
+#define GET_BLOCK(pChunk,x,y,z) ((pChunk)->blocks[((y)<<8)|((z)<<4)|(x)])
+
+
+const wchar_t *SyntheticWorldName( int kind )
+{
+    return gSyntheticWorldName[kind];
+}
+
+int WriteSyntheticWorld( const wchar_t *directory, int kind, int size )
+{
+    wchar_t regionDir[MAX_PATH];
+    int retCode;
+    int rx, rz;
+
+    PortaMakeDirectory( directory );
+    swprintf_s( regionDir, MAX_PATH, L"%ls/region", directory );
+    PortaMakeDirectory( regionDir );
+
+    retCode = writeLevelDat( directory, size );
+    if ( retCode != MW_NO_ERROR )
+        return retCode;
+
+    // 32 x 32 chunks to a region file
+    for ( rx = 0; rx <= (size-1)>>5; rx++ )
+    {
+        for ( rz = 0; rz <= (size-1)>>5; rz++ )
+        {
+            retCode = writeRegion( regionDir, kind, rx, rz, size );
+            if ( retCode != MW_NO_ERROR )
+                return retCode;
+        }
+    }
+    return MW_NO_ERROR;
+}
+
+static void makeChunk( SyntheticChunk *pChunk, int kind, int cx, int cz )
+{
+    memset( pChunk, 0, sizeof(SyntheticChunk) );
+    switch ( kind )
+    {
+    case SYNTHETIC_TERRAIN:
+        makeTerrain( pChunk, cx, cz, 0 );
+        break;
+    case SYNTHETIC_CAVES:
+        makeTerrain( pChunk, cx, cz, 1 );
+        break;
+    case SYNTHETIC_BUILDINGS:
+        makeBuildings( pChunk, cx, cz );
+        break;
+    case SYNTHETIC_OCEAN:
+        makeOcean( pChunk, cx, cz );
+        break;
+    default:
+        assert(0);
+        break;
+    }
+}
+
+static void makeTerrain( SyntheticChunk *pChunk, int cx, int cz, int caves )
+{
+    int x, y, z;
+
+    pChunk->biome = 1;  // plains
+    for ( x = 0; x < 16; x++ )
+    {
+        for ( z = 0; z < 16; z++ )
+        {
+            int wx = cx*16 + x;
+            int wz = cz*16 + z;
+            int height = 50 + (int)(28.0f*noise2( wx, wz, 64, 1 ) + 8.0f*noise2( wx, wz, 16, 2 ));
+
+            SET_BLOCK( pChunk, x, 0, z, BLOCK_BEDROCK, 0 );
+            for ( y = 1; y <= height; y++ )
+            {
+                if ( y < height - 3 )
+                {
+                    SET_BLOCK( pChunk, x, y, z, BLOCK_STONE, 0 );
+                }
+                else if ( height <= SEA_LEVEL + 1 )
+                {
+                    // beaches and lake bottoms
+                    SET_BLOCK( pChunk, x, y, z, BLOCK_SAND, 0 );
+                }
+                else if ( y < height )
+                {
+                    SET_BLOCK( pChunk, x, y, z, BLOCK_DIRT, 0 );
+                }
+                else
+                {
+                    SET_BLOCK( pChunk, x, y, z, BLOCK_GRASS, 0 );
+                }
+            }
+            for ( y = height + 1; y <= SEA_LEVEL; y++ )
+            {
+                SET_BLOCK( pChunk, x, y, z, BLOCK_STATIONARY_WATER, 0 );
+            }
+
+            if ( caves )
+            {
+                // winding holes where the 3D noise is high, with lava at the bottom; the surface is left alone
+                for ( y = 4; y < height - 3; y++ )
+                {
+                    if ( noise3( wx, y, wz, 16, 3 ) > 0.66f )
+                    {
+                        SET_BLOCK( pChunk, x, y, z, ( y < 11 ) ? BLOCK_STATIONARY_LAVA : BLOCK_AIR, 0 );
+                    }
+                }
+            }
+
+            // trees kept away from the chunk's edges, so they fit in it; grass and flowers elsewhere
+            if ( GET_BLOCK( pChunk, x, height, z ) == BLOCK_GRASS )
+            {
+                unsigned int h = hash3( wx, 0, wz, 4 );
+                if ( x >= 2 && x <= 13 && z >= 2 && z <= 13 && height < 256 - 10 && ( h % 61 ) == 0 )
+                {
+                    addTree( pChunk, x, height + 1, z );
+                }
+                else if ( ( h % 5 ) == 0 )
+                {
+                    SET_BLOCK( pChunk, x, height + 1, z, BLOCK_TALL_GRASS, 1 );
+                }
+                else if ( ( h % 37 ) == 0 )
+                {
+                    SET_BLOCK( pChunk, x, height + 1, z, ( h & 0x100 ) ? BLOCK_DANDELION : BLOCK_POPPY, 0 );
+                }
+            }
+        }
+    }
+}
+
+// a town: each chunk is a block of the town, with a building in the middle and roads along two sides
+static void makeBuildings( SyntheticChunk *pChunk, int cx, int cz )
+{
+    static const int wallTypes[4] = { BLOCK_BRICK, BLOCK_STONE_BRICKS, BLOCK_WOODEN_PLANKS, BLOCK_COBBLESTONE };
+    unsigned int h = hash3( cx, 0, cz, 5 );
+    int floors = 2 + (int)( h % 9 );
+    int wall = wallTypes[(h>>8) & 0x3];
+    int top = GROUND_LEVEL + floors*4;
+    int x, y, z;
+
+    pChunk->biome = 1;
+    for ( x = 0; x < 16; x++ )
+    {
+        for ( z = 0; z < 16; z++ )
+        {
+            SET_BLOCK( pChunk, x, 0, z, BLOCK_BEDROCK, 0 );
+            for ( y = 1; y < GROUND_LEVEL; y++ )
+            {
+                SET_BLOCK( pChunk, x, y, z, ( y < GROUND_LEVEL - 3 ) ? BLOCK_STONE : BLOCK_DIRT, 0 );
+            }
+            if ( x < 2 || z < 2 )
+            {
+                // road, lit by torches
+                SET_BLOCK( pChunk, x, GROUND_LEVEL, z, BLOCK_COBBLESTONE, 0 );
+                if ( x == 0 && ( z & 0x3 ) == 2 )
+                {
+                    SET_BLOCK( pChunk, x, GROUND_LEVEL + 1, z, BLOCK_TORCH, 5 );
+                }
+            }
+            else
+            {
+                SET_BLOCK( pChunk, x, GROUND_LEVEL, z, BLOCK_GRASS, 0 );
+            }
+        }
+    }
+
+    // the building, from 3 to 14 in X and Z
+    for ( y = GROUND_LEVEL + 1; y <= top; y++ )
+    {
+        int level = ( y - GROUND_LEVEL - 1 ) % 4;   // 0 is each floor's ceiling/floor layer
+        for ( x = 3; x <= 14; x++ )
+        {
+            for ( z = 3; z <= 14; z++ )
+            {
+                int edgeX = ( x == 3 || x == 14 );
+                int edgeZ = ( z == 3 || z == 14 );
+                if ( edgeX && edgeZ )
+                {
+                    SET_BLOCK( pChunk, x, y, z, BLOCK_LOG, 0 );
+                }
+                else if ( edgeX || edgeZ )
+                {
+                    int along = edgeX ? z : x;
+                    if ( level != 0 && ( along % 3 ) != 0 )
+                    {
+                        SET_BLOCK( pChunk, x, y, z, ( level == 3 ) ? wall : BLOCK_GLASS_PANE, 0 );
+                    }
+                    else
+                    {
+                        SET_BLOCK( pChunk, x, y, z, wall, 0 );
+                    }
+                }
+                else if ( level == 0 )
+                {
+                    SET_BLOCK( pChunk, x, y, z, BLOCK_WOODEN_PLANKS, 0 );
+                }
+                else if ( x == 4 && level < 3 )
+                {
+                    // furnishings along one wall
+                    SET_BLOCK( pChunk, x, y, z, ( z & 0x1 ) ? BLOCK_BOOKSHELF : ( ( z & 0x2 ) ? BLOCK_CHEST : BLOCK_CRAFTING_TABLE ), 2 );
+                }
+                else if ( x == 13 && z == 8 )
+                {
+                    // ladder up through the floors, facing west
+                    SET_BLOCK( pChunk, x, y, z, BLOCK_LADDER, 4 );
+                }
+                else if ( level == 1 && x == 8 && z == 8 )
+                {
+                    SET_BLOCK( pChunk, x, y, z, BLOCK_FLOWER_POT, 0 );
+                }
+            }
+        }
+        // the ladder goes through each floor
+        if ( level == 0 )
+        {
+            SET_BLOCK( pChunk, 13, y, 8, BLOCK_LADDER, 4 );
+        }
+    }
+    // door, with a step up to it
+    SET_BLOCK( pChunk, 8, GROUND_LEVEL + 1, 3, BLOCK_AIR, 0 );
+    SET_BLOCK( pChunk, 8, GROUND_LEVEL + 2, 3, BLOCK_AIR, 0 );
+    SET_BLOCK( pChunk, 8, GROUND_LEVEL + 1, 2, BLOCK_OAK_WOOD_STAIRS, 2 );
+    // flat roof of slabs, with a railing of fences
+    for ( x = 3; x <= 14; x++ )
+    {
+        for ( z = 3; z <= 14; z++ )
+        {
+            if ( x == 3 || x == 14 || z == 3 || z == 14 )
+            {
+                SET_BLOCK( pChunk, x, top + 1, z, BLOCK_FENCE, 0 );
+            }
+            else
+            {
+                SET_BLOCK( pChunk, x, top + 1, z, BLOCK_STONE_SLAB, 0 );
+            }
+        }
+    }
+    SET_BLOCK( pChunk, 8, top + 2, 8, BLOCK_TORCH, 5 );
+}
+
+static void makeOcean( SyntheticChunk *pChunk, int cx, int cz )
+{
+    int x, y, z;
+
+    pChunk->biome = 24; // deep ocean
+    for ( x = 0; x < 16; x++ )
+    {
+        for ( z = 0; z < 16; z++ )
+        {
+            int wx = cx*16 + x;
+            int wz = cz*16 + z;
+            int floor = 24 + (int)(16.0f*noise2( wx, wz, 32, 6 ));
+
+            SET_BLOCK( pChunk, x, 0, z, BLOCK_BEDROCK, 0 );
+            for ( y = 1; y <= floor; y++ )
+            {
+                SET_BLOCK( pChunk, x, y, z, ( y < floor - 2 ) ? BLOCK_STONE : BLOCK_SAND, 0 );
+            }
+            for ( y = floor + 1; y <= SEA_LEVEL; y++ )
+            {
+                SET_BLOCK( pChunk, x, y, z, BLOCK_STATIONARY_WATER, 0 );
+            }
+        }
+    }
+}
+
+static void addTree( SyntheticChunk *pChunk, int x, int y, int z )
+{
+    int dx, dy, dz;
+
+    for ( dy = 2; dy <= 5; dy++ )
+    {
+        int radius = ( dy < 4 ) ? 2 : 1;
+        for ( dx = -radius; dx <= radius; dx++ )
+        {
+            for ( dz = -radius; dz <= radius; dz++ )
+            {
+                SET_BLOCK( pChunk, x + dx, y + dy, z + dz, BLOCK_LEAVES, 0 );
+            }
+        }
+    }
+    for ( dy = 0; dy < 5; dy++ )
+    {
+        SET_BLOCK( pChunk, x, y + dy, z, BLOCK_LOG, 0 );
+    }
+}
+
+// Integer hashing, so that the worlds come out the same on any machine
+static unsigned int hash3( int x, int y, int z, unsigned int seed )
+{
+    unsigned int h = seed*0x9e3779b9u ^ (unsigned int)x*0x8da6b343u ^ (unsigned int)y*0xd8163841u ^ (unsigned int)z*0xcb1ab31fu;
+    h ^= h >> 15;
+    h *= 0x2c1b3c6du;
+    h ^= h >> 12;
+    h *= 0x297a2d39u;
+    h ^= h >> 15;
+    return h;
+}
+
+#define HASH_TO_UNIT(h)     ((float)((h) >> 8) * (1.0f/16777216.0f))
+#define SMOOTH(t)           ((t)*(t)*(3.0f - 2.0f*(t)))
+#define LERP(t,a,b)         ((a) + (t)*((b) - (a)))
+
+// smooth value noise, 0 to 1, with features about cell blocks across
+static float noise2( int x, int z, int cell, unsigned int seed )
+{
+    int x0 = x / cell;
+    int z0 = z / cell;
+    float tx = SMOOTH( (float)(x % cell) / (float)cell );
+    float tz = SMOOTH( (float)(z % cell) / (float)cell );
+    float v00 = HASH_TO_UNIT( hash3( x0, 0, z0, seed ) );
+    float v10 = HASH_TO_UNIT( hash3( x0+1, 0, z0, seed ) );
+    float v01 = HASH_TO_UNIT( hash3( x0, 0, z0+1, seed ) );
+    float v11 = HASH_TO_UNIT( hash3( x0+1, 0, z0+1, seed ) );
+    return LERP( tz, LERP( tx, v00, v10 ), LERP( tx, v01, v11 ) );
+}
+
+static float noise3( int x, int y, int z, int cell, unsigned int seed )
+{
+    int x0 = x / cell;
+    int y0 = y / cell;
+    int z0 = z / cell;
+    float tx = SMOOTH( (float)(x % cell) / (float)cell );
+    float ty = SMOOTH( (float)(y % cell) / (float)cell );
+    float tz = SMOOTH( (float)(z % cell) / (float)cell );
+    float v[2][2];
+    int i, j;
+    for ( i = 0; i < 2; i++ )
+    {
+        for ( j = 0; j < 2; j++ )
+        {
+            v[i][j] = LERP( tx, HASH_TO_UNIT( hash3( x0, y0+i, z0+j, seed ) ), HASH_TO_UNIT( hash3( x0+1, y0+i, z0+j, seed ) ) );
+        }
+    }
+    return LERP( ty, LERP( tz, v[0][0], v[0][1] ), LERP( tz, v[1][0], v[1][1] ) );
+}
+
+// Write the chunks of region rx,rz that are inside the world. Each chunk is zlib compressed NBT,
+// starting on a 4 KB sector, and listed in the location table at the start of the file.
+static int writeRegion( const wchar_t *regionDir, int kind, int rx, int rz, int size )
+{
+#ifdef WIN32
+    DWORD br;
+#endif
+    wchar_t filename[MAX_PATH];
+    unsigned char header[2*REGION_SECTOR];
+    SyntheticChunk *pChunk;
+    NBTBuffer nbt;
+    unsigned char *compressed = NULL;
+    uLongf compressedAllocated = 0;
+    int sector = 2;     // past the location and timestamp tables
+    int retCode = MW_NO_ERROR;
+    int cx, cz;
+
+    swprintf_s( filename, MAX_PATH, L"%ls/r.%d.%d.mca", regionDir, rx, rz );
+    PORTAFILE fh = PortaCreate( filename );
+    if ( fh == INVALID_HANDLE_VALUE )
+        return MW_CANNOT_CREATE_FILE;
+
+    pChunk = (SyntheticChunk *)malloc( sizeof(SyntheticChunk) );
+    memset( &nbt, 0, sizeof(NBTBuffer) );
+    memset( header, 0, sizeof(header) );
+    if ( pChunk == NULL || PortaWrite( fh, header, sizeof(header) ) )
+    {
+        retCode = MW_CANNOT_WRITE_TO_FILE;
+        goto Exit;
+    }
+
+    for ( cz = rz*32; cz < rz*32 + 32 && cz < size; cz++ )
+    {
+        for ( cx = rx*32; cx < rx*32 + 32 && cx < size; cx++ )
+        {
+            makeChunk( pChunk, kind, cx, cz );
+            nbt.size = 0;
+            nbtChunk( &nbt, pChunk, cx, cz );
+            if ( nbt.failed )
+            {
+                retCode = MW_CANNOT_WRITE_TO_FILE;
+                goto Exit;
+            }
+
+            uLongf compressedSize = compressBound( (uLong)nbt.size );
+            if ( compressedSize > compressedAllocated )
+            {
+                free( compressed );
+                compressedAllocated = compressedSize;
+                compressed = (unsigned char *)malloc( 5 + compressedAllocated + REGION_SECTOR );
+                if ( compressed == NULL )
+                {
+                    retCode = MW_CANNOT_WRITE_TO_FILE;
+                    goto Exit;
+                }
+            }
+            if ( compress2( compressed + 5, &compressedSize, nbt.data, (uLong)nbt.size, Z_DEFAULT_COMPRESSION ) != Z_OK )
+            {
+                retCode = MW_CANNOT_WRITE_TO_FILE;
+                goto Exit;
+            }
+
+            // length, including the compression type byte, then 2 for zlib
+            int length = (int)compressedSize + 1;
+            compressed[0] = (unsigned char)(length >> 24);
+            compressed[1] = (unsigned char)(length >> 16);
+            compressed[2] = (unsigned char)(length >> 8);
+            compressed[3] = (unsigned char)length;
+            compressed[4] = 2;
+            int sectors = ( 4 + length + REGION_SECTOR - 1 ) / REGION_SECTOR;
+            memset( compressed + 4 + length, 0, sectors*REGION_SECTOR - ( 4 + length ) );
+            if ( PortaWrite( fh, compressed, sectors*REGION_SECTOR ) )
+            {
+                retCode = MW_CANNOT_WRITE_TO_FILE;
+                goto Exit;
+            }
+
+            unsigned char *location = &header[4*( (cx & 31) + (cz & 31)*32 )];
+            location[0] = (unsigned char)(sector >> 16);
+            location[1] = (unsigned char)(sector >> 8);
+            location[2] = (unsigned char)sector;
+            location[3] = (unsigned char)sectors;
+            sector += sectors;
+        }
+    }
+
+    // now that the chunks' places are known, fill in the location table
+    if ( PortaSeek( fh, 0 ) || PortaWrite( fh, header, REGION_SECTOR ) )
+    {
+        retCode = MW_CANNOT_WRITE_TO_FILE;
+    }
+
+Exit:
+    PortaClose( fh );
+    free( pChunk );
+    free( nbt.data );
+    free( compressed );
+    return retCode;
+}
+
+// level.dat is gzipped NBT; Mineways needs only the version, and the spawn point to center the map on
+static int writeLevelDat( const wchar_t *directory, int size )
+{
+    wchar_t filename[MAX_PATH];
+    NBTBuffer nbt;
+    FILE *fptr;
+    gzFile gz;
+    int written;
+
+    memset( &nbt, 0, sizeof(NBTBuffer) );
+    putTag( &nbt, 10, "" );
+    putTag( &nbt, 10, "Data" );
+    putTag( &nbt, 3, "version" );
+    putInt( &nbt, 19133 );
+    putTag( &nbt, 3, "SpawnX" );
+    putInt( &nbt, size*8 );
+    putTag( &nbt, 3, "SpawnY" );
+    putInt( &nbt, GROUND_LEVEL );
+    putTag( &nbt, 3, "SpawnZ" );
+    putInt( &nbt, size*8 );
+    putByte( &nbt, 0 );     // end of Data
+    putByte( &nbt, 0 );     // end of root
+    if ( nbt.failed )
+    {
+        free( nbt.data );
+        return MW_CANNOT_WRITE_TO_FILE;
+    }
+
+    swprintf_s( filename, MAX_PATH, L"%ls/level.dat", directory );
+    if ( _wfopen_s( &fptr, filename, L"wb" ) != 0 || fptr == NULL )
+    {
+        free( nbt.data );
+        return MW_CANNOT_CREATE_FILE;
+    }
+    gz = gzdopen( _fileno(fptr), "wb" );
+    if ( gz == NULL )
+    {
+        fclose( fptr );
+        free( nbt.data );
+        return MW_CANNOT_CREATE_FILE;
+    }
+    written = gzwrite( gz, nbt.data, (unsigned int)nbt.size );
+    gzclose( gz );
+    free( nbt.data );
+    return ( written == (int)nbt.size ) ? MW_NO_ERROR : MW_CANNOT_WRITE_TO_FILE;
+}
+
+// The chunk in the Anvil format, as nbtGetBlocks reads it: Level holds the biomes, and a section
+// for each 16 blocks of height that has anything in it.
+static void nbtChunk( NBTBuffer *pNBT, SyntheticChunk *pChunk, int cx, int cz )
+{
+    unsigned char nibbles[2048];
+    unsigned char biomes[256];
+    int sectionCount = 0;
+    int section, i;
+
+    putTag( pNBT, 10, "" );
+    putTag( pNBT, 10, "Level" );
+    putTag( pNBT, 3, "xPos" );
+    putInt( pNBT, cx );
+    putTag( pNBT, 3, "zPos" );
+    putInt( pNBT, cz );
+    memset( biomes, pChunk->biome, 256 );
+    putTag( pNBT, 7, "Biomes" );
+    putInt( pNBT, 256 );
+    putBytes( pNBT, biomes, 256 );
+
+    for ( section = 0; section < 16; section++ )
+    {
+        for ( i = 0; i < 4096; i++ )
+        {
+            if ( pChunk->blocks[section*4096 + i] != BLOCK_AIR )
+            {
+                sectionCount++;
+                break;
+            }
+        }
+    }
+    putTag( pNBT, 9, "Sections" );
+    putByte( pNBT, 10 );
+    putInt( pNBT, sectionCount );
+    for ( section = 0; section < 16; section++ )
+    {
+        unsigned char *blocks = &pChunk->blocks[section*4096];
+        unsigned char *data = &pChunk->data[section*4096];
+        for ( i = 0; i < 4096 && blocks[i] == BLOCK_AIR; i++ )
+            ;
+        if ( i == 4096 )
+            continue;
+
+        putTag( pNBT, 1, "Y" );
+        putByte( pNBT, (unsigned char)section );
+        putTag( pNBT, 7, "Blocks" );
+        putInt( pNBT, 4096 );
+        putBytes( pNBT, blocks, 4096 );
+        for ( i = 0; i < 2048; i++ )
+        {
+            nibbles[i] = (unsigned char)( (data[2*i] & 0xf) | ((data[2*i+1] & 0xf) << 4) );
+        }
+        putTag( pNBT, 7, "Data" );
+        putInt( pNBT, 2048 );
+        putBytes( pNBT, nibbles, 2048 );
+        memset( nibbles, 0xff, 2048 );
+        putTag( pNBT, 7, "BlockLight" );
+        putInt( pNBT, 2048 );
+        putBytes( pNBT, nibbles, 2048 );
+        putTag( pNBT, 7, "SkyLight" );
+        putInt( pNBT, 2048 );
+        putBytes( pNBT, nibbles, 2048 );
+        putByte( pNBT, 0 );     // end of section
+    }
+    putByte( pNBT, 0 );     // end of Level
+    putByte( pNBT, 0 );     // end of root
+}
+
+static void putBytes( NBTBuffer *pNBT, const void *bytes, size_t count )
+{
+    if ( pNBT->failed )
+        return;
+    if ( pNBT->size + count > pNBT->allocated )
+    {
+        size_t allocated = 2*pNBT->allocated + count + 65536;
+        unsigned char *data = (unsigned char *)realloc( pNBT->data, allocated );
+        if ( data == NULL )
+        {
+            pNBT->failed = 1;
+            return;
+        }
+        pNBT->data = data;
+        pNBT->allocated = allocated;
+    }
+    memcpy( pNBT->data + pNBT->size, bytes, count );
+    pNBT->size += count;
+}
+
+static void putByte( NBTBuffer *pNBT, unsigned char value )
+{
+    putBytes( pNBT, &value, 1 );
+}
+
+// NBT numbers are big-endian
+static void putShort( NBTBuffer *pNBT, int value )
+{
+    unsigned char bytes[2];
+    bytes[0] = (unsigned char)(value >> 8);
+    bytes[1] = (unsigned char)value;
+    putBytes( pNBT, bytes, 2 );
+}
+
+static void putInt( NBTBuffer *pNBT, int value )
+{
+    unsigned char bytes[4];
+    bytes[0] = (unsigned char)(value >> 24);
+    bytes[1] = (unsigned char)(value >> 16);
+    bytes[2] = (unsigned char)(value >> 8);
+    bytes[3] = (unsigned char)value;
+    putBytes( pNBT, bytes, 4 );
+}
+
+// a named tag's type and name; its value follows
+static void putTag( NBTBuffer *pNBT, unsigned char type, const char *name )
+{
+    size_t length = strlen( name );
+    putByte( pNBT, type );
+    putShort( pNBT, (int)length );
+    putBytes( pNBT, name, length );
+}
@@ -0,0 +1,45 @@
+/*
+Copyright (c) 2011, Eric Haines
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Writes made-up worlds to disk, the same every time, for benchmarking exports: a level.dat and
+// Anvil region files that Mineways reads like any other world.
+
+#pragma once
+
+// kinds of world
+#define SYNTHETIC_TERRAIN           0   // rolling hills with trees and lakes
+#define SYNTHETIC_CAVES             1   // the hills, riddled with caves, for many more faces
+#define SYNTHETIC_BUILDINGS         2   // a town of dense buildings of many block types
+#define SYNTHETIC_OCEAN             3   // deep water over sand
+
+#define SYNTHETIC_KIND_COUNT        4
+
+const wchar_t *SyntheticWorldName( int kind );
+
+// Write a world of the given kind, size by size chunks starting at chunk 0,0, into directory,
+// which is made if needed. Returns MW_NO_ERROR, MW_CANNOT_CREATE_FILE or MW_CANNOT_WRITE_TO_FILE.
+int WriteSyntheticWorld( const wchar_t *directory, int kind, int size );
@@ -0,0 +1,64 @@
+/*
+Copyright (c) 2011, Eric Haines
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+// Not built with the precompiled header, so that TileMaker can compile it as-is.
+#define WIN32_LEAN_AND_MEAN
+#include "stdafx.h"
+#include <stdlib.h>
+#include "Workers.h"
+
+void RunOnWorkers( DWORD (WINAPI *fn)(LPVOID), void *param, int maxWorkers )
+{
+    PORTATHREAD *threads = NULL;
+    int numThreads = 0;
+    int i;
+
+    if ( maxWorkers > 1 )
+        threads = (PORTATHREAD *)malloc( (maxWorkers-1) * sizeof(PORTATHREAD) );
+    if ( threads != NULL )
+    {
+        for ( i = 1; i < maxWorkers; i++ )
+        {
+            threads[numThreads] = PortaCreateThread( fn, param );
+            if ( threads[numThreads] != NULL )
+            {
+                numThreads++;
+            }
+        }
+    }
+    fn( param );
+    if ( numThreads > 0 )
+    {
+        PortaWaitForThreads( numThreads, threads );
+        for ( i = 0; i < numThreads; i++ )
+        {
+            PortaCloseThread( threads[i] );
+        }
+    }
+    free( threads );
+}
@@ -0,0 +1,500 @@
+/*
+Copyright (c) 2011, Eric Haines
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "stdafx.h"
+#include <stdio.h>
+#ifndef WIN32
+#include <sys/stat.h>
+#endif
+#include "zlib.h"
+#include "ZipWriter.h"
+#include "ParallelDeflate.h"
+#include "Workers.h"
+
+// A file is compressed in pieces of this size, on several threads, a batch of pieces at a time
+#define ZIP_PIECE_SIZE      (256*1024)
+#define ZIP_BATCH_PIECES    32
+// most threads compressing one batch
+#define MAX_ZIP_THREADS     8
+// how much of the data before each batch is kept for its first piece to look back into, the largest deflate window
+#define ZIP_DICTIONARY_SIZE 32768
+
+#define ZIP_STORED          0
+#define ZIP_DEFLATED        8
+
+// entry names are UTF-8, bit 11 of the general purpose flags
+#define ZIP_FLAG_UTF8       0x0800
+
+#define ZIP_LOCAL_HEADER_SIZE       30
+#define ZIP_CENTRAL_HEADER_SIZE     46
+#define ZIP_END_SIZE                22
+
+// one file in the zip
+typedef struct ZipEntry {
+    const wchar_t *fileName;
+    const unsigned char *data;  // the file's contents, if it's in memory rather than on disk
+    char name[MAX_PATH*3];      // UTF-8
+    int nameLength;
+    int store;                  // store as is, don't compress
+    unsigned int size;          // size of the file
+    unsigned int compressedSize;
+    unsigned long crc;
+    unsigned short dosTime;
+    unsigned short dosDate;
+    unsigned int offset;        // of the entry's local header in the zip
+} ZipEntry;
+
+// One batch of a file being compressed, read into memory after the end of the batch before it, which each
+// piece may use as its dictionary, or just pointing into the file if it's in memory. Threads take the next
+// piece to do until there are none left.
+typedef struct ZipBatch {
+    unsigned char *buffer;      // room for the dictionary, then a batch read from disk
+    const unsigned char *in;    // the batch itself
+    unsigned int history;       // how many bytes of the file just before in are there
+    unsigned int length;
+    int numPieces;
+    int last;                   // the batch ends the file
+    volatile LONG nextPiece;
+    volatile LONG failed;
+    unsigned char *out[ZIP_BATCH_PIECES];   // compressed data of each piece
+    size_t outSize[ZIP_BATCH_PIECES];
+    unsigned long crc[ZIP_BATCH_PIECES];    // crc32 of each piece's uncompressed data
+} ZipBatch;
+
+static int writeEntry( PORTAFILE hZip, ZipEntry *pEntry, ZipBatch *pBatch, int numWorkers, unsigned int *pOffset );
+static int compressBatch( ZipBatch *pBatch, int numWorkers );
+static DWORD WINAPI deflatePieces( LPVOID pParam );
+static int writeBatch( PORTAFILE hZip, ZipBatch *pBatch, int store, unsigned long long *pZipSize );
+static int isPNG( const wchar_t *fileName );
+static void getDosTime( ZipEntry *pEntry );
+static void putLocalHeader( unsigned char *header, ZipEntry *pEntry );
+static int seekZip( PORTAFILE hZip, unsigned int offset );
+static int writeCentral( PORTAFILE hZip, ZipEntry *entries, int count, unsigned int offset );
+static void put16( unsigned char *p, unsigned int value );
+static void put32( unsigned char *p, unsigned int value );
+
+
+int WriteZip( const wchar_t *zipFileName, const wchar_t **fileName, const wchar_t **entryName,
+    const unsigned char **data, const size_t *size, int count,
+    ProgressCallback callback, float progressStart, float progressEnd )
+{
+    ZipBatch batch;
+    int retCode = 0;
+    int i;
+
+    ZipEntry *entries = (ZipEntry *)calloc( count, sizeof(ZipEntry) );
+    if ( entries == NULL )
+        return -1;
+
+    for ( i = 0; i < count; i++ )
+    {
+        entries[i].fileName = fileName[i];
+        if ( data != NULL && data[i] != NULL )
+        {
+            // the plain zip format can't go past 4 GB
+            if ( size[i] >= 0xffffffff )
+            {
+                free( entries );
+                return -1;
+            }
+            entries[i].data = data[i];
+            entries[i].size = (unsigned int)size[i];
+        }
+        entries[i].store = isPNG( fileName[i] );
+        entries[i].nameLength = WideCharToMultiByte( CP_UTF8, 0, entryName[i], -1, entries[i].name, MAX_PATH*3, NULL, NULL ) - 1;
+        if ( entries[i].nameLength <= 0 )
+        {
+            free( entries );
+            return -1;
+        }
+    }
+
+    // one batch's worth of memory, however large the files are
+    memset( &batch, 0, sizeof(ZipBatch) );
+    batch.buffer = (unsigned char *)malloc( ZIP_DICTIONARY_SIZE + ZIP_BATCH_PIECES*ZIP_PIECE_SIZE );
+    for ( i = 0; i < ZIP_BATCH_PIECES; i++ )
+    {
+        batch.out[i] = (unsigned char *)malloc( DeflatePieceBound( ZIP_PIECE_SIZE ) );
+        if ( batch.out[i] == NULL )
+            retCode = -1;
+    }
+    if ( batch.buffer == NULL )
+        retCode = -1;
+
+    int numWorkers = PortaProcessorCount();
+    if ( numWorkers > MAX_ZIP_THREADS )
+        numWorkers = MAX_ZIP_THREADS;
+
+    if ( retCode == 0 )
+    {
+        PORTAFILE hZip = PortaCreate( zipFileName );
+        if ( hZip == INVALID_HANDLE_VALUE )
+            retCode = -1;
+        else
+        {
+            unsigned int offset = 0;
+            for ( i = 0; i < count && retCode == 0; i++ )
+            {
+                if ( callback )
+                    (*callback)( progressStart + (progressEnd-progressStart)*(float)i/(float)count );
+                retCode = writeEntry( hZip, &entries[i], &batch, numWorkers, &offset );
+            }
+            if ( retCode == 0 )
+                retCode = writeCentral( hZip, entries, count, offset );
+            PortaClose( hZip );
+        }
+    }
+
+    for ( i = 0; i < ZIP_BATCH_PIECES; i++ )
+    {
+        free( batch.out[i] );
+    }
+    free( batch.buffer );
+    free( entries );
+    return retCode;
+}
+
+// The local header, then the entry's bytes, read if need be and compressed a batch at a time. A file that fits in one
+// batch is stored if compression doesn't make it smaller. A larger one is always compressed, as its start is
+// written before the rest is read; its header is filled in once the whole file is done.
+static int writeEntry( PORTAFILE hZip, ZipEntry *pEntry, ZipBatch *pBatch, int numWorkers, unsigned int *pOffset )
+{
+#ifdef WIN32
+    DWORD br;
+#endif
+    unsigned char header[ZIP_LOCAL_HEADER_SIZE];
+    unsigned long long fileSize;
+    unsigned long long zipSize;
+    unsigned int bytesRead = 0;
+    int retCode = -1;
+    PORTAFILE hFile = INVALID_HANDLE_VALUE;
+
+    if ( pEntry->data == NULL )
+    {
+        hFile = PortaOpen( pEntry->fileName );
+        if ( hFile == INVALID_HANDLE_VALUE )
+            return -1;
+
+        // the plain zip format can't go past 4 GB
+        if ( !PortaFileSize( pEntry->fileName, &fileSize ) || fileSize >= 0xffffffff )
+            goto Exit;
+        pEntry->size = (unsigned int)fileSize;
+    }
+    pEntry->offset = *pOffset;
+    getDosTime( pEntry );
+
+    pEntry->crc = crc32( 0L, Z_NULL, 0 );
+    pEntry->compressedSize = 0;
+    zipSize = (unsigned long long)*pOffset + ZIP_LOCAL_HEADER_SIZE + pEntry->nameLength;
+    do
+    {
+        unsigned int history = ( bytesRead < ZIP_DICTIONARY_SIZE ) ? bytesRead : ZIP_DICTIONARY_SIZE;
+        if ( pEntry->data != NULL )
+        {
+            // already in memory, so compress it where it is, looking back into whatever's before it
+            pBatch->in = pEntry->data + bytesRead;
+        }
+        else
+        {
+            // keep the end of the last batch as the dictionary for this one, then read the next
+            unsigned char *in = pBatch->buffer + ZIP_DICTIONARY_SIZE;
+            if ( history > 0 )
+                memmove( in - history, pBatch->in + pBatch->length - history, history );
+            pBatch->in = in;
+        }
+        pBatch->history = history;
+        pBatch->length = pEntry->size - bytesRead;
+        if ( pBatch->length > ZIP_BATCH_PIECES*ZIP_PIECE_SIZE )
+            pBatch->length = ZIP_BATCH_PIECES*ZIP_PIECE_SIZE;
+        if ( pEntry->data == NULL && pBatch->length > 0 && PortaRead( hFile, pBatch->buffer + ZIP_DICTIONARY_SIZE, pBatch->length ) )
+            goto Exit;
+        bytesRead += pBatch->length;
+        pBatch->last = ( bytesRead == pEntry->size );
+
+        if ( pEntry->store )
+        {
+            pBatch->crc[0] = crc32( crc32( 0L, Z_NULL, 0 ), pBatch->in, pBatch->length );
+            pBatch->numPieces = 1;
+        }
+        else if ( !compressBatch( pBatch, numWorkers ) )
+            goto Exit;
+        for ( int i = 0; i < pBatch->numPieces; i++ )
+        {
+            unsigned int length = pBatch->length - i*ZIP_PIECE_SIZE;
+            if ( !pEntry->store && length > ZIP_PIECE_SIZE )
+                length = ZIP_PIECE_SIZE;
+            pEntry->crc = crc32_combine( pEntry->crc, pBatch->crc[i], (z_off_t)length );
+        }
+
+        if ( bytesRead == pBatch->length )
+        {
+            // the first batch: if it's the whole file, all of the header is known now
+            if ( pBatch->last && !pEntry->store )
+            {
+                unsigned int compressedSize = 0;
+                for ( int i = 0; i < pBatch->numPieces; i++ )
+                {
+                    compressedSize += (unsigned int)pBatch->outSize[i];
+                }
+                if ( compressedSize >= pEntry->size )
+                    pEntry->store = 1;
+                else
+                    pEntry->compressedSize = compressedSize;
+            }
+            if ( pEntry->store )
+                pEntry->compressedSize = pEntry->size;
+            putLocalHeader( header, pEntry );
+            if ( PortaWrite( hZip, header, ZIP_LOCAL_HEADER_SIZE ) ||
+                PortaWrite( hZip, pEntry->name, pEntry->nameLength ) )
+                goto Exit;
+        }
+        if ( writeBatch( hZip, pBatch, pEntry->store, &zipSize ) )
+            goto Exit;
+    } while ( !pBatch->last );
+
+    if ( bytesRead > pBatch->length )
+    {
+        // written a batch at a time, so go back and put in the CRC and compressed size
+        pEntry->compressedSize = (unsigned int)( zipSize - pEntry->offset - ZIP_LOCAL_HEADER_SIZE - pEntry->nameLength );
+        putLocalHeader( header, pEntry );
+        if ( seekZip( hZip, pEntry->offset + 14 ) || PortaWrite( hZip, header + 14, 12 ) ||
+            seekZip( hZip, (unsigned int)zipSize ) )
+            goto Exit;
+    }
+    *pOffset = (unsigned int)zipSize;
+    retCode = 0;
+
+Exit:
+    if ( hFile != INVALID_HANDLE_VALUE )
+        PortaClose( hFile );
+    return retCode;
+}
+
+// Compress the pieces of the batch on as many threads as there are processors, this one included.
+// Returns 1 on success.
+static int compressBatch( ZipBatch *pBatch, int numWorkers )
+{
+    pBatch->numPieces = (int)( ( pBatch->length + ZIP_PIECE_SIZE - 1 ) / ZIP_PIECE_SIZE );
+    if ( pBatch->numPieces == 0 )
+        pBatch->numPieces = 1;
+    pBatch->nextPiece = 0;
+    pBatch->failed = 0;
+
+    if ( numWorkers > pBatch->numPieces )
+        numWorkers = pBatch->numPieces;
+    RunOnWorkers( deflatePieces, pBatch, numWorkers );
+    return !pBatch->failed;
+}
+
+static DWORD WINAPI deflatePieces( LPVOID pParam )
+{
+    ZipBatch *pBatch = (ZipBatch *)pParam;
+    int piece;
+
+    while ( !pBatch->failed )
+    {
+        // PortaIncrement returns the new value, so subtract one to get the piece this thread took
+        piece = (int)PortaIncrement( &pBatch->nextPiece ) - 1;
+        if ( piece >= pBatch->numPieces )
+            break;
+        // raw deflate data, as zip wants, each piece ending the file's stream only if it's the file's last
+        unsigned int start = piece * ZIP_PIECE_SIZE;
+        unsigned int length = pBatch->length - start;
+        if ( length > ZIP_PIECE_SIZE )
+            length = ZIP_PIECE_SIZE;
+        if ( !DeflatePiece( pBatch->in + start, length, start + pBatch->history, Z_DEFAULT_COMPRESSION,
+            ( pBatch->last && piece == pBatch->numPieces-1 ), DEFLATE_CHECK_CRC32,
+            &pBatch->crc[piece], pBatch->out[piece], &pBatch->outSize[piece] ) )
+            pBatch->failed = 1;
+    }
+    return 0;
+}
+
+// Write the batch, stored or compressed. *pZipSize keeps track of how big the zip is, as its offsets are 32 bits.
+// Returns nonzero on failure.
+static int writeBatch( PORTAFILE hZip, ZipBatch *pBatch, int store, unsigned long long *pZipSize )
+{
+#ifdef WIN32
+    DWORD br;
+#endif
+
+    if ( store )
+    {
+        *pZipSize += pBatch->length;
+        return ( *pZipSize >= 0xffffffff || ( pBatch->length > 0 && PortaWrite( hZip, pBatch->in, pBatch->length ) ) );
+    }
+    for ( int i = 0; i < pBatch->numPieces; i++ )
+    {
+        *pZipSize += pBatch->outSize[i];
+        if ( *pZipSize >= 0xffffffff || ( pBatch->outSize[i] > 0 && PortaWrite( hZip, pBatch->out[i], (DWORD)pBatch->outSize[i] ) ) )
+            return 1;
+    }
+    return 0;
+}
+
+// The zip has the time the file was last written, in local time, as zip tools expect; a file in memory is
+// being written now
+static void getDosTime( ZipEntry *pEntry )
+{
+    pEntry->dosTime = 0;
+    pEntry->dosDate = (1<<5) | 1;   // January 1, 1980
+#ifdef WIN32
+    WIN32_FILE_ATTRIBUTE_DATA fileData;
+    FILETIME localTime;
+    if ( pEntry->data != NULL )
+        GetSystemTimeAsFileTime( &fileData.ftLastWriteTime );
+    else if ( !GetFileAttributesExW( pEntry->fileName, GetFileExInfoStandard, &fileData ) )
+        return;
+    if ( FileTimeToLocalFileTime( &fileData.ftLastWriteTime, &localTime ) )
+    {
+        WORD dosDate, dosTime;
+        if ( FileTimeToDosDateTime( &localTime, &dosDate, &dosTime ) )
+        {
+            pEntry->dosDate = dosDate;
+            pEntry->dosTime = dosTime;
+        }
+    }
+#else
+    char name[MAX_PATH*4];
+    struct stat fileStat;
+    struct tm local;
+    if ( pEntry->data != NULL )
+        fileStat.st_mtime = time( NULL );
+    else
+    {
+        portaFileName( pEntry->fileName, name, MAX_PATH*4 );
+        if ( stat( name, &fileStat ) != 0 )
+            return;
+    }
+    if ( localtime_r( &fileStat.st_mtime, &local ) != NULL && local.tm_year >= 80 )
+    {
+        pEntry->dosDate = (unsigned short)(((local.tm_year - 80) << 9) | ((local.tm_mon + 1) << 5) | local.tm_mday);
+        pEntry->dosTime = (unsigned short)((local.tm_hour << 11) | (local.tm_min << 5) | (local.tm_sec / 2));
+    }
+#endif
+}
+
+static int isPNG( const wchar_t *fileName )
+{
+    size_t length = wcslen( fileName );
+    return ( length >= 4 && _wcsicmp( fileName + length - 4, L".png" ) == 0 );
+}
+
+static void putLocalHeader( unsigned char *header, ZipEntry *pEntry )
+{
+    put32( header, 0x04034b50 );
+    put16( header + 4, 20 );        // version needed to extract, 2.0
+    put16( header + 6, ZIP_FLAG_UTF8 );
+    put16( header + 8, pEntry->store ? ZIP_STORED : ZIP_DEFLATED );
+    put16( header + 10, pEntry->dosTime );
+    put16( header + 12, pEntry->dosDate );
+    put32( header + 14, (unsigned int)pEntry->crc );
+    put32( header + 18, pEntry->compressedSize );
+    put32( header + 22, pEntry->size );
+    put16( header + 26, pEntry->nameLength );
+    put16( header + 28, 0 );        // no extra field
+}
+
+// Returns nonzero on failure. Zip offsets can be past 2 GB, so on Windows they're passed as 64 bits;
+// they stay under 4 GB, so the low 32 bits that come back are never INVALID_SET_FILE_POINTER on success.
+static int seekZip( PORTAFILE hZip, unsigned int offset )
+{
+#ifdef WIN32
+    LONG high = 0;
+    return ( SetFilePointer( hZip, (LONG)offset, &high, FILE_BEGIN ) == INVALID_SET_FILE_POINTER );
+#else
+    return fseek( hZip, (long)offset, SEEK_SET );
+#endif
+}
+
+// the central directory, listing every entry, then the end record pointing to it
+static int writeCentral( PORTAFILE hZip, ZipEntry *entries, int count, unsigned int offset )
+{
+#ifdef WIN32
+    DWORD br;
+#endif
+    unsigned char header[ZIP_CENTRAL_HEADER_SIZE];
+    unsigned int centralSize = 0;
+
+    if ( count > 0xffff )
+        return -1;
+
+    for ( int i = 0; i < count; i++ )
+    {
+        ZipEntry *pEntry = &entries[i];
+        put32( header, 0x02014b50 );
+        put16( header + 4, 0xB00 | 20 );    // made by Windows (NTFS), zip 2.0
+        put16( header + 6, 20 );
+        put16( header + 8, ZIP_FLAG_UTF8 );
+        put16( header + 10, pEntry->store ? ZIP_STORED : ZIP_DEFLATED );
+        put16( header + 12, pEntry->dosTime );
+        put16( header + 14, pEntry->dosDate );
+        put32( header + 16, (unsigned int)pEntry->crc );
+        put32( header + 20, pEntry->compressedSize );
+        put32( header + 24, pEntry->size );
+        put16( header + 28, pEntry->nameLength );
+        put16( header + 30, 0 );            // extra field
+        put16( header + 32, 0 );            // comment
+        put16( header + 34, 0 );            // disk number
+        put16( header + 36, 0 );            // internal attributes
+        put32( header + 38, 0x20 );         // external attributes: FILE_ATTRIBUTE_ARCHIVE
+        put32( header + 42, pEntry->offset );
+        if ( PortaWrite( hZip, header, ZIP_CENTRAL_HEADER_SIZE ) ||
+            PortaWrite( hZip, pEntry->name, pEntry->nameLength ) )
+            return -1;
+        centralSize += ZIP_CENTRAL_HEADER_SIZE + pEntry->nameLength;
+    }
+
+    unsigned char end[ZIP_END_SIZE];
+    put32( end, 0x06054b50 );
+    put16( end + 4, 0 );                    // this disk
+    put16( end + 6, 0 );                    // disk the central directory starts on
+    put16( end + 8, count );
+    put16( end + 10, count );
+    put32( end + 12, centralSize );
+    put32( end + 16, offset );
+    put16( end + 20, 0 );                   // comment
+    if ( PortaWrite( hZip, end, ZIP_END_SIZE ) )
+        return -1;
+    return 0;
+}
+
+// zip numbers are little-endian
+static void put16( unsigned char *p, unsigned int value )
+{
+    p[0] = (unsigned char)value;
+    p[1] = (unsigned char)(value >> 8);
+}
+
+static void put32( unsigned char *p, unsigned int value )
+{
+    p[0] = (unsigned char)value;
+    p[1] = (unsigned char)(value >> 8);
+    p[2] = (unsigned char)(value >> 16);
+    p[3] = (unsigned char)(value >> 24);
+}
@@ -0,0 +1,42 @@
+/*
+Copyright (c) 2011, Eric Haines
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+// Writes a zip file of a set of files, on disk or already in memory. Each file is read and compressed a batch at a
+// time, the pieces of a batch on several threads at once, so only one batch of a file on disk is ever in memory.
+
+#pragma once
+
+// Zip count files into zipFileName. Each file is stored in the zip as entryName[i], compressed unless
+// it's a PNG, as PNGs are already compressed and gain nothing. If data[i] isn't NULL, it holds the file's
+// size[i] bytes, and fileName[i] is just the name it would have on disk; otherwise the file is read from disk.
+// data may be NULL if all the files are on disk. The callback goes from progressStart to progressEnd as the zip
+// is written. Returns 0 if the zip was written. Otherwise -1, if something can't be read or written, or the zip
+// would be too large for the plain zip format.
+int WriteZip( const wchar_t *zipFileName, const wchar_t **fileName, const wchar_t **entryName,
+    const unsigned char **data, const size_t *size, int count,
+    ProgressCallback callback, float progressStart, float progressEnd );
@@ -121,8 +121,6 @@ extern MaterialCost gMtlCostTable[];
 #define UNITS_MILLIMETER 2
 #define UNITS_INCHES 3
 
-int unitIndex; // initialize to UNITS_METER
-
 typedef struct UnitType {
     wchar_t *wname;
     char *name;
@@ -220,6 +218,20 @@ extern UnitType gUnitTypeTable[];
 // use biomes for export
 #define EXPT_BIOME							0x2000000
 
+// write OBJ vertex and texture coordinates with a fixed number of decimals, based on the block size and units,
+// instead of the default "%g" format. Faster to write and usually smaller, but not identical to the default output.
+#define EXPT_OUTPUT_OBJ_FIXED_PRECISION		0x4000000
+
+// write OBJ geometry slab by slab (along X) while it is generated, instead of holding the whole model in memory.
+// Materials are then repeated for each slab, so faces are grouped by material only within a slab.
+#define EXPT_OUTPUT_OBJ_STREAMING			0x8000000
+
+// hollow out every block farther than the wall thickness from air, using a distance transform, instead of
+// hollowing upwards from the bottom. Super-hollowing is then not done.
+#define EXPT_HOLLOW_BY_DISTANCE				0x10000000
+// with EXPT_HOLLOW_BY_DISTANCE, also hollow areas not open to the bottom, and drill a drain hole down from each
+#define EXPT_HOLLOW_DRAIN_HOLES				0x20000000
+
 #define EP_FIELD_LENGTH 20
 
 // linked to the ofn.lpstrFilter in Mineways.cpp
@@ -231,17 +243,20 @@ extern UnitType gUnitTypeTable[];
 #define FILE_TYPE_BINARY_VISCAM_STL 3
 #define FILE_TYPE_ASCII_STL 4
 #define FILE_TYPE_VRML2 5
+#define FILE_TYPE_BINARY_PLY 6
+// offered for rendering only
+#define FILE_TYPE_GLTF 7
 // this is an entirely separate file type, only exportable through the schematic export option
-#define FILE_TYPE_SCHEMATIC 6
+#define FILE_TYPE_SCHEMATIC 8
 
-#define FILE_TYPE_TOTAL         7
+#define FILE_TYPE_TOTAL         9
 
 
 typedef struct ExportFileData
 {
     // dialog file type last chosen in export dialog; this is used next time.
     // Note that this value is *not* valid during export itself; fileType is passed in.
-    int fileType;           // 0,1 - OBJ, 2,3 - Binary STL, 4 - ASCII STL, 5 - VRML2, 6 - Schematic
+    int fileType;           // 0,1 - OBJ, 2,3 - Binary STL, 4 - ASCII STL, 5 - VRML2, 6 - PLY, 7 - glTF, 8 - Schematic
 
     // in reality, the character fields could be kept private, but whatever
     char minxString[EP_FIELD_LENGTH];
@@ -302,6 +317,8 @@ typedef struct ExportFileData
     UINT chkDeleteFloaters;
     UINT chkHollow[FILE_TYPE_TOTAL];
     UINT chkSuperHollow[FILE_TYPE_TOTAL];
+    UINT chkHollowByDistance[FILE_TYPE_TOTAL];
+    UINT chkDrainHoles[FILE_TYPE_TOTAL];
     UINT chkMeltSnow;
 
     char floaterCountString[EP_FIELD_LENGTH];
@@ -318,6 +335,8 @@ typedef struct ExportFileData
     UINT chkMultipleObjects;
     UINT chkMaterialPerType;
     UINT chkG3DMaterial;
+    UINT chkStreamOBJ;      // write OBJ geometry out as it is made, instead of holding the whole model
+    UINT chkFixedPrecisionOBJ;  // write OBJ coordinates with a fixed number of decimals
 
     UINT flags;
 } ExportFileData;
@@ -327,6 +346,11 @@ typedef struct ExportFileData
 typedef struct FileList {
     int count;
     wchar_t name[MAX_OUTPUT_FILES][260];  // output file list, MAX_PATH == 260
+    // If inMemory is set, the files are only wanted in a zip, so they're kept in memory until it's written, instead
+    // of going to disk and being read back. A file's data is NULL if it went to disk after all, e.g. it got too big.
+    int inMemory;
+    unsigned char *data[MAX_OUTPUT_FILES];
+    size_t size[MAX_OUTPUT_FILES];
 } FileList;
 
 
@@ -337,6 +361,10 @@ typedef struct Options {
     int moreExportMemory;             // use more memory for caching or not?
     int currentCacheSize;
     ExportFileData *pEFD;   // print or view option values, etc.
+    int pngCompression;     // PNG_COMPRESSION_* in rwpng.h, how hard to work at compressing texture files
+    int timingReport;       // TIMING_REPORT_* in ExportTiming.h, where to report how long each stage of the export took
+    int schematicCompression;   // zlib level 1 (fastest) to 9 (smallest) for schematic files, 0 for zlib's default
+    int keepVolume;         // keep the volume read for the next export of the same selection, until ClearVolumeCache
     ///// these are really statistics, but let's shove them in here - so sloppy!
     int dimensions[3];
     float dim_inches[3];
@@ -345,6 +373,7 @@ typedef struct Options {
     int totalBlocks;
     float block_mm;
     float block_inch;
+    int timingReportError;  // MW_NO_ERROR, or why the -timing.json file couldn't be written; not in SaveVolume's result
 } Options;
 
 
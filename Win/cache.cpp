@@ -55,9 +55,15 @@ typedef struct {
 
 static block_entry **gBlockCache=NULL;
 
+// Guards the cache when several exports run at once. Exports hold it shared while they read a
+// chunk, and exclusive while they add one, since adding may free the oldest chunk.
+static PORTARWLOCK gCacheLock=PORTARWLOCK_INIT;
+
 static IPoint2 *gCacheHistory=NULL;
 static int gCacheN=0;
 
+static void emptyCache();
+
 static int hash_coord(int x, int z) {
     return (x&(HASH_XDIM-1))*(HASH_ZDIM) + (z & (HASH_ZDIM - 1));
 }
@@ -79,8 +85,30 @@ void Change_Cache_Size( int size )
         return;
     }
     // mindless, but safe: empty cache and just start again.
-    Cache_Empty();
+    Cache_Lock_Exclusive();
+    emptyCache();
     gHashMaxEntries = size;
+    Cache_Unlock_Exclusive();
+}
+
+void Cache_Lock_Shared()
+{
+    PortaLockShared(&gCacheLock);
+}
+
+void Cache_Unlock_Shared()
+{
+    PortaUnlockShared(&gCacheLock);
+}
+
+void Cache_Lock_Exclusive()
+{
+    PortaLockExclusive(&gCacheLock);
+}
+
+void Cache_Unlock_Exclusive()
+{
+    PortaUnlockExclusive(&gCacheLock);
 }
 
 void Cache_Add(int bx, int bz, void *data)
@@ -145,7 +173,15 @@ void *Cache_Find(int bx,int bz)
     return NULL;
 }
 
+// must not be called while holding the cache lock
 void Cache_Empty()
+{
+    Cache_Lock_Exclusive();
+    emptyCache();
+    Cache_Unlock_Exclusive();
+}
+
+static void emptyCache()
 {
     int hash;
     block_entry *entry,*next;
@@ -177,10 +213,10 @@ void Cache_Empty()
 **  free(oldBlock) // same size
 **
 ** Repeatedly. Recycling the old block can prevent the need for 
-** malloc and free.
+** malloc and free. Each thread recycles its own block.
 **/
 
-static WorldBlock* last_block = NULL;
+static THREAD_LOCAL WorldBlock* last_block = NULL;
 
 WorldBlock* block_alloc() 
 {
@@ -62,6 +62,13 @@ void *Cache_Find(int bx,int bz);
 void Cache_Add(int bx,int bz,void *data);
 void Cache_Empty();
 
+// Only needed when more than one thread uses the cache: hold the lock shared while using a
+// block from Cache_Find, exclusive around Cache_Add.
+void Cache_Lock_Shared();
+void Cache_Unlock_Shared();
+void Cache_Lock_Exclusive();
+void Cache_Unlock_Exclusive();
+
 /* a simple malloc wrapper, based on the observation that a common
 * behavior pattern for Mineways when the cache is at max capacity
 * is something like:
@@ -355,8 +355,12 @@ unsigned lodepng_load_file(unsigned char** out, size_t* outsize, const char* fil
   *out = 0;
   *outsize = 0;
 
-  errno_t err = fopen_s(&file, filename, "rb");
-  if (!err) return 78;
+#ifdef WIN32
+  if (fopen_s(&file, filename, "rb") != 0) return 78;
+#else
+  file = fopen(filename, "rb");
+  if (!file) return 78;
+#endif
 
   /*get filesize:*/
   fseek(file , 0 , SEEK_END);
@@ -377,8 +381,12 @@ unsigned lodepng_load_file(unsigned char** out, size_t* outsize, const char* fil
 unsigned lodepng_save_file(const unsigned char* buffer, size_t buffersize, const char* filename)
 {
   FILE* file;
-  errno_t err = fopen_s(&file, filename, "wb");
-  if (!err) return 79;
+#ifdef WIN32
+  if (fopen_s(&file, filename, "wb") != 0) return 79;
+#else
+  file = fopen(filename, "wb");
+  if (!file) return 79;
+#endif
   fwrite((char*)buffer , 1 , buffersize, file);
   fclose(file);
   return 0;
@@ -6085,9 +6093,23 @@ void save_file(const std::vector<unsigned char>& buffer, const std::string& file
   file.write(buffer.empty() ? 0 : (char*)&buffer[0], std::streamsize(buffer.size()));
 }
 #ifdef LODEPNG_WIDE_CHARS
+#ifndef WIN32
+/*the streams take only narrow names outside of Windows, so use the locale's multibyte form, e.g. UTF-8*/
+static std::string narrow_file_name(const std::wstring& filename)
+{
+	std::string name(filename.size()*4 + 1, '\0');
+	size_t len = wcstombs(&name[0], filename.c_str(), name.size());
+	name.resize(len == (size_t)-1 ? 0 : len);
+	return name;
+}
+#define WIDE_FILE_NAME(filename) narrow_file_name(filename).c_str()
+#else
+#define WIDE_FILE_NAME(filename) filename.c_str()
+#endif
+
 void load_file(std::vector<unsigned char>& buffer, const std::wstring& filename)
 {
-	std::ifstream file(filename.c_str(), std::ios::in|std::ios::binary|std::ios::ate);
+	std::ifstream file(WIDE_FILE_NAME(filename), std::ios::in|std::ios::binary|std::ios::ate);
 
 	/*get filesize*/
 	std::streamsize size = 0;
@@ -6102,7 +6124,7 @@ void load_file(std::vector<unsigned char>& buffer, const std::wstring& filename)
 /*write given buffer to the file, overwriting the file, it doesn't append to it.*/
 void save_file(const std::vector<unsigned char>& buffer, const std::wstring& filename)
 {
-	std::ofstream file(filename.c_str(), std::ios::out|std::ios::binary);
+	std::ofstream file(WIDE_FILE_NAME(filename), std::ios::out|std::ios::binary);
 	file.write(buffer.empty() ? 0 : (char*)&buffer[0], std::streamsize(buffer.size()));
 }
 #endif //LODEPNG_WIDE_CHARS
@@ -77,19 +77,30 @@ deflated data is the chunk length - 1.
 int regionGetBlocks(wchar_t *directory, int cx, int cz, unsigned char *block, unsigned char *data, unsigned char *blockLight, unsigned char *biome) 
 {
     wchar_t filename[256];
+
+    // open the region file - note we get the new mca 1.2 file type here!
+    swprintf_s(filename,256,L"%lsregion/r.%d.%d.mca",directory,cx>>5,cz>>5);
+
+    return regionFileGetBlocks(filename, cx, cz, block, data, blockLight, biome);
+}
+
+// As above, but from the region file named, which must be the one holding chunk cx, cz
+int regionFileGetBlocks(const wchar_t *filename, int cx, int cz, unsigned char *block, unsigned char *data, unsigned char *blockLight, unsigned char *biome)
+{
     PORTAFILE regionFile;
 #ifdef WIN32
     DWORD br;
 #endif
-    static unsigned char *buf=NULL,*out=NULL;
+    // one set of buffers and inflate state per thread, so chunks can be read on several at once
+    static THREAD_LOCAL unsigned char *buf=NULL,*out=NULL;
 
     int sectorNumber, offset, chunkLength;
 
     int status;
     bfFile bf;
 
-    static z_stream strm;
-    static int strm_initialized = 0;
+    static THREAD_LOCAL z_stream strm;
+    static THREAD_LOCAL int strm_initialized = 0;
 
     if (buf==NULL)
     {
@@ -98,8 +109,7 @@ int regionGetBlocks(wchar_t *directory, int cx, int cz, unsigned char *block, un
         out=(unsigned char*)malloc(CHUNK_INFLATE_MAX);
     }
 
-    // open the region file - note we get the new mca 1.2 file type here!
-    swprintf_s(filename,256,L"%sregion/r.%d.%d.mca",directory,cx>>5,cz>>5);
+    Timing_Start(TIMING_REGION_READ);
 
     regionFile=PortaOpen(filename);
     if (regionFile == INVALID_HANDLE_VALUE)
@@ -133,6 +143,8 @@ int regionGetBlocks(wchar_t *directory, int cx, int cz, unsigned char *block, un
     RERROR(buf[4] != 2);
 
     PortaClose(regionFile);
+    Timing_Stop(TIMING_REGION_READ);
+    Timing_Count(TIMING_BYTES_READ, 4 + 4096 * sectorNumber);
 
     // decompress chunk
 
@@ -151,8 +163,10 @@ int regionGetBlocks(wchar_t *directory, int cx, int cz, unsigned char *block, un
     strm.avail_in = chunkLength - 1;
     strm.next_in = buf + 5;
 
+    Timing_Start(TIMING_INFLATE);
     inflateReset(&strm);
     status = inflate(&strm, Z_FINISH); // decompress in one step
+    Timing_Stop(TIMING_INFLATE);
 
     if (status != Z_STREAM_END) // error inflating (not enough space?)
         return 0;
@@ -164,5 +178,8 @@ int regionGetBlocks(wchar_t *directory, int cx, int cz, unsigned char *block, un
     bf._offset = 0;
     bf.offset = &bf._offset;
 
-    return nbtGetBlocks(bf, block, data, blockLight, biome);
+    Timing_Start(TIMING_NBT_PARSE);
+    status = nbtGetBlocks(bf, block, data, blockLight, biome);
+    Timing_Stop(TIMING_NBT_PARSE);
+    return status;
 }
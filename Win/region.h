@@ -30,5 +30,6 @@ THE POSSIBILITY OF SUCH DAMAGE.
 #define __REGION_H__
 
 int regionGetBlocks(wchar_t *directory, int cx, int cz, unsigned char *block, unsigned char *data, unsigned char *blockLight, unsigned char *biome);
+int regionFileGetBlocks(const wchar_t *filename, int cx, int cz, unsigned char *block, unsigned char *data, unsigned char *blockLight, unsigned char *biome);
 
 #endif
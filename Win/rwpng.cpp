@@ -27,10 +27,17 @@ THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "stdafx.h"
 #include "rwpng.h"
+#include "zlib.h"
+#include "ParallelDeflate.h"
 
 #include <assert.h>
 
-#include <iostream>
+// PNG_COMPRESSION_* value used by writepng, set separately by each thread that writes images
+static THREAD_LOCAL int gPNGCompression = PNG_COMPRESSION_DEFAULT;
+
+static unsigned int encodepng(progimage_info *im, int channels, std::vector<unsigned char> &buffer);
+static unsigned zlibCompress( unsigned char** out, size_t* outsize, const unsigned char* in,
+    size_t insize, const LodePNGCompressSettings* settings );
 
 // from http://lodev.org/lodepng/example_decode.cpp
 
@@ -111,37 +118,100 @@ int readpngheader(progimage_info *im, wchar_t *filename)
 //Encode from raw pixels to disk with a single function call
 //The image argument has width * height RGBA pixels or width * height * 4 bytes
 // return 0 on success
+// Set how hard writepng works at compressing, for images written by the calling thread.
+void writepng_setcompression(int compression)
+{
+    gPNGCompression = compression;
+}
+
 int writepng(progimage_info *im, int channels, wchar_t *filename)
 {
     // TODOTODO need to switch to wifstream, etc.
     //char filename[MAX_PATH];
     //dumb_wcharToChar(wfilename,filename);
 
-    //Encode the image, depending on type
+    std::vector<unsigned char> buffer;
+    unsigned int error = encodepng(im, channels, buffer);
+    if ( !error )
+    {
+        lodepng::save_file(buffer, filename);
+    }
+
+    //if there's an error, display it
+    if (error)
+    {
+        //std::cout << "encoder error " << error << ": "<< lodepng_error_text(error) << std::endl;
+        return (int)error;
+    }
+
+    return 0;
+}
+
+// Encode the image into memory instead of a file. *data is malloc'ed and must be freed by the caller.
+// Returns 0 on success, as for writepng.
+int writepng_memory(progimage_info *im, int channels, unsigned char **data, size_t *size)
+{
+    std::vector<unsigned char> buffer;
+    unsigned int error = encodepng(im, channels, buffer);
+    if (error)
+        return (int)error;
+
+    *data = (unsigned char *)malloc(buffer.size());
+    if ( *data == NULL )
+        return 83;	// lodepng's "memory allocation failed"
+    memcpy(*data, &buffer[0], buffer.size());
+    *size = buffer.size();
+    return 0;
+}
+
+// Encode the image into buffer, depending on type
+static unsigned int encodepng(progimage_info *im, int channels, std::vector<unsigned char> &buffer)
+{
     unsigned int error = 1;	// 1 means didn't reach lodepng
+    lodepng::State state;
+    int level;
+
     if ( channels == 4 )
     {
         // 32 bit RGBA, the default
-        error = lodepng::encode(filename, im->image_data, (unsigned int)im->width, (unsigned int)im->height, LCT_RGBA );
+        state.info_raw.colortype = LCT_RGBA;
     }
     else if ( channels == 3 )
     {
         // 24 bit RGB
-        error = lodepng::encode(filename, im->image_data, (unsigned int)im->width, (unsigned int)im->height, LCT_RGB );
+        state.info_raw.colortype = LCT_RGB;
     }
     else
     {
         assert(0);
+        return (int)error;
     }
+    state.info_raw.bitdepth = 8;
+    state.info_png.color.colortype = state.info_raw.colortype;
+    state.info_png.color.bitdepth = 8;
 
-    //if there's an error, display it
-    if (error)
+    switch ( gPNGCompression )
     {
-        //std::cout << "encoder error " << error << ": "<< lodepng_error_text(error) << std::endl;
-        return (int)error;
+    case PNG_COMPRESSION_FAST:
+        // quickest zlib level, and the cheapest filter choice that still compresses well
+        level = 1;
+        state.encoder.filter_strategy = LFS_MINSUM;
+        break;
+    case PNG_COMPRESSION_SMALL:
+        // best zlib level, and pick filters by entropy, which is slower but usually smaller
+        level = 9;
+        state.encoder.filter_strategy = LFS_ENTROPY;
+        break;
+    default:
+        level = Z_DEFAULT_COMPRESSION;
+        break;
     }
+    // compress with zlib, on as many threads as the image is big enough for
+    state.encoder.zlibsettings.custom_zlib = zlibCompress;
+    state.encoder.zlibsettings.custom_context = &level;
 
-    return 0;
+    error = lodepng::encode(buffer, im->image_data, (unsigned int)im->width, (unsigned int)im->height, state);
+    return error;
 }
 
 
@@ -150,4 +220,9 @@ void writepng_cleanup(progimage_info *im)
     im->image_data.clear();
 }
 
-
+// lodepng custom_zlib function: custom_context points at the zlib compression level to use.
+static unsigned zlibCompress( unsigned char** out, size_t* outsize, const unsigned char* in,
+    size_t insize, const LodePNGCompressSettings* settings )
+{
+    return ParallelZlibCompress( out, outsize, in, insize, *(const int *)settings->custom_context );
+}
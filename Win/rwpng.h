@@ -40,7 +40,14 @@ int readpng(progimage_info *mainprog_ptr, wchar_t *filename);
 int readpngheader(progimage_info *im, wchar_t *filename);
 void readpng_cleanup(int free_image_data, progimage_info *mainprog_ptr);
 
+// how hard writepng works at compressing, set with writepng_setcompression
+#define PNG_COMPRESSION_DEFAULT 0
+#define PNG_COMPRESSION_FAST    1
+#define PNG_COMPRESSION_SMALL   2
+
+void writepng_setcompression(int compression);
 int writepng(progimage_info *mainprog_ptr, int channels, wchar_t *filename);
+int writepng_memory(progimage_info *mainprog_ptr, int channels, unsigned char **data, size_t *size);
 void writepng_cleanup(progimage_info *mainprog_ptr);
 
 #endif
\ No newline at end of file
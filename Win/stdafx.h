@@ -28,23 +28,34 @@ THE POSSIBILITY OF SUCH DAMAGE.
 
 #pragma once
 
+#ifdef WIN32
 #include "targetver.h"
+#endif
 #include "cache.h"
 #include "MinewaysMap.h"
 #include "ObjFileManip.h"
 #include "nbt.h"
 #include "region.h"
+#include "ExportTiming.h"
 
+#ifdef WIN32
 #define WIN32_LEAN_AND_MEAN             // Exclude rarely-used stuff from Windows headers
 // Windows Header Files:
 #include <windows.h>
 #include <commctrl.h>
+#endif
 
 // C RunTime Header Files
 #include <stdlib.h>
+#ifdef WIN32
 #include <malloc.h>
-#include <memory.h>
 #include <tchar.h>
+#else
+// lodepng.h uses the C++ library, which must come in before the min and max macros below
+#include <string>
+#include <vector>
+#endif
+#include <memory.h>
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -65,6 +76,13 @@ THE POSSIBILITY OF SUCH DAMAGE.
 #define swapint(a,b)	{int tempint = (a); (a)=(b); (b)=tempint;}
 #endif
 
+// each thread gets its own copy of a variable so marked
+#ifdef WIN32
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
 
 #ifdef WIN32
 #define PORTAFILE HANDLE
@@ -75,19 +93,194 @@ THE POSSIBILITY OF SUCH DAMAGE.
 #define PortaRead(h,buf,len) !ReadFile(h,buf,len,&br,NULL)
 #define PortaWrite(h,buf,len) !WriteFile(h,buf,(DWORD)len,&br,NULL)
 #define PortaClose(h) CloseHandle(h)
+#define PortaDelete(fn) DeleteFileW(fn)
+#define PortaMakeDirectory(dir) CreateDirectoryW(dir,NULL)
+#define PortaGetCwd(buf,size) _wgetcwd(buf,size)
+// 0 if the file can't be found
+#define PortaFileSize(fn,pSize) portaFileSize(fn,pSize)
+#define PORTA_SLASH L"\\"
+
+// threads run a DWORD WINAPI function( LPVOID param ); PortaCreateThread gives NULL if the thread can't be made
+#define PORTATHREAD HANDLE
+#define PortaCreateThread(fn,param) CreateThread(NULL,0,fn,param,0,NULL)
+#define PortaWaitForThreads(count,threads) WaitForMultipleObjects(count,threads,TRUE,INFINITE)
+#define PortaCloseThread(h) CloseHandle(h)
+// PortaIncrement gives the new value
+#define PortaIncrement(p) InterlockedIncrement(p)
+#define PortaOr(p,value) InterlockedOr(p,value)
+
+#define PORTALOCK CRITICAL_SECTION
+#define PortaInitLock(l) InitializeCriticalSection(l)
+#define PortaLock(l) EnterCriticalSection(l)
+#define PortaUnlock(l) LeaveCriticalSection(l)
+#define PortaDeleteLock(l) DeleteCriticalSection(l)
+
+// many readers or one writer
+#define PORTARWLOCK SRWLOCK
+#define PORTARWLOCK_INIT SRWLOCK_INIT
+#define PortaLockShared(l) AcquireSRWLockShared(l)
+#define PortaUnlockShared(l) ReleaseSRWLockShared(l)
+#define PortaLockExclusive(l) AcquireSRWLockExclusive(l)
+#define PortaUnlockExclusive(l) ReleaseSRWLockExclusive(l)
+
+static __inline int PortaProcessorCount()
+{
+    SYSTEM_INFO sysInfo;
+    GetSystemInfo( &sysInfo );
+    return (int)sysInfo.dwNumberOfProcessors;
+}
+
+// a high resolution clock, in ticks of 1/PortaTicksPerSecond() seconds
+static __inline long long PortaTicks()
+{
+    LARGE_INTEGER ticks;
+    QueryPerformanceCounter( &ticks );
+    return ticks.QuadPart;
+}
+
+static __inline long long PortaTicksPerSecond()
+{
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency( &frequency );
+    return frequency.QuadPart;
+}
+
+static __inline int portaFileSize( const wchar_t *fileName, unsigned long long *pSize )
+{
+    WIN32_FILE_ATTRIBUTE_DATA fileData;
+    if ( !GetFileAttributesExW( fileName, GetFileExInfoStandard, &fileData ) )
+        return 0;
+    *pSize = ((unsigned long long)fileData.nFileSizeHigh << 32) | fileData.nFileSizeLow;
+    return 1;
+}
+
+// Call fn( fileName, context ) with the name of each file in directory; directories are skipped. fn returns 0 to go
+// on, or a positive value to stop the scan, which is then returned. Returns 0 once done, -1 if directory can't be read.
+static __inline int PortaScanDirectory( const wchar_t *directory, int (*fn)(const wchar_t *, void *), void *context )
+{
+    wchar_t searchPath[MAX_PATH];
+    WIN32_FIND_DATAW ffd;
+    HANDLE hFind;
+    size_t length = wcslen( directory );
+    int rc = 0;
+
+    swprintf_s( searchPath, MAX_PATH, ( length > 0 && ( directory[length-1] == L'\\' || directory[length-1] == L'/' ) ) ? L"%ls*" : L"%ls\\*", directory );
+    hFind = FindFirstFileW( searchPath, &ffd );
+    if ( hFind == INVALID_HANDLE_VALUE )
+        return -1;
+    do
+    {
+        if ( !( ffd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ) )
+            rc = fn( ffd.cFileName, context );
+    } while ( rc == 0 && FindNextFileW( hFind, &ffd ) != 0 );
+    FindClose( hFind );
+    return rc;
+}
 #endif
 
+// The export code, and so MinewaysCmd, also builds with gcc or clang, using the calls here and in Portability.cpp
+// in place of the Win32 ones. File names stay wchar_t, and are turned into UTF-8 when a file is opened.
 #ifndef WIN32
+#include <string.h>
+#include <strings.h>
+#include <wchar.h>
+#include <wctype.h>
+#include <errno.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+
+typedef uint32_t DWORD;
+typedef int32_t LONG;
+typedef int64_t LONGLONG;
+typedef int BOOL;
+typedef unsigned char BYTE;
+typedef void *LPVOID;
+typedef wchar_t TCHAR;
+typedef int errno_t;
+#define WINAPI
+#define TRUE 1
+#define FALSE 0
+#define MAX_PATH 260
+#define __forceinline inline
+#define _countof(a) (sizeof(a)/sizeof((a)[0]))
+
 #define strncpy_s(f,n,w,m) strncpy(f,w,m)
 #define strncat_s(f,n,w,m) strncat(f,w,m)
 #define sprintf_s snprintf
+#define swprintf_s swprintf
+// the only use has its one sized string last, where the extra size argument is ignored
+#define swscanf_s swscanf
+#define _wcsicmp wcscasecmp
+#define _stricmp strcasecmp
+#define _copysign copysign
+#define _fileno fileno
+static inline errno_t strcpy_s( char *dst, size_t size, const char *src ) { snprintf( dst, size, "%s", src ); return 0; }
+static inline errno_t strcat_s( char *dst, size_t size, const char *src ) { size_t length = strlen( dst ); snprintf( dst + length, size - length, "%s", src ); return 0; }
+static inline errno_t wcsncpy_s( wchar_t *dst, size_t size, const wchar_t *src, size_t count ) { if ( count >= size ) count = size-1; wcsncpy( dst, src, count ); dst[count] = 0; return 0; }
+static inline errno_t wcscpy_s( wchar_t *dst, size_t size, const wchar_t *src ) { return wcsncpy_s( dst, size, src, size-1 ); }
+static inline errno_t wcscat_s( wchar_t *dst, size_t size, const wchar_t *src ) { size_t length = wcslen( dst ); return wcsncpy_s( dst + length, size - length, src, size - length - 1 ); }
+static inline errno_t _wcslwr_s( wchar_t *str, size_t size ) { for ( ; size > 0 && *str; str++, size-- ) *str = (wchar_t)towlower( *str ); return 0; }
+typedef time_t __time32_t;
+#define _time32 time
+static inline errno_t _localtime32_s( struct tm *pTime, const time_t *pClock ) { return ( localtime_r( pClock, pTime ) == NULL ) ? EINVAL : 0; }
+static inline errno_t asctime_s( char *buf, size_t size, const struct tm *pTime ) { return ( size < 26 || asctime_r( pTime, buf ) == NULL ) ? EINVAL : 0; }
+int sscanf_s( const char *str, const char *format, ... );
+errno_t _wfopen_s( FILE **pFile, const wchar_t *fileName, const wchar_t *mode );
+void qsort_s( void *base, size_t count, size_t size, int (*compare)(void *, const void *, const void *), void *context );
+// UTF-8 only, the one code page the export code uses
+#define CP_UTF8 65001
+#define MB_ERR_INVALID_CHARS 8
+int MultiByteToWideChar( unsigned int codePage, DWORD flags, const char *str, int length, wchar_t *wstr, int wlength );
+int WideCharToMultiByte( unsigned int codePage, DWORD flags, const wchar_t *wstr, int wlength, char *str, int length, const char *defaultChar, BOOL *usedDefault );
+
 #define PORTAFILE FILE*
-#define PortaOpen(fn) fopen(fn,"rb")
-#define PortaCreate(fn) fopen(fn,"w")
+#define INVALID_HANDLE_VALUE NULL
+#define PortaOpen(fn) portaOpen(fn,"rb")
+#define PortaCreate(fn) portaOpen(fn,"wb")
 #define PortaSeek(h,ofs) fseek(h,ofs,SEEK_SET)
 #define PortaRead(h,buf,len) fread(buf,len,1,h)!=1
 #define PortaWrite(h,buf,len) fwrite(buf,len,1,h)!=1
 #define PortaClose(h) fclose(h)
+#define PortaDelete(fn) portaDelete(fn)
+#define PortaMakeDirectory(dir) portaMakeDirectory(dir)
+#define PortaGetCwd(buf,size) portaGetCwd(buf,size)
+#define PortaFileSize(fn,pSize) portaFileSize(fn,pSize)
+#define PORTA_SLASH L"/"
+FILE *portaOpen( const wchar_t *fileName, const char *mode );
+int portaDelete( const wchar_t *fileName );
+int portaMakeDirectory( const wchar_t *dir );
+wchar_t *portaGetCwd( wchar_t *buf, int size );
+int portaFileSize( const wchar_t *fileName, unsigned long long *pSize );
+// the UTF-8 form of a wchar_t file name, as fopen and the like want
+void portaFileName( const wchar_t *fileName, char *utf8Name, int size );
+int PortaScanDirectory( const wchar_t *directory, int (*fn)(const wchar_t *, void *), void *context );
+
+#define PORTATHREAD pthread_t*
+#define PortaCreateThread(fn,param) portaCreateThread(fn,param)
+#define PortaWaitForThreads(count,threads) portaWaitForThreads(count,threads)
+#define PortaCloseThread(h) free(h)
+#define PortaIncrement(p) __sync_add_and_fetch(p,1)
+#define PortaOr(p,value) __sync_or_and_fetch(p,value)
+pthread_t *portaCreateThread( DWORD (*fn)(LPVOID), LPVOID param );
+void portaWaitForThreads( int count, pthread_t **threads );
+
+#define PORTALOCK pthread_mutex_t
+#define PortaInitLock(l) pthread_mutex_init(l,NULL)
+#define PortaLock(l) pthread_mutex_lock(l)
+#define PortaUnlock(l) pthread_mutex_unlock(l)
+#define PortaDeleteLock(l) pthread_mutex_destroy(l)
+
+#define PORTARWLOCK pthread_rwlock_t
+#define PORTARWLOCK_INIT PTHREAD_RWLOCK_INITIALIZER
+#define PortaLockShared(l) pthread_rwlock_rdlock(l)
+#define PortaUnlockShared(l) pthread_rwlock_unlock(l)
+#define PortaLockExclusive(l) pthread_rwlock_wrlock(l)
+#define PortaUnlockExclusive(l) pthread_rwlock_unlock(l)
+
+int PortaProcessorCount();
+long long PortaTicks();
+long long PortaTicksPerSecond();
 #endif
 
 #if __STDC_VERSION__ >= 199901L
@@ -12,18 +12,72 @@
 #include <windows.h>
 #include <tchar.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "tiles.h"
+// for PortaScanDirectory
+#include "../../Win/stdafx.h"
+#include "../../Win/Workers.h"
 
 //#define TILE_PATH	L".\\blocks\\"
 #define BASE_INPUT_FILENAME			L"terrainBase.png"
 #define TILE_PATH	L"blocks"
 #define OUTPUT_FILENAME L"terrainExt.png"
 
+// power of two, a few times the number of names and alternate names in gTiles
+#define TILE_HASH_SIZE 2048
+// most threads used to read and merge tiles
+#define MAX_MERGE_THREADS 16
+
+// A png file in the tile directory.
+typedef struct TileFile {
+	wchar_t fileName[MAX_PATH];
+	wchar_t path[MAX_PATH];
+	int width;
+	int readError;
+} TileFile;
+
+// Where scanTileDirectory puts the files it finds.
+typedef struct TileScan {
+	wchar_t *tilePath;
+	std::vector<TileFile> *files;
+} TileScan;
+
+// The tile files being read and merged into the output. Threads take the next file to do until there are none left.
+typedef struct MergeJob {
+	TileFile *files;
+	int numFiles;
+	int *slotFile;              // for each tile in gTiles, the file that goes there, or -1
+	progimage_info *destination;
+	int chosenTile;
+	volatile LONG nextFile;
+	volatile LONG failedFile;   // a file that could not be read, or -1
+} MergeJob;
+
+// An entry in the tile name hash table, for a name or alternate name in gTiles
+typedef struct TileNameEntry {
+	const wchar_t *name;
+	int index;          // into gTiles
+	int alternate;      // name is the alternate name
+	int next;           // next entry in the same bucket, or -1
+} TileNameEntry;
+
+static TileNameEntry gNameEntry[TOTAL_TILES*2];
+static int gNameBucket[TILE_HASH_SIZE];
+
+static void buildTileHash();
+static unsigned int hashTileName( const wchar_t *tileName );
 int findTile( wchar_t *tileName, int alternate );
 int findNextTile( wchar_t *tileName, int index, int alternate );
 int findUnneededTile( wchar_t *tileName );
 
+static int scanTileDirectory( wchar_t *tilePath, std::vector<TileFile> &files );
+static int addTileFile( const wchar_t *fileName, void *context );
+static int compareTileFiles( const void *a, const void *b );
+static int readTileWidth( wchar_t *filename, int *pWidth );
+static int mergeTiles( MergeJob *pJob );
+static DWORD WINAPI mergeTileFiles( LPVOID pParam );
+
 static void reportReadError( int rc, wchar_t *filename );
 
 static void setBlackAlphaPNGTile(int chosenTile, progimage_info *src);
@@ -48,10 +102,10 @@ int wmain(int argc, wchar_t* argv[])
 
 	int i;
 
-	int tilesFound = 0;
-	int tilesFoundArray[TOTAL_TILES];
+	std::vector<TileFile> tileFiles;
+	int slotFile[TOTAL_TILES];
 	int tilesMissingSet[TOTAL_TILES];
-	progimage_info tile[TOTAL_TILES];
+	MergeJob job;
 	int baseTileSize, xTiles, baseYTiles, baseXResolution, baseYResolution;
 	int outputTileSize, outputYTiles, outputXResolution, outputYResolution;
 
@@ -77,6 +131,11 @@ int wmain(int argc, wchar_t* argv[])
 	wcscpy_s(terrainExtOutput, MAX_PATH, OUTPUT_FILENAME );
 
 	memset( tilesMissingSet, 0, 4*TOTAL_TILES );
+	// which tile file, if any, goes into each tile of the output
+	for ( i = 0; i < TOTAL_TILES; i++ )
+	{
+		slotFile[i] = -1;
+	}
 
 	// usage: [-i terrainBase.png] [-d tiles] [-o terrainExt.png] [-t tileSize]
 	// single argument is alternate subdirectory other than "tiles"
@@ -143,7 +202,7 @@ int wmain(int argc, wchar_t* argv[])
 		else
 		{
 			// go to here-----------------------------------------------------------------------------|
-			wprintf( L"TileMaker version 2.01\n");
+			wprintf( L"TileMaker version 2.02\n");
 			wprintf( L"usage: TileMaker [-i terrainBase.png] [-d blocks] [-o terrainExt.png]\n        [-t tileSize] [-c chosenTile] [-nb] [-nt] [-r] [-m] [-v]\n");
 			wprintf( L"  -i terrainBase.png - image containing the base set of terrain blocks\n    (includes special chest tiles). Default is 'terrainBase.png'.\n");
 			wprintf( L"  -d blocks - directory of block textures to overlay on top of the base.\n    Default directory is 'blocks'.\n");
@@ -205,95 +264,74 @@ int wmain(int argc, wchar_t* argv[])
 	outputYTiles = baseYTiles;
 
 	// look through tiles in tiles directory, see which exist, find maximum Y value.
+	// Only the size of each tile is read for now; tiles are read in full when they are merged into the output.
 	if ( !notiles )
 	{
-		HANDLE hFind;
-		WIN32_FIND_DATA ffd;
-
-		wchar_t tileSearch[MAX_PATH];
-		wcscpy_s( tileSearch, MAX_PATH, tilePath );
-		wcscat_s( tileSearch, MAX_PATH, L"*.png" );
-		hFind=FindFirstFile(tileSearch,&ffd);
-
-		if (hFind == INVALID_HANDLE_VALUE) 
+		if ( !scanTileDirectory( tilePath, tileFiles ) )
 		{
-			printf ("ERROR: FindFirstFile failed (error # %d).\n", GetLastError());
 			wprintf (L"No files found - please put your new blocks in the directory %s.\n", tilePath);
 			return 1;
-		} 
-		else 
-		{
-			do {
-				wchar_t tileName[MAX_PATH];
-				int len;
+		}
 
-				if ( verbose )
-					wprintf (L"The file found is %s\n", ffd.cFileName);
+		buildTileHash();
+		for ( i = 0; i < (int)tileFiles.size(); i++ )
+		{
+			wchar_t tileName[MAX_PATH];
+			int index;
+			int used = 0;
+
+			if ( verbose )
+				wprintf (L"The file found is %s\n", tileFiles[i].fileName);
+
+			// remove .png suffix
+			wcscpy_s( tileName, MAX_PATH, tileFiles[i].fileName );
+			tileName[wcslen(tileName)-4] = 0x0;
+			index = findTile(tileName, alternate);
+			if ( index < 0 )
+			{
+				// see if tile is on unneeded list
+				if ( findUnneededTile( tileFiles[i].fileName ) < 0 )
+					wprintf (L"WARNING: %s is a tile name that TileMaker does not understand. Perhaps you need to rename it?\nSee https://github.com/erich666/Mineways/blob/master/tilemaker/TileMaker/tiles.h for the image file names used.\n", tileFiles[i].fileName);
+			}
 
-				wcscpy_s( tileName, MAX_PATH, ffd.cFileName );
-				// check for .png suffix - note test is case insensitive
-				len = (int)wcslen(tileName);
-				if ( _wcsicmp( &tileName[len-4], L".png" ) == 0 )
+			while ( index >= 0 )
+			{
+				// tile is one we care about. A later file replaces an earlier one for the same tile,
+				// unless -r is on, in which case the first one is used.
+				if ( onlyreplace && slotFile[index] >= 0 )
 				{
-					int index;
-					// remove .png suffix
-					tileName[len-4] = 0x0;
-					index = findTile(tileName, alternate);
-					if ( index < 0 )
-					{
-                        // see if tile is on unneeded list
-                        if ( findUnneededTile( ffd.cFileName ) < 0 )
-						    wprintf (L"WARNING: %s is a tile name that TileMaker does not understand. Perhaps you need to rename it?\nSee https://github.com/erich666/Mineways/blob/master/tilemaker/TileMaker/tiles.h for the image file names used.\n", ffd.cFileName);
-					}
-
-					while ( index >= 0 )
-					{
-						// tile is one we care about.
-						tilesFoundArray[tilesFound] = index;
+					wprintf (L"UNUSED: %s was not used because there is already a tile.\n", gTiles[index].filename);
+				}
+				else
+				{
+					slotFile[index] = i;
+				}
+				tilesMissingSet[index] = 1;	// note tile is used
+				used = 1;
 
-						{
-							// read image file - build path
-							wchar_t readFileName[MAX_PATH];
-							wcscpy_s( readFileName, MAX_PATH, tilePath );
-							wcscat_s( readFileName, MAX_PATH, ffd.cFileName );
-							// read in tile for later
-							rc = readpng(&tile[tilesFound], readFileName);
-							if ( rc != 0 )
-							{
-								reportReadError(rc,readFileName);
-								return 1;
-							}
-							readpng_cleanup(0,&tile[tilesFound]);
-						}
+				// find maximum Y resolution of output tile
+				if ( outputYTiles-1 < gTiles[index].txrY )
+				{
+					outputYTiles = gTiles[index].txrY + 1;
+				}
+				index = findNextTile(tileName, index, alternate);
+			}
 
-						// check for unsupported formats
-						//if ( 
-						//	//( tile[tilesFound].bit_depth == 8 || tile[tilesFound].bit_depth == 4 ) &&
-						//	 ( tile[tilesFound].color_type == PNG_COLOR_TYPE_RGB_ALPHA || 
-						//	   tile[tilesFound].color_type == PNG_COLOR_TYPE_RGB || 
-						//	   tile[tilesFound].color_type == PNG_COLOR_TYPE_GRAY || 
-						//	   tile[tilesFound].color_type == PNG_COLOR_TYPE_PALETTE ))
-						{
-							tilesMissingSet[index] = 1;	// note tile is used
-							tilesFound++;
-
-							// find maximum Y resolution of output tile
-							if ( outputYTiles-1 < gTiles[index].txrY )
-							{
-								outputYTiles = gTiles[index].txrY + 1;
-							}
-						}
-						//else
-						//{
-						//	// unknown format
-						//	_tprintf (TEXT("WARNING: file %s not used because unsupported bit depth %d and color type %d\n"), ffd.cFileName, tile[tilesFound].bit_depth, tile[tilesFound].color_type );
-						//}
-						index = findNextTile(tileName, index, alternate);
-					}
+			if ( used )
+			{
+				rc = readTileWidth(tileFiles[i].path, &tileFiles[i].width);
+				if ( rc != 0 )
+				{
+					reportReadError(rc,tileFiles[i].path);
+					return 1;
 				}
-			} while (FindNextFile(hFind,&ffd)!=0);
 
-			FindClose(hFind);
+				// find largest tile. Hmmm, beware of flowing lava & water, which is twice as wide.
+				if ( overlayTileSize < tileFiles[i].width )
+				{
+					overlayTileSize = tileFiles[i].width;
+				}
+			}
 		}
 	}
 
@@ -311,15 +349,6 @@ int wmain(int argc, wchar_t* argv[])
 		}
 	}
 
-	// find largest tile. Hmmm, beware of flowing lava & water, which is twice as wide.
-	for ( i = 0; i < tilesFound; i++ )
-	{
-		if ( overlayTileSize < tile[i].width )
-		{
-			overlayTileSize = tile[i].width;
-		}
-	}
-
 	if ( verbose )
 		wprintf (L"Largest tile found is %d pixels wide.\n", overlayTileSize);
 
@@ -358,26 +387,40 @@ int wmain(int argc, wchar_t* argv[])
 			wprintf (L"Base texture %s copied to output.\n", terrainBase);
 	}
 
-	// copy tiles found over
-	for ( i = 0; i < tilesFound; i++ )
+	// -r option on? Then tiles already in the base texture are kept.
+	if ( onlyreplace )
 	{
-		int index = tilesFoundArray[i];
-		// -r option on?
-		if ( onlyreplace )
+		for ( i = 0; i < TOTAL_TILES; i++ )
 		{
-			if ( !isPNGTileEmpty(destination_ptr, gTiles[index].txrX, gTiles[index].txrY) )
+			if ( slotFile[i] >= 0 && !isPNGTileEmpty(destination_ptr, gTiles[i].txrX, gTiles[i].txrY) )
 			{
-				wprintf (L"UNUSED: %s was not used because there is already a tile.\n", gTiles[index].filename);
-				continue;
+				wprintf (L"UNUSED: %s was not used because there is already a tile.\n", gTiles[i].filename);
+				slotFile[i] = -1;
 			}
 		}
-		if ( gTiles[index].flags & SBIT_BLACK_ALPHA )
+	}
+
+	// read tiles found and copy them over, each right after it is read
+	if ( tileFiles.size() > 0 )
+	{
+		job.files = &tileFiles[0];
+		job.numFiles = (int)tileFiles.size();
+		job.slotFile = slotFile;
+		job.destination = destination_ptr;
+		job.chosenTile = chosenTile;
+		if ( !mergeTiles( &job ) )
 		{
-			setBlackAlphaPNGTile( chosenTile, &tile[i] );
+			reportReadError(tileFiles[job.failedFile].readError,tileFiles[job.failedFile].path);
+			return 1;
+		}
+	}
+	if ( verbose )
+	{
+		for ( i = 0; i < TOTAL_TILES; i++ )
+		{
+			if ( slotFile[i] >= 0 )
+				wprintf (L"File %s merged.\n", tileFiles[slotFile[i]].fileName);
 		}
-		copyPNGTile(destination_ptr, gTiles[index].txrX, gTiles[index].txrY, chosenTile, &tile[i]);
-		if ( verbose )
-			wprintf (L"File %s merged.\n", gTiles[index].filename);
 	}
 
 	// write out the result
@@ -394,30 +437,68 @@ int wmain(int argc, wchar_t* argv[])
 	return 0;
 }
 
-int findTile( wchar_t *tileName, int alternate )
+// Put each tile name and alternate name in gTiles into the hash table. A name can be used by more than one tile,
+// so entries are added to the end of their bucket, keeping each bucket in gTiles order for findNextTile.
+static void buildTileHash()
 {
-	int i;
+	int i, alt, bucket, entry;
+	int numEntries = 0;
+	int bucketTail[TILE_HASH_SIZE];
 
+	for ( i = 0; i < TILE_HASH_SIZE; i++ )
+	{
+		gNameBucket[i] = -1;
+	}
 	for ( i = 0; i < TOTAL_TILES; i++ )
 	{
-		if ( wcscmp(tileName, gTiles[i].filename) == 0 )
-			return i;
-        if ( alternate && wcscmp(tileName, gTiles[i].altFilename) == 0 )
-            return i;
+		for ( alt = 0; alt < 2; alt++ )
+		{
+			const wchar_t *name = alt ? gTiles[i].altFilename : gTiles[i].filename;
+			if ( name == NULL || name[0] == 0x0 )
+				continue;
+			entry = numEntries++;
+			gNameEntry[entry].name = name;
+			gNameEntry[entry].index = i;
+			gNameEntry[entry].alternate = alt;
+			gNameEntry[entry].next = -1;
+			bucket = hashTileName( name );
+			if ( gNameBucket[bucket] < 0 )
+				gNameBucket[bucket] = entry;
+			else
+				gNameEntry[bucketTail[bucket]].next = entry;
+			bucketTail[bucket] = entry;
+		}
 	}
-	return -1;
 }
 
+// FNV-1a
+static unsigned int hashTileName( const wchar_t *tileName )
+{
+	unsigned int hash = 2166136261u;
+	while ( *tileName )
+	{
+		hash ^= (unsigned int)*tileName++;
+		hash *= 16777619u;
+	}
+	return hash & (TILE_HASH_SIZE-1);
+}
+
+int findTile( wchar_t *tileName, int alternate )
+{
+	return findNextTile( tileName, -1, alternate );
+}
+
+// find the next tile after index that uses this name
 int findNextTile( wchar_t *tileName, int index, int alternate )
 {
-	int i;
+	int entry;
 
-	for ( i = index+1; i < TOTAL_TILES; i++ )
+	for ( entry = gNameBucket[hashTileName(tileName)]; entry >= 0; entry = gNameEntry[entry].next )
 	{
-        if ( wcscmp(tileName, gTiles[i].filename) == 0 )
-            return i;
-        if ( alternate && wcscmp(tileName, gTiles[i].altFilename) == 0 )
-            return i;
+		if ( gNameEntry[entry].index > index &&
+			( alternate || !gNameEntry[entry].alternate ) &&
+			wcscmp(tileName, gNameEntry[entry].name) == 0 )
+			return gNameEntry[entry].index;
 	}
 	return -1;
 }
@@ -442,6 +523,153 @@ int findUnneededTile( wchar_t *tileName )
 
 //====================== statics ==========================
 
+// Find the .png files in the tile directory, sorted by name so that which of two files for the same tile is used
+// doesn't depend on the order the file system lists them in. Returns 0 if the directory can't be read.
+static int scanTileDirectory( wchar_t *tilePath, std::vector<TileFile> &files )
+{
+	TileScan scan;
+
+	scan.tilePath = tilePath;
+	scan.files = &files;
+	if ( PortaScanDirectory( tilePath, addTileFile, &scan ) != 0 )
+	{
+		wprintf (L"ERROR: cannot read the directory %s.\n", tilePath);
+		return 0;
+	}
+	if ( files.size() == 0 )
+		return 0;
+
+	if ( files.size() > 1 )
+		qsort( &files[0], files.size(), sizeof(TileFile), compareTileFiles );
+	return 1;
+}
+
+static int addTileFile( const wchar_t *fileName, void *context )
+{
+	TileScan *pScan = (TileScan *)context;
+	TileFile tileFile;
+	size_t len = wcslen(fileName);
+
+	// check for .png suffix - note test is case insensitive
+	if ( len > 4 && _wcsicmp( &fileName[len-4], L".png" ) == 0 )
+	{
+		wcscpy_s( tileFile.fileName, MAX_PATH, fileName );
+		wcscpy_s( tileFile.path, MAX_PATH, pScan->tilePath );
+		wcscat_s( tileFile.path, MAX_PATH, fileName );
+		tileFile.width = 0;
+		tileFile.readError = 0;
+		pScan->files->push_back( tileFile );
+	}
+	return 0;
+}
+
+static int compareTileFiles( const void *a, const void *b )
+{
+	return _wcsicmp( ((const TileFile *)a)->fileName, ((const TileFile *)b)->fileName );
+}
+
+// Read just the header of a png file, to get its width. Returns 0 on success, else a lodepng error.
+static int readTileWidth( wchar_t *filename, int *pWidth )
+{
+	FILE *fh;
+	unsigned char header[33];   // signature and IHDR chunk
+	size_t headerSize;
+	unsigned int width, height;
+	unsigned int error;
+	LodePNGState state;
+
+	if ( _wfopen_s( &fh, filename, L"rb" ) != 0 )
+		return 78;  // lodepng's "failed to open file for reading"
+	headerSize = fread( header, 1, sizeof(header), fh );
+	fclose( fh );
+
+	lodepng_state_init( &state );
+	error = lodepng_inspect( &width, &height, &state, header, headerSize );
+	lodepng_state_cleanup( &state );
+	if ( error )
+		return (int)error;
+	*pWidth = (int)width;
+	return 0;
+}
+
+// Read the tile files and copy each into its tiles in the destination, on several threads.
+// Each tile of the destination gets at most one file, so threads never write to the same pixels.
+// Returns 0 if a file could not be read; pJob->failedFile is then that file.
+static int mergeTiles( MergeJob *pJob )
+{
+	SYSTEM_INFO sysInfo;
+	int numWorkers;
+
+	pJob->nextFile = 0;
+	pJob->failedFile = -1;
+
+	GetSystemInfo( &sysInfo );
+	numWorkers = (int)sysInfo.dwNumberOfProcessors;
+	if ( numWorkers > pJob->numFiles )
+		numWorkers = pJob->numFiles;
+	if ( numWorkers > MAX_MERGE_THREADS )
+		numWorkers = MAX_MERGE_THREADS;
+
+	// this thread is one of the workers; if a thread can't be made, the others simply take more files
+	RunOnWorkers( mergeTileFiles, pJob, numWorkers );
+	return ( pJob->failedFile < 0 );
+}
+
+static DWORD WINAPI mergeTileFiles( LPVOID pParam )
+{
+	MergeJob *pJob = (MergeJob *)pParam;
+	progimage_info tile;
+	int file, index, pass, rc;
+	int used, blackAlpha;
+
+	while ( pJob->failedFile < 0 )
+	{
+		// InterlockedIncrement returns the new value, so subtract one to get the file this thread took
+		file = (int)InterlockedIncrement(&pJob->nextFile) - 1;
+		if ( file >= pJob->numFiles )
+			break;
+
+		used = blackAlpha = 0;
+		for ( index = 0; index < TOTAL_TILES; index++ )
+		{
+			if ( pJob->slotFile[index] == file )
+			{
+				used = 1;
+				if ( gTiles[index].flags & SBIT_BLACK_ALPHA )
+					blackAlpha = 1;
+			}
+		}
+		if ( !used )
+			continue;
+
+		rc = readpng(&tile, pJob->files[file].path);
+		if ( rc != 0 )
+		{
+			pJob->files[file].readError = rc;
+			InterlockedCompareExchange(&pJob->failedFile, file, -1);
+			break;
+		}
+
+		// tiles that treat black as clear change the image, so are copied after the others
+		for ( pass = 0; pass < 1 + blackAlpha; pass++ )
+		{
+			if ( pass == 1 )
+				setBlackAlphaPNGTile( pJob->chosenTile, &tile );
+			for ( index = 0; index < TOTAL_TILES; index++ )
+			{
+				if ( pJob->slotFile[index] == file &&
+					( ( gTiles[index].flags & SBIT_BLACK_ALPHA ) != 0 ) == ( pass == 1 ) )
+				{
+					copyPNGTile(pJob->destination, gTiles[index].txrX, gTiles[index].txrY, pJob->chosenTile, &tile);
+				}
+			}
+		}
+		// lodepng adds to the end of the image data, so clear it for the next file
+		readpng_cleanup(1,&tile);
+	}
+	return 0;
+}
+
 static void reportReadError( int rc, wchar_t *filename )
 {
 	switch (rc) {
@@ -27,11 +27,16 @@ THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "stdafx.h"
 #include "rwpng.h"
+#include "../../Win/zlib.h"
+#include "../../Win/ParallelDeflate.h"
 
 #include <assert.h>
 
 #include <iostream>
 
+static unsigned zlibCompress( unsigned char** out, size_t* outsize, const unsigned char* in,
+	size_t insize, const LodePNGCompressSettings* settings );
+
 // from http://lodev.org/lodepng/example_decode.cpp
 
 //Decode from disk to raw pixels with a single function call
@@ -85,20 +90,38 @@ int writepng(progimage_info *im, int channels, wchar_t *filename)
 
 	//Encode the image, depending on type
 	unsigned int error = 1;	// 1 means didn't reach lodepng
+	lodepng::State state;
+	std::vector<unsigned char> buffer;
+	int level = Z_DEFAULT_COMPRESSION;
+
 	if ( channels == 4 )
 	{
 		// 32 bit RGBA, the default - note, we could leave off the last arg, and lodepng
 		// will then find the best compact format (e.g. 8 bits), but that kills G3D.
-		error = lodepng::encode(filename, im->image_data, (unsigned int)im->width, (unsigned int)im->height, LCT_RGBA );
+		state.info_raw.colortype = LCT_RGBA;
 	}
 	else if ( channels == 3 )
 	{
 		// 24 bit RGB
-		error = lodepng::encode(filename, im->image_data, (unsigned int)im->width, (unsigned int)im->height, LCT_RGB );
+		state.info_raw.colortype = LCT_RGB;
 	}
 	else
 	{
 		assert(0);
+		return (int)error;
+	}
+	state.info_raw.bitdepth = 8;
+	state.info_png.color.colortype = state.info_raw.colortype;
+	state.info_png.color.bitdepth = 8;
+
+	// compress with zlib, on as many threads as the image is big enough for
+	state.encoder.zlibsettings.custom_zlib = zlibCompress;
+	state.encoder.zlibsettings.custom_context = &level;
+
+	error = lodepng::encode(buffer, im->image_data, (unsigned int)im->width, (unsigned int)im->height, state);
+	if ( !error )
+	{
+		lodepng::save_file(buffer, filename);
 	}
 
 	//if there's an error, display it
@@ -117,4 +140,9 @@ void writepng_cleanup(progimage_info *im)
 	im->image_data.clear();
 }
 
-
+// lodepng custom_zlib function: custom_context points at the zlib compression level to use.
+static unsigned zlibCompress( unsigned char** out, size_t* outsize, const unsigned char* in,
+	size_t insize, const LodePNGCompressSettings* settings )
+{
+	return ParallelZlibCompress( out, outsize, in, insize, *(const int *)settings->custom_context );
+}